@@ -0,0 +1,118 @@
+// Backpressure policies of FrameQueue against a synthetic slow consumer, no camera needed.
+// A producer stamps frames at a fixed rate into a pool-backed queue; the consumer takes
+// consumer_ms per frame and stalls for 5x that every 50th frame. Every policy runs without and
+// with the RateAdapter feedback loop (adapt). Reports per run: frames delivered per second, the
+// age of the frames at the consumer (capture to pop), drops per reason, frames the producer
+// skipped on feedback and the keep ratio it ended at, and pool slots filled per delivered frame
+// (1.00 = no frame produced in vain). Checks that every pushed frame was delivered or dropped.
+//
+// Usage: bench_backpressure [producer_fps] [consumer_ms] [seconds] [queue_size] [frame_bytes]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.h"
+#include "latency_histogram.h"
+
+typedef std::vector<uint8_t> Buffer;
+
+struct Result {
+    uint64_t pushed;
+    uint64_t filled;
+    uint64_t delivered;
+    uint64_t skipped;
+    unsigned keep_every;
+    LatencyHistogram age;
+};
+
+static bool run(const std::string& policy, bool adapt, int producer_fps, int consumer_ms, int seconds,
+                size_t queue_size, size_t frame_bytes) {
+    BackpressureConfig config;
+    parseBackpressure(policy, config);
+    FramePool<Buffer> pool(queue_size + 3, [frame_bytes](Buffer& b) { b.resize(frame_bytes); });
+    FrameQueue<Buffer> queue(queue_size, config);
+    Result r;
+    r.pushed = r.filled = r.delivered = r.skipped = 0;
+    r.keep_every = 1;
+
+    std::thread consumer([&] {
+        FrameRef<Buffer> frame;
+        uint64_t count = 0;
+        while (queue.pop(frame, 1000)) {
+            r.age.record((frameQueueNowNs() - frame.timestamp()) / 1000);
+            r.delivered++;
+            int ms = ++count % 50 == 0 ? consumer_ms * 5 : consumer_ms;
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            frame.reset();
+        }
+    });
+
+    // Producer: a camera delivering producer_fps whatever happens downstream
+    RateAdapter<Buffer> rate(queue);
+    std::chrono::steady_clock::duration period = std::chrono::nanoseconds(1000000000LL / producer_fps);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = next + std::chrono::seconds(seconds);
+    uint64_t seq = 0;
+    while (next < end) {
+        std::this_thread::sleep_until(next);
+        next += period;
+        seq++;
+        if (adapt && !rate.keep()) {
+            continue;
+        }
+        FrameRef<Buffer> frame = pool.acquire();
+        if (!frame) {
+            continue;
+        }
+        memset(frame->data(), (int)(seq & 0xff), frame->size());  // "capture" into the slot
+        frame.seq() = seq;
+        frame.timestamp() = frameQueueNowNs();
+        r.filled++;
+        r.pushed++;
+        queue.push(frame);
+    }
+    r.skipped = rate.skipped();
+    r.keep_every = rate.keepEvery();
+    queue.stop();
+    consumer.join();
+
+    uint64_t dropped = queue.dropped();
+    bool ok = r.delivered + dropped == r.pushed;
+    printf("%-18s %-5s delivered=%6.1f/s  age p50=%6.1f p99=%6.1f max=%6.1f ms  dropped", policy.c_str(),
+           adapt ? "adapt" : "-", (double)r.delivered / seconds, r.age.percentile(50) / 1000.0,
+           r.age.percentile(99) / 1000.0, r.age.max() / 1000.0);
+    for (int reason = 0; reason < DROP_REASON_COUNT; reason++) {
+        printf(" %s=%llu", dropReasonName(reason), (unsigned long long)queue.dropped((DropReason)reason));
+    }
+    printf("  skipped=%llu keep=1/%u  filled/delivered=%.2f  %s\n", (unsigned long long)r.skipped, r.keep_every,
+           r.delivered ? (double)r.filled / r.delivered : 0.0, ok ? "ok" : "FAIL");
+    if (!ok) {
+        printf("check fail: pushed=%llu delivered=%llu dropped=%llu\n", (unsigned long long)r.pushed,
+               (unsigned long long)r.delivered, (unsigned long long)dropped);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int producer_fps = argc > 1 ? atoi(argv[1]) : 120;
+    int consumer_ms = argc > 2 ? atoi(argv[2]) : 20;
+    int seconds = argc > 3 ? atoi(argv[3]) : 3;
+    size_t queue_size = argc > 4 ? atoi(argv[4]) : 4;
+    size_t frame_bytes = argc > 5 ? atoi(argv[5]) : 1920 * 1080 * 3 / 2;
+
+    printf("producer %d fps, consumer %d ms/frame (stall every 50th), queue %zu, %zu byte frames\n", producer_fps,
+           consumer_ms, queue_size, frame_bytes);
+    const char* policies[] = {"drop-oldest", "drop-newest", "keep-every=3", "latency-target=50"};
+    bool ok = true;
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        ok = run(policies[p], false, producer_fps, consumer_ms, seconds, queue_size, frame_bytes) && ok;
+        ok = run(policies[p], true, producer_fps, consumer_ms, seconds, queue_size, frame_bytes) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+// Multi-stream capture manager on live videotestsrc streams, no camera needed. Half the streams
+// run at the given frame rate and half at half of it; one simulated backend (a sleep of
+// infer_ms per frame, like waiting for the NPU) is paced to the target aggregate frame rate.
+// Prints the stats once a second, then per stream: captured and inferred frames, drops and
+// latency from capture to the end of inference. Fairness is Jain's index over the inference
+// rates (1 = every stream got the same share). Fails if a stream was starved.
+//
+// Usage: bench_capture_manager [streams|config] [target_fps] [infer_ms] [seconds] [width] [height] [fps]
+// streams defaults to running 8 and then 16; a config file is read with loadStreamConfig().
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "capture_manager.h"
+
+static bool run(const std::vector<StreamConfig>& streams, double target_fps, int infer_ms, int seconds) {
+    CaptureManager manager(streams, target_fps);
+    unsigned sum = 0;
+    bool started = manager.start([&](int, const GstFrame& frame) {
+        const uint8_t* y = frame.plane(0);
+        if (y) {
+            sum += y[0];
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(infer_ms));
+    });
+    if (!started) {
+        return false;
+    }
+
+    printf("---- %zu streams, target %.1f fps, backend %d ms/frame\n", streams.size(), target_fps, infer_ms);
+    for (int s = 0; s < seconds && manager.isRunning(); s++) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::vector<StreamStats> stats = manager.stats();
+        double infer_fps = 0;
+        uint64_t dropped = 0;
+        LatencyHistogram latency;
+        for (size_t i = 0; i < stats.size(); i++) {
+            infer_fps += stats[i].infer_fps;
+            dropped += stats[i].dropped + stats[i].pool_dropped;
+            latency.merge(stats[i].latency);
+        }
+        printf("[%2ds] infer %6.1f fps | dropped %llu | latency p50 %.1f p99 %.1f ms\n", s + 1, infer_fps,
+               (unsigned long long)dropped, latency.percentile(50) / 1000.0, latency.percentile(99) / 1000.0);
+    }
+    manager.stop();
+
+    manager.printStats(std::cout);
+    std::vector<StreamStats> stats = manager.stats();
+    double total = 0, squares = 0;
+    bool starved = false;
+    for (size_t i = 0; i < stats.size(); i++) {
+        total += stats[i].infer_fps;
+        squares += stats[i].infer_fps * stats[i].infer_fps;
+        starved = starved || stats[i].inferred == 0;
+    }
+    double fairness = squares > 0 ? total * total / (stats.size() * squares) : 0;
+    printf("fairness %.3f%s (%u)\n\n", fairness, starved ? ", a stream was starved" : "", sum & 0xff);
+    return !starved;
+}
+
+int main(int argc, char** argv) {
+    std::string streams_arg = argc > 1 ? argv[1] : "";
+    double target_fps = argc > 2 ? atof(argv[2]) : 120;
+    int infer_ms = argc > 3 ? atoi(argv[3]) : 5;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    int width = argc > 5 ? atoi(argv[5]) : 640;
+    int height = argc > 6 ? atoi(argv[6]) : 360;
+    int fps = argc > 7 ? atoi(argv[7]) : 30;
+
+    gst_init(&argc, &argv);
+
+    if (!streams_arg.empty() && !isdigit((unsigned char)streams_arg[0])) {
+        std::vector<StreamConfig> streams;
+        if (!loadStreamConfig(streams_arg, streams) || streams.empty()) {
+            return 1;
+        }
+        return run(streams, target_fps, infer_ms, seconds) ? 0 : 1;
+    }
+
+    std::vector<int> counts;
+    if (streams_arg.empty()) {
+        counts.push_back(8);
+        counts.push_back(16);
+    } else {
+        counts.push_back(atoi(streams_arg.c_str()));
+    }
+    bool ok = true;
+    for (size_t c = 0; c < counts.size(); c++) {
+        std::vector<StreamConfig> streams(counts[c]);
+        for (int i = 0; i < counts[c]; i++) {
+            streams[i].name = "test" + std::to_string(i);
+            streams[i].source = "videotestsrc is-live=true pattern=" + std::to_string(i % 20);
+            streams[i].width = width;
+            streams[i].height = height;
+            streams[i].fps = i % 2 ? fps / 2 : fps;
+        }
+        ok = run(streams, target_fps, infer_ms, seconds) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+// Benchmark of FrameQueue: 1 to 8 producers push frames into a drop-oldest queue drained by 1 to
+// 8 consumers. Compares the lock-free ring of pooled frame references with the previous
+// std::mutex + clone() queue. Needs neither OpenCV nor a camera.
+//
+// Both queues get the same load: each producer offers a frame every producer_us and each
+// consumer spends consumer_us on a frame, so their drop rates are comparable. A producer that
+// can not keep its pace (the mutex queue copies every frame) shows up as a lower push rate.
+// With producer_us and consumer_us at 0 both sides run flat out, which measures contention only:
+// drops then depend on how fast each producer is and can not be compared.
+//
+// Checks that every pushed frame is either popped or dropped, that each consumer sees the frames
+// of a producer in order and intact, and that every pool slot comes back. Exits with 1 on failure.
+//
+// Usage: bench_frame_queue [frames_per_producer] [frame_bytes] [queue_size] [producer_us] [consumer_us]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.h"
+
+typedef std::vector<uint8_t> Buffer;
+
+// The queue of camera-gstreamer/main.cpp before the ring, Buffer copies standing in for clone()
+class MutexFrameQueue {
+private:
+    std::queue<Buffer> queue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    size_t max_size_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> dropped_;
+
+public:
+    explicit MutexFrameQueue(size_t max_size) : max_size_(max_size), running_(true), dropped_(0) {}
+
+    void push(const Buffer& frame) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (queue_.size() >= max_size_ && running_) {
+            queue_.pop();
+            dropped_++;
+        }
+        if (running_) {
+            queue_.push(frame);
+            cond_.notify_one();
+        }
+    }
+
+    bool pop(Buffer& frame, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                            [this] { return !queue_.empty() || !running_; })) {
+            return false;
+        }
+        if (queue_.empty()) {
+            return false;
+        }
+        frame = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    uint64_t dropped() const { return dropped_; }
+};
+
+// Same load for both queues
+struct Load {
+    int producer_us;  // interval between the frames of one producer, 0: as fast as it can
+    int consumer_us;  // time a consumer spends on each frame, 0: none
+};
+
+// Keeps a producer at one frame per interval; a late producer does not catch up with a burst
+static void pace(std::chrono::steady_clock::time_point& next, int interval_us) {
+    if (interval_us <= 0) {
+        return;
+    }
+    next += std::chrono::microseconds(interval_us);
+    auto now = std::chrono::steady_clock::now();
+    if (next < now) {
+        next = now;
+    }
+    std::this_thread::sleep_until(next);
+}
+
+static void consume(int consumer_us) {
+    if (consumer_us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(consumer_us));
+    }
+}
+
+struct Result {
+    double seconds;
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;
+    uint64_t errors;
+};
+
+// A frame carries its producer, its sequence number and the inverse of both
+static void stamp(uint8_t* data, uint32_t producer, uint32_t seq) {
+    uint32_t header[4] = {producer, seq, ~producer, ~seq};
+    memcpy(data, header, sizeof(header));
+}
+
+// Returns false if the frame is torn; last[producer] is the last sequence number this consumer saw
+static bool verify(const uint8_t* data, std::vector<int64_t>& last) {
+    uint32_t header[4];
+    memcpy(header, data, sizeof(header));
+    if (header[2] != ~header[0] || header[3] != ~header[1] || header[0] >= last.size()) {
+        return false;
+    }
+    if ((int64_t)header[1] <= last[header[0]]) {
+        return false;
+    }
+    last[header[0]] = header[1];
+    return true;
+}
+
+static Result run_lockfree(int producers, int consumers, int frames, size_t frame_bytes, size_t queue_size,
+                           const Load& load) {
+    // queued frames + one being written per producer + one held per consumer
+    FramePool<Buffer> pool(queue_size + producers + consumers, [&](Buffer& b) { b.resize(frame_bytes); });
+    FrameQueue<Buffer> queue(queue_size);
+    std::atomic<uint64_t> popped(0), errors(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; c++) {
+        threads.push_back(std::thread([&] {
+            std::vector<int64_t> last(producers, -1);
+            FrameRef<Buffer> frame;
+            uint64_t n = 0, bad = 0;
+            while (queue.pop(frame, 100) || queue.is_running() || queue.size() > 0) {
+                if (!frame) {
+                    continue;
+                }
+                if (!verify(frame->data(), last)) {
+                    bad++;
+                }
+                n++;
+                consume(load.consumer_us);
+                frame.reset();
+            }
+            popped += n;
+            errors += bad;
+        }));
+    }
+    std::vector<std::thread> writers;
+    for (int p = 0; p < producers; p++) {
+        writers.push_back(std::thread([&, p] {
+            auto next = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) {
+                FrameRef<Buffer> frame = pool.acquire();
+                while (!frame) {
+                    std::this_thread::yield();
+                    frame = pool.acquire();
+                }
+                stamp(frame->data(), p, i);
+                queue.push(frame);
+                frame.reset();
+                pace(next, load.producer_us);
+            }
+        }));
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    queue.stop();
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    Result r;
+    r.seconds = std::chrono::duration<double>(end - start).count();
+    r.pushed = (uint64_t)producers * frames;
+    r.popped = popped;
+    r.dropped = queue.dropped();
+    r.errors = errors;
+    if (pool.available() != pool.size()) {
+        printf("check fail: %zu of %zu pool slots not returned\n", pool.size() - pool.available(), pool.size());
+        r.errors++;
+    }
+    return r;
+}
+
+static Result run_mutex(int producers, int consumers, int frames, size_t frame_bytes, size_t queue_size,
+                        const Load& load) {
+    MutexFrameQueue queue(queue_size);
+    std::atomic<uint64_t> popped(0), errors(0);
+    std::atomic<int> producing(producers);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; c++) {
+        threads.push_back(std::thread([&] {
+            std::vector<int64_t> last(producers, -1);
+            Buffer frame;
+            uint64_t n = 0, bad = 0;
+            while (producing > 0 || queue.size() > 0) {
+                if (!queue.pop(frame, 100)) {
+                    continue;
+                }
+                if (!verify(frame.data(), last)) {
+                    bad++;
+                }
+                n++;
+                consume(load.consumer_us);
+            }
+            popped += n;
+            errors += bad;
+        }));
+    }
+    std::vector<std::thread> writers;
+    for (int p = 0; p < producers; p++) {
+        writers.push_back(std::thread([&, p] {
+            Buffer frame(frame_bytes);
+            auto next = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) {
+                stamp(frame.data(), p, i);
+                queue.push(frame);
+                pace(next, load.producer_us);
+            }
+            producing--;
+        }));
+    }
+    for (auto& t : writers) {
+        t.join();
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    queue.stop();
+    auto end = std::chrono::steady_clock::now();
+
+    Result r;
+    r.seconds = std::chrono::duration<double>(end - start).count();
+    r.pushed = (uint64_t)producers * frames;
+    r.popped = popped;
+    r.dropped = queue.dropped();
+    r.errors = errors;
+    return r;
+}
+
+static bool report(const char* name, int producers, int consumers, const Result& r) {
+    bool ok = r.errors == 0 && r.popped + r.dropped == r.pushed;
+    printf("%-9s %2dP %2dC  push=%10.0f/s  pop=%10.0f/s  dropped=%5.1f%%  %s\n", name, producers, consumers,
+           r.pushed / r.seconds, r.popped / r.seconds, 100.0 * r.dropped / r.pushed, ok ? "ok" : "FAIL");
+    if (!ok) {
+        printf("check fail: pushed=%llu popped=%llu dropped=%llu errors=%llu\n", (unsigned long long)r.pushed,
+               (unsigned long long)r.popped, (unsigned long long)r.dropped, (unsigned long long)r.errors);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t frame_bytes = argc > 2 ? (size_t)atol(argv[2]) : 1920 * 1080 * 3;
+    size_t queue_size = argc > 3 ? (size_t)atol(argv[3]) : 5;
+    Load load;
+    load.producer_us = argc > 4 ? atoi(argv[4]) : 1000;
+    load.consumer_us = argc > 5 ? atoi(argv[5]) : 2000;
+    if (frames <= 0 || frame_bytes < 16 || queue_size == 0 || load.producer_us < 0 || load.consumer_us < 0) {
+        printf("%s [frames_per_producer] [frame_bytes >= 16] [queue_size] [producer_us] [consumer_us]\n", argv[0]);
+        return -1;
+    }
+    printf("frames per producer: %d, frame: %zu bytes, queue size: %zu, cpus: %u\n", frames, frame_bytes,
+           queue_size, std::thread::hardware_concurrency());
+    printf("a frame every %d us per producer, %d us per frame per consumer\n\n", load.producer_us,
+           load.consumer_us);
+
+    const int counts[] = {1, 2, 4, 8};
+    int failed = 0;
+    for (int producers : counts) {
+        for (int consumers : counts) {
+            // flat out, the copies make the mutex queue slow: keep its runs short
+            bool paced = load.producer_us > 0;
+            int mutex_frames = !paced && frame_bytes > 65536 ? frames / 10 + 1 : frames;
+            if (!report("lock-free", producers, consumers,
+                        run_lockfree(producers, consumers, frames, frame_bytes, queue_size, load))) {
+                failed++;
+            }
+            if (!report("mutex", producers, consumers,
+                        run_mutex(producers, consumers, mutex_frames, frame_bytes, queue_size, load))) {
+                failed++;
+            }
+        }
+    }
+    printf("\nfailed: %d\n", failed);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+// Throughput of the appsink capture source on videotestsrc, no camera needed:
+//   nv12      GstCapture, NV12 frames used in place from the source's buffer pool
+//   bgr+copy  what cv::VideoCapture(CAP_GSTREAMER) does: videoconvert to BGR, then a copy into a Mat
+// Reports frames/sec, CPU time per frame, CPU copies per frame and how many frames came as dmabuf.
+// Consumers hold a few frames at a time, so buffers are only recycled once released.
+//
+// Usage: bench_gst_capture [width] [height] [frames] [source]
+// source defaults to "videotestsrc pattern=ball", e.g. "v4l2src device=/dev/video0 io-mode=dmabuf"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <chrono>
+
+#include "gst_capture.h"
+
+#define HELD_FRAMES 3
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Reads one byte per row of plane 0, as a consumer that looks at the frame would
+static unsigned touch(const GstFrame& frame) {
+    unsigned sum = 0;
+    const uint8_t* data = frame.plane(0);
+    if (!data) {
+        return 0;
+    }
+    for (int y = 0; y < frame.height(); y++) {
+        sum += data[(size_t)y * frame.stride(0)];
+    }
+    return sum;
+}
+
+static bool run(const char* name, const std::string& source, const std::string& format, int width, int height,
+                bool copy) {
+    GstCapture capture;
+    // no drops: every frame of the source is consumed
+    if (!capture.open(source, width, height, 0, format, 4, false)) {
+        printf("%-9s failed to open: %s\n", name, capture.description().c_str());
+        return false;
+    }
+
+    std::vector<GstFrame> held(HELD_FRAMES);
+    std::vector<uint8_t> mat;
+    uint64_t frame_bytes = 0, copied_bytes = 0;
+    unsigned sum = 0;
+    int count = 0;
+    double cpu_start = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    GstFrame frame;
+    while (capture.read(frame, 5000)) {
+        size_t size = gst_buffer_get_size(frame.buffer());
+        frame_bytes += size;
+        if (copy) {
+            // cv::Mat copy of the appsink buffer, the buffer goes back right away
+            mat.resize(size);
+            GstMapInfo map;
+            if (gst_buffer_map(frame.buffer(), &map, GST_MAP_READ)) {
+                memcpy(mat.data(), map.data, map.size);
+                gst_buffer_unmap(frame.buffer(), &map);
+                copied_bytes += map.size;
+            }
+            sum += mat[0];
+        } else {
+            sum += touch(frame);
+        }
+        held[count % HELD_FRAMES] = frame;  // releases the frame read HELD_FRAMES ago
+        count++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double cpu = cpuSeconds() - cpu_start;
+    double seconds = std::chrono::duration<double>(end - start).count();
+    held.clear();
+    frame.reset();
+
+    printf("%-9s %dx%d frames=%-5d fps=%8.1f cpu/frame=%6.3fms copies/frame=%.2f dmabuf=%llu (%u)\n", name, width,
+           height, count, count / seconds, count > 0 ? cpu * 1000 / count : 0.0,
+           frame_bytes > 0 ? (double)copied_bytes / frame_bytes : 0.0, (unsigned long long)capture.dmabufFrames(),
+           sum & 0xff);
+    return count > 0;
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int frames = argc > 3 ? atoi(argv[3]) : 500;
+    std::string source = argc > 4 ? argv[4] : "videotestsrc pattern=ball";
+
+    gst_init(&argc, &argv);
+    source += " num-buffers=" + std::to_string(frames);
+    bool ok = run("nv12", source, "NV12", width, height, false);
+    ok = run("bgr+copy", source + " ! video/x-raw, format=NV12 ! videoconvert", "BGR", width, height, true) && ok;
+    return ok ? 0 : 1;
+}
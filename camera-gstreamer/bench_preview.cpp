@@ -0,0 +1,99 @@
+// Frame loop throughput with the three window modes, on synthetic NV12 frames so no camera is
+// needed. The loop takes frames as fast as it can and does what the demos do per frame:
+//   full     cvtColorTwoPlane at full size, imshow and waitKey(1), as the demos did
+//   preview  PreviewSink: the latest frame, downscaled and shown at preview_fps, on its own thread
+//   off      headless, nothing
+// Reports frames/sec and CPU time per frame of the whole process (preview thread included),
+// and for the preview how many frames it showed. full and preview need a display; without one
+// they are skipped.
+//
+// Usage: bench_preview [width] [height] [seconds] [preview_fps] [preview_scale]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "preview_sink.h"
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// NV12 in one Mat, height * 3 / 2 rows: Y, then interleaved UV
+static void renderFrame(const cv::Mat& nv12, double scale, cv::Mat& bgr) {
+    int width = nv12.cols, height = nv12.rows * 2 / 3;
+    renderNv12Preview(nv12.data, width, nv12.data + (size_t)width * height, width, width, height, scale, bgr);
+}
+
+static void run(const char* name, const PreviewConfig& config, const std::vector<cv::Mat>& frames, int seconds) {
+    const std::string window = "bench_preview";
+    if (config.mode == PREVIEW_FULL) {
+        cv::namedWindow(window, cv::WINDOW_AUTOSIZE);
+    }
+    PreviewSink<cv::Mat> preview(window, config, renderFrame);
+    if (config.mode == PREVIEW_SCALED) {
+        preview.start();
+    }
+
+    cv::Mat bgr;
+    uint64_t count = 0;
+    double cpu_start = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end) {
+        const cv::Mat& frame = frames[count % frames.size()];
+        if (config.mode == PREVIEW_FULL) {
+            renderFrame(frame, 1.0, bgr);
+            cv::imshow(window, bgr);
+            cv::waitKey(1);
+        } else if (config.mode == PREVIEW_SCALED) {
+            preview.offer(frame);  // the frames are never written again, no copy needed
+        }
+        count++;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    preview.stop();
+    double cpu = cpuSeconds() - cpu_start;
+    if (config.mode == PREVIEW_FULL) {
+        cv::destroyWindow(window);
+        cv::waitKey(1);
+    }
+
+    printf("%-8s fps=%9.1f cpu/frame=%7.3fms shown=%llu\n", name, count / elapsed, count > 0 ? cpu * 1000 / count : 0.0,
+           (unsigned long long)(config.mode == PREVIEW_FULL ? count : preview.shown()));
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    double preview_fps = argc > 4 ? atof(argv[4]) : 10;
+    double preview_scale = argc > 5 ? atof(argv[5]) : 0.5;
+
+    // A few frames of noise, so the conversions cannot be skipped
+    std::vector<cv::Mat> frames(4);
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].create(height * 3 / 2, width, CV_8UC1);
+        cv::randu(frames[i], 0, 256);
+    }
+
+    bool display = getenv("DISPLAY") || getenv("WAYLAND_DISPLAY");
+    printf("%dx%d NV12, %d s per mode, preview %.1f fps at %.2fx\n", width, height, seconds, preview_fps,
+           preview_scale);
+    if (display) {
+        run("full", PreviewConfig(PREVIEW_FULL), frames, seconds);
+        run("preview", PreviewConfig(PREVIEW_SCALED, preview_fps, preview_scale), frames, seconds);
+    } else {
+        printf("no display: full and preview skipped\n");
+    }
+    run("off", PreviewConfig(PREVIEW_OFF), frames, seconds);
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include "capture_manager.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+
+static void pinCurrentThread(int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        std::cerr << "Warning: failed to pin thread to cpu " << cpu << std::endl;
+    }
+}
+
+bool loadStreamConfig(const std::string& path, std::vector<StreamConfig>& streams) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: failed to open stream config " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        StreamConfig config;
+        if (!(fields >> config.name >> config.width >> config.height >> config.fps >> config.cpu)) {
+            std::cerr << "Error: " << path << ":" << line_no
+                      << ": expected \"name width height fps cpu source\"" << std::endl;
+            return false;
+        }
+        std::getline(fields >> std::ws, config.source);
+        if (config.source.empty()) {
+            std::cerr << "Error: " << path << ":" << line_no << ": missing source" << std::endl;
+            return false;
+        }
+        streams.push_back(config);
+    }
+    return true;
+}
+
+// Slots for the queued frames, the one being captured, the one in the backend and one
+// released by a drop
+CaptureManager::Stream::Stream(const StreamConfig& config, int cpu, size_t queue_size)
+    : config(config), cpu(cpu), pool(queue_size + 3, [](StreamFrame&) {}), queue(queue_size),
+      captured(0), pool_dropped(0), inferred(0), ended(false) {}
+
+CaptureManager::CaptureManager(const std::vector<StreamConfig>& streams, double target_fps,
+                               size_t queue_size, int scheduler_cpu)
+    : target_fps_(target_fps), scheduler_cpu_(scheduler_cpu), running_(false), pending_(false) {
+    int cores = (int)std::thread::hardware_concurrency();
+    if (cores < 1) {
+        cores = 1;
+    }
+    for (size_t i = 0; i < streams.size(); i++) {
+        int cpu = streams[i].cpu >= 0 ? streams[i].cpu : (int)(i % cores);
+        streams_.push_back(std::unique_ptr<Stream>(new Stream(streams[i], cpu, queue_size)));
+    }
+}
+
+CaptureManager::~CaptureManager() {
+    stop();
+}
+
+bool CaptureManager::start(const InferFunc& infer) {
+    stop();
+    // Open on this thread so a bad source fails start(); the capture threads only read
+    for (size_t i = 0; i < streams_.size(); i++) {
+        Stream& stream = *streams_[i];
+        stream.capture.setAffinity(stream.cpu);
+        // Every pool slot of the stream can hold a v4l2src buffer
+        stream.capture.setHeldBuffers((int)stream.pool.size());
+        const StreamConfig& config = stream.config;
+        std::string source =
+            GstCapture::sourceFor(config.source, config.width, config.height, config.fps);
+        if (!stream.capture.open(source, config.width, config.height, config.fps)) {
+            std::cerr << "Error: failed to open stream " << config.name << ": " << config.source
+                      << std::endl;
+            for (size_t j = 0; j <= i; j++) {
+                streams_[j]->capture.close();
+            }
+            return false;
+        }
+    }
+
+    infer_ = infer;
+    running_ = true;
+    start_time_ = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < streams_.size(); i++) {
+        streams_[i]->thread = std::thread(&CaptureManager::captureLoop, this, std::ref(*streams_[i]));
+    }
+    scheduler_ = std::thread(&CaptureManager::schedulerLoop, this);
+    return true;
+}
+
+void CaptureManager::stop() {
+    running_ = false;
+    notifyReady();
+    if (scheduler_.joinable()) {
+        scheduler_.join();
+    }
+    for (size_t i = 0; i < streams_.size(); i++) {
+        Stream& stream = *streams_[i];
+        if (stream.thread.joinable()) {
+            stream.thread.join();
+        }
+        // Give the buffers back before their pipeline goes away
+        FrameRef<StreamFrame> frame;
+        while (stream.queue.try_pop(frame)) {
+            frame.reset();
+        }
+        stream.capture.close();
+    }
+}
+
+void CaptureManager::notifyReady() {
+    {
+        std::lock_guard<std::mutex> lock(ready_mutex_);
+        pending_ = true;
+    }
+    ready_.notify_one();
+}
+
+void CaptureManager::captureLoop(Stream& stream) {
+    pinCurrentThread(stream.cpu);
+    while (running_) {
+        GstFrame captured;
+        if (!stream.capture.read(captured, 100)) {
+            if (stream.capture.isEos()) {
+                stream.ended = true;
+                break;
+            }
+            continue;
+        }
+        stream.captured.fetch_add(1, std::memory_order_relaxed);
+
+        FrameRef<StreamFrame> frame = stream.pool.acquire();
+        if (!frame) {
+            stream.pool_dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        frame->frame = captured;
+        frame->captured =
+            std::chrono::steady_clock::time_point(std::chrono::nanoseconds(captured.capture_ns()));
+        frame.seq() = captured.seq();
+        frame.timestamp() = captured.capture_ns();
+        stream.queue.push(frame);
+        notifyReady();
+    }
+    notifyReady();
+}
+
+void CaptureManager::schedulerLoop() {
+    pinCurrentThread(scheduler_cpu_);
+    typedef std::chrono::steady_clock Clock;
+    std::chrono::duration<double> seconds_per_frame(target_fps_ > 0 ? 1.0 / target_fps_ : 0.0);
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(seconds_per_frame);
+    Clock::time_point next = Clock::now();
+    size_t turn = 0;
+    size_t count = streams_.size();
+
+    while (running_) {
+        if (period > Clock::duration::zero()) {
+            std::this_thread::sleep_until(next);
+        }
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex_);
+            pending_ = false;
+        }
+
+        // Round robin: the first stream with a frame after the one served last
+        FrameRef<StreamFrame> frame;
+        size_t index = 0;
+        bool all_ended = true;
+        for (size_t i = 0; i < count; i++) {
+            index = (turn + i) % count;
+            // Read before the queue: a stream only ends after its last push
+            bool ended = streams_[index]->ended;
+            if (streams_[index]->queue.try_pop(frame)) {
+                break;
+            }
+            all_ended = all_ended && ended;
+        }
+
+        if (!frame) {
+            if (all_ended) {
+                running_ = false;
+                break;
+            }
+            std::unique_lock<std::mutex> lock(ready_mutex_);
+            ready_.wait_for(lock, std::chrono::milliseconds(100),
+                            [this] { return pending_ || !running_; });
+            // Idle time is not owed to anyone: no burst of calls once frames come back
+            Clock::time_point now = Clock::now();
+            if (next < now) {
+                next = now;
+            }
+            continue;
+        }
+        turn = index + 1;
+
+        Stream& stream = *streams_[index];
+        infer_((int)index, frame->frame);
+        Clock::time_point done = Clock::now();
+        int64_t latency =
+            std::chrono::duration_cast<std::chrono::microseconds>(done - frame->captured).count();
+        frame.reset();
+        stream.inferred.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(stream.latency_mutex);
+            stream.latency.record(latency);
+        }
+
+        // A backend slower than the target only loses the late calls, it does not catch up
+        next += period;
+        if (next < done - period) {
+            next = done;
+        }
+    }
+}
+
+std::vector<StreamStats> CaptureManager::stats() const {
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_time_;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    std::vector<StreamStats> result(streams_.size());
+    for (size_t i = 0; i < streams_.size(); i++) {
+        const Stream& stream = *streams_[i];
+        StreamStats& stats = result[i];
+        stats.name = stream.config.name;
+        stats.captured = stream.captured.load(std::memory_order_relaxed);
+        stats.inferred = stream.inferred.load(std::memory_order_relaxed);
+        stats.dropped = stream.queue.dropped();
+        stats.pool_dropped = stream.pool_dropped.load(std::memory_order_relaxed);
+        stats.capture_fps = seconds > 0 ? stats.captured / seconds : 0;
+        stats.infer_fps = seconds > 0 ? stats.inferred / seconds : 0;
+        stats.ended = stream.ended;
+        std::lock_guard<std::mutex> lock(stream.latency_mutex);
+        stats.latency = stream.latency;
+    }
+    return result;
+}
+
+void CaptureManager::printStats(std::ostream& out) const {
+    std::vector<StreamStats> all = stats();
+    LatencyHistogram total;
+    double capture_fps = 0, infer_fps = 0;
+    uint64_t dropped = 0;
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < all.size(); i++) {
+        const StreamStats& s = all[i];
+        out << std::left << std::setw(10) << s.name << std::right << " capture " << std::setw(6)
+            << s.capture_fps << " fps | infer " << std::setw(6) << s.infer_fps << " fps | dropped "
+            << std::setw(6) << s.dropped + s.pool_dropped << " | latency p50 " << std::setw(6)
+            << s.latency.percentile(50) / 1000.0 << " p99 " << std::setw(6)
+            << s.latency.percentile(99) / 1000.0 << " max " << std::setw(6) << s.latency.max() / 1000.0
+            << " ms" << (s.ended ? " (ended)" : "") << std::endl;
+        total.merge(s.latency);
+        capture_fps += s.capture_fps;
+        infer_fps += s.infer_fps;
+        dropped += s.dropped + s.pool_dropped;
+    }
+    out << std::left << std::setw(10) << "total" << std::right << " capture " << std::setw(6)
+        << capture_fps << " fps | infer " << std::setw(6) << infer_fps << " fps | dropped "
+        << std::setw(6) << dropped << " | latency p50 " << std::setw(6) << total.percentile(50) / 1000.0
+        << " p99 " << std::setw(6) << total.percentile(99) / 1000.0 << " max " << std::setw(6)
+        << total.max() / 1000.0 << " ms"
+        << " | target " << target_fps_ << " fps" << std::endl;
+    out.flags(flags);
+}
@@ -0,0 +1,128 @@
+#ifndef CAMERA_GSTREAMER_CAPTURE_MANAGER_H
+#define CAMERA_GSTREAMER_CAPTURE_MANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.h"
+#include "gst_capture.h"
+#include "latency_histogram.h"
+
+// One source of the capture manager
+struct StreamConfig {
+    std::string name;
+    // "/dev/videoN", a video file or a source description, see GstCapture::sourceFor
+    std::string source;
+    int width;           // <= 0: negotiated
+    int height;
+    int fps;
+    int cpu;             // core of the capture threads, -1: stream index modulo the core count
+
+    StreamConfig() : width(0), height(0), fps(0), cpu(-1) {}
+};
+
+// Reads one stream per line: "name width height fps cpu source...", the source being the
+// rest of the line. Empty lines and lines starting with '#' are skipped.
+bool loadStreamConfig(const std::string& path, std::vector<StreamConfig>& streams);
+
+// Frame of one stream with its capture time, see GstFrame::capture_ns()
+struct StreamFrame {
+    GstFrame frame;
+    std::chrono::steady_clock::time_point captured;
+};
+
+inline void frame_pool_recycle(StreamFrame& frame) {
+    frame.frame.reset();
+}
+
+struct StreamStats {
+    std::string name;
+    uint64_t captured;      // frames read from the source
+    uint64_t inferred;      // frames run through the backend
+    uint64_t dropped;       // frames replaced in the stream queue by a newer one before their turn
+    uint64_t pool_dropped;  // frames skipped because every slot of the stream was in use
+    double capture_fps;
+    double infer_fps;
+    bool ended;             // end of stream
+    LatencyHistogram latency;  // capture to end of inference, us
+};
+
+// Runs N capture streams into one inference backend. Each stream has its own capture thread,
+// pinned to a core together with its GStreamer streaming threads, and a small drop-oldest queue,
+// so a stream never waits for the backend and the backend always gets the newest frames.
+// A single scheduler thread takes the streams in round-robin order, one frame per stream with
+// a frame ready per round, and paces the backend calls to the target aggregate frame rate:
+// every stream gets the same share however fast it captures.
+class CaptureManager {
+public:
+    // Called on the scheduler thread, one frame at a time
+    typedef std::function<void(int stream, const GstFrame& frame)> InferFunc;
+
+    // target_fps <= 0 runs the backend as fast as it goes. queue_size is per stream: with 1 the
+    // backend only ever sees the newest frame of a stream, more smooths out capture jitter.
+    CaptureManager(const std::vector<StreamConfig>& streams, double target_fps, size_t queue_size = 1,
+                   int scheduler_cpu = -1);
+    ~CaptureManager();
+
+    CaptureManager(const CaptureManager&) = delete;
+    CaptureManager& operator=(const CaptureManager&) = delete;
+
+    // Opens every stream and starts the threads, false (and nothing running) if one fails
+    bool start(const InferFunc& infer);
+    void stop();
+
+    // False after stop() or once every stream ended and its frames went through the backend
+    bool isRunning() const { return running_; }
+
+    size_t streams() const { return streams_.size(); }
+    std::vector<StreamStats> stats() const;
+
+    // One line per stream and an aggregate line
+    void printStats(std::ostream& out) const;
+
+private:
+    struct Stream {
+        StreamConfig config;
+        int cpu;
+        GstCapture capture;
+        FramePool<StreamFrame> pool;
+        FrameQueue<StreamFrame> queue;
+        std::thread thread;
+        std::atomic<uint64_t> captured;
+        std::atomic<uint64_t> pool_dropped;
+        std::atomic<uint64_t> inferred;
+        std::atomic<bool> ended;
+        mutable std::mutex latency_mutex;
+        LatencyHistogram latency;
+
+        Stream(const StreamConfig& config, int cpu, size_t queue_size);
+    };
+
+    std::vector<std::unique_ptr<Stream>> streams_;
+    double target_fps_;
+    int scheduler_cpu_;
+    InferFunc infer_;
+    std::thread scheduler_;
+    std::atomic<bool> running_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    // Wakes the scheduler when a stream queued a frame
+    std::mutex ready_mutex_;
+    std::condition_variable ready_;
+    bool pending_;
+
+    void captureLoop(Stream& stream);
+    void schedulerLoop();
+    void notifyReady();
+};
+
+#endif  // CAMERA_GSTREAMER_CAPTURE_MANAGER_H
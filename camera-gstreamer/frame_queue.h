@@ -0,0 +1,543 @@
+#ifndef CAMERA_GSTREAMER_FRAME_QUEUE_H
+#define CAMERA_GSTREAMER_FRAME_QUEUE_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <semaphore.h>
+
+// Bounded lock-free MPMC ring (Vyukov): every cell carries a sequence number that tells
+// producers and consumers whether it is free for position pos (2 * pos) or holds the value
+// of pos (2 * pos + 1); the doubling keeps the two apart even with a single cell.
+// Any capacity from 1 up works (0 is taken as 1), positions are 64-bit and never wrap in practice.
+template <typename T>
+class MpmcRing {
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::vector<Cell> cells_;
+    size_t capacity_;
+    char pad0_[64];
+    std::atomic<size_t> head_;
+    char pad1_[64];
+    std::atomic<size_t> tail_;
+    char pad2_[64];
+
+public:
+    explicit MpmcRing(size_t capacity)
+        : cells_(capacity > 0 ? capacity : 1), capacity_(cells_.size()), head_(0), tail_(0) {
+        for (size_t i = 0; i < capacity_; i++) {
+            cells_[i].seq.store(2 * i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    bool try_push(const T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos % capacity_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(2 * pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->seq.store(2 * pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos % capacity_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(2 * pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // empty, or the producer of pos has not finished writing it
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->value;
+        cell->seq.store(2 * (pos + capacity_), std::memory_order_release);
+        return true;
+    }
+
+    // Approximate while other threads push and pop
+    size_t size() const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+};
+
+// Called when the last reference to a pool slot is dropped. Frames that own their memory keep it
+// for the next acquire(); frames that borrow a buffer overload this to give it back right away.
+template <typename Frame>
+inline void frame_pool_recycle(Frame&) {}
+
+template <typename Frame> class FramePool;
+template <typename Frame> class FrameQueue;
+
+// Reference to a frame slot of a FramePool. Copies share the slot, which goes back to the
+// pool when the last reference is dropped, so a frame can sit in several queues without a copy.
+template <typename Frame>
+class FrameRef {
+private:
+    friend class FramePool<Frame>;
+    friend class FrameQueue<Frame>;
+    typedef typename FramePool<Frame>::Slot Slot;
+
+    Slot* slot_;
+
+    explicit FrameRef(Slot* slot) : slot_(slot) {}
+
+public:
+    FrameRef() : slot_(nullptr) {}
+    FrameRef(const FrameRef& other) : slot_(other.slot_) {
+        if (slot_) {
+            slot_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    FrameRef(FrameRef&& other) : slot_(other.slot_) { other.slot_ = nullptr; }
+    ~FrameRef() { reset(); }
+
+    FrameRef& operator=(FrameRef other) {
+        std::swap(slot_, other.slot_);
+        return *this;
+    }
+
+    void reset() {
+        if (slot_) {
+            FramePool<Frame>::unref(slot_);
+            slot_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return slot_ != nullptr; }
+    Frame& operator*() const { return slot_->frame; }
+    Frame* operator->() const { return &slot_->frame; }
+
+    // Set by the producer, e.g. a capture sequence number
+    uint64_t& seq() const { return slot_->seq; }
+
+    // Capture time in steady_clock ns, set by the producer; FrameQueue::push() stamps frames
+    // left at 0 with the push time. Frame age for the LATENCY_TARGET policy.
+    int64_t& timestamp() const { return slot_->stamp_ns; }
+};
+
+// Fixed set of frames allocated once. acquire() hands out a free slot or an empty
+// reference when every slot is in use; it never allocates.
+template <typename Frame>
+class FramePool {
+private:
+    friend class FrameRef<Frame>;
+    friend class FrameQueue<Frame>;
+
+    struct Slot {
+        Frame frame;
+        uint64_t seq;
+        int64_t stamp_ns;
+        std::atomic<int> refs;
+        FramePool* pool;
+    };
+
+    std::vector<Slot> slots_;
+    MpmcRing<Slot*> free_;
+
+    static void unref(Slot* slot) {
+        if (slot->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            frame_pool_recycle(slot->frame);
+            // The ring holds every slot, it only looks full while an acquire() is halfway
+            // through taking the cell this push goes to
+            while (!slot->pool->free_.try_push(slot)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+public:
+    // init(frame) allocates each frame, e.g. [](cv::Mat& m) { m.create(1080, 1920, CV_8UC3); }
+    template <typename Init>
+    FramePool(size_t count, Init init) : slots_(count), free_(count) {
+        for (size_t i = 0; i < count; i++) {
+            init(slots_[i].frame);
+            slots_[i].seq = 0;
+            slots_[i].stamp_ns = 0;
+            slots_[i].refs.store(0, std::memory_order_relaxed);
+            slots_[i].pool = this;
+            free_.try_push(&slots_[i]);
+        }
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    FrameRef<Frame> acquire() {
+        Slot* slot;
+        if (!free_.try_pop(slot)) {
+            return FrameRef<Frame>();
+        }
+        slot->refs.store(1, std::memory_order_relaxed);
+        slot->stamp_ns = 0;
+        return FrameRef<Frame>(slot);
+    }
+
+    size_t available() const { return free_.size(); }
+    size_t size() const { return slots_.size(); }
+};
+
+// What push() does when the consumers fall behind
+enum BackpressurePolicy {
+    DROP_OLDEST,     // a full queue drops its oldest frame for the new one
+    DROP_NEWEST,     // a full queue refuses the new frame, the queued ones are kept
+    KEEP_EVERY_NTH,  // only 1 of every keep_every pushed frames is queued, then as DROP_OLDEST
+    LATENCY_TARGET,  // as DROP_OLDEST, and frames older than max_age_us are dropped instead of popped
+};
+
+enum DropReason {
+    DROP_REASON_OLDEST,     // replaced by a newer frame in a full queue
+    DROP_REASON_NEWEST,     // refused by a full queue
+    DROP_REASON_DECIMATED,  // not one of the Nth frames
+    DROP_REASON_STALE,      // older than the latency target
+    DROP_REASON_COUNT
+};
+
+inline const char* dropReasonName(int reason) {
+    static const char* names[DROP_REASON_COUNT] = {"oldest", "newest", "decimated", "stale"};
+    return names[reason];
+}
+
+struct BackpressureConfig {
+    BackpressurePolicy policy;
+    unsigned keep_every;  // KEEP_EVERY_NTH
+    int64_t max_age_us;   // LATENCY_TARGET, age from FrameRef::timestamp()
+
+    BackpressureConfig(BackpressurePolicy policy = DROP_OLDEST, unsigned keep_every = 2,
+                       int64_t max_age_us = 100000)
+        : policy(policy), keep_every(keep_every), max_age_us(max_age_us) {}
+};
+
+// "drop-oldest", "drop-newest", "keep-every=N" or "latency-target=MS"
+inline bool parseBackpressure(const std::string& text, BackpressureConfig& config) {
+    size_t eq = text.find('=');
+    std::string name = text.substr(0, eq);
+    long value = eq == std::string::npos ? 0 : strtol(text.c_str() + eq + 1, nullptr, 10);
+    if (name == "drop-oldest") {
+        config = BackpressureConfig(DROP_OLDEST);
+    } else if (name == "drop-newest") {
+        config = BackpressureConfig(DROP_NEWEST);
+    } else if (name == "keep-every" && value >= 1) {
+        config = BackpressureConfig(KEEP_EVERY_NTH, (unsigned)value);
+    } else if (name == "latency-target" && value >= 1) {
+        config = BackpressureConfig(LATENCY_TARGET, 1, (int64_t)value * 1000);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline int64_t frameQueueNowNs() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// Bounded multi-producer multi-consumer queue of frame references on a lock-free ring.
+// push() never blocks: when the queue is full the backpressure policy decides which frame
+// goes, and every drop is counted with its reason. Each frame goes to one consumer. pop()
+// only sleeps (on a futex based semaphore) when the queue is empty.
+template <typename Frame>
+class FrameQueue {
+private:
+    typedef typename FramePool<Frame>::Slot Slot;
+
+    MpmcRing<Slot*> ring_;
+    sem_t items_;                  // one token per frame in the ring
+    std::atomic<bool> running_;
+    BackpressureConfig config_;
+    std::atomic<uint64_t> pushes_;
+    std::atomic<uint64_t> delivered_;
+    std::atomic<uint64_t> dropped_[DROP_REASON_COUNT];
+
+    // Take the frame a token was taken for; its producer may still be finishing the write.
+    // After stop() the token may be the stop token instead: nullptr once the ring is empty.
+    Slot* take() {
+        Slot* slot;
+        while (!ring_.try_pop(slot)) {
+            if (!running_) {
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+        return slot;
+    }
+
+    bool stale(const Slot* slot) const {
+        return config_.policy == LATENCY_TARGET &&
+               (frameQueueNowNs() - slot->stamp_ns) / 1000 > config_.max_age_us;
+    }
+
+    void drop(Slot* slot, DropReason reason) {
+        FramePool<Frame>::unref(slot);
+        dropped_[reason].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A frame taken for a token: handed out, or dropped when it is past the latency target
+    bool deliver(Slot* slot, FrameRef<Frame>& frame) {
+        if (stale(slot)) {
+            drop(slot, DROP_REASON_STALE);
+            return false;
+        }
+        delivered_.fetch_add(1, std::memory_order_relaxed);
+        frame = FrameRef<Frame>(slot);
+        return true;
+    }
+
+public:
+    explicit FrameQueue(size_t max_size = 5, const BackpressureConfig& config = BackpressureConfig())
+        : ring_(max_size), running_(true), config_(config), pushes_(0), delivered_(0) {
+        if (config_.keep_every < 1) {
+            config_.keep_every = 1;
+        }
+        for (int i = 0; i < DROP_REASON_COUNT; i++) {
+            dropped_[i].store(0, std::memory_order_relaxed);
+        }
+        sem_init(&items_, 0, 0);
+    }
+
+    ~FrameQueue() {
+        Slot* slot;
+        while (ring_.try_pop(slot)) {
+            FramePool<Frame>::unref(slot);
+        }
+        sem_destroy(&items_);
+    }
+
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    // The queue takes its own reference, the caller keeps frame. False when the policy
+    // dropped the frame instead of queuing it.
+    bool push(const FrameRef<Frame>& frame) {
+        if (!running_ || !frame) {
+            return false;
+        }
+        Slot* slot = frame.slot_;
+        if (config_.policy == KEEP_EVERY_NTH &&
+            pushes_.fetch_add(1, std::memory_order_relaxed) % config_.keep_every != 0) {
+            dropped_[DROP_REASON_DECIMATED].fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (slot->stamp_ns == 0) {
+            slot->stamp_ns = frameQueueNowNs();
+        }
+        slot->refs.fetch_add(1, std::memory_order_relaxed);
+        while (!ring_.try_push(slot)) {
+            if (config_.policy == DROP_NEWEST) {
+                drop(slot, DROP_REASON_NEWEST);
+                return false;
+            }
+            // Full: drop the oldest frame. Without a token the consumers are taking the
+            // remaining frames right now and a cell frees up shortly.
+            if (sem_trywait(&items_) == 0) {
+                Slot* oldest = take();
+                if (!oldest) {
+                    sem_post(&items_);
+                    FramePool<Frame>::unref(slot);
+                    return false;
+                }
+                drop(oldest, stale(oldest) ? DROP_REASON_STALE : DROP_REASON_OLDEST);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        sem_post(&items_);
+        return true;
+    }
+
+    bool pop(FrameRef<Frame>& frame, int timeout_ms = 1000) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        for (;;) {
+            while (sem_timedwait(&items_, &deadline) != 0) {
+                if (errno != EINTR) {
+                    return false;
+                }
+            }
+            Slot* slot = take();
+            if (!slot) {
+                sem_post(&items_);  // the stop token, pass it on to the next consumer
+                return false;
+            }
+            if (deliver(slot, frame)) {
+                return true;
+            }
+        }
+    }
+
+    // Never sleeps: false when the queue is empty, for consumers polling several queues
+    bool try_pop(FrameRef<Frame>& frame) {
+        while (sem_trywait(&items_) == 0) {
+            Slot* slot = take();
+            if (!slot) {
+                sem_post(&items_);
+                return false;
+            }
+            if (deliver(slot, frame)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Wakes every waiting consumer; frames still queued can be popped
+    void stop() {
+        running_ = false;
+        sem_post(&items_);
+    }
+
+    bool is_running() const { return running_; }
+
+    size_t size() const { return ring_.size(); }
+
+    const BackpressureConfig& config() const { return config_; }
+
+    // Frames handed to consumers
+    uint64_t delivered() const { return delivered_.load(std::memory_order_relaxed); }
+
+    uint64_t dropped(DropReason reason) const { return dropped_[reason].load(std::memory_order_relaxed); }
+
+    // Drops of every reason
+    uint64_t dropped() const {
+        uint64_t total = 0;
+        for (int i = 0; i < DROP_REASON_COUNT; i++) {
+            total += dropped_[i].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Drops because the consumers fell behind, i.e. all but the policy's own decimation
+    uint64_t overflowed() const { return dropped() - dropped(DROP_REASON_DECIMATED); }
+};
+
+// Producer side of the backpressure loop, fed once per captured frame. Every interval it
+// compares what the producer offered with what the consumers took: while frames overflow it
+// keeps fewer (1 of every keepEvery() frames, enough for the consumers' pace), and after a few
+// windows without overflow it tries one more; each probe that overflows doubles the wait before
+// the next one, so a producer at the consumers' pace is not pushed back over it. Skipping a
+// frame before it reaches the pool is the cheapest way to lower the capture rate. With several
+// producers on one queue each one adapts to the queue's total, which makes them converge more
+// slowly.
+template <typename Frame>
+class RateAdapter {
+private:
+    const FrameQueue<Frame>& queue_;
+    int64_t interval_ns_;
+    unsigned max_keep_every_;
+    unsigned keep_every_;
+    unsigned clean_windows_;
+    unsigned probe_wait_;  // clean windows before the next probe
+    bool probing_;         // the previous window kept one more frame
+    uint64_t seen_;
+    uint64_t skipped_;
+    uint64_t window_seen_;
+    uint64_t window_offered_;
+    int64_t window_start_ns_;
+    uint64_t last_delivered_;
+    uint64_t last_overflowed_;
+
+    void adapt(int64_t now) {
+        uint64_t delivered = queue_.delivered() - last_delivered_;
+        uint64_t overflowed = queue_.overflowed() - last_overflowed_;
+        // More than 5% lost: keep about what the consumers took
+        if (overflowed * 20 > window_offered_) {
+            if (probing_ && probe_wait_ < 32) {
+                probe_wait_ *= 2;
+            }
+            unsigned needed =
+                delivered > 0 ? (unsigned)ceil((double)window_seen_ / delivered) : keep_every_ * 2;
+            keep_every_ = needed > keep_every_ ? needed : keep_every_ + 1;
+            if (keep_every_ > max_keep_every_) {
+                keep_every_ = max_keep_every_;
+            }
+            clean_windows_ = 0;
+            probing_ = false;
+        } else if (overflowed == 0 && keep_every_ > 1 && ++clean_windows_ >= probe_wait_) {
+            keep_every_--;
+            clean_windows_ = 0;
+            probing_ = true;
+        } else {
+            probing_ = false;
+        }
+        last_delivered_ += delivered;
+        last_overflowed_ += overflowed;
+        window_seen_ = 0;
+        window_offered_ = 0;
+        window_start_ns_ = now;
+    }
+
+public:
+    explicit RateAdapter(const FrameQueue<Frame>& queue, int interval_ms = 500, unsigned max_keep_every = 30)
+        : queue_(queue), interval_ns_((int64_t)interval_ms * 1000000), max_keep_every_(max_keep_every),
+          keep_every_(1), clean_windows_(0), probe_wait_(2), probing_(false), seen_(0), skipped_(0),
+          window_seen_(0), window_offered_(0),
+          window_start_ns_(frameQueueNowNs()), last_delivered_(queue.delivered()),
+          last_overflowed_(queue.overflowed()) {}
+
+    // False: skip this frame
+    bool keep() {
+        bool keep = seen_++ % keep_every_ == 0;
+        window_seen_++;
+        if (keep) {
+            window_offered_++;
+        } else {
+            skipped_++;
+        }
+        int64_t now = frameQueueNowNs();
+        if (now - window_start_ns_ >= interval_ns_) {
+            adapt(now);
+        }
+        return keep;
+    }
+
+    unsigned keepEvery() const { return keep_every_; }
+    uint64_t skipped() const { return skipped_; }
+};
+
+#endif  // CAMERA_GSTREAMER_FRAME_QUEUE_H
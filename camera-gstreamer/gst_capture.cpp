@@ -0,0 +1,291 @@
+#include "gst_capture.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#include <gst/allocators/gstdmabuf.h>
+#include <gst/app/gstappsink.h>
+
+int GstFrame::stride(int i) const {
+    if (data_->mapped) {
+        return GST_VIDEO_FRAME_PLANE_STRIDE(&data_->vframe, i);
+    }
+    // The video meta has the layout the producer really used, the caps only the default one
+    GstVideoMeta* meta = gst_buffer_get_video_meta(buffer());
+    return meta ? meta->stride[i] : GST_VIDEO_INFO_PLANE_STRIDE(&data_->info, i);
+}
+
+size_t GstFrame::offset(int i) const {
+    GstVideoMeta* meta = gst_buffer_get_video_meta(buffer());
+    return meta ? meta->offset[i] : GST_VIDEO_INFO_PLANE_OFFSET(&data_->info, i);
+}
+
+uint64_t GstFrame::pts_ns() const {
+    GstClockTime pts = GST_BUFFER_PTS(buffer());
+    return GST_CLOCK_TIME_IS_VALID(pts) ? pts : 0;
+}
+
+GstCapture::GstCapture()
+    : pipeline_(nullptr), sink_(nullptr), map_dmabuf_(true), writable_(false), cpu_(-1), held_buffers_(0),
+      min_buffers_(0), eos_(false), frames_(0), dmabuf_frames_(0), copied_frames_(0) {}
+
+GstCapture::~GstCapture() {
+    close();
+}
+
+void GstCapture::logBusErrors() {
+    GstBus* bus = gst_element_get_bus(pipeline_);
+    GstMessage* msg;
+    GstMessageType types = (GstMessageType)(GST_MESSAGE_ERROR | GST_MESSAGE_WARNING);
+    while ((msg = gst_bus_pop_filtered(bus, types)) != nullptr) {
+        GError* error = nullptr;
+        gchar* debug = nullptr;
+        if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+            gst_message_parse_error(msg, &error, &debug);
+            std::cerr << "Error: " << GST_OBJECT_NAME(msg->src) << ": " << error->message << std::endl;
+        } else {
+            gst_message_parse_warning(msg, &error, &debug);
+            std::cerr << "Warning: " << GST_OBJECT_NAME(msg->src) << ": " << error->message << std::endl;
+        }
+        g_error_free(error);
+        g_free(debug);
+        gst_message_unref(msg);
+    }
+    gst_object_unref(bus);
+}
+
+GstBusSyncReply GstCapture::onSyncMessage(GstBus*, GstMessage* msg, gpointer user_data) {
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_STREAM_STATUS) {
+        return GST_BUS_PASS;
+    }
+    // Posted from the streaming thread itself when it starts
+    GstStreamStatusType type;
+    GstElement* owner;
+    gst_message_parse_stream_status(msg, &type, &owner);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(((GstCapture*)user_data)->cpu_, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    return GST_BUS_DROP;
+}
+
+// rawvideoparse format of a packed raw recording, by extension; empty for anything else
+static std::string rawFormatFor(const std::string& location, size_t& frame_size, int width, int height) {
+    std::string ext = location.substr(location.find_last_of('.') + 1);
+    size_t pixels = (size_t)width * height;
+    if (ext == "nv12") {
+        frame_size = pixels * 3 / 2;
+        return "nv12";
+    }
+    if (ext == "yuv" || ext == "i420") {
+        frame_size = pixels * 3 / 2;
+        return "i420";
+    }
+    if (ext == "rgb") {
+        frame_size = pixels * 3;
+        return "rgb";
+    }
+    if (ext == "gray") {
+        frame_size = pixels;
+        return "gray8";
+    }
+    return "";
+}
+
+std::string GstCapture::sourceFor(const std::string& location, int width, int height, int fps) {
+    if (location.compare(0, 5, "/dev/") == 0) {
+        return "v4l2src device=" + location + " io-mode=dmabuf";
+    }
+    struct stat st;
+    if (stat(location.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return location;
+    }
+    // Played at its own pace like a camera, or without a clock as fast as it is read
+    const char* replay = getenv("REPLAY");
+    std::string pace = replay && std::string(replay) == "fast" ? "" : " ! identity sync=true";
+    size_t frame_size = 0;
+    std::string raw = width > 0 && height > 0 ? rawFormatFor(location, frame_size, width, height) : "";
+    if (!raw.empty()) {
+        // One read per frame
+        return "filesrc location=\"" + location + "\" blocksize=" + std::to_string(frame_size) +
+               " ! rawvideoparse width=" + std::to_string(width) + " height=" + std::to_string(height) +
+               " format=" + raw + " framerate=" + std::to_string(fps > 0 ? fps : 30) + "/1" +
+               " ! videoconvert" + pace;
+    }
+    // Scaled and resampled to the requested caps
+    return "filesrc location=\"" + location + "\" ! decodebin ! videoconvert ! videoscale ! videorate" + pace;
+}
+
+bool GstCapture::open(const std::string& source, int width, int height, int fps,
+                      const std::string& format, int max_buffers, bool drop, bool map_dmabuf) {
+    close();
+    if (!gst_is_initialized()) {
+        gst_init(nullptr, nullptr);
+    }
+
+    std::string caps = "video/x-raw, format=" + format;
+    if (width > 0 && height > 0) {
+        caps += ", width=" + std::to_string(width) + ", height=" + std::to_string(height);
+    }
+    if (fps > 0) {
+        caps += ", framerate=" + std::to_string(fps) + "/1";
+    }
+    // Without the last sample the appsink holds no reference of its own to a handed out buffer
+    description_ = source + " ! " + caps +
+                   " ! appsink name=sink sync=false enable-last-sample=false max-buffers=" +
+                   std::to_string(max_buffers) + (drop ? " drop=true" : " drop=false");
+
+    GError* error = nullptr;
+    pipeline_ = gst_parse_launch(description_.c_str(), &error);
+    if (error) {
+        std::cerr << "Error: " << error->message << std::endl;
+        g_error_free(error);
+        if (pipeline_) {
+            gst_object_unref(pipeline_);
+            pipeline_ = nullptr;
+        }
+        return false;
+    }
+    sink_ = gst_bin_get_by_name(GST_BIN(pipeline_), "sink");
+    min_buffers_ = held_buffers_ > 0 ? held_buffers_ + max_buffers + 1 : 0;
+    if (min_buffers_ > 0) {
+        GstPad* pad = gst_element_get_static_pad(sink_, "sink");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, onSinkQuery, this, nullptr);
+        gst_object_unref(pad);
+    }
+    if (cpu_ >= 0) {
+        GstBus* bus = gst_element_get_bus(pipeline_);
+        gst_bus_set_sync_handler(bus, onSyncMessage, this, nullptr);
+        gst_object_unref(bus);
+    }
+    map_dmabuf_ = map_dmabuf;
+    eos_ = false;
+    frames_ = 0;
+    dmabuf_frames_ = 0;
+    copied_frames_ = 0;
+
+    // Wait for the source to start, so a missing device fails here and not on the first read
+    gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+    if (gst_element_get_state(pipeline_, nullptr, nullptr, 5 * GST_SECOND) == GST_STATE_CHANGE_FAILURE) {
+        logBusErrors();
+        close();
+        return false;
+    }
+    return true;
+}
+
+// The source sizes its pool from the ALLOCATION query (v4l2src: our minimum plus what the driver
+// needs), the appsink does not propose one of its own
+GstPadProbeReturn GstCapture::onSinkQuery(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    (void)pad;
+    GstQuery* query = GST_PAD_PROBE_INFO_QUERY(info);
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION) {
+        return GST_PAD_PROBE_OK;
+    }
+    GstCapture* self = static_cast<GstCapture*>(user_data);
+    GstCaps* caps = nullptr;
+    gst_query_parse_allocation(query, &caps, nullptr);
+    GstVideoInfo video_info;
+    guint size = caps && gst_video_info_from_caps(&video_info, caps) ? GST_VIDEO_INFO_SIZE(&video_info) : 0;
+    gst_query_add_allocation_pool(query, nullptr, size, self->min_buffers_, 0);
+    return GST_PAD_PROBE_OK;
+}
+
+// The PTS is the buffer's running time: base time + PTS is the pipeline clock time it was
+// stamped at. How long ago that was on the pipeline clock, taken from the arrival time,
+// gives the stamp on steady_clock whatever clock the pipeline runs on.
+int64_t GstCapture::captureTime(GstSample* sample, int64_t arrival_ns) {
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstSegment* segment = gst_sample_get_segment(sample);
+    if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_PTS(buffer)) || !segment) {
+        return arrival_ns;
+    }
+    GstClock* clock = gst_element_get_clock(pipeline_);
+    if (!clock) {
+        return arrival_ns;
+    }
+    GstClockTime now = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+    GstClockTime running = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    if (!GST_CLOCK_TIME_IS_VALID(running)) {
+        return arrival_ns;
+    }
+    // Buffers stamped ahead of the clock (non-live sources) count as just captured
+    GstClockTime stamped = gst_element_get_base_time(pipeline_) + running;
+    return stamped > now ? arrival_ns : arrival_ns - (int64_t)(now - stamped);
+}
+
+bool GstCapture::read(GstFrame& frame, int timeout_ms) {
+    frame.reset();
+    if (!pipeline_) {
+        return false;
+    }
+    GstSample* sample =
+        gst_app_sink_try_pull_sample(GST_APP_SINK(sink_), (GstClockTime)timeout_ms * GST_MSECOND);
+    if (!sample) {
+        if (gst_app_sink_is_eos(GST_APP_SINK(sink_))) {
+            eos_ = true;
+        }
+        logBusErrors();
+        return false;
+    }
+
+    int64_t arrival_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    std::shared_ptr<GstFrame::Data> data = std::make_shared<GstFrame::Data>();
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    if (!buffer || !gst_video_info_from_caps(&data->info, gst_sample_get_caps(sample))) {
+        std::cerr << "Error: sample without buffer or video caps" << std::endl;
+        gst_sample_unref(sample);
+        return false;
+    }
+    data->capture_ns = captureTime(sample, arrival_ns);
+    // Keep the buffer only: once the sample is gone the frame holds its only reference
+    buffer = gst_buffer_ref(buffer);
+    gst_sample_unref(sample);
+    if (writable_ && !gst_buffer_is_writable(buffer)) {
+        buffer = gst_buffer_make_writable(buffer);
+        copied_frames_++;
+    }
+    data->buffer = buffer;
+
+    GstMemory* memory = gst_buffer_peek_memory(buffer, 0);
+    if (gst_buffer_n_memory(buffer) == 1 && gst_is_dmabuf_memory(memory)) {
+        data->fd = gst_dmabuf_memory_get_fd(memory);
+        data->fd_offset = memory->offset;
+        dmabuf_frames_++;
+    }
+    // Mapping system memory only returns its pointer; a dmabuf is mmapped
+    if (data->fd < 0 || map_dmabuf_ || writable_) {
+        data->mapped = gst_video_frame_map(&data->vframe, &data->info, buffer,
+                                           writable_ ? GST_MAP_READWRITE : GST_MAP_READ);
+        if (!data->mapped) {
+            std::cerr << "Error: failed to map frame" << std::endl;
+            return false;
+        }
+        data->writable = writable_;
+    }
+    data->seq = frames_++;
+    frame.data_ = data;
+    return true;
+}
+
+void GstCapture::close() {
+    if (pipeline_) {
+        gst_element_set_state(pipeline_, GST_STATE_NULL);
+        if (sink_) {
+            gst_object_unref(sink_);
+        }
+        gst_object_unref(pipeline_);
+    }
+    pipeline_ = nullptr;
+    sink_ = nullptr;
+}
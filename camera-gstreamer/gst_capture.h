@@ -0,0 +1,158 @@
+#ifndef CAMERA_GSTREAMER_GST_CAPTURE_H
+#define CAMERA_GSTREAMER_GST_CAPTURE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+// Frame pulled from an appsink. The pixels stay in the buffer of the upstream pool (v4l2src,
+// videotestsrc, a decoder...): nothing is converted or copied. Copies of a GstFrame share the
+// buffer, which goes back to its pool when the last copy is reset or destroyed.
+class GstFrame {
+private:
+    friend class GstCapture;
+
+    struct Data {
+        GstBuffer* buffer;
+        GstVideoInfo info;
+        GstVideoFrame vframe;
+        bool mapped;
+        bool writable;
+        int fd;
+        size_t fd_offset;
+        uint64_t seq;
+        int64_t capture_ns;
+
+        Data() : buffer(nullptr), mapped(false), writable(false), fd(-1), fd_offset(0), seq(0), capture_ns(0) {}
+        ~Data() {
+            if (mapped) {
+                gst_video_frame_unmap(&vframe);
+            }
+            if (buffer) {
+                gst_buffer_unref(buffer);
+            }
+        }
+    };
+
+    std::shared_ptr<Data> data_;
+
+public:
+    bool empty() const { return !data_; }
+    void reset() { data_.reset(); }
+
+    int width() const { return GST_VIDEO_INFO_WIDTH(&data_->info); }
+    int height() const { return GST_VIDEO_INFO_HEIGHT(&data_->info); }
+    GstVideoFormat format() const { return GST_VIDEO_INFO_FORMAT(&data_->info); }
+    int planes() const { return GST_VIDEO_INFO_N_PLANES(&data_->info); }
+
+    // CPU view of a plane (NV12: 0 = Y, 1 = UV), nullptr for dmabuf frames captured without mapping
+    const uint8_t* plane(int i) const {
+        return data_->mapped ? (const uint8_t*)GST_VIDEO_FRAME_PLANE_DATA(&data_->vframe, i) : nullptr;
+    }
+    // Same, for frames captured with GstCapture::setWritable(true), nullptr otherwise
+    uint8_t* writable_plane(int i) const {
+        return data_->mapped && data_->writable ? (uint8_t*)GST_VIDEO_FRAME_PLANE_DATA(&data_->vframe, i) : nullptr;
+    }
+    int stride(int i) const;
+    size_t offset(int i) const;
+
+    // dmabuf of the buffer for RGA / the NPU, -1 if the memory is not a dmabuf.
+    // Plane i starts at dmabuf_offset() + offset(i).
+    int dmabuf_fd() const { return data_->fd; }
+    size_t dmabuf_offset() const { return data_->fd_offset; }
+
+    uint64_t pts_ns() const;
+    // When the source stamped the buffer (a V4L2 timestamp for v4l2src), as steady_clock ns.
+    // The time the frame left the appsink if the buffer has no PTS.
+    int64_t capture_ns() const { return data_->capture_ns; }
+    uint64_t seq() const { return data_->seq; }
+    GstBuffer* buffer() const { return data_->buffer; }
+    const GstVideoInfo& info() const { return data_->info; }
+};
+
+// FramePool slots holding a GstFrame give the buffer back as soon as they are free
+inline void frame_pool_recycle(GstFrame& frame) {
+    frame.reset();
+}
+
+// Capture source built on appsink instead of cv::VideoCapture: frames keep their native format
+// (NV12 by default) and are handed out in place, see GstFrame.
+class GstCapture {
+private:
+    GstElement* pipeline_;
+    GstElement* sink_;
+    std::string description_;
+    bool map_dmabuf_;
+    bool writable_;
+    int cpu_;
+    int held_buffers_;
+    int min_buffers_;
+    std::atomic<bool> eos_;
+    uint64_t frames_;
+    uint64_t dmabuf_frames_;
+    uint64_t copied_frames_;
+
+    void logBusErrors();
+    int64_t captureTime(GstSample* sample, int64_t arrival_ns);
+    static GstBusSyncReply onSyncMessage(GstBus* bus, GstMessage* msg, gpointer user_data);
+    static GstPadProbeReturn onSinkQuery(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+public:
+    GstCapture();
+    ~GstCapture();
+
+    GstCapture(const GstCapture&) = delete;
+    GstCapture& operator=(const GstCapture&) = delete;
+
+    // source is the pipeline up to the caps filter, e.g. "videotestsrc is-live=true" or
+    // "v4l2src device=/dev/video0 io-mode=dmabuf"; width, height and fps <= 0 are left to negotiation.
+    // The appsink keeps at most max_buffers frames; with drop it drops the oldest beyond that, so
+    // a slow consumer never blocks the source, otherwise the source waits. With map_dmabuf false
+    // dmabuf frames are not mapped (plane() returns nullptr), for consumers that only use the fd.
+    bool open(const std::string& source, int width = 0, int height = 0, int fps = 0,
+              const std::string& format = "NV12", int max_buffers = 2, bool drop = true, bool map_dmabuf = true);
+
+    // Pins the GStreamer streaming threads of the next open() to one core, -1 to leave them alone
+    void setAffinity(int cpu) { cpu_ = cpu; }
+
+    // Frames the application holds at once besides the appsink queue (queue slots, a preview...).
+    // The next open() asks the source's buffer pool for these plus max_buffers plus one being
+    // pulled, through the ALLOCATION query: a v4l2src with io-mode=dmabuf otherwise allocates
+    // only a few buffers and stops capturing while all of them are held. 0 leaves the count to
+    // the source.
+    void setHeldBuffers(int count) { held_buffers_ = count; }
+    int minBuffers() const { return min_buffers_; }
+
+    // Maps frames for writing, e.g. to draw overlays into the captured NV12 before it is encoded.
+    // The buffer is written in place when nothing else holds it, which is the normal case;
+    // otherwise GStreamer copies it first (counted by copiedFrames()).
+    void setWritable(bool writable) { writable_ = writable; }
+
+    // Source description for a location: "/dev/videoN" becomes a dmabuf v4l2src, an existing
+    // file is replayed, anything else is taken as a source description. Files named .nv12, .yuv
+    // (I420), .rgb or .gray hold packed width x height frames back to back, e.g. recorded with
+    // V4L2_CAPTURE_RECORD from rknn/utils/v4l2_capture.h, and play at fps; other files are decoded
+    // and play at their own frame rate. With REPLAY=fast in the environment a file plays as fast
+    // as it is read, every frame in order when the capture is opened with drop false, so
+    // benchmarks see the same frames on every run.
+    static std::string sourceFor(const std::string& location, int width = 0, int height = 0, int fps = 0);
+
+    // Waits up to timeout_ms for the next frame, false on timeout, error or end of stream
+    bool read(GstFrame& frame, int timeout_ms = 1000);
+
+    void close();
+
+    bool isOpened() const { return pipeline_ != nullptr; }
+    bool isEos() const { return eos_; }
+    const std::string& description() const { return description_; }
+    uint64_t frames() const { return frames_; }
+    uint64_t dmabufFrames() const { return dmabuf_frames_; }
+    uint64_t copiedFrames() const { return copied_frames_; }
+};
+
+#endif  // CAMERA_GSTREAMER_GST_CAPTURE_H
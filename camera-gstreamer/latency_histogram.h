@@ -0,0 +1,112 @@
+#ifndef CAMERA_GSTREAMER_LATENCY_HISTOGRAM_H
+#define CAMERA_GSTREAMER_LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <cstring>
+
+// Latency histogram in microseconds with HDR-style buckets: powers of two split into 32 linear
+// sub-buckets, so every value is kept to within about 3% from 1 us to more than an hour in a
+// fixed 16 KB array. Recording never allocates. Not thread safe.
+class LatencyHistogram {
+public:
+    static const int kSubBits = 5;
+    static const int kSubBuckets = 1 << kSubBits;
+    static const int kBuckets = (64 - kSubBits) * kSubBuckets;
+
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        memset(counts_, 0, sizeof(counts_));
+        count_ = 0;
+        sum_ = 0;
+        min_ = INT64_MAX;
+        max_ = 0;
+    }
+
+    void record(int64_t us) {
+        if (us < 0) {
+            us = 0;
+        }
+        counts_[index(us)]++;
+        count_++;
+        sum_ += us;
+        if (us < min_) {
+            min_ = us;
+        }
+        if (us > max_) {
+            max_ = us;
+        }
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < kBuckets; i++) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if (other.min_ < min_) {
+            min_ = other.min_;
+        }
+        if (other.max_ > max_) {
+            max_ = other.max_;
+        }
+    }
+
+    uint64_t count() const { return count_; }
+    int64_t min() const { return count_ ? min_ : 0; }
+    int64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+
+    // Value at or below which p percent of the recorded values lie, e.g. 99.9
+    int64_t percentile(double p) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(p / 100.0 * count_ + 0.5);
+        if (rank < 1) {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                int64_t upper = bucketUpper(i);
+                return upper < max_ ? upper : max_;
+            }
+        }
+        return max_;
+    }
+
+    // Non-empty buckets, for dumps: [lower, upper] in us and the count
+    int buckets() const { return kBuckets; }
+    uint64_t bucketCount(int i) const { return counts_[i]; }
+    int64_t bucketLower(int i) const {
+        int exp = i / kSubBuckets;
+        int sub = i % kSubBuckets;
+        return exp == 0 ? sub : (int64_t)(kSubBuckets + sub) << (exp - 1);
+    }
+    int64_t bucketUpper(int i) const {
+        int exp = i / kSubBuckets;
+        return exp == 0 ? bucketLower(i) : bucketLower(i) + ((int64_t)1 << (exp - 1)) - 1;
+    }
+
+private:
+    uint64_t counts_[kBuckets];
+    uint64_t count_;
+    int64_t sum_;
+    int64_t min_;
+    int64_t max_;
+
+    // Values below kSubBuckets are exact; above, the top kSubBits + 1 bits select the bucket
+    static int index(int64_t v) {
+        if (v < kSubBuckets) {
+            return (int)v;
+        }
+        int msb = 63 - __builtin_clzll((unsigned long long)v);
+        int exp = msb - kSubBits + 1;
+        int sub = (int)(v >> (exp - 1)) - kSubBuckets;
+        return exp * kSubBuckets + sub;
+    }
+};
+
+#endif  // CAMERA_GSTREAMER_LATENCY_HISTOGRAM_H
@@ -0,0 +1,179 @@
+#ifndef CAMERA_GSTREAMER_LATENCY_STATS_H
+#define CAMERA_GSTREAMER_LATENCY_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "latency_histogram.h"
+
+// Points a frame passes between the sensor and the screen
+enum LatencyStage {
+    STAGE_CAPTURE,  // stamped by the source, e.g. GstFrame::capture_ns()
+    STAGE_DEQUEUE,  // taken off the queue (or returned by read()) in the consumer
+    STAGE_PROCESS,  // conversion / inference done
+    STAGE_ENCODE,   // encoded
+    STAGE_PUBLISH,  // encoded frame handed to the network sink
+    STAGE_DISPLAY,  // handed to the window
+    STAGE_COUNT
+};
+
+inline const char* latencyStageName(int stage) {
+    static const char* names[STAGE_COUNT] = {"capture", "dequeue", "process", "encode", "publish",
+                                                "display"};
+    return names[stage];
+}
+
+// steady_clock, which is CLOCK_MONOTONIC like V4L2 timestamps
+inline int64_t monotonicNs() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// Timestamps of one frame in monotonicNs(), 0 for stages the frame does not go through
+struct FrameTimestamps {
+    int64_t ns[STAGE_COUNT];
+
+    FrameTimestamps() { clear(); }
+    void clear() {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            ns[i] = 0;
+        }
+    }
+    void mark(LatencyStage stage) { ns[stage] = monotonicNs(); }
+};
+
+// Glass-to-glass latency: for every stage, a histogram of the time since capture and one of the
+// time since the previous stage the frame went through. Frame rates use a floating point
+// duration, so short or uneven windows are not truncated. Not thread safe: feed it from the
+// thread that finishes the frames. measure names what the times are in the status line and the
+// JSON dump, e.g. when the capture stamp is not on the same clock as the later stages.
+class LatencyStats {
+public:
+    explicit LatencyStats(const char* measure = "latency")
+        : measure_(measure), frames_(0), start_ns_(monotonicNs()), window_frames_(0),
+          window_start_ns_(start_ns_) {}
+
+    void add(const FrameTimestamps& t) {
+        frames_++;
+        window_frames_++;
+        if (t.ns[STAGE_CAPTURE] == 0) {
+            return;
+        }
+        int previous = STAGE_CAPTURE;
+        for (int i = STAGE_CAPTURE + 1; i < STAGE_COUNT; i++) {
+            if (t.ns[i] == 0) {
+                continue;
+            }
+            since_capture_[i].record((t.ns[i] - t.ns[STAGE_CAPTURE]) / 1000);
+            since_previous_[i].record((t.ns[i] - t.ns[previous]) / 1000);
+            previous = i;
+        }
+    }
+
+    const LatencyHistogram& sinceCapture(LatencyStage stage) const { return since_capture_[stage]; }
+    const LatencyHistogram& sincePrevious(LatencyStage stage) const { return since_previous_[stage]; }
+    uint64_t frames() const { return frames_; }
+
+    // Frames per second since the previous call (or the start)
+    double windowFps() {
+        int64_t now = monotonicNs();
+        double seconds = (now - window_start_ns_) / 1e9;
+        double fps = seconds > 0 ? window_frames_ / seconds : 0;
+        window_frames_ = 0;
+        window_start_ns_ = now;
+        return fps;
+    }
+
+    // "latency ms p50/p99/p999: dequeue 1.2/2.0/2.5 display 30.1/41.7/45.0", stages without
+    // frames left out
+    std::string line() const {
+        std::ostringstream out;
+        char buf[64];
+        out << measure_ << " ms p50/p99/p999:";
+        for (int i = STAGE_CAPTURE + 1; i < STAGE_COUNT; i++) {
+            const LatencyHistogram& h = since_capture_[i];
+            if (h.count() == 0) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), " %s %.1f/%.1f/%.1f", latencyStageName(i),
+                     h.percentile(50) / 1000.0, h.percentile(99) / 1000.0, h.percentile(99.9) / 1000.0);
+            out << buf;
+        }
+        return out.str();
+    }
+
+    // Writes everything as JSON, in us, through a temporary file so readers never see half a dump.
+    // The last stage also gets its histogram buckets as [lower_us, upper_us, count].
+    bool dumpJson(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        FILE* fp = fopen(tmp.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "Error: failed to open %s\n", tmp.c_str());
+            return false;
+        }
+        double seconds = (monotonicNs() - start_ns_) / 1e9;
+        fprintf(fp,
+                "{\n  \"measure\": \"%s\",\n  \"frames\": %llu,\n  \"seconds\": %.3f,\n"
+                "  \"fps\": %.3f,\n  \"stages\": [",
+                measure_, (unsigned long long)frames_, seconds, seconds > 0 ? frames_ / seconds : 0.0);
+        int last = -1;
+        const char* sep = "";
+        for (int i = STAGE_CAPTURE + 1; i < STAGE_COUNT; i++) {
+            if (since_capture_[i].count() == 0) {
+                continue;
+            }
+            fprintf(fp, "%s\n    {\"stage\": \"%s\", \"since_capture\": ", sep, latencyStageName(i));
+            writeSummary(fp, since_capture_[i]);
+            fprintf(fp, ", \"since_previous\": ");
+            writeSummary(fp, since_previous_[i]);
+            fprintf(fp, "}");
+            sep = ",";
+            last = i;
+        }
+        fprintf(fp, "\n  ]");
+        if (last >= 0) {
+            const LatencyHistogram& h = since_capture_[last];
+            fprintf(fp, ",\n  \"histogram\": {\"stage\": \"%s\", \"buckets\": [",
+                    latencyStageName(last));
+            sep = "";
+            for (int b = 0; b < h.buckets(); b++) {
+                if (h.bucketCount(b) == 0) {
+                    continue;
+                }
+                fprintf(fp, "%s[%lld, %lld, %llu]", sep, (long long)h.bucketLower(b),
+                        (long long)h.bucketUpper(b), (unsigned long long)h.bucketCount(b));
+                sep = ", ";
+            }
+            fprintf(fp, "]}");
+        }
+        fprintf(fp, "\n}\n");
+        bool ok = fclose(fp) == 0 && rename(tmp.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            fprintf(stderr, "Error: failed to write %s\n", path.c_str());
+        }
+        return ok;
+    }
+
+private:
+    const char* measure_;
+    LatencyHistogram since_capture_[STAGE_COUNT];
+    LatencyHistogram since_previous_[STAGE_COUNT];
+    uint64_t frames_;
+    int64_t start_ns_;
+    uint64_t window_frames_;
+    int64_t window_start_ns_;
+
+    static void writeSummary(FILE* fp, const LatencyHistogram& h) {
+        fprintf(fp,
+                "{\"count\": %llu, \"min_us\": %lld, \"mean_us\": %.1f, \"p50_us\": %lld, "
+                "\"p90_us\": %lld, \"p99_us\": %lld, \"p999_us\": %lld, \"max_us\": %lld}",
+                (unsigned long long)h.count(), (long long)h.min(), h.mean(), (long long)h.percentile(50),
+                (long long)h.percentile(90), (long long)h.percentile(99), (long long)h.percentile(99.9),
+                (long long)h.max());
+    }
+};
+
+#endif  // CAMERA_GSTREAMER_LATENCY_STATS_H
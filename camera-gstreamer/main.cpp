@@ -1,124 +1,97 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
-#include <queue>
 #include <chrono>
 
-// Thread-safe frame queue
-class FrameQueue {
-private:
-    std::queue<cv::Mat> queue_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
-    size_t max_size_;
-    std::atomic<bool> running_;
-
-public:
-    FrameQueue(size_t max_size = 5) : max_size_(max_size), running_(true) {}
-
-    void push(const cv::Mat& frame) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        
-        // If queue is full, remove the oldest frame
-        while (queue_.size() >= max_size_ && running_) {
-            queue_.pop();
-        }
-        
-        if (running_) {
-            queue_.push(frame.clone());
-            cond_.notify_one();
-        }
-    }
-
-    bool pop(cv::Mat& frame, int timeout_ms = 1000) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        
-        // Wait for frame available or timeout
-        if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), 
-                            [this] { return !queue_.empty() || !running_; })) {
-            return false;
-        }
-
-        if (!running_ && queue_.empty()) {
-            return false;
-        }
-
-        if (!queue_.empty()) {
-            frame = queue_.front();
-            queue_.pop();
-            return true;
-        }
-
-        return false;
-    }
-
-    void stop() {
-        running_ = false;
-        cond_.notify_all();
-    }
+#include "frame_queue.h"
+#include "gst_capture.h"
+#include "latency_stats.h"
+#include "preview_sink.h"
 
-    bool is_running() const {
-        return running_;
-    }
-
-    size_t size() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
-    }
+// Queued frame with the timestamps of its way to the screen
+struct TimedFrame {
+    GstFrame frame;
+    FrameTimestamps times;
 };
 
+inline void frame_pool_recycle(TimedFrame& frame) {
+    frame.frame.reset();
+}
+
 // Capture thread function
-void captureThread(FrameQueue& frameQueue, const std::string& gst_pipeline, 
-                   std::atomic<bool>& running, std::atomic<int>& capture_fps) {
+void captureThread(FramePool<TimedFrame>& framePool, FrameQueue<TimedFrame>& frameQueue,
+                   const std::string& source, int width, int height, int fps,
+                   std::atomic<bool>& running, std::atomic<double>& capture_fps,
+                   std::atomic<unsigned>& keep_every) {
     std::cout << "Capture thread starting..." << std::endl;
-    std::cout << "GStreamer Pipeline: " << gst_pipeline << std::endl;
 
-    // Open camera using GStreamer
-    cv::VideoCapture cap(gst_pipeline, cv::CAP_GSTREAMER);
-    
-    if (!cap.isOpened()) {
+    // Open camera with an appsink: NV12 frames stay in the v4l2src buffers
+    GstCapture cap;
+    // Every pool slot can hold a v4l2src buffer, and the preview holds one more
+    cap.setHeldBuffers(static_cast<int>(framePool.size()) + 1);
+    if (!cap.open(source, width, height, fps)) {
         std::cerr << "Error: Failed to open camera!" << std::endl;
         running = false;
         frameQueue.stop();
         return;
     }
+    std::cout << "GStreamer Pipeline: " << cap.description() << std::endl;
+    std::cout << "Source buffers requested: " << cap.minBuffers() << std::endl;
 
-    cv::Mat frame;
     int frame_count = 0;
     auto last_time = std::chrono::steady_clock::now();
 
+    // Feedback from the queue: when the display falls behind, frames are skipped here,
+    // before they take a pool slot, instead of being dropped from the queue
+    RateAdapter<TimedFrame> rate(frameQueue);
+
     while (running) {
-        if (!cap.read(frame)) {
+        GstFrame captured;
+        if (!cap.read(captured, 1000)) {
+            if (cap.isEos()) {
+                std::cerr << "Error: End of stream!" << std::endl;
+                running = false;
+                break;
+            }
             std::cerr << "Error: Failed to read frame!" << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
         }
 
-        if (frame.empty()) {
-            std::cerr << "Warning: Empty frame received!" << std::endl;
+        bool keep = rate.keep();
+        keep_every = rate.keepEvery();
+        if (!keep) {
+            continue;
+        }
+
+        // The queue passes references to pool slots around, the slot holds the buffer
+        FrameRef<TimedFrame> frame = framePool.acquire();
+        if (!frame) {
+            // Every slot is queued or on screen, skip this frame
             continue;
         }
+        frame->frame = captured;
+        frame->times.clear();
+        frame->times.ns[STAGE_CAPTURE] = captured.capture_ns();
 
-        // Push frame to queue
+        // Push frame to queue, the backpressure policy decides what goes when it is full
+        frame.seq() = captured.seq();
+        frame.timestamp() = captured.capture_ns();
         frameQueue.push(frame);
         frame_count++;
 
-        // Calculate FPS
+        // Calculate FPS over the real length of the window, not a truncated second
         auto current_time = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            current_time - last_time).count();
-        
-        if (elapsed >= 1000) {
-            capture_fps = frame_count;
+        double elapsed = std::chrono::duration<double>(current_time - last_time).count();
+
+        if (elapsed >= 1.0) {
+            capture_fps = frame_count / elapsed;
             frame_count = 0;
             last_time = current_time;
         }
     }
 
-    cap.release();
+    cap.close();
     std::cout << "Capture thread exiting" << std::endl;
 }
 
@@ -133,6 +106,7 @@ int main(int argc, char** argv) {
     int height = 1080;
     int fps = 30;
     size_t queue_size = 5;
+    std::string policy = "drop-oldest";
 
     // Parse command line arguments
     if (argc >= 2) device = argv[1];
@@ -140,92 +114,163 @@ int main(int argc, char** argv) {
     if (argc >= 4) height = std::atoi(argv[3]);
     if (argc >= 5) fps = std::atoi(argv[4]);
     if (argc >= 6) queue_size = std::atoi(argv[5]);
+    if (argc >= 7) policy = argv[6];
+
+    BackpressureConfig backpressure;
+    if (!parseBackpressure(policy, backpressure)) {
+        std::cerr << "Error: unknown policy " << policy
+                  << ", expected drop-oldest, drop-newest, keep-every=N or latency-target=MS" << std::endl;
+        return -1;
+    }
+
+    // Window: PREVIEW=off|full|FPS[@SCALE], a 10 fps half size preview by default, headless
+    // without a display
+    PreviewConfig preview_config;
+    if (!previewFromEnv(preview_config)) {
+        std::cerr << "Error: unknown PREVIEW, expected off, full or FPS[@SCALE]" << std::endl;
+        return -1;
+    }
 
     std::cout << "Configuration:" << std::endl;
     std::cout << "  Device: " << device << std::endl;
     std::cout << "  Resolution: " << width << "x" << height << std::endl;
     std::cout << "  FPS: " << fps << " FPS" << std::endl;
     std::cout << "  Queue Size: " << queue_size << std::endl;
+    std::cout << "  Policy: " << policy << std::endl;
+    std::cout << "  Preview: " << previewName(preview_config) << std::endl;
     std::cout << std::endl;
 
-    // Build GStreamer Pipeline
-    std::string gst_pipeline = "v4l2src device=" + device + " min-buffers=2 io-mode=mmap " +
-                               " ! video/x-raw, format=NV12, width=" + std::to_string(width) + 
-                               ", height=" + std::to_string(height) + 
-                               ", framerate=" + std::to_string(fps) + "/1" +
-                               " ! videoconvert ! video/x-raw, format=(string)BGR ! appsink";
+    // GStreamer source: a V4L2 device exporting its buffers as dmabuf, a video file, or any
+    // source description such as "videotestsrc is-live=true"
+    std::string source = GstCapture::sourceFor(device, width, height, fps);
+
+    // Slots for the queued frames, the one being captured, the one being displayed and one
+    // released by a drop; a slot only holds a reference to the GStreamer buffer (the preview
+    // keeps a buffer, not a slot)
+    FramePool<TimedFrame> framePool(queue_size + 3, [](TimedFrame&) {});
 
     // Create frame queue
-    FrameQueue frameQueue(queue_size);
+    FrameQueue<TimedFrame> frameQueue(queue_size, backpressure);
 
     // Atomic variables for inter-thread communication
     std::atomic<bool> running(true);
-    std::atomic<int> capture_fps(0);
-    std::atomic<int> display_fps(0);
+    std::atomic<double> capture_fps(0);
+    std::atomic<unsigned> keep_every(1);
+
+    // Capture to display latency, dumped as JSON every second when LATENCY_STATS=<file> is set
+    LatencyStats latency;
+    const char* latency_file = getenv("LATENCY_STATS");
 
     // Set environment variables for RGA hardware acceleration
     setenv("GST_VIDEO_CONVERT_USE_RGA", "1", 1);
     setenv("GST_VIDEO_FLIP_USE_RGA", "1", 1);
 
     // Start capture thread
-    std::thread capture_thread(captureThread, std::ref(frameQueue), 
-                               gst_pipeline, std::ref(running), 
-                               std::ref(capture_fps));
+    std::thread capture_thread(captureThread, std::ref(framePool), std::ref(frameQueue),
+                               source, width, height, fps, std::ref(running),
+                               std::ref(capture_fps), std::ref(keep_every));
 
     // Wait a moment to ensure capture thread initialization
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     
+    // Ctrl-C ends headless runs
+    handleStopSignals();
+
     const std::string window_name = "V4L2 Camera Stream";
-    cv::namedWindow(window_name, cv::WINDOW_AUTOSIZE);
+    if (preview_config.mode == PREVIEW_FULL) {
+        cv::namedWindow(window_name, cv::WINDOW_AUTOSIZE);
+    }
+    PreviewSink<GstFrame> preview(window_name, preview_config, [](const GstFrame& image, double scale, cv::Mat& bgr) {
+        renderNv12Preview(image.plane(0), image.stride(0), image.plane(1), image.stride(1), image.width(),
+                          image.height(), scale, bgr);
+    });
+    if (preview_config.mode == PREVIEW_SCALED) {
+        preview.start();
+    }
 
-    cv::Mat frame;
-    int frame_count = 0;
+    FrameRef<TimedFrame> frame;
+    cv::Mat bgr;
     auto last_time = std::chrono::steady_clock::now();
 
-    while (running && frameQueue.is_running()) {
+    while (running && frameQueue.is_running() && !stopRequested()) {
         if (!frameQueue.pop(frame, 1000)) {
             if (!running) break;
             continue;
         }
 
-        if (frame.empty()) {
+        const GstFrame& image = frame->frame;
+        if (image.empty()) {
             continue;
         }
-
-        // Display frame
-        cv::imshow(window_name, frame);
-
-        frame_count++;
-
-        // Calculate display FPS
-        auto current_time = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            current_time - last_time).count();
-        
-        if (elapsed >= 1000) {
-            display_fps = frame_count;
-            frame_count = 0;
-            last_time = current_time;
-            
-            // Print FPS information to console (overwrite previous line)
-            std::cout << "\r[FPS] Capture: " << capture_fps.load() 
-                      << " | Display: " << display_fps.load() 
-                      << " | Queue: " << frameQueue.size() 
-                      << "  " << std::flush;
+        FrameTimestamps& times = frame->times;
+        times.mark(STAGE_DEQUEUE);
+
+        int key = -1;
+        if (preview_config.mode == PREVIEW_FULL) {
+            // Display frame, NV12 is only converted for the window
+            cv::Mat y(image.height(), image.width(), CV_8UC1, (void*)image.plane(0), image.stride(0));
+            cv::Mat uv(image.height() / 2, image.width() / 2, CV_8UC2, (void*)image.plane(1), image.stride(1));
+            cv::cvtColorTwoPlane(y, uv, bgr, cv::COLOR_YUV2BGR_NV12);
+            times.mark(STAGE_PROCESS);
+            cv::imshow(window_name, bgr);
+
+            // Check key press, HighGUI draws the window here
+            key = cv::waitKey(1);
+            times.mark(STAGE_DISPLAY);
+        } else {
+            // The preview thread converts the latest frame when it is due, the frame is done here
+            if (preview_config.mode == PREVIEW_SCALED) {
+                preview.offer(image);
+                key = preview.key();
+            }
+            times.mark(STAGE_PROCESS);
         }
+        latency.add(times);
+        frame.reset();
 
-        // Check key press
-        int key = cv::waitKey(1);
         if (key == 'q' || key == 'Q' || key == 27) { // 'q' or ESC key to exit
             std::cout << std::endl << "Exit key detected..." << std::endl;
             running = false;
             break;
         }
+
+        // Print FPS and latency once a second (overwrite previous line)
+        auto current_time = std::chrono::steady_clock::now();
+        if (current_time - last_time >= std::chrono::seconds(1)) {
+            last_time = current_time;
+            char fps_text[64];
+            snprintf(fps_text, sizeof(fps_text), "Capture: %.1f | Consumer: %.1f", capture_fps.load(),
+                     latency.windowFps());
+            std::cout << "\r[FPS] " << fps_text
+                      << " | Queue: " << frameQueue.size()
+                      << " | Dropped:" << (frameQueue.dropped() == 0 ? " 0" : "");
+            for (int reason = 0; reason < DROP_REASON_COUNT; reason++) {
+                if (frameQueue.dropped((DropReason)reason) > 0) {
+                    std::cout << " " << dropReasonName(reason) << " " << frameQueue.dropped((DropReason)reason);
+                }
+            }
+            if (preview_config.mode == PREVIEW_SCALED) {
+                std::cout << " | Preview: " << preview.shown() << "/" << preview.offered();
+            }
+            std::cout << " | Keep: 1/" << keep_every.load()
+                      << " | " << latency.line()
+                      << "  " << std::flush;
+            if (latency_file) {
+                latency.dumpJson(latency_file);
+            }
+        }
+    }
+
+    if (latency_file) {
+        latency.dumpJson(latency_file);
     }
+    std::cout << std::endl << "Latency over " << latency.frames() << " frames, " << latency.line() << std::endl;
 
+    preview.stop();
     cv::destroyAllWindows();
     
-    // Stop queue and wait for capture thread to finish
+    // Stop queue and wait for capture thread to finish; a stop signal ends only the loop above
+    running = false;
     frameQueue.stop();
     capture_thread.join();
 
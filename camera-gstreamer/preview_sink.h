@@ -0,0 +1,295 @@
+#ifndef CAMERA_GSTREAMER_PREVIEW_SINK_H
+#define CAMERA_GSTREAMER_PREVIEW_SINK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <opencv2/opencv.hpp>
+
+#include "frame_queue.h"
+
+// How a camera program shows its frames
+enum PreviewMode {
+    PREVIEW_OFF,     // headless: no window at all
+    PREVIEW_FULL,    // every frame at full size on the frame path, imshow + waitKey per frame
+    PREVIEW_SCALED,  // PreviewSink: the latest frame, downscaled and rate limited, on its own thread
+};
+
+struct PreviewConfig {
+    PreviewMode mode;
+    double fps;
+    double scale;
+
+    PreviewConfig(PreviewMode mode = PREVIEW_SCALED, double fps = 10, double scale = 0.5)
+        : mode(mode), fps(fps), scale(scale) {}
+};
+
+// "off", "full" or "FPS[@SCALE]", e.g. "10@0.5": 10 previews a second at half width and height
+inline bool parsePreview(const std::string& text, PreviewConfig& config) {
+    if (text == "off") {
+        config = PreviewConfig(PREVIEW_OFF);
+        return true;
+    }
+    if (text == "full") {
+        config = PreviewConfig(PREVIEW_FULL);
+        return true;
+    }
+    char* end = nullptr;
+    double fps = strtod(text.c_str(), &end);
+    double scale = 0.5;
+    if (*end == '@') {
+        scale = strtod(end + 1, &end);
+    }
+    if (*end != '\0' || fps <= 0 || scale <= 0 || scale > 1) {
+        return false;
+    }
+    config = PreviewConfig(PREVIEW_SCALED, fps, scale);
+    return true;
+}
+
+// PREVIEW=<mode> from the environment. Without it: a scaled preview when there is a display to
+// show it on, headless otherwise.
+inline bool previewFromEnv(PreviewConfig& config) {
+    const char* text = getenv("PREVIEW");
+    if (text) {
+        return parsePreview(text, config);
+    }
+    bool display = getenv("DISPLAY") || getenv("WAYLAND_DISPLAY");
+    config = PreviewConfig(display ? PREVIEW_SCALED : PREVIEW_OFF);
+    return true;
+}
+
+inline std::string previewName(const PreviewConfig& config) {
+    if (config.mode == PREVIEW_OFF) {
+        return "off (headless)";
+    }
+    if (config.mode == PREVIEW_FULL) {
+        return "full";
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.1f fps at %.2fx", config.fps, config.scale);
+    return buf;
+}
+
+// Set by SIGINT and SIGTERM once handleStopSignals() is called: headless runs have no window
+// to press 'q' in
+inline std::atomic<bool>& stopRequested() {
+    static std::atomic<bool> requested(false);
+    return requested;
+}
+
+inline void handleStopSignals() {
+    stopRequested();
+    signal(SIGINT, [](int) { stopRequested() = true; });
+    signal(SIGTERM, [](int) { stopRequested() = true; });
+}
+
+// NV12 to a BGR preview: the planes are scaled first, so only the small image is converted
+inline void renderNv12Preview(const uint8_t* y, int y_stride, const uint8_t* uv, int uv_stride, int width, int height,
+                              double scale, cv::Mat& bgr) {
+    cv::Mat y_plane(height, width, CV_8UC1, (void*)y, y_stride);
+    cv::Mat uv_plane(height / 2, width / 2, CV_8UC2, (void*)uv, uv_stride);
+    if (scale >= 1) {
+        cv::cvtColorTwoPlane(y_plane, uv_plane, bgr, cv::COLOR_YUV2BGR_NV12);
+        return;
+    }
+    int w = std::max(2, (int)(width * scale)) & ~1;
+    int h = std::max(2, (int)(height * scale)) & ~1;
+    cv::Mat y_small, uv_small;
+    cv::resize(y_plane, y_small, cv::Size(w, h), 0, 0, cv::INTER_LINEAR);
+    cv::resize(uv_plane, uv_small, cv::Size(w / 2, h / 2), 0, 0, cv::INTER_LINEAR);
+    cv::cvtColorTwoPlane(y_small, uv_small, bgr, cv::COLOR_YUV2BGR_NV12);
+}
+
+inline void renderBgrPreview(const cv::Mat& frame, double scale, cv::Mat& bgr) {
+    if (scale >= 1) {
+        bgr = frame;
+        return;
+    }
+    cv::resize(frame, bgr, cv::Size(), scale, scale, cv::INTER_LINEAR);
+}
+
+// Preview window on its own thread, off the frame path. offer() only swaps the pending frame
+// under a lock; the preview thread takes the newest one at most fps times a second, renders it
+// downscaled and shows it. Frames offered in between are replaced without ever being converted.
+// The thread makes every HighGUI call for its window, as HighGUI wants them from one thread, and
+// sleeps in waitKey() so the window stays responsive. Frame must be cheap to copy and keep (a
+// GstFrame, a FrameRef, a cv::Mat that is not written again) and default constructible.
+template <typename Frame>
+class PreviewSink {
+public:
+    typedef std::function<void(const Frame&, double scale, cv::Mat& bgr)> Render;
+
+    PreviewSink(const std::string& window, const PreviewConfig& config, Render render)
+        : window_(window), config_(config), render_(render), pending_(false), stopped_(false), next_ns_(0), key_(-1),
+          offered_(0), shown_(0) {}
+
+    ~PreviewSink() { stop(); }
+
+    PreviewSink(const PreviewSink&) = delete;
+    PreviewSink& operator=(const PreviewSink&) = delete;
+
+    void start() { thread_ = std::thread(&PreviewSink::run, this); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        cond_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // False while a frame is pending or the next preview is not due: producers that must copy a
+    // frame to keep it can skip the copy
+    bool due() const { return !pending_ && nowNs() >= next_ns_; }
+
+    // Replaces the pending frame; never waits for the window
+    void offer(const Frame& frame) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame_ = frame;
+            pending_ = true;
+        }
+        offered_++;
+        cond_.notify_one();
+    }
+
+    // Last key pressed in the window, -1 if none since the previous call
+    int key() { return key_.exchange(-1); }
+
+    uint64_t offered() const { return offered_; }
+    uint64_t shown() const { return shown_; }
+
+private:
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void pollKey(int ms) {
+        int key = cv::waitKey(std::max(1, ms));
+        if (key >= 0) {
+            key_ = key;
+        }
+    }
+
+    void run() {
+        cv::namedWindow(window_, cv::WINDOW_AUTOSIZE);
+        const int64_t interval_ns = (int64_t)(1e9 / config_.fps);
+        cv::Mat bgr;
+        for (;;) {
+            // Until the next preview is due, keep the window alive
+            int64_t wait_ns = next_ns_ - nowNs();
+            if (wait_ns > 0) {
+                pollKey((int)(wait_ns / 1000000));
+                continue;
+            }
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!pending_ && !stopped_) {
+                    cond_.wait_for(lock, std::chrono::milliseconds(30));
+                }
+                if (stopped_) {
+                    break;
+                }
+                if (!pending_) {
+                    lock.unlock();
+                    pollKey(1);
+                    continue;
+                }
+                std::swap(frame, frame_);
+                pending_ = false;
+            }
+            next_ns_ = nowNs() + interval_ns;
+            render_(frame, config_.scale, bgr);
+            frame = Frame();  // the source gets its buffer back before the window is drawn
+            cv::imshow(window_, bgr);
+            shown_++;
+            pollKey(1);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame_ = Frame();
+        }
+        cv::destroyWindow(window_);
+    }
+
+    std::string window_;
+    PreviewConfig config_;
+    Render render_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    Frame frame_;
+    std::atomic<bool> pending_;
+    bool stopped_;
+    std::atomic<int64_t> next_ns_;
+    std::atomic<int> key_;
+    std::atomic<uint64_t> offered_;
+    std::atomic<uint64_t> shown_;
+};
+
+// Scaled preview of BGR frames that the capture writes again (cap >> frame): a frame due for
+// the preview is copied into one of two Mats allocated here, one shown and one pending. The
+// slot goes back before imshow, so a full size preview is copied out of it. Only PREVIEW_SCALED
+// has a thread and frames; PREVIEW_FULL stays on the caller's frame path.
+class BgrPreview {
+public:
+    BgrPreview(const std::string& window, const PreviewConfig& config, int width, int height)
+        : scaled_(config.mode == PREVIEW_SCALED),
+          frames_(2,
+                  [&](cv::Mat& m) {
+                      if (scaled_) {
+                          m.create(height, width, CV_8UC3);
+                      }
+                  }),
+          sink_(window, config, [](const FrameRef<cv::Mat>& f, double scale, cv::Mat& bgr) {
+              if (scale >= 1) {
+                  f->copyTo(bgr);
+              } else {
+                  renderBgrPreview(*f, scale, bgr);
+              }
+          }) {
+        if (scaled_) {
+            sink_.start();
+        }
+    }
+
+    // Copies frame when a preview is due and a slot is free; the last key pressed in the window
+    int offer(const cv::Mat& frame) {
+        if (!scaled_) {
+            return -1;
+        }
+        FrameRef<cv::Mat> copy;
+        if (sink_.due() && (copy = frames_.acquire())) {
+            frame.copyTo(*copy);
+            sink_.offer(copy);
+        }
+        return sink_.key();
+    }
+
+    void stop() { sink_.stop(); }
+    uint64_t shown() const { return sink_.shown(); }
+
+private:
+    bool scaled_;
+    FramePool<cv::Mat> frames_;
+    PreviewSink<FrameRef<cv::Mat>> sink_;
+};
+
+#endif  // CAMERA_GSTREAMER_PREVIEW_SINK_H
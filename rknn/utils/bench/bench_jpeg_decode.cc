@@ -0,0 +1,118 @@
+// Images/sec of a JPEG directory: read_image() against a reused jpeg_decoder_t, full size and DCT scaled.
+//
+// Usage: bench_jpeg_decode <image_dir> [min_size] [passes]
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "easy_timer.h"
+#include "image_utils.h"
+#include "jpeg_decoder.h"
+
+static int is_jpeg(const char* name)
+{
+    const char* ext = strrchr(name, '.');
+    return ext != NULL && (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0 || strcmp(ext, ".JPG") == 0 ||
+                           strcmp(ext, ".JPEG") == 0);
+}
+
+static void report(const char* mode, int images, long pixels, TIMER* timer)
+{
+    float ms = timer->get_time();
+    printf("%-22s images=%-6d %8.1f images/sec %8.1f Mpix/sec (decoded)\n", mode, images, images * 1000.0f / ms,
+           pixels / 1000.0f / ms);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <image_dir> [min_size] [passes]\n", argv[0]);
+        return -1;
+    }
+    const char* dir = argv[1];
+    int min_size = argc > 2 ? atoi(argv[2]) : 640;
+    int passes = argc > 3 ? atoi(argv[3]) : 1;
+
+    std::vector<std::string> files;
+    struct dirent** entries;
+    int n = scandir(dir, &entries, NULL, alphasort);
+    for (int i = 0; i < n; i++) {
+        if (is_jpeg(entries[i]->d_name)) {
+            files.push_back(std::string(dir) + "/" + entries[i]->d_name);
+        }
+        free(entries[i]);
+    }
+    if (n > 0) {
+        free(entries);
+    }
+    if (files.empty()) {
+        printf("no jpeg in %s\n", dir);
+        return -1;
+    }
+
+    TIMER timer;
+    long pixels;
+    int images = (int)files.size() * passes;
+
+    // baseline: new handle, file buffer and output buffer per image
+    pixels = 0;
+    timer.tik();
+    for (int p = 0; p < passes; p++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            image_buffer_t img;
+            memset(&img, 0, sizeof(image_buffer_t));
+            if (read_image(files[i].c_str(), &img) == 0) {
+                pixels += (long)img.width * img.height;
+                free(img.virt_addr);
+            }
+        }
+    }
+    timer.tok();
+    report("read_image", images, pixels, &timer);
+
+    struct {
+        const char* name;
+        image_format_t format;
+        int min_size;
+    } modes[] = {
+        {"decoder rgb", IMAGE_FORMAT_RGB888, 0},
+        {"decoder rgb scaled", IMAGE_FORMAT_RGB888, min_size},
+        {"decoder nv12 scaled", IMAGE_FORMAT_YUV420SP_NV12, min_size},
+    };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        jpeg_decoder_t* decoder = jpeg_decoder_create(4);
+        jpeg_decode_param_t param;
+        memset(&param, 0, sizeof(param));
+        param.format = modes[m].format;
+        param.min_width = modes[m].min_size;
+        param.min_height = modes[m].min_size;
+
+        pixels = 0;
+        int ok = 0;
+        timer.tik();
+        for (int p = 0; p < passes; p++) {
+            for (size_t i = 0; i < files.size(); i++) {
+                image_buffer_t img;
+                memset(&img, 0, sizeof(image_buffer_t));
+                if (jpeg_decoder_decode_file(decoder, files[i].c_str(), &param, &img) == 0) {
+                    pixels += (long)img.width * img.height;
+                    ok++;
+                    jpeg_decoder_release(decoder, &img);
+                }
+            }
+        }
+        timer.tok();
+        report(modes[m].name, ok, pixels, &timer);
+
+        jpeg_decoder_stats_t stats;
+        jpeg_decoder_get_stats(decoder, &stats);
+        printf("%-22s pool hits=%ld misses=%ld\n", "", stats.pool_hits, stats.pool_misses);
+        jpeg_decoder_destroy(decoder);
+    }
+    return 0;
+}
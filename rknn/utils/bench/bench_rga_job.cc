@@ -0,0 +1,128 @@
+// Counts RGA driver submissions of the per-operation preprocessing against image_job batching.
+// Link against the recording stub (-DRGA_RECORDING_STUB=ON), RGA_STUB_SUBMIT_US sets the cost of one submission.
+// Operations (single ops and jobs) and buffer imports/releases are reported apart: batching only
+// saves operations, imports are saved by registering the buffers (image_job_register_buffer).
+//
+// Usage: bench_rga_job [frames] [max_streams] [boxes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "easy_timer.h"
+#include "image_job.h"
+#include "image_utils.h"
+#include "rga_recording_stub.h"
+
+#define SRC_WIDTH 1920
+#define SRC_HEIGHT 1080
+#define MODEL_SIZE 640
+
+static void alloc_image(image_buffer_t* img, int width, int height)
+{
+    memset(img, 0, sizeof(image_buffer_t));
+    img->width = width;
+    img->height = height;
+    img->format = IMAGE_FORMAT_RGB888;
+    img->size = get_image_size(img);
+    img->virt_addr = (unsigned char*)malloc(img->size);
+    memset(img->virt_addr, 0, img->size);
+}
+
+static void report(const char* mode, int streams, int frames, TIMER* timer)
+{
+    rga_stub_counters_t c;
+    rga_stub_get_counters(&c);
+    printf("%-14s streams=%-2d submissions/frame=%6.1f ops/frame=%5.1f imports+releases/frame=%5.1f "
+           "tasks/frame=%6.1f time/frame=%.3f ms\n",
+           mode, streams, (double)rga_stub_submissions(&c) / frames, (double)(c.single_ops + c.jobs) / frames,
+           (double)(c.imports + c.releases) / frames, (double)c.tasks / frames, timer->get_time() / frames);
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 1000;
+    int max_streams = argc > 2 ? atoi(argv[2]) : 4;
+    int boxes = argc > 3 ? atoi(argv[3]) : 8;
+
+    std::vector<image_buffer_t> srcs(max_streams);
+    std::vector<image_buffer_t> dsts(max_streams);
+    for (int i = 0; i < max_streams; i++) {
+        alloc_image(&srcs[i], SRC_WIDTH, SRC_HEIGHT);
+        alloc_image(&dsts[i], MODEL_SIZE, MODEL_SIZE);
+    }
+
+    TIMER timer;
+    letterbox_t letterbox;
+    for (int streams = 1; streams <= max_streams; streams *= 2) {
+        // one improcess/imfill (plus buffer imports) per operation
+        rga_stub_reset();
+        timer.tik();
+        for (int f = 0; f < frames; f++) {
+            for (int s = 0; s < streams; s++) {
+                convert_image_with_letterbox(&srcs[s], &dsts[s], &letterbox, 114);
+            }
+        }
+        timer.tok();
+        report("per-op", streams, frames, &timer);
+
+        // all streams of a frame in one job
+        rga_stub_reset();
+        timer.tik();
+        for (int f = 0; f < frames; f++) {
+            image_job_t* job = image_job_create();
+            for (int s = 0; s < streams; s++) {
+                image_job_add_letterbox(job, &srcs[s], &dsts[s], &letterbox, 114);
+            }
+            image_job_submit(job);
+        }
+        timer.tok();
+        report("job", streams, frames, &timer);
+
+        // same job with the detection boxes of the previous frame drawn on the source images
+        rga_stub_reset();
+        timer.tik();
+        for (int f = 0; f < frames; f++) {
+            image_job_t* job = image_job_create();
+            for (int s = 0; s < streams; s++) {
+                image_job_add_letterbox(job, &srcs[s], &dsts[s], &letterbox, 114);
+                for (int b = 0; b < boxes; b++) {
+                    image_rect_t rect = {b * 100, b * 50, b * 100 + 200, b * 50 + 300};
+                    image_job_add_rectangle(job, &srcs[s], &rect, 0xFF0000FF, 3);
+                }
+            }
+            image_job_submit(job);
+        }
+        timer.tok();
+        report("job+boxes", streams, frames, &timer);
+
+        // same job with the buffers imported once, as frame pool buffers are
+        for (int s = 0; s < streams; s++) {
+            image_job_register_buffer(&srcs[s]);
+            image_job_register_buffer(&dsts[s]);
+        }
+        rga_stub_reset();
+        timer.tik();
+        for (int f = 0; f < frames; f++) {
+            image_job_t* job = image_job_create();
+            for (int s = 0; s < streams; s++) {
+                image_job_add_letterbox(job, &srcs[s], &dsts[s], &letterbox, 114);
+            }
+            image_job_submit(job);
+        }
+        timer.tok();
+        report("job+registered", streams, frames, &timer);
+        for (int s = 0; s < streams; s++) {
+            image_job_unregister_buffer(&srcs[s]);
+            image_job_unregister_buffer(&dsts[s]);
+        }
+    }
+
+    for (int i = 0; i < max_streams; i++) {
+        free(srcs[i].virt_addr);
+        free(dsts[i].virt_addr);
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+// ROIs/sec of convert_image_rois against one convert_image call per ROI.
+//
+// Usage: bench_rois [iterations] [roi_size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "easy_timer.h"
+#include "image_utils.h"
+
+#define SRC_WIDTH 1920
+#define SRC_HEIGHT 1080
+#define MAX_ROIS 64
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    int roi_size = argc > 2 ? atoi(argv[2]) : 224;
+
+    image_buffer_t src;
+    memset(&src, 0, sizeof(image_buffer_t));
+    src.width = SRC_WIDTH;
+    src.height = SRC_HEIGHT;
+    src.format = IMAGE_FORMAT_RGB888;
+    src.size = get_image_size(&src);
+    src.virt_addr = (unsigned char*)malloc(src.size);
+    for (int i = 0; i < src.size; i++) {
+        src.virt_addr[i] = (unsigned char)(i * 7);
+    }
+
+    // detection-like boxes of various sizes spread over the frame
+    std::vector<image_rect_t> rois(MAX_ROIS);
+    srand(0);
+    for (int i = 0; i < MAX_ROIS; i++) {
+        int w = 32 + rand() % 320;
+        int h = 32 + rand() % 320;
+        rois[i].left = rand() % (SRC_WIDTH - w);
+        rois[i].top = rand() % (SRC_HEIGHT - h);
+        rois[i].right = rois[i].left + w - 1;
+        rois[i].bottom = rois[i].top + h - 1;
+    }
+
+    image_buffer_t tensor;
+    memset(&tensor, 0, sizeof(image_buffer_t));
+    tensor.width = roi_size;
+    tensor.format = IMAGE_FORMAT_RGB888;
+    int roi_bytes = roi_size * roi_size * 3;
+    tensor.virt_addr = (unsigned char*)malloc((size_t)roi_bytes * MAX_ROIS);
+
+    TIMER timer;
+    printf("%-6s %16s %16s\n", "rois", "per-roi ROIs/s", "batched ROIs/s");
+    for (int n = 1; n <= MAX_ROIS; n *= 2) {
+        tensor.height = roi_size * n;
+        tensor.size = roi_bytes * n;
+
+        timer.tik();
+        for (int it = 0; it < iterations; it++) {
+            for (int i = 0; i < n; i++) {
+                image_buffer_t view = tensor;
+                view.height = roi_size;
+                view.size = roi_bytes;
+                view.virt_addr = tensor.virt_addr + (size_t)i * roi_bytes;
+                convert_image(&src, &view, &rois[i], NULL, 0);
+            }
+        }
+        timer.tok();
+        double per_roi = (double)n * iterations * 1000 / timer.get_time();
+
+        timer.tik();
+        for (int it = 0; it < iterations; it++) {
+            convert_image_rois(&src, &rois[0], n, &tensor);
+        }
+        timer.tok();
+        double batched = (double)n * iterations * 1000 / timer.get_time();
+
+        printf("%-6d %16.1f %16.1f\n", n, per_roi, batched);
+    }
+
+    free(src.virt_addr);
+    free(tensor.virt_addr);
+    return 0;
+}
@@ -0,0 +1,191 @@
+// V4L2 capture into a processing thread: frames handed over as the exported DMABUF (zero copy) against
+// a memcpy of every frame into a heap buffer, which is what an appsink / cv::VideoCapture path does at
+// least once. The processing thread letterboxes each frame to 640x640 RGB and releases it.
+// Reports fps, CPU copies per frame, capture latency (driver timestamp to dequeue), end to end latency
+// (driver timestamp to processed), how long frames are held and the frames the driver dropped.
+//
+// Without a camera, load the virtual driver: sudo modprobe vivid (multiplanar=2 for an rkisp-like node),
+// or replay a recording (V4L2_CAPTURE_RECORD=<file>) or a MJPEG clip in place of the device. A replay is
+// looped until frames are captured; "fast" delivers them as soon as a buffer is free instead of at
+// their recorded timestamps, so every run sees the same frames.
+//
+// Usage: bench_v4l2_capture <device | file> [width] [height] [frames] [NV12|NV21|RGB3|GREY] [realtime|fast]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "image_utils.h"
+#include "v4l2_capture.h"
+
+#define MODEL_SIZE 640
+
+static int64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct Handoff {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<v4l2_frame_t*> frames;
+    bool done = false;
+};
+
+struct Result {
+    int frames = 0;
+    double copies = 0;
+    double e2e_sum_ms = 0;
+    int e2e_count = 0;
+};
+
+static void process(Handoff* handoff, bool copy, Result* result)
+{
+    image_buffer_t dst;
+    memset(&dst, 0, sizeof(image_buffer_t));
+    dst.width = MODEL_SIZE;
+    dst.height = MODEL_SIZE;
+    dst.format = IMAGE_FORMAT_RGB888;
+    dst.size = get_image_size(&dst);
+    dst.virt_addr = (unsigned char*)malloc(dst.size);
+    dst.fd = -1;
+    unsigned char* heap = NULL;
+    uint64_t copied_bytes = 0, frame_bytes = 0;
+
+    for (;;) {
+        v4l2_frame_t* frame;
+        {
+            std::unique_lock<std::mutex> lock(handoff->mutex);
+            handoff->cond.wait(lock, [&] { return !handoff->frames.empty() || handoff->done; });
+            if (handoff->frames.empty()) {
+                break;
+            }
+            frame = handoff->frames.front();
+            handoff->frames.pop_front();
+        }
+
+        image_buffer_t src = frame->image;
+        frame_bytes += src.size;
+        if (copy) {
+            // the driver buffer goes back right away, the pixels live on in the heap copy
+            if (heap == NULL) {
+                heap = (unsigned char*)malloc(frame->image.size);
+            }
+            memcpy(heap, frame->image.virt_addr, frame->image.size);
+            copied_bytes += frame->image.size;
+            src.virt_addr = heap;
+            src.fd = -1;
+        }
+        int64_t timestamp_us = frame->timestamp_us;
+        if (copy) {
+            v4l2_frame_release(frame);
+        }
+
+        letterbox_t letter_box;
+        memset(&letter_box, 0, sizeof(letterbox_t));
+        convert_image_with_letterbox(&src, &dst, &letter_box, 114);
+        if (!copy) {
+            v4l2_frame_release(frame);
+        }
+
+        int64_t e2e_us = monotonic_us() - timestamp_us;
+        if (timestamp_us > 0 && e2e_us >= 0 && e2e_us < 10000000) {
+            result->e2e_sum_ms += e2e_us / 1000.0;
+            result->e2e_count++;
+        }
+        result->frames++;
+    }
+    result->copies = frame_bytes > 0 ? (double)copied_bytes / frame_bytes : 0;
+    free(heap);
+    free(dst.virt_addr);
+}
+
+static int run(const char* device, v4l2_capture_config_t* config, int frames, bool copy)
+{
+    v4l2_capture_t* capture = v4l2_capture_open(device, config);
+    if (capture == NULL) {
+        return -1;
+    }
+    Handoff handoff;
+    Result result;
+    std::thread worker(process, &handoff, copy, &result);
+
+    v4l2_capture_start(capture);
+    int64_t start_us = 0;
+    int timeouts = 0;
+    for (int i = 0; i < frames;) {
+        v4l2_frame_t* frame;
+        int ret = v4l2_capture_dequeue(capture, &frame, 1000);
+        if (ret == -2) {
+            if (++timeouts == 3) {
+                printf("no frame for 3s\n");
+                break;
+            }
+            continue;
+        }
+        if (ret != 0) {
+            break;
+        }
+        if (start_us == 0) {
+            start_us = monotonic_us();
+        }
+        std::lock_guard<std::mutex> lock(handoff.mutex);
+        handoff.frames.push_back(frame);
+        handoff.cond.notify_one();
+        i++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(handoff.mutex);
+        handoff.done = true;
+        handoff.cond.notify_one();
+    }
+    worker.join();
+    int64_t end_us = monotonic_us();
+
+    v4l2_capture_stats_t stats;
+    v4l2_capture_get_stats(capture, &stats);
+    v4l2_capture_stop(capture);
+    v4l2_capture_close(capture);
+
+    printf("%-7s frames=%-5d fps=%6.1f copies/frame=%.2f capture latency avg=%.2fms max=%.2fms "
+           "end to end=%.2fms held=%.2fms dropped=%llu\n",
+           copy ? "copy" : "dmabuf", result.frames,
+           start_us > 0 ? result.frames * 1000000.0 / (end_us - start_us) : 0.0, result.copies,
+           stats.latency_avg_ms, stats.latency_max_ms,
+           result.e2e_count > 0 ? result.e2e_sum_ms / result.e2e_count : 0.0, stats.hold_avg_ms,
+           (unsigned long long)stats.dropped);
+    return result.frames > 0 ? 0 : -1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <device | file> [width] [height] [frames] [NV12|NV21|RGB3|GREY] [realtime|fast]\n", argv[0]);
+        return -1;
+    }
+    v4l2_capture_config_t config;
+    v4l2_capture_config_default(&config);
+    const char* device = argv[1];
+    config.width = argc > 2 ? atoi(argv[2]) : 1280;
+    config.height = argc > 3 ? atoi(argv[3]) : 720;
+    int frames = argc > 4 ? atoi(argv[4]) : 300;
+    if (argc > 5 && strlen(argv[5]) == 4) {
+        config.pixel_format = v4l2_fourcc(argv[5][0], argv[5][1], argv[5][2], argv[5][3]);
+    }
+    config.replay_realtime = argc > 6 && strcmp(argv[6], "fast") == 0 ? 0 : 1;
+    config.replay_loops = 0;
+
+    if (run(device, &config, frames, false) != 0) {
+        return -1;
+    }
+    return run(device, &config, frames, true) != 0 ? -1 : 0;
+}
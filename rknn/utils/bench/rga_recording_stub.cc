@@ -0,0 +1,277 @@
+// Replacement for librga that records the calls instead of talking to the RGA driver.
+// Each driver request can be given an artificial cost with RGA_STUB_SUBMIT_US=<microseconds>,
+// which models the ioctl + scheduling overhead on the board.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "im2d.h"
+#include "rga_recording_stub.h"
+
+static std::atomic<long> g_imports(0);
+static std::atomic<long> g_releases(0);
+static std::atomic<long> g_single_ops(0);
+static std::atomic<long> g_jobs(0);
+static std::atomic<long> g_tasks(0);
+static std::atomic<unsigned int> g_next_handle(1);
+
+static void submit(std::atomic<long>& counter)
+{
+    static long cost_us = getenv("RGA_STUB_SUBMIT_US") != NULL ? atol(getenv("RGA_STUB_SUBMIT_US")) : 0;
+    counter++;
+    if (cost_us <= 0) {
+        return;
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds(cost_us);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+static rga_buffer_t make_buffer(void* vir_addr, void* phy_addr, int fd, rga_buffer_handle_t handle, int width,
+                                int height, int wstride, int hstride, int format)
+{
+    rga_buffer_t buf;
+    memset(&buf, 0, sizeof(rga_buffer_t));
+    buf.vir_addr = vir_addr;
+    buf.phy_addr = phy_addr;
+    buf.fd = fd;
+    buf.handle = handle;
+    buf.width = width;
+    buf.height = height;
+    buf.wstride = wstride;
+    buf.hstride = hstride;
+    buf.format = format;
+    return buf;
+}
+
+/*-------------------------------------------
+                  Counters
+-------------------------------------------*/
+void rga_stub_reset()
+{
+    g_imports = 0;
+    g_releases = 0;
+    g_single_ops = 0;
+    g_jobs = 0;
+    g_tasks = 0;
+}
+
+void rga_stub_get_counters(rga_stub_counters_t* counters)
+{
+    counters->imports = g_imports;
+    counters->releases = g_releases;
+    counters->single_ops = g_single_ops;
+    counters->jobs = g_jobs;
+    counters->tasks = g_tasks;
+}
+
+long rga_stub_submissions(const rga_stub_counters_t* counters)
+{
+    return counters->imports + counters->releases + counters->single_ops + counters->jobs;
+}
+
+/*-------------------------------------------
+                  Buffers
+-------------------------------------------*/
+static rga_buffer_handle_t import_handle()
+{
+    submit(g_imports);
+    return g_next_handle++;
+}
+
+IM_EXPORT_API rga_buffer_handle_t importbuffer_fd(int fd, im_handle_param_t* param)
+{
+    (void)fd;
+    (void)param;
+    return import_handle();
+}
+
+IM_EXPORT_API rga_buffer_handle_t importbuffer_virtualaddr(void* va, im_handle_param_t* param)
+{
+    (void)va;
+    (void)param;
+    return import_handle();
+}
+
+IM_EXPORT_API rga_buffer_handle_t importbuffer_physicaladdr(uint64_t pa, im_handle_param_t* param)
+{
+    (void)pa;
+    (void)param;
+    return import_handle();
+}
+
+IM_EXPORT_API IM_STATUS releasebuffer_handle(rga_buffer_handle_t handle)
+{
+    (void)handle;
+    submit(g_releases);
+    return IM_STATUS_SUCCESS;
+}
+
+IM_C_API rga_buffer_t wrapbuffer_handle_t(rga_buffer_handle_t handle, int width, int height, int wstride, int hstride,
+                                          int format)
+{
+    return make_buffer(NULL, NULL, 0, handle, width, height, wstride, hstride, format);
+}
+
+IM_API rga_buffer_t wrapbuffer_handle(rga_buffer_handle_t handle, int width, int height, int format)
+{
+    return make_buffer(NULL, NULL, 0, handle, width, height, width, height, format);
+}
+
+IM_API rga_buffer_t wrapbuffer_handle(rga_buffer_handle_t handle, int width, int height, int format, int wstride,
+                                      int hstride)
+{
+    return make_buffer(NULL, NULL, 0, handle, width, height, wstride, hstride, format);
+}
+
+IM_C_API rga_buffer_t wrapbuffer_virtualaddr_t(void* vir_addr, int width, int height, int wstride, int hstride,
+                                               int format)
+{
+    return make_buffer(vir_addr, NULL, 0, 0, width, height, wstride, hstride, format);
+}
+
+IM_C_API rga_buffer_t wrapbuffer_physicaladdr_t(void* phy_addr, int width, int height, int wstride, int hstride,
+                                                int format)
+{
+    return make_buffer(NULL, phy_addr, 0, 0, width, height, wstride, hstride, format);
+}
+
+IM_C_API rga_buffer_t wrapbuffer_fd_t(int fd, int width, int height, int wstride, int hstride, int format)
+{
+    return make_buffer(NULL, NULL, fd, 0, width, height, wstride, hstride, format);
+}
+
+IM_C_API const char* imStrError_t(IM_STATUS status)
+{
+    (void)status;
+    return "rga recording stub";
+}
+
+/*-------------------------------------------
+                  Single operations
+-------------------------------------------*/
+IM_C_API IM_STATUS improcess(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat, im_rect srect, im_rect drect,
+                             im_rect prect, int usage)
+{
+    (void)src;
+    (void)dst;
+    (void)pat;
+    (void)srect;
+    (void)drect;
+    (void)prect;
+    (void)usage;
+    submit(g_single_ops);
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS improcess(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat, im_rect srect, im_rect drect,
+                           im_rect prect, int acquire_fence_fd, int* release_fence_fd, im_opt_t* opt_ptr, int usage)
+{
+    (void)src;
+    (void)dst;
+    (void)pat;
+    (void)srect;
+    (void)drect;
+    (void)prect;
+    (void)acquire_fence_fd;
+    (void)opt_ptr;
+    (void)usage;
+    submit(g_single_ops);
+    if (release_fence_fd != NULL) {
+        *release_fence_fd = -1;
+    }
+    return IM_STATUS_SUCCESS;
+}
+
+IM_C_API IM_STATUS imfill_t(rga_buffer_t dst, im_rect rect, int color, int sync)
+{
+    (void)dst;
+    (void)rect;
+    (void)color;
+    (void)sync;
+    submit(g_single_ops);
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS imfill(rga_buffer_t dst, im_rect rect, int color, int sync, int* release_fence_fd)
+{
+    (void)dst;
+    (void)rect;
+    (void)color;
+    (void)sync;
+    submit(g_single_ops);
+    if (release_fence_fd != NULL) {
+        *release_fence_fd = -1;
+    }
+    return IM_STATUS_SUCCESS;
+}
+
+/*-------------------------------------------
+                  Jobs
+-------------------------------------------*/
+IM_API im_job_handle_t imbeginJob(uint64_t flags)
+{
+    (void)flags;
+    static std::atomic<unsigned int> next_job(1);
+    return next_job++;
+}
+
+IM_API IM_STATUS imendJob(im_job_handle_t job_handle, int sync_mode, int acquire_fence_fd, int* release_fence_fd)
+{
+    (void)job_handle;
+    (void)sync_mode;
+    (void)acquire_fence_fd;
+    submit(g_jobs);
+    if (release_fence_fd != NULL) {
+        *release_fence_fd = -1;
+    }
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS imcancelJob(im_job_handle_t job_handle)
+{
+    (void)job_handle;
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS imfillTask(im_job_handle_t job_handle, rga_buffer_t dst, im_rect rect, uint32_t color)
+{
+    (void)job_handle;
+    (void)dst;
+    (void)rect;
+    (void)color;
+    g_tasks++;
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS imrectangleTask(im_job_handle_t job_handle, rga_buffer_t dst, im_rect rect, uint32_t color,
+                                 int thickness)
+{
+    (void)job_handle;
+    (void)dst;
+    (void)rect;
+    (void)color;
+    (void)thickness;
+    g_tasks++;
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS improcessTask(im_job_handle_t job_handle, rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                               im_rect srect, im_rect drect, im_rect prect, im_opt_t* opt_ptr, int usage)
+{
+    (void)job_handle;
+    (void)src;
+    (void)dst;
+    (void)pat;
+    (void)srect;
+    (void)drect;
+    (void)prect;
+    (void)opt_ptr;
+    (void)usage;
+    g_tasks++;
+    return IM_STATUS_SUCCESS;
+}
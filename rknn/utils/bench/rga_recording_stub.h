@@ -0,0 +1,46 @@
+#ifndef _RKNN_MODEL_ZOO_RGA_RECORDING_STUB_H_
+#define _RKNN_MODEL_ZOO_RGA_RECORDING_STUB_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Calls recorded by the librga stub
+ *
+ * Every counter except tasks is one request to the RGA driver (ioctl), tasks are only
+ * recorded in user space and go out with the imendJob() of their job.
+ */
+typedef struct {
+    long imports;      // importbuffer_*
+    long releases;     // releasebuffer_handle
+    long single_ops;   // improcess / imfill / ... outside of a job
+    long jobs;         // imendJob
+    long tasks;        // im*Task
+} rga_stub_counters_t;
+
+/**
+ * @brief Reset all counters
+ */
+void rga_stub_reset();
+
+/**
+ * @brief Read the counters
+ *
+ * @param counters [out] Counters
+ */
+void rga_stub_get_counters(rga_stub_counters_t* counters);
+
+/**
+ * @brief Get the number of driver submissions (imports + releases + single ops + jobs)
+ *
+ * @param counters [in] Counters
+ * @return long Submission count
+ */
+long rga_stub_submissions(const rga_stub_counters_t* counters);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_RGA_RECORDING_STUB_H_
@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MAX_TEXT_LINE_LENGTH 1024
 
@@ -51,6 +55,74 @@ int read_data_from_file(const char *path, char **out_data)
     return file_size;
 }
 
+int get_file_size(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        printf("stat %s fail!\n", path);
+        return -1;
+    }
+    return (int)st.st_size;
+}
+
+void* map_file(const char *path, int *out_size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("open %s fail!\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        printf("%s contains no data\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("mmap %s fail!\n", path);
+        return NULL;
+    }
+    // read once front to back: large read-ahead, start it now
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    madvise(data, st.st_size, MADV_WILLNEED);
+    *out_size = (int)st.st_size;
+    return data;
+}
+
+void unmap_file(void *data, int size)
+{
+    if (data != NULL) {
+        munmap(data, size);
+    }
+}
+
+int read_file_to_buffer(const char *path, void *buf, int buf_size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    int done = 0;
+    while (done < buf_size) {
+        ssize_t n = read(fd, (char *)buf + done, buf_size - done);
+        if (n < 0) {
+            printf("read %s fail!\n", path);
+            close(fd);
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+    return done;
+}
+
 int write_data_to_file(const char *path, const char *data, unsigned int size)
 {
     FILE *fp;
@@ -14,6 +14,44 @@ extern "C" {
  */
 int read_data_from_file(const char *path, char **out_data);
 
+/**
+ * @brief Get file size
+ * 
+ * @param path [in] File path
+ * @return int -1: error; >= 0: File size
+ */
+int get_file_size(const char *path);
+
+/**
+ * @brief Map a file read only, with sequential read-ahead hints
+ * 
+ * Unlike read_data_from_file() there is no heap copy, the pages stay in the page cache and
+ * are dropped again by unmap_file().
+ * 
+ * @param path [in] File path
+ * @param out_size [out] File size
+ * @return void* Mapped data, NULL: error
+ */
+void* map_file(const char *path, int *out_size);
+
+/**
+ * @brief Unmap a file mapped by map_file()
+ * 
+ * @param data [in] Mapped data
+ * @param size [in] File size
+ */
+void unmap_file(void *data, int size);
+
+/**
+ * @brief Read a file into a caller provided buffer
+ * 
+ * @param path [in] File path
+ * @param buf [out] Buffer
+ * @param buf_size [in] Buffer size, at most this many bytes are read
+ * @return int -1: error; >= 0: Read data size
+ */
+int read_file_to_buffer(const char *path, void *buf, int buf_size);
+
 /**
  * @brief Write data to file
  * 
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.h"
+#include "image_job.h"
+#include "dma_alloc.hpp"
+
+#define FRAME_POOL_BASE_ALIGN 4096
+
+struct frame_slot {
+    frame_t frame;              // first member, frame_t* points to the frame_slot
+    frame_pool_t* pool;
+    unsigned char* addr;
+    int fd;
+    std::atomic<int> refs;
+};
+
+struct frame_pool {
+    image_buffer_t format;      // virt_addr NULL, fd -1
+    size_t buffer_size;
+    void (*heap_free)(void* user_data, void* addr);
+    void* heap_user_data;
+    std::vector<frame_slot*> slots;
+
+    std::mutex mutex;
+    std::condition_variable released;
+    std::vector<frame_slot*> free_slots;
+    frame_pool_stats_t stats;
+};
+
+static size_t buffer_size(const image_buffer_t* image)
+{
+    size_t pixels = (size_t)image->width_stride * image->height_stride;
+    switch (image->format) {
+    case IMAGE_FORMAT_RGB888:
+        return pixels * 3;
+    case IMAGE_FORMAT_RGBA8888:
+        return pixels * 4;
+    case IMAGE_FORMAT_YUV420SP_NV12:
+    case IMAGE_FORMAT_YUV420SP_NV21:
+        return pixels * 3 / 2;
+    default:
+        return pixels;
+    }
+}
+
+static void slot_image(frame_pool_t* pool, frame_slot* slot, image_buffer_t* image)
+{
+    *image = pool->format;
+    image->virt_addr = slot->addr;
+    image->fd = slot->fd;
+}
+
+static void free_slot(frame_pool_t* pool, frame_slot* slot)
+{
+    image_buffer_t image;
+    slot_image(pool, slot, &image);
+    image_job_unregister_buffer(&image);
+    if (slot->fd >= 0) {
+        dma_buf_free(pool->buffer_size, &slot->fd, slot->addr);
+    } else if (pool->heap_free != NULL) {
+        pool->heap_free(pool->heap_user_data, slot->addr);
+    } else {
+        free(slot->addr);
+    }
+    delete slot;
+}
+
+void frame_pool_config_default(frame_pool_config_t* config)
+{
+    memset(config, 0, sizeof(frame_pool_config_t));
+    config->format = IMAGE_FORMAT_RGB888;
+    config->count = 4;
+    config->dma_heap = DMA_HEAP_DMA32_UNCACHE_PATCH;
+}
+
+frame_pool_t* frame_pool_create(const frame_pool_config_t* config)
+{
+    if (config == NULL || config->width <= 0 || config->height <= 0 || config->count <= 0) {
+        printf("frame pool: bad config\n");
+        return NULL;
+    }
+    frame_pool_t* pool = new frame_pool_t();
+    image_buffer_t* format = &pool->format;
+    format->width = config->width;
+    format->height = config->height;
+    format->format = config->format;
+    int align = config->stride_align > 0 ? config->stride_align : 1;
+    format->width_stride = (config->width + align - 1) / align * align;
+    format->height_stride = config->height;
+    if (config->format == IMAGE_FORMAT_YUV420SP_NV12 || config->format == IMAGE_FORMAT_YUV420SP_NV21) {
+        format->height_stride = (config->height + 1) & ~1;
+    }
+    format->virt_addr = NULL;
+    format->fd = -1;
+    pool->buffer_size = buffer_size(format);
+    format->size = (int)pool->buffer_size;
+    pool->heap_free = config->heap_alloc != NULL ? config->heap_free : NULL;
+    pool->heap_user_data = config->heap_user_data;
+
+    // once a heap failed, the remaining buffers come from memory as well
+    const char* dma_heap = config->dma_heap;
+    for (int i = 0; i < config->count; i++) {
+        frame_slot* slot = new frame_slot();
+        slot->pool = pool;
+        slot->refs = 0;
+        slot->fd = -1;
+        slot->addr = NULL;
+        if (dma_heap != NULL && dma_buf_alloc(dma_heap, pool->buffer_size, &slot->fd, (void**)&slot->addr) != 0) {
+            printf("frame pool: no buffers from %s, using heap memory\n", dma_heap);
+            slot->fd = -1;
+            slot->addr = NULL;
+            dma_heap = NULL;
+        }
+        if (slot->addr == NULL) {
+            void* addr = NULL;
+            if (config->heap_alloc != NULL) {
+                addr = config->heap_alloc(config->heap_user_data, pool->buffer_size);
+            } else if (posix_memalign(&addr, FRAME_POOL_BASE_ALIGN, pool->buffer_size) != 0) {
+                addr = NULL;
+            }
+            if (addr == NULL) {
+                printf("frame pool: alloc %zu bytes fail!\n", pool->buffer_size);
+                delete slot;
+                frame_pool_destroy(pool);
+                return NULL;
+            }
+            slot->addr = (unsigned char*)addr;
+        } else {
+            pool->stats.dma_buffers++;
+        }
+        pool->stats.allocations++;
+        // RGA jobs reuse this import instead of importing the buffer for every frame
+        image_buffer_t image;
+        slot_image(pool, slot, &image);
+        image_job_register_buffer(&image);
+        pool->slots.push_back(slot);
+        pool->free_slots.push_back(slot);
+    }
+    pool->stats.buffers = config->count;
+    pool->stats.buffer_size = (int)pool->buffer_size;
+    return pool;
+}
+
+frame_t* frame_pool_acquire(frame_pool_t* pool, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    if (pool->free_slots.empty()) {
+        pool->stats.waited++;
+        auto ready = [pool] { return !pool->free_slots.empty(); };
+        if (timeout_ms < 0) {
+            pool->released.wait(lock, ready);
+        } else if (!pool->released.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+            pool->stats.timeouts++;
+            return NULL;
+        }
+    }
+    frame_slot* slot = pool->free_slots.back();
+    pool->free_slots.pop_back();
+    pool->stats.acquired++;
+    pool->stats.in_use++;
+    if (pool->stats.in_use > pool->stats.peak_in_use) {
+        pool->stats.peak_in_use = pool->stats.in_use;
+    }
+    lock.unlock();
+
+    // a stage may have changed the image, e.g. decoded a smaller one into it
+    frame_t* frame = &slot->frame;
+    memset(frame, 0, sizeof(frame_t));
+    slot_image(pool, slot, &frame->image);
+    slot->refs.store(1);
+    return frame;
+}
+
+void frame_ref(frame_t* frame)
+{
+    ((frame_slot*)frame)->refs.fetch_add(1);
+}
+
+void frame_release(frame_t* frame)
+{
+    if (frame == NULL) {
+        return;
+    }
+    frame_slot* slot = (frame_slot*)frame;
+    if (slot->refs.fetch_sub(1) != 1) {
+        return;
+    }
+    frame_pool_t* pool = slot->pool;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->free_slots.push_back(slot);
+        pool->stats.in_use--;
+    }
+    pool->released.notify_one();
+}
+
+void frame_pool_get_stats(frame_pool_t* pool, frame_pool_stats_t* stats)
+{
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    *stats = pool->stats;
+}
+
+int frame_pool_get_image(frame_pool_t* pool, int index, image_buffer_t* image)
+{
+    if (index < 0 || index >= (int)pool->slots.size()) {
+        return -1;
+    }
+    slot_image(pool, pool->slots[index], image);
+    return 0;
+}
+
+void frame_pool_destroy(frame_pool_t* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    if (pool->stats.in_use > 0) {
+        printf("frame pool destroyed with %d frames still held\n", pool->stats.in_use);
+    }
+    for (size_t i = 0; i < pool->slots.size(); i++) {
+        free_slot(pool, pool->slots[i]);
+    }
+    delete pool;
+}
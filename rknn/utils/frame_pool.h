@@ -0,0 +1,131 @@
+#ifndef _RKNN_MODEL_ZOO_FRAME_POOL_H_
+#define _RKNN_MODEL_ZOO_FRAME_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "common.h"
+#include "image_utils.h"
+
+/**
+ * @brief Fixed set of image buffers of one format and size, allocated once
+ *
+ * Every stage of a frame path (capture copy, letterbox, inference input, encoder input) takes
+ * its buffers from a pool and passes frames on by reference instead of allocating, copying or
+ * freeing them per frame. Buffers come from a DMA heap when one is given and available (fd set,
+ * ready for RGA and rknn_create_mem_from_fd), otherwise from page aligned heap memory (fd -1).
+ * Each buffer is registered with image_job_register_buffer(), so RGA jobs import it only once.
+ */
+typedef struct frame_pool frame_pool_t;
+
+/**
+ * @brief Pool configuration
+ *
+ */
+typedef struct {
+    int width;
+    int height;
+    image_format_t format;
+    int count;                  // buffers, frames held anywhere count against it
+    int stride_align;           // width_stride is a multiple of it in pixels (RGA wants 16), 0: packed rows.
+                                // The CPU paths of image_utils assume packed rows
+    const char* dma_heap;       // e.g. DMA_HEAP_DMA32_UNCACHE_PATCH, NULL: heap memory only
+    // the heap memory, NULL: posix_memalign. E.g. memory of the inference backend it can read in place
+    void* (*heap_alloc)(void* user_data, size_t size);
+    void (*heap_free)(void* user_data, void* addr);
+    void* heap_user_data;
+} frame_pool_config_t;
+
+/**
+ * @brief Frame handle
+ *
+ * image is the buffer of the pool, the other members are metadata for the stages, reset on
+ * acquire. Pass the frame on with frame_ref() and give it back with frame_release(), the
+ * buffer is free again when the last reference is released.
+ */
+typedef struct {
+    image_buffer_t image;       // first member, an image_buffer_t* of the frame is the frame_t*
+    int64_t frame_id;
+    int64_t timestamp_us;       // capture time, CLOCK_MONOTONIC
+    letterbox_t letter_box;     // set by the stage that letterboxed into this frame
+    void* user_data;
+} frame_t;
+
+/**
+ * @brief Pool statistics since frame_pool_create()
+ *
+ */
+typedef struct {
+    int buffers;
+    int dma_buffers;            // buffers from the DMA heap
+    int buffer_size;            // bytes per buffer
+    uint64_t allocations;       // buffer allocations, only ever the buffers made at create
+    uint64_t acquired;
+    uint64_t waited;            // acquires that found every buffer in use
+    uint64_t timeouts;
+    int in_use;
+    int peak_in_use;
+} frame_pool_stats_t;
+
+void frame_pool_config_default(frame_pool_config_t* config);
+
+/**
+ * @brief Allocate the buffers of a pool
+ *
+ * @param config [in] Configuration
+ * @return frame_pool_t* NULL: error
+ */
+frame_pool_t* frame_pool_create(const frame_pool_config_t* config);
+
+/**
+ * @brief Take a free buffer, never allocates
+ *
+ * @param pool [in] Pool
+ * @param timeout_ms [in] Time to wait for a release when every buffer is in use, 0: no wait, -1: forever
+ * @return frame_t* Frame holding one reference, NULL on timeout
+ */
+frame_t* frame_pool_acquire(frame_pool_t* pool, int timeout_ms);
+
+void frame_ref(frame_t* frame);
+
+/**
+ * @brief Drop one reference, any thread, NULL is ignored
+ *
+ */
+void frame_release(frame_t* frame);
+
+/**
+ * @brief Frame of an image that came from frame_pool_acquire(), e.g. in a callback that only gets the image
+ *
+ */
+static inline frame_t* frame_from_image(image_buffer_t* image)
+{
+    return (frame_t*)image;
+}
+
+void frame_pool_get_stats(frame_pool_t* pool, frame_pool_stats_t* stats);
+
+/**
+ * @brief Buffer index of the pool, whether it is in use or not, e.g. to bind every buffer once as model input
+ *
+ * @param pool [in] Pool
+ * @param index [in] 0 .. buffers - 1
+ * @param image [out] The buffer, as acquire would hand it out
+ * @return int 0: ok, -1: index out of range
+ */
+int frame_pool_get_image(frame_pool_t* pool, int index, image_buffer_t* image);
+
+/**
+ * @brief Free the buffers, every frame must have been released
+ *
+ */
+void frame_pool_destroy(frame_pool_t* pool);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_FRAME_POOL_H_
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#if !defined(DISABLE_RGA)
+#include "im2d.h"
+#endif
+
+#include "image_async.h"
+#include "image_job.h"
+#include "image_utils_internal.h"
+
+struct image_async_token {
+    // RGA path: release fence of the submitted job and the imported buffers
+    int release_fence_fd;
+    std::vector<unsigned int> handles;
+
+    // CPU path: work executed by the worker thread
+    int use_cpu;
+    std::function<int()> work;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    int done;
+    int ret;
+};
+
+static void release_token(image_async_token_t* token)
+{
+    if (token->release_fence_fd >= 0) {
+        close(token->release_fence_fd);
+        token->release_fence_fd = -1;
+    }
+#if !defined(DISABLE_RGA)
+    for (size_t i = 0; i < token->handles.size(); i++) {
+        releasebuffer_handle(token->handles[i]);
+    }
+#endif
+    delete token;
+}
+
+/*-------------------------------------------
+        CPU worker (fallback when RGA is not usable)
+-------------------------------------------*/
+class CpuConvertWorker {
+public:
+    static CpuConvertWorker& instance()
+    {
+        static CpuConvertWorker worker;
+        return worker;
+    }
+
+    void submit(image_async_token_t* token)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(token);
+        cond_.notify_one();
+    }
+
+private:
+    CpuConvertWorker() : running_(true)
+    {
+        thread_ = std::thread(&CpuConvertWorker::loop, this);
+    }
+
+    ~CpuConvertWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            cond_.notify_all();
+        }
+        thread_.join();
+    }
+
+    void loop()
+    {
+        while (true) {
+            image_async_token_t* token = NULL;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return !queue_.empty() || !running_; });
+                if (queue_.empty()) {
+                    return;
+                }
+                token = queue_.front();
+                queue_.pop_front();
+            }
+
+            int ret = token->work();
+
+            // notify under the lock, the waiter may free the token as soon as it sees done
+            std::lock_guard<std::mutex> lock(token->mutex);
+            token->ret = ret;
+            token->done = 1;
+            token->cond.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<image_async_token_t*> queue_;
+    bool running_;
+    std::thread thread_;
+};
+
+/*-------------------------------------------
+        Internal hooks used by image_job.cc
+-------------------------------------------*/
+image_async_token_t* image_async_create_token()
+{
+    image_async_token_t* token = new image_async_token_t();
+    token->release_fence_fd = -1;
+    token->use_cpu = 0;
+    token->done = 0;
+    token->ret = 0;
+    return token;
+}
+
+void image_async_attach_fence(image_async_token_t* token, int release_fence_fd, const std::vector<unsigned int>& handles)
+{
+    token->release_fence_fd = release_fence_fd;
+    token->handles = handles;
+}
+
+void image_async_run_on_cpu(image_async_token_t* token, std::function<int()> work)
+{
+    token->use_cpu = 1;
+    token->work = work;
+    CpuConvertWorker::instance().submit(token);
+}
+
+/*-------------------------------------------
+                  Public API
+-------------------------------------------*/
+int convert_image_async(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box,
+                        char color, image_async_token_t** token)
+{
+    if (src_img == NULL || dst_img == NULL || token == NULL) {
+        return -1;
+    }
+
+    // the padding fill and the resize go out as one RGA job with a single release fence
+    image_job_t* job = image_job_create();
+    if (image_job_add_convert(job, src_img, dst_img, src_box, dst_box, color) != 0) {
+        image_job_destroy(job);
+        return -1;
+    }
+    return image_job_submit_async(job, token);
+}
+
+int convert_image_with_letterbox_async(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox,
+                                       char color, image_async_token_t** token)
+{
+    if (src_image == NULL || dst_image == NULL || token == NULL) {
+        return -1;
+    }
+
+    image_job_t* job = image_job_create();
+    if (image_job_add_letterbox(job, src_image, dst_image, letterbox, color) != 0) {
+        image_job_destroy(job);
+        return -1;
+    }
+    return image_job_submit_async(job, token);
+}
+
+int image_async_poll(image_async_token_t* token)
+{
+    if (token == NULL) {
+        return 1;
+    }
+    if (token->use_cpu) {
+        std::lock_guard<std::mutex> lock(token->mutex);
+        return token->done;
+    }
+    if (token->release_fence_fd < 0) {
+        return 1;
+    }
+    struct pollfd pfd;
+    pfd.fd = token->release_fence_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0 ? 1 : 0;
+}
+
+int image_async_wait(image_async_token_t* token, int timeout_ms)
+{
+    int ret = 0;
+    if (token == NULL) {
+        return -1;
+    }
+
+    if (token->use_cpu) {
+        std::unique_lock<std::mutex> lock(token->mutex);
+        if (timeout_ms < 0) {
+            token->cond.wait(lock, [token] { return token->done != 0; });
+        } else if (!token->cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                         [token] { return token->done != 0; })) {
+            return -2;
+        }
+        ret = token->ret;
+    } else if (token->release_fence_fd >= 0) {
+        struct pollfd pfd;
+        pfd.fd = token->release_fence_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int n;
+        do {
+            n = poll(&pfd, 1, timeout_ms);
+        } while (n < 0 && errno == EINTR);
+        if (n == 0) {
+            return -2;
+        }
+        if (n < 0 || (pfd.revents & (POLLERR | POLLNVAL))) {
+            printf("wait rga fence %d fail\n", token->release_fence_fd);
+            ret = -1;
+        }
+    }
+
+    release_token(token);
+    return ret;
+}
@@ -0,0 +1,73 @@
+#ifndef _RKNN_MODEL_ZOO_IMAGE_ASYNC_H_
+#define _RKNN_MODEL_ZOO_IMAGE_ASYNC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "image_utils.h"
+
+/**
+ * @brief Completion token of an asynchronous image conversion
+ *
+ */
+typedef struct image_async_token image_async_token_t;
+
+/**
+ * @brief Convert image asynchronously, same semantics as convert_image()
+ *
+ * The RGA job is submitted with sync=0 and its release fence is kept in the token.
+ * When RGA is disabled or can not handle the image, the conversion runs on a CPU worker thread.
+ * src_image and dst_image memory must stay valid until image_async_wait() returns.
+ *
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image
+ * @param src_box [in] Crop rectangle on source image, can be NULL
+ * @param dst_box [in] Crop rectangle on target image, can be NULL
+ * @param color [in] Pading color if dst_box can not fill target image
+ * @param token [out] Completion token, remember call image_async_wait() to release
+ * @return int 0: success; -1: error
+ */
+int convert_image_async(image_buffer_t* src_image, image_buffer_t* dst_image, image_rect_t* src_box, image_rect_t* dst_box,
+                        char color, image_async_token_t** token);
+
+/**
+ * @brief Convert image with letterbox asynchronously
+ *
+ * letterbox is filled before return, only the pixels are produced asynchronously.
+ *
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image, buffer must be allocated by caller
+ * @param letterbox [out] Letterbox
+ * @param color [in] Fill color on target image
+ * @param token [out] Completion token, remember call image_async_wait() to release
+ * @return int 0: success; -1: error
+ */
+int convert_image_with_letterbox_async(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox,
+                                       char color, image_async_token_t** token);
+
+/**
+ * @brief Check whether an asynchronous conversion has finished, never blocks
+ *
+ * @param token [in] Completion token
+ * @return int 1: finished; 0: still running
+ */
+int image_async_poll(image_async_token_t* token);
+
+/**
+ * @brief Wait for an asynchronous conversion
+ *
+ * The token is released unless the wait times out.
+ *
+ * @param token [in] Completion token
+ * @param timeout_ms [in] Timeout in milliseconds, -1 waits forever
+ * @return int 0: success; -1: conversion failed; -2: timeout, token is still valid
+ */
+int image_async_wait(image_async_token_t* token, int timeout_ms);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_IMAGE_ASYNC_H_
@@ -0,0 +1,582 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <mutex>
+#include <vector>
+
+#if !defined(DISABLE_RGA)
+#include "im2d.h"
+#endif
+
+#include "image_job.h"
+#include "image_utils_internal.h"
+
+typedef enum {
+    IMAGE_TASK_FILL,
+    IMAGE_TASK_PROCESS,
+    IMAGE_TASK_RECTANGLE,
+} image_task_type_t;
+
+typedef struct {
+    image_task_type_t type;
+    image_buffer_t src;
+    image_buffer_t dst;
+    image_rect_t src_box;
+    image_rect_t dst_box;      // fill / rectangle area for IMAGE_TASK_FILL and IMAGE_TASK_RECTANGLE
+    unsigned char color[4];    // r, g, b, a
+    int raw_color;             // color[0] is written as is to every channel and plane
+    int thickness;
+} image_task_t;
+
+struct image_job {
+    std::vector<image_task_t> tasks;
+};
+
+static image_rect_t whole_rect(image_buffer_t* img)
+{
+    image_rect_t rect;
+    rect.left = 0;
+    rect.top = 0;
+    rect.right = img->width - 1;
+    rect.bottom = img->height - 1;
+    return rect;
+}
+
+/*-------------------------------------------
+                  CPU replay
+-------------------------------------------*/
+static void rgb_to_yuv(const unsigned char* rgb, unsigned char* y, unsigned char* u, unsigned char* v)
+{
+    // BT.601 full range
+    *y = (unsigned char)(0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2]);
+    *u = (unsigned char)(-0.169f * rgb[0] - 0.331f * rgb[1] + 0.5f * rgb[2] + 128);
+    *v = (unsigned char)(0.5f * rgb[0] - 0.419f * rgb[1] - 0.081f * rgb[2] + 128);
+}
+
+static int fill_rect_cpu(image_buffer_t* img, image_rect_t rect, const unsigned char* color, int raw_color)
+{
+    if (img->virt_addr == NULL) {
+        return -1;
+    }
+    int x0 = rect.left < 0 ? 0 : rect.left;
+    int y0 = rect.top < 0 ? 0 : rect.top;
+    int x1 = rect.right >= img->width ? img->width - 1 : rect.right;
+    int y1 = rect.bottom >= img->height ? img->height - 1 : rect.bottom;
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+
+    unsigned char px[4];
+    int channel = 0;
+    switch (img->format) {
+    case IMAGE_FORMAT_GRAY8:
+        channel = 1;
+        break;
+    case IMAGE_FORMAT_RGB888:
+        channel = 3;
+        break;
+    case IMAGE_FORMAT_RGBA8888:
+        channel = 4;
+        break;
+    case IMAGE_FORMAT_YUV420SP_NV12:
+    case IMAGE_FORMAT_YUV420SP_NV21: {
+        unsigned char y, u, v;
+        if (raw_color) {
+            y = u = v = color[0];
+        } else {
+            rgb_to_yuv(color, &y, &u, &v);
+        }
+        unsigned char* y_plane = img->virt_addr;
+        unsigned char* uv_plane = img->virt_addr + img->width * img->height;
+        for (int row = y0; row <= y1; row++) {
+            memset(y_plane + row * img->width + x0, y, x1 - x0 + 1);
+        }
+        unsigned char first = img->format == IMAGE_FORMAT_YUV420SP_NV12 ? u : v;
+        unsigned char second = img->format == IMAGE_FORMAT_YUV420SP_NV12 ? v : u;
+        for (int row = y0 / 2; row <= y1 / 2; row++) {
+            unsigned char* p = uv_plane + row * img->width;
+            for (int col = x0 / 2; col <= x1 / 2; col++) {
+                p[col * 2] = first;
+                p[col * 2 + 1] = second;
+            }
+        }
+        return 0;
+    }
+    default:
+        printf("fill: no support format %d\n", img->format);
+        return -1;
+    }
+
+    if (raw_color) {
+        memset(px, color[0], sizeof(px));
+    } else if (channel == 1) {
+        unsigned char u, v;
+        rgb_to_yuv(color, &px[0], &u, &v);
+    } else {
+        memcpy(px, color, sizeof(px));
+    }
+    for (int row = y0; row <= y1; row++) {
+        unsigned char* p = img->virt_addr + (row * img->width + x0) * channel;
+        if (raw_color) {
+            memset(p, px[0], (x1 - x0 + 1) * channel);
+            continue;
+        }
+        for (int col = x0; col <= x1; col++) {
+            memcpy(p, px, channel);
+            p += channel;
+        }
+    }
+    return 0;
+}
+
+static int draw_rectangle_cpu(image_task_t* task)
+{
+    image_rect_t r = task->dst_box;
+    int t = task->thickness;
+    if (t < 0 || t * 2 >= r.right - r.left + 1 || t * 2 >= r.bottom - r.top + 1) {
+        return fill_rect_cpu(&task->dst, r, task->color, task->raw_color);
+    }
+    image_rect_t top = {r.left, r.top, r.right, r.top + t - 1};
+    image_rect_t bottom = {r.left, r.bottom - t + 1, r.right, r.bottom};
+    image_rect_t left = {r.left, r.top + t, r.left + t - 1, r.bottom - t};
+    image_rect_t right = {r.right - t + 1, r.top + t, r.right, r.bottom - t};
+    if (fill_rect_cpu(&task->dst, top, task->color, 0) != 0 ||
+        fill_rect_cpu(&task->dst, bottom, task->color, 0) != 0 ||
+        fill_rect_cpu(&task->dst, left, task->color, 0) != 0 ||
+        fill_rect_cpu(&task->dst, right, task->color, 0) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int run_job_cpu(image_job_t* job)
+{
+    int ret = 0;
+    for (size_t i = 0; i < job->tasks.size(); i++) {
+        image_task_t* task = &job->tasks[i];
+        switch (task->type) {
+        case IMAGE_TASK_FILL:
+            ret = fill_rect_cpu(&task->dst, task->dst_box, task->color, task->raw_color);
+            break;
+        case IMAGE_TASK_PROCESS:
+            ret = crop_and_scale_image_cpu(&task->src, &task->dst, &task->src_box, &task->dst_box);
+            break;
+        case IMAGE_TASK_RECTANGLE:
+            ret = draw_rectangle_cpu(task);
+            break;
+        }
+        if (ret != 0) {
+            printf("image job task %d fail on cpu\n", (int)i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*-------------------------------------------
+                  RGA job
+-------------------------------------------*/
+#if !defined(DISABLE_RGA)
+typedef struct {
+    int fd;
+    ino_t inode;  // of the dma-buf behind fd: a freed buffer whose fd number is reused does not match
+    void* virt_addr;
+    int width;
+    int height;
+    int format;
+    rga_buffer_t buf;
+} rga_import_t;
+
+static int rga_usable(image_buffer_t* img)
+{
+    if (get_rga_fmt(img->format) < 0) {
+        return 0;
+    }
+#if defined(RV1106_1103)
+    return img->width % 4 == 0;
+#else
+    return img->width % 16 == 0;
+#endif
+}
+
+// Imports kept from image_job_register_buffer() to image_job_unregister_buffer(), shared by all jobs
+static std::mutex g_registered_mutex;
+static std::vector<rga_import_t> g_registered;
+
+// Each dma-buf gets its own inode, so it tells a buffer apart from a later one with the same fd number
+static ino_t buffer_inode(int fd)
+{
+    struct stat st;
+    if (fd <= 0 || fstat(fd, &st) != 0) {
+        return 0;
+    }
+    return st.st_ino;
+}
+
+static int find_import(const std::vector<rga_import_t>& imports, image_buffer_t* img, int fmt, ino_t inode)
+{
+    for (size_t i = 0; i < imports.size(); i++) {
+        const rga_import_t* imp = &imports[i];
+        if (imp->fd == img->fd && imp->inode == inode && imp->virt_addr == img->virt_addr &&
+            imp->width == img->width && imp->height == img->height && imp->format == fmt) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int rga_import(std::vector<rga_import_t>& imports, std::vector<unsigned int>& handles, image_buffer_t* img,
+                      rga_buffer_t* buf)
+{
+    int fmt = get_rga_fmt(img->format);
+    ino_t inode = buffer_inode(img->fd);
+    int found = find_import(imports, img, fmt, inode);
+    if (found >= 0) {
+        *buf = imports[found].buf;
+        return 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_registered_mutex);
+        found = find_import(g_registered, img, fmt, inode);
+        if (found >= 0) {
+            *buf = g_registered[found].buf;
+            return 0;
+        }
+    }
+
+    rga_import_t imp;
+    imp.fd = img->fd;
+    imp.inode = inode;
+    imp.virt_addr = img->virt_addr;
+    imp.width = img->width;
+    imp.height = img->height;
+    imp.format = fmt;
+#if defined(LIBRGA_IM2D_HANDLE)
+    im_handle_param_t param;
+    param.width = img->width;
+    param.height = img->height;
+    param.format = fmt;
+    rga_buffer_handle_t handle;
+    if (img->fd > 0) {
+        handle = importbuffer_fd(img->fd, &param);
+    } else {
+        handle = importbuffer_virtualaddr(img->virt_addr, &param);
+    }
+    if (handle == 0) {
+        printf("import rga buffer error\n");
+        return -1;
+    }
+    handles.push_back(handle);
+    imp.buf = wrapbuffer_handle(handle, img->width, img->height, fmt, img->width, img->height);
+#else
+    if (img->fd > 0) {
+        imp.buf = wrapbuffer_fd(img->fd, img->width, img->height, fmt);
+    } else {
+        imp.buf = wrapbuffer_virtualaddr(img->virt_addr, img->width, img->height, fmt);
+    }
+#endif
+    imports.push_back(imp);
+    *buf = imp.buf;
+    return 0;
+}
+
+static im_rect to_im_rect(image_rect_t* box)
+{
+    im_rect rect;
+    rect.x = box->left;
+    rect.y = box->top;
+    rect.width = box->right - box->left + 1;
+    rect.height = box->bottom - box->top + 1;
+    return rect;
+}
+
+static unsigned int to_rga_color(image_task_t* task)
+{
+    if (task->raw_color) {
+        unsigned int imcolor;
+        memset(&imcolor, task->color[0], sizeof(imcolor));
+        return imcolor;
+    }
+    return ((unsigned int)task->color[3] << 24) | ((unsigned int)task->color[2] << 16) |
+           ((unsigned int)task->color[1] << 8) | task->color[0];
+}
+
+static void release_handles(std::vector<unsigned int>& handles)
+{
+    for (size_t i = 0; i < handles.size(); i++) {
+        releasebuffer_handle(handles[i]);
+    }
+    handles.clear();
+}
+
+// Record all tasks into one RGA job and submit it, returns -1 when the job must fall back to cpu
+static int run_job_rga(image_job_t* job, int sync, int* release_fence_fd, std::vector<unsigned int>& handles)
+{
+    for (size_t i = 0; i < job->tasks.size(); i++) {
+        image_task_t* task = &job->tasks[i];
+        if (!rga_usable(&task->dst) || (task->type == IMAGE_TASK_PROCESS && !rga_usable(&task->src))) {
+            return -1;
+        }
+    }
+
+    std::vector<rga_import_t> imports;
+    im_job_handle_t job_handle = imbeginJob();
+    if (job_handle == 0) {
+        printf("imbeginJob fail\n");
+        return -1;
+    }
+
+    IM_STATUS ret_rga = IM_STATUS_SUCCESS;
+    for (size_t i = 0; i < job->tasks.size() && ret_rga > 0; i++) {
+        image_task_t* task = &job->tasks[i];
+        rga_buffer_t src;
+        rga_buffer_t dst;
+        if (rga_import(imports, handles, &task->dst, &dst) != 0) {
+            ret_rga = IM_STATUS_FAILED;
+            break;
+        }
+        switch (task->type) {
+        case IMAGE_TASK_FILL:
+            ret_rga = imfillTask(job_handle, dst, to_im_rect(&task->dst_box), to_rga_color(task));
+            break;
+        case IMAGE_TASK_PROCESS: {
+            rga_buffer_t pat;
+            im_rect prect;
+            memset(&pat, 0, sizeof(rga_buffer_t));
+            memset(&prect, 0, sizeof(im_rect));
+            if (rga_import(imports, handles, &task->src, &src) != 0) {
+                ret_rga = IM_STATUS_FAILED;
+                break;
+            }
+            ret_rga = improcessTask(job_handle, src, dst, pat, to_im_rect(&task->src_box), to_im_rect(&task->dst_box),
+                                    prect, NULL, 0);
+            break;
+        }
+        case IMAGE_TASK_RECTANGLE:
+            ret_rga = imrectangleTask(job_handle, dst, to_im_rect(&task->dst_box), to_rga_color(task),
+                                      task->thickness);
+            break;
+        }
+    }
+
+    if (ret_rga > 0) {
+        if (sync) {
+            ret_rga = imendJob(job_handle);
+        } else {
+            ret_rga = imendJob(job_handle, IM_ASYNC, 0, release_fence_fd);
+        }
+    } else {
+        imcancelJob(job_handle);
+    }
+
+    if (ret_rga <= 0) {
+        printf("Error on rga job STATUS=%d\n", ret_rga);
+        printf("RGA error message: %s\n", imStrError((IM_STATUS)ret_rga));
+        release_handles(handles);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+/*-------------------------------------------
+                  Public API
+-------------------------------------------*/
+int image_job_register_buffer(image_buffer_t* image)
+{
+    if (image == NULL) {
+        return -1;
+    }
+#if !defined(DISABLE_RGA)
+    if (!rga_usable(image)) {
+        return -1;
+    }
+    std::vector<rga_import_t> imports;
+    std::vector<unsigned int> handles;
+    rga_buffer_t buf;
+    {
+        std::lock_guard<std::mutex> lock(g_registered_mutex);
+        if (find_import(g_registered, image, get_rga_fmt(image->format), buffer_inode(image->fd)) >= 0) {
+            return 0;
+        }
+    }
+    if (rga_import(imports, handles, image, &buf) != 0) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(g_registered_mutex);
+    g_registered.push_back(imports[0]);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void image_job_unregister_buffer(image_buffer_t* image)
+{
+    if (image == NULL) {
+        return;
+    }
+#if !defined(DISABLE_RGA)
+    ino_t inode = buffer_inode(image->fd);
+    std::lock_guard<std::mutex> lock(g_registered_mutex);
+    int found = find_import(g_registered, image, get_rga_fmt(image->format), inode);
+    if (found < 0) {
+        return;
+    }
+#if defined(LIBRGA_IM2D_HANDLE)
+    releasebuffer_handle(g_registered[found].buf.handle);
+#endif
+    g_registered.erase(g_registered.begin() + found);
+#endif
+}
+
+image_job_t* image_job_create()
+{
+    return new image_job_t();
+}
+
+void image_job_destroy(image_job_t* job)
+{
+    delete job;
+}
+
+int image_job_task_count(image_job_t* job)
+{
+    if (job == NULL) {
+        return 0;
+    }
+    return (int)job->tasks.size();
+}
+
+int image_job_add_fill(image_job_t* job, image_buffer_t* dst_image, image_rect_t* rect, char color)
+{
+    if (job == NULL || dst_image == NULL) {
+        return -1;
+    }
+    image_task_t task;
+    memset(&task, 0, sizeof(image_task_t));
+    task.type = IMAGE_TASK_FILL;
+    task.dst = *dst_image;
+    task.dst_box = rect != NULL ? *rect : whole_rect(dst_image);
+    task.color[0] = (unsigned char)color;
+    task.raw_color = 1;
+    job->tasks.push_back(task);
+    return 0;
+}
+
+int image_job_add_resize(image_job_t* job, image_buffer_t* src_image, image_buffer_t* dst_image,
+                         image_rect_t* src_box, image_rect_t* dst_box)
+{
+    if (job == NULL || src_image == NULL || dst_image == NULL) {
+        return -1;
+    }
+    image_task_t task;
+    memset(&task, 0, sizeof(image_task_t));
+    task.type = IMAGE_TASK_PROCESS;
+    task.src = *src_image;
+    task.dst = *dst_image;
+    task.src_box = src_box != NULL ? *src_box : whole_rect(src_image);
+    task.dst_box = dst_box != NULL ? *dst_box : whole_rect(dst_image);
+    job->tasks.push_back(task);
+    return 0;
+}
+
+int image_job_add_convert(image_job_t* job, image_buffer_t* src_image, image_buffer_t* dst_image,
+                          image_rect_t* src_box, image_rect_t* dst_box, char color)
+{
+    if (job == NULL || src_image == NULL || dst_image == NULL) {
+        return -1;
+    }
+    if (dst_box != NULL) {
+        int box_w = dst_box->right - dst_box->left + 1;
+        int box_h = dst_box->bottom - dst_box->top + 1;
+        if (box_w != dst_image->width || box_h != dst_image->height) {
+            image_job_add_fill(job, dst_image, NULL, color);
+        }
+    }
+    return image_job_add_resize(job, src_image, dst_image, src_box, dst_box);
+}
+
+int image_job_add_letterbox(image_job_t* job, image_buffer_t* src_image, image_buffer_t* dst_image,
+                            letterbox_t* letterbox, char color)
+{
+    if (job == NULL || src_image == NULL || dst_image == NULL) {
+        return -1;
+    }
+    if (dst_image->virt_addr == NULL && dst_image->fd <= 0) {
+        printf("image job letterbox requires a preallocated dst buffer\n");
+        return -1;
+    }
+    image_rect_t dst_box;
+    get_letterbox_box(src_image, dst_image, letterbox, &dst_box);
+    return image_job_add_convert(job, src_image, dst_image, NULL, &dst_box, color);
+}
+
+int image_job_add_rectangle(image_job_t* job, image_buffer_t* dst_image, image_rect_t* rect,
+                            unsigned int color, int thickness)
+{
+    if (job == NULL || dst_image == NULL || rect == NULL) {
+        return -1;
+    }
+    image_task_t task;
+    memset(&task, 0, sizeof(image_task_t));
+    task.type = IMAGE_TASK_RECTANGLE;
+    task.dst = *dst_image;
+    task.dst_box = *rect;
+    task.color[0] = (color >> 16) & 0xff;
+    task.color[1] = (color >> 8) & 0xff;
+    task.color[2] = color & 0xff;
+    task.color[3] = (color >> 24) & 0xff;
+    task.thickness = thickness;
+    job->tasks.push_back(task);
+    return 0;
+}
+
+int image_job_submit(image_job_t* job)
+{
+    if (job == NULL) {
+        return -1;
+    }
+    int ret = -1;
+#if !defined(DISABLE_RGA)
+    std::vector<unsigned int> handles;
+    ret = run_job_rga(job, 1, NULL, handles);
+    release_handles(handles);
+    if (ret != 0) {
+        printf("try image job use cpu\n");
+    }
+#endif
+    if (ret != 0) {
+        ret = run_job_cpu(job);
+    }
+    image_job_destroy(job);
+    return ret;
+}
+
+int image_job_submit_async(image_job_t* job, image_async_token_t** token)
+{
+    if (job == NULL || token == NULL) {
+        return -1;
+    }
+    image_async_token_t* t = image_async_create_token();
+#if !defined(DISABLE_RGA)
+    std::vector<unsigned int> handles;
+    int release_fence_fd = -1;
+    if (run_job_rga(job, 0, &release_fence_fd, handles) == 0) {
+        image_async_attach_fence(t, release_fence_fd, handles);
+        image_job_destroy(job);
+        *token = t;
+        return 0;
+    }
+    printf("async rga job fail, run image job on cpu worker\n");
+#endif
+    image_async_run_on_cpu(t, [job]() {
+        int ret = run_job_cpu(job);
+        image_job_destroy(job);
+        return ret;
+    });
+    *token = t;
+    return 0;
+}
@@ -0,0 +1,156 @@
+#ifndef _RKNN_MODEL_ZOO_IMAGE_JOB_H_
+#define _RKNN_MODEL_ZOO_IMAGE_JOB_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "image_utils.h"
+#include "image_async.h"
+
+/**
+ * @brief Batch of image operations submitted together
+ *
+ * Tasks are recorded first and go out as one RGA job (imbeginJob/im*Task/imendJob), i.e. a
+ * single kernel submission instead of one per operation. A job may mix tasks of several
+ * images, so the preprocessing of several streams can be grouped into one submission.
+ * If RGA is disabled or can not handle one of the tasks, the whole job runs on the CPU.
+ * Image memory referenced by the tasks must stay valid until the job has completed.
+ */
+typedef struct image_job image_job_t;
+
+/**
+ * @brief Import a buffer into RGA once and keep it until image_job_unregister_buffer()
+ *
+ * Jobs import the buffers of their tasks and release them when they complete, which costs
+ * two driver requests per buffer and job. Buffers used frame after frame (frame pool slots,
+ * model inputs) are registered once instead and jobs reuse the import. A registered buffer
+ * matches tasks with the same fd, virt_addr, width, height and format; for a DMA buffer, only
+ * while that dma-buf lives, so a new buffer that gets the same fd number is imported anew.
+ * A buffer must be unregistered before it is freed (frame_pool does so when it frees its
+ * slots): the import keeps the buffer's memory, and a heap buffer can not be told apart from
+ * a later allocation at the same address.
+ *
+ * @param image [in] Image buffer
+ * @return int 0: success; -1: RGA disabled or can not handle the image, jobs import it per use
+ */
+int image_job_register_buffer(image_buffer_t* image);
+
+/**
+ * @brief Release the import of a registered buffer, no job using it may be in flight
+ *
+ * @param image [in] Image buffer passed to image_job_register_buffer()
+ */
+void image_job_unregister_buffer(image_buffer_t* image);
+
+/**
+ * @brief Create an empty job
+ *
+ * @return image_job_t* Job, NULL on error
+ */
+image_job_t* image_job_create();
+
+/**
+ * @brief Destroy a job that will not be submitted
+ *
+ * @param job [in] Job
+ */
+void image_job_destroy(image_job_t* job);
+
+/**
+ * @brief Get the number of recorded tasks
+ *
+ * @param job [in] Job
+ * @return int Task count
+ */
+int image_job_task_count(image_job_t* job);
+
+/**
+ * @brief Add color fill task
+ *
+ * @param job [in] Job
+ * @param dst_image [in] Target Image
+ * @param rect [in] Fill rectangle on target image, NULL for whole image
+ * @param color [in] Fill color, written to every channel
+ * @return int 0: success; -1: error
+ */
+int image_job_add_fill(image_job_t* job, image_buffer_t* dst_image, image_rect_t* rect, char color);
+
+/**
+ * @brief Add crop, resize and pixel format change task, same semantics as convert_image()
+ *
+ * A fill task is added before the resize when dst_box does not cover the target image.
+ *
+ * @param job [in] Job
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image
+ * @param src_box [in] Crop rectangle on source image, can be NULL
+ * @param dst_box [in] Crop rectangle on target image, can be NULL
+ * @param color [in] Pading color if dst_box can not fill target image
+ * @return int 0: success; -1: error
+ */
+int image_job_add_convert(image_job_t* job, image_buffer_t* src_image, image_buffer_t* dst_image,
+                          image_rect_t* src_box, image_rect_t* dst_box, char color);
+
+/**
+ * @brief Add crop and resize task, pixels of target image outside dst_box are left untouched
+ *
+ * @param job [in] Job
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image
+ * @param src_box [in] Crop rectangle on source image, can be NULL
+ * @param dst_box [in] Crop rectangle on target image, can be NULL
+ * @return int 0: success; -1: error
+ */
+int image_job_add_resize(image_job_t* job, image_buffer_t* src_image, image_buffer_t* dst_image,
+                         image_rect_t* src_box, image_rect_t* dst_box);
+
+/**
+ * @brief Add letterbox task (fill + resize), same semantics as convert_image_with_letterbox()
+ *
+ * @param job [in] Job
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image, buffer must be allocated by caller
+ * @param letterbox [out] Letterbox, filled before return
+ * @param color [in] Fill color on target image
+ * @return int 0: success; -1: error
+ */
+int image_job_add_letterbox(image_job_t* job, image_buffer_t* src_image, image_buffer_t* dst_image,
+                            letterbox_t* letterbox, char color);
+
+/**
+ * @brief Add rectangle drawing task
+ *
+ * @param job [in] Job
+ * @param dst_image [in] Image to draw on
+ * @param rect [in] Rectangle
+ * @param color [in] Line color, ARGB8888 as in image_drawing.h
+ * @param thickness [in] Line thickness, -1 draws a filled rectangle
+ * @return int 0: success; -1: error
+ */
+int image_job_add_rectangle(image_job_t* job, image_buffer_t* dst_image, image_rect_t* rect,
+                            unsigned int color, int thickness);
+
+/**
+ * @brief Submit the job and wait for it, the job is destroyed
+ *
+ * @param job [in] Job
+ * @return int 0: success; -1: error
+ */
+int image_job_submit(image_job_t* job);
+
+/**
+ * @brief Submit the job without waiting, the job is destroyed
+ *
+ * @param job [in] Job
+ * @param token [out] Completion token, remember call image_async_wait() to release
+ * @return int 0: success; -1: error
+ */
+int image_job_submit_async(image_job_t* job, image_async_token_t** token);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_IMAGE_JOB_H_
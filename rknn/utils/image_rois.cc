@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "image_job.h"
+#include "image_utils.h"
+#include "image_utils_internal.h"
+
+// keep every stacked view below the smallest RGA output height limit
+#define RGA_MAX_HEIGHT 4096
+
+// fixed point bilinear weights, 11 bits per direction
+#define RESIZE_BITS 11
+#define RESIZE_ONE (1 << RESIZE_BITS)
+
+// below this many output bytes a call is resized on the calling thread, waking workers costs more
+#define ROI_PARALLEL_MIN_BYTES (256 * 256 * 3)
+
+static int get_channel(image_format_t format)
+{
+    switch (format) {
+    case IMAGE_FORMAT_GRAY8:
+        return 1;
+    case IMAGE_FORMAT_RGB888:
+        return 3;
+    case IMAGE_FORMAT_RGBA8888:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static image_rect_t clamp_roi(image_rect_t roi, int width, int height)
+{
+    if (roi.left < 0) roi.left = 0;
+    if (roi.top < 0) roi.top = 0;
+    if (roi.right > width - 1) roi.right = width - 1;
+    if (roi.bottom > height - 1) roi.bottom = height - 1;
+    if (roi.right < roi.left) roi.right = roi.left;
+    if (roi.bottom < roi.top) roi.bottom = roi.top;
+    return roi;
+}
+
+/*-------------------------------------------
+                  CPU path
+-------------------------------------------*/
+// Separable fixed point bilinear resize. The horizontal pass is computed once per source row
+// and the vertical blend is a plain multiply-add over a contiguous row, which the compiler
+// vectorizes (NEON on the boards, SSE/AVX on hosts).
+static void resize_bilinear_u8(const unsigned char* src, int src_stride, image_rect_t* box, int channel,
+                               unsigned char* dst, int dst_width, int dst_height)
+{
+    int crop_w = box->right - box->left + 1;
+    int crop_h = box->bottom - box->top + 1;
+    int row_len = dst_width * channel;
+
+    std::vector<int> xofs0(dst_width);
+    std::vector<int> xofs1(dst_width);
+    std::vector<int> xalpha(dst_width);
+    for (int dx = 0; dx < dst_width; dx++) {
+        float fx = (dx + 0.5f) * crop_w / dst_width - 0.5f;
+        if (fx < 0) fx = 0;
+        int sx = (int)fx;
+        if (sx > crop_w - 1) sx = crop_w - 1;
+        xalpha[dx] = (int)((fx - sx) * RESIZE_ONE);
+        xofs0[dx] = (box->left + sx) * channel;
+        xofs1[dx] = (box->left + (sx + 1 < crop_w ? sx + 1 : sx)) * channel;
+    }
+
+    std::vector<int> rows(row_len * 2);
+    int* hrow[2] = {&rows[0], &rows[row_len]};
+    int hrow_y[2] = {-1, -1};
+
+    for (int dy = 0; dy < dst_height; dy++) {
+        float fy = (dy + 0.5f) * crop_h / dst_height - 0.5f;
+        if (fy < 0) fy = 0;
+        int sy = (int)fy;
+        if (sy > crop_h - 1) sy = crop_h - 1;
+        int beta = (int)((fy - sy) * RESIZE_ONE);
+        int sy1 = sy + 1 < crop_h ? sy + 1 : sy;
+
+        // horizontal pass for the two source rows, reusing rows of the previous output row
+        int need[2] = {sy, sy1};
+        for (int k = 0; k < 2; k++) {
+            if (hrow_y[k] == need[k]) {
+                continue;
+            }
+            if (k == 0 && hrow_y[1] == need[0]) {
+                int* tmp = hrow[0];
+                hrow[0] = hrow[1];
+                hrow[1] = tmp;
+                hrow_y[1] = hrow_y[0];
+                hrow_y[0] = need[0];
+                continue;
+            }
+            const unsigned char* s = src + (box->top + need[k]) * src_stride;
+            int* h = hrow[k];
+            for (int dx = 0; dx < dst_width; dx++) {
+                const unsigned char* p0 = s + xofs0[dx];
+                const unsigned char* p1 = s + xofs1[dx];
+                int a = xalpha[dx];
+                for (int c = 0; c < channel; c++) {
+                    h[dx * channel + c] = p0[c] * (RESIZE_ONE - a) + p1[c] * a;
+                }
+            }
+            hrow_y[k] = need[k];
+        }
+
+        const int* h0 = hrow[0];
+        const int* h1 = hrow[1];
+        unsigned char* d = dst + dy * row_len;
+        int b0 = RESIZE_ONE - beta;
+        for (int i = 0; i < row_len; i++) {
+            d[i] = (unsigned char)((h0[i] * b0 + h1[i] * beta + (1 << (RESIZE_BITS * 2 - 1))) >> (RESIZE_BITS * 2));
+        }
+    }
+}
+
+// Workers created once for the CPU path (one per core besides the caller). Each call is a batch
+// of tasks; the caller runs tasks of its batch as well, so a call never waits on an idle pool,
+// and concurrent calls share the workers.
+class RoiWorkerPool {
+public:
+    static RoiWorkerPool& instance()
+    {
+        static RoiWorkerPool pool;
+        return pool;
+    }
+
+    int workers() const { return (int)threads_.size(); }
+
+    void run(int count, const std::function<void(int)>& task)
+    {
+        Batch batch(count, task);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.push_back(&batch);
+            cond_.notify_all();
+        }
+        int done = work(&batch);
+        std::unique_lock<std::mutex> lock(mutex_);
+        batch.done += done;
+        done_cond_.wait(lock, [&batch] { return batch.done == batch.count && batch.active == 0; });
+        for (size_t i = 0; i < batches_.size(); i++) {
+            if (batches_[i] == &batch) {
+                batches_.erase(batches_.begin() + i);
+                break;
+            }
+        }
+    }
+
+private:
+    struct Batch {
+        Batch(int count, const std::function<void(int)>& task)
+            : count(count), task(task), next(0), done(0), active(0)
+        {
+        }
+        int count;
+        const std::function<void(int)>& task;
+        std::atomic<int> next;
+        int done;    // tasks finished, under the pool mutex
+        int active;  // workers inside the batch, under the pool mutex
+    };
+
+    RoiWorkerPool() : running_(true)
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        for (int i = 1; i < cores; i++) {
+            threads_.push_back(std::thread(&RoiWorkerPool::loop, this));
+        }
+    }
+
+    ~RoiWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            cond_.notify_all();
+        }
+        for (size_t i = 0; i < threads_.size(); i++) {
+            threads_[i].join();
+        }
+    }
+
+    // Runs tasks of the batch until none is left, returns how many
+    static int work(Batch* batch)
+    {
+        int done = 0;
+        for (int i = batch->next.fetch_add(1); i < batch->count; i = batch->next.fetch_add(1)) {
+            batch->task(i);
+            done++;
+        }
+        return done;
+    }
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cond_.wait(lock, [this] { return !batches_.empty() || !running_; });
+            if (!running_) {
+                return;
+            }
+            Batch* batch = batches_.front();
+            if (batch->next.load() >= batch->count) {
+                // every task taken, its caller removes it once they are finished
+                batches_.pop_front();
+                continue;
+            }
+            batch->active++;
+            lock.unlock();
+            int done = work(batch);
+            lock.lock();
+            batch->done += done;
+            batch->active--;
+            done_cond_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable done_cond_;
+    std::deque<Batch*> batches_;
+    bool running_;
+    std::vector<std::thread> threads_;
+};
+
+static int convert_rois_cpu(image_buffer_t* src, image_rect_t* rois, int num_rois, image_buffer_t* dst, int roi_height)
+{
+    int channel = get_channel(src->format);
+    if (channel == 0 || src->format != dst->format) {
+        printf("convert_image_rois: cpu path does not support format %d -> %d\n", src->format, dst->format);
+        return -1;
+    }
+    if (src->virt_addr == NULL || dst->virt_addr == NULL) {
+        printf("convert_image_rois: cpu path needs virtual address\n");
+        return -1;
+    }
+
+    int roi_size = dst->width * roi_height * channel;
+    std::function<void(int)> resize_roi = [&](int i) {
+        image_rect_t box = clamp_roi(rois[i], src->width, src->height);
+        resize_bilinear_u8(src->virt_addr, src->width * channel, &box, channel,
+                           dst->virt_addr + (size_t)i * roi_size, dst->width, roi_height);
+    };
+
+    RoiWorkerPool& pool = RoiWorkerPool::instance();
+    if (num_rois == 1 || pool.workers() == 0 || (size_t)roi_size * num_rois < ROI_PARALLEL_MIN_BYTES) {
+        for (int i = 0; i < num_rois; i++) {
+            resize_roi(i);
+        }
+        return 0;
+    }
+    pool.run(num_rois, resize_roi);
+    return 0;
+}
+
+/*-------------------------------------------
+                  RGA path
+-------------------------------------------*/
+#if !defined(DISABLE_RGA)
+static int rois_rga_usable(image_buffer_t* src, image_buffer_t* dst)
+{
+    if (get_rga_fmt(src->format) < 0 || get_rga_fmt(dst->format) < 0) {
+        return 0;
+    }
+#if defined(RV1106_1103)
+    return src->width % 4 == 0 && dst->width % 4 == 0;
+#else
+    return src->width % 16 == 0 && dst->width % 16 == 0;
+#endif
+}
+
+// One job: the tensor is split in views of at most RGA_MAX_HEIGHT rows, each roi is a resize task
+// into its slot of a view.
+static int convert_rois_rga(image_buffer_t* src, image_rect_t* rois, int num_rois, image_buffer_t* dst, int roi_height)
+{
+    int rois_per_view = RGA_MAX_HEIGHT / roi_height;
+    if (rois_per_view < 1) rois_per_view = 1;
+    if (rois_per_view > num_rois) rois_per_view = num_rois;
+    int num_views = (num_rois + rois_per_view - 1) / rois_per_view;
+    if (num_views > 1 && dst->virt_addr == NULL) {
+        printf("convert_image_rois: %d rois need virtual address of dst tensor\n", num_rois);
+        return -1;
+    }
+    int roi_size = get_image_size(dst) / num_rois;
+
+    std::vector<image_buffer_t> views(num_views);
+    image_job_t* job = image_job_create();
+    for (int v = 0; v < num_views; v++) {
+        int count = num_rois - v * rois_per_view < rois_per_view ? num_rois - v * rois_per_view : rois_per_view;
+        image_buffer_t* view = &views[v];
+        *view = *dst;
+        view->height = roi_height * count;
+        view->size = roi_size * count;
+        if (v > 0) {
+            view->virt_addr = dst->virt_addr + (size_t)v * rois_per_view * roi_size;
+            view->fd = 0;
+        }
+        for (int k = 0; k < count; k++) {
+            int i = v * rois_per_view + k;
+            image_rect_t src_box = clamp_roi(rois[i], src->width, src->height);
+            image_rect_t dst_box = {0, k * roi_height, dst->width - 1, (k + 1) * roi_height - 1};
+            image_job_add_resize(job, src, view, &src_box, &dst_box);
+        }
+    }
+    return image_job_submit(job);
+}
+#endif
+
+/*-------------------------------------------
+                  Public API
+-------------------------------------------*/
+int convert_image_rois(image_buffer_t* src_image, image_rect_t* rois, int num_rois, image_buffer_t* dst_tensor)
+{
+    if (src_image == NULL || rois == NULL || dst_tensor == NULL || num_rois <= 0) {
+        return -1;
+    }
+    if (dst_tensor->height % num_rois != 0) {
+        printf("convert_image_rois: tensor height %d is not a multiple of %d rois\n", dst_tensor->height, num_rois);
+        return -1;
+    }
+    if (dst_tensor->virt_addr == NULL && dst_tensor->fd <= 0) {
+        printf("convert_image_rois: dst tensor buffer must be allocated by caller\n");
+        return -1;
+    }
+    int roi_height = dst_tensor->height / num_rois;
+
+#if !defined(DISABLE_RGA)
+    if (rois_rga_usable(src_image, dst_tensor)) {
+        return convert_rois_rga(src_image, rois, num_rois, dst_tensor, roi_height);
+    }
+#endif
+    return convert_rois_cpu(src_image, rois, num_rois, dst_tensor, roi_height);
+}
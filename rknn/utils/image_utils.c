@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <dirent.h>
 #include <math.h>
 #include <sys/time.h>
@@ -20,6 +21,15 @@
 
 #include "image_utils.h"
 #include "file_utils.h"
+#include "jpeg_decoder.h"
+
+// Per call trace of the conversions (path taken, letterbox, fill), printed for every frame when
+// built with IMAGE_UTILS_DEBUG=ON; errors are always printed
+#if defined(IMAGE_UTILS_DEBUG)
+#define debug_printf printf
+#else
+#define debug_printf(...)
+#endif
 
 static const char* filter_image_names[] = {
     "jpg",
@@ -32,10 +42,6 @@ static const char* filter_image_names[] = {
     NULL
 };
 
-static const char* subsampName[TJ_NUMSAMP] = {"4:4:4", "4:2:2", "4:2:0", "Grayscale", "4:4:0", "4:1:1"};
-
-static const char* colorspaceName[TJ_NUMCS] = {"RGB", "YCbCr", "GRAY", "CMYK", "YCCK"};
-
 static int image_file_filter(const struct dirent *entry)
 {
     const char ** filter;
@@ -48,101 +54,50 @@ static int image_file_filter(const struct dirent *entry)
     return 0;
 }
 
-static int read_image_jpeg(const char* path, image_buffer_t* image)
+int list_image_files(const char* dir_path, char*** file_list)
 {
-    FILE* jpegFile = NULL;
-    unsigned long jpegSize;
-    int flags = 0;
-    int width, height;
-    int origin_width, origin_height;
-    unsigned char* imgBuf = NULL;
-    unsigned char* jpegBuf = NULL;
-    unsigned long size;
-    unsigned short orientation = 1;
-    struct timeval tv1, tv2;
-
-    if ((jpegFile = fopen(path, "rb")) == NULL) {
-        printf("open input file failure\n");
-    }
-    if (fseek(jpegFile, 0, SEEK_END) < 0 || (size = ftell(jpegFile)) < 0 || fseek(jpegFile, 0, SEEK_SET) < 0) {
-        printf("determining input file size failure\n");
+    struct dirent** entries;
+    int n = scandir(dir_path, &entries, image_file_filter, alphasort);
+    if (n < 0) {
+        printf("scandir %s fail!\n", dir_path);
+        return -1;
     }
-    if (size == 0) {
-        printf("determining input file size, Input file contains no data\n");
+    char** list = (char**)malloc((n > 0 ? n : 1) * sizeof(char*));
+    for (int i = 0; i < n; i++) {
+        size_t len = strlen(dir_path) + strlen(entries[i]->d_name) + 2;
+        list[i] = (char*)malloc(len);
+        snprintf(list[i], len, "%s/%s", dir_path, entries[i]->d_name);
+        free(entries[i]);
     }
-    jpegSize = (unsigned long)size;
-    if ((jpegBuf = (unsigned char*)malloc(jpegSize * sizeof(unsigned char))) == NULL) {
-        printf("allocating JPEG buffer\n");
+    free(entries);
+    *file_list = list;
+    return n;
+}
+
+void free_image_file_list(char** file_list, int count)
+{
+    if (file_list == NULL) {
+        return;
     }
-    if (fread(jpegBuf, jpegSize, 1, jpegFile) < 1) {
-        printf("reading input file");
+    for (int i = 0; i < count; i++) {
+        free(file_list[i]);
     }
-    fclose(jpegFile);
-    jpegFile = NULL;
-
-    tjhandle handle = NULL;
-    int subsample, colorspace;
-    int padding = 1;
-    int ret = 0;
+    free(file_list);
+}
 
-    handle = tjInitDecompress();
-    ret = tjDecompressHeader3(handle, jpegBuf, size, &origin_width, &origin_height, &subsample, &colorspace);
-    if (ret < 0) {
-        printf("header file error, errorStr:%s, errorCode:%d\n", tjGetErrorStr(), tjGetErrorCode(handle));
+static int read_image_jpeg(const char* path, image_buffer_t* image)
+{
+    // one-shot decode, use a jpeg_decoder_t directly to keep the handle and buffers across images
+    jpeg_decoder_t* decoder = jpeg_decoder_create(0);
+    if (decoder == NULL) {
         return -1;
     }
-
-    // 对图像做裁剪16对齐，利于后续rga操作
-    int crop_width = origin_width / 16 * 16;
-    int crop_height = origin_height / 16 * 16;
-
-    printf("origin size=%dx%d crop size=%dx%d\n", origin_width, origin_height, crop_width, crop_height);
-
-    // gettimeofday(&tv1, NULL);
-    ret = tjDecompressHeader3(handle, jpegBuf, size, &width, &height, &subsample, &colorspace);
-    if (ret < 0) {
-        printf("header file error, errorStr:%s, errorCode:%d\n", tjGetErrorStr(), tjGetErrorCode(handle));
+    int ret = jpeg_decoder_decode_file(decoder, path, NULL, image);
+    jpeg_decoder_destroy(decoder);
+    if (ret != 0) {
         return -1;
     }
-    printf("input image: %d x %d, subsampling: %s, colorspace: %s, orientation: %d\n", 
-            width, height, subsampName[subsample], colorspaceName[colorspace], orientation);
-    int sw_out_size = width * height * 3;
-    unsigned char* sw_out_buf = image->virt_addr;
-    if (sw_out_buf == NULL) {
-        sw_out_buf = (unsigned char*)malloc(sw_out_size * sizeof(unsigned char));
-    }
-    if (sw_out_buf == NULL) {
-        printf("sw_out_buf is NULL\n");
-        goto out;
-    }
-
-    flags |= 0;
-
-    // 错误码为0时，表示警告，错误码为-1时表示错误
-    int pixelFormat = TJPF_RGB;
-    ret = tjDecompress2(handle, jpegBuf, size, sw_out_buf, width, 0, height, pixelFormat, flags);
-    // ret = tjDecompressToYUV2(handle, jpeg_buf, size, dst_buf, *width, padding, *height, flags);
-    if ((0 != tjGetErrorCode(handle)) && (ret < 0)) {
-        printf("error : decompress to yuv failed, errorStr:%s, errorCode:%d\n", tjGetErrorStr(),
-               tjGetErrorCode(handle));
-        goto out;
-    }
-    if ((0 == tjGetErrorCode(handle)) && (ret < 0)) {
-        printf("warning : errorStr:%s, errorCode:%d\n", tjGetErrorStr(), tjGetErrorCode(handle));
-    }
-    tjDestroy(handle);
-    // gettimeofday(&tv2, NULL);
-    // printf("decode time %ld ms\n", (tv2.tv_sec-tv1.tv_sec)*1000 + (tv2.tv_usec-tv1.tv_usec)/1000);
-
-    image->width = width;
-    image->height = height;
-    image->format = IMAGE_FORMAT_RGB888;
-    image->virt_addr = sw_out_buf;
-    image->size = sw_out_size;
-out:
-    if (jpegBuf) {
-        free(jpegBuf);
-    }
+    printf("input image: %d x %d\n", image->width, image->height);
     return 0;
 }
 
@@ -378,8 +333,7 @@ static int crop_and_scale_image_yuv420sp(unsigned char *src, int src_width, int
     return 0;
 }
 
-static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box, char color) {
-    int ret;
+int crop_and_scale_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box) {
     if (dst->virt_addr == NULL) {
         return -1;
     }
@@ -411,12 +365,6 @@ static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rec
         dst_box_h = dst_box->bottom - dst_box->top + 1;
     }
 
-    // fill pad color
-    if (dst_box_w != dst->width || dst_box_h != dst->height) {
-        int dst_size = get_image_size(dst);
-        memset(dst->virt_addr, color, dst_size);
-    }
-
     int need_release_dst_buffer = 0;
     int reti = 0;
     if (src->format == IMAGE_FORMAT_RGB888) {
@@ -446,11 +394,25 @@ static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rec
         printf("convert_image_cpu fail %d\n", reti);
         return -1;
     }
-    printf("finish\n");
+    debug_printf("finish\n");
     return 0;
 }
 
-static int get_rga_fmt(image_format_t fmt) {
+static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box, char color) {
+    if (dst->virt_addr == NULL) {
+        return -1;
+    }
+
+    // fill pad color
+    if (dst_box != NULL && (dst_box->right - dst_box->left + 1 != dst->width || dst_box->bottom - dst_box->top + 1 != dst->height)) {
+        int dst_size = get_image_size(dst);
+        memset(dst->virt_addr, color, dst_size);
+    }
+
+    return crop_and_scale_image_cpu(src, dst, src_box, dst_box);
+}
+
+int get_rga_fmt(image_format_t fmt) {
     switch (fmt)
     {
     case IMAGE_FORMAT_RGB888:
@@ -487,6 +449,7 @@ int get_image_size(image_buffer_t* image)
     }
 }
 
+#if !defined(DISABLE_RGA)
 static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
 {
     int ret = 0;
@@ -628,7 +591,7 @@ static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, i
         p_imcolor[1] = color;
         p_imcolor[2] = color;
         p_imcolor[3] = color;
-        printf("fill dst image (x y w h)=(%d %d %d %d) with color=0x%x\n",
+        debug_printf("fill dst image (x y w h)=(%d %d %d %d) with color=0x%x\n",
             dst_whole_rect.x, dst_whole_rect.y, dst_whole_rect.width, dst_whole_rect.height, imcolor);
         ret_rga = imfill(rga_buf_dst, dst_whole_rect, imcolor);
         if (ret_rga <= 0) {
@@ -661,12 +624,13 @@ err:
     // printf("finish\n");
     return ret;
 }
+#endif
 
 int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
 {
     int ret;
 #if defined(DISABLE_RGA) 
-    printf("convert image use cpu\n");
+    debug_printf("convert image use cpu\n");
     ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
 #else
 
@@ -681,16 +645,15 @@ int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t
             ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
         }
     } else {
-        printf("src width is not 4/16-aligned, convert image use cpu\n");
+        debug_printf("src width is not 4/16-aligned, convert image use cpu\n");
         ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
     }
 #endif
     return ret;
 }
 
-int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+int get_letterbox_box(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, image_rect_t* out_box)
 {
-    int ret = 0;
     int allow_slight_change = 1;
     int src_w = src_image->width;
     int src_h = src_image->height;
@@ -706,12 +669,6 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     int _top_offset = 0;
     float scale = 1.0;
 
-    image_rect_t src_box;
-    src_box.left = 0;
-    src_box.top = 0;
-    src_box.right = src_image->width - 1;
-    src_box.bottom = src_image->height - 1;
-
     image_rect_t dst_box;
     dst_box.left = 0;
     dst_box.top = 0;
@@ -759,7 +716,7 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
         dst_box.right = dst_box.left + resize_w - 1;
         _left_offset = dst_box.left;
     }
-    printf("scale=%f dst_box=(%d %d %d %d) allow_slight_change=%d _left_offset=%d _top_offset=%d padding_w=%d padding_h=%d\n",
+    debug_printf("scale=%f dst_box=(%d %d %d %d) allow_slight_change=%d _left_offset=%d _top_offset=%d padding_w=%d padding_h=%d\n",
         scale, dst_box.left, dst_box.top, dst_box.right, dst_box.bottom, allow_slight_change,
         _left_offset, _top_offset, padding_w, padding_h);
 
@@ -769,6 +726,25 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
         letterbox->x_pad = _left_offset;
         letterbox->y_pad = _top_offset;
     }
+    if (out_box != NULL) {
+        *out_box = dst_box;
+    }
+    return 0;
+}
+
+int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+{
+    int ret = 0;
+
+    image_rect_t src_box;
+    src_box.left = 0;
+    src_box.top = 0;
+    src_box.right = src_image->width - 1;
+    src_box.bottom = src_image->height - 1;
+
+    image_rect_t dst_box;
+    get_letterbox_box(src_image, dst_image, letterbox, &dst_box);
+
     // alloc memory buffer for dst image,
     // remember to free
     if (dst_image->virt_addr == NULL && dst_image->fd <= 0) {
@@ -26,6 +26,23 @@ typedef struct {
  */
 int read_image(const char* path, image_buffer_t* image);
 
+/**
+ * @brief List the image files (jpg/png/data) of a directory, sorted by name
+ * 
+ * @param dir_path [in] Directory path
+ * @param file_list [out] File paths ("dir_path/name"), free with free_image_file_list()
+ * @return int Number of files; -1: error
+ */
+int list_image_files(const char* dir_path, char*** file_list);
+
+/**
+ * @brief Free a list returned by list_image_files()
+ * 
+ * @param file_list [in] File paths
+ * @param count [in] Number of files
+ */
+void free_image_file_list(char** file_list, int count);
+
 /**
  * @brief Write image file (support jpg/png)
  * 
@@ -47,6 +64,17 @@ int write_image(const char* path, const image_buffer_t* image);
  */
 int convert_image(image_buffer_t* src_image, image_buffer_t* dst_image, image_rect_t* src_box, image_rect_t* dst_box, char color);
 
+/**
+ * @brief Compute letterbox geometry without touching any pixels
+ * 
+ * @param src_image [in] Source Image
+ * @param dst_image [in] Target Image (only width/height are used)
+ * @param letterbox [out] Letterbox, can be NULL
+ * @param dst_box [out] Rectangle on target image that receives the resized source
+ * @return int 0: success; -1: error
+ */
+int get_letterbox_box(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, image_rect_t* dst_box);
+
 /**
  * @brief Convert image with letterbox
  * 
@@ -58,6 +86,22 @@ int convert_image(image_buffer_t* src_image, image_buffer_t* dst_image, image_re
  */
 int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color);
 
+/**
+ * @brief Crop several regions of one image and resize each of them into one batch tensor
+ *
+ * dst_tensor holds num_rois images of dst_tensor->width x (dst_tensor->height / num_rois) stacked
+ * one after another (NHWC), roi i is written to the i-th image. All regions go out in one RGA job,
+ * the CPU fallback resizes the regions in parallel on worker threads created at the first call
+ * (small batches stay on the calling thread).
+ *
+ * @param src_image [in] Source Image
+ * @param rois [in] Crop rectangles on source image, clamped to the image
+ * @param num_rois [in] Number of rectangles
+ * @param dst_tensor [out] Target tensor, RGB888/RGBA8888/GRAY8, buffer must be allocated by caller
+ * @return int 0: success; -1: error
+ */
+int convert_image_rois(image_buffer_t* src_image, image_rect_t* rois, int num_rois, image_buffer_t* dst_tensor);
+
 /**
  * @brief Get the image size
  * 
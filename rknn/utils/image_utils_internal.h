@@ -0,0 +1,49 @@
+#ifndef _RKNN_MODEL_ZOO_IMAGE_UTILS_INTERNAL_H_
+#define _RKNN_MODEL_ZOO_IMAGE_UTILS_INTERNAL_H_
+
+// Helpers shared between the utils translation units, not part of the public API.
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Get RGA pixel format of image format
+ *
+ * @param fmt [in] Image format
+ * @return int RK_FORMAT_*; -1: not supported by RGA
+ */
+int get_rga_fmt(image_format_t fmt);
+
+/**
+ * @brief CPU crop and bilinear resize, pixels outside dst_box are left untouched
+ *
+ * @param src [in] Source Image
+ * @param dst [out] Target Image
+ * @param src_box [in] Crop rectangle on source image, can be NULL
+ * @param dst_box [in] Crop rectangle on target image, can be NULL
+ * @return int 0: success; -1: error
+ */
+int crop_and_scale_image_cpu(image_buffer_t* src, image_buffer_t* dst, image_rect_t* src_box, image_rect_t* dst_box);
+
+#ifdef __cplusplus
+}  // extern "C"
+
+#include <functional>
+#include <vector>
+
+#include "image_async.h"
+
+image_async_token_t* image_async_create_token();
+
+// Token completes when release_fence_fd signals, the RGA handles are released after that
+void image_async_attach_fence(image_async_token_t* token, int release_fence_fd, const std::vector<unsigned int>& handles);
+
+// Token completes when work() returns on the CPU worker thread
+void image_async_run_on_cpu(image_async_token_t* token, std::function<int()> work);
+
+#endif
+
+#endif // _RKNN_MODEL_ZOO_IMAGE_UTILS_INTERNAL_H_
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "turbojpeg.h"
+
+#include "jpeg_decoder.h"
+
+#define JPEG_POOL_MAX 64
+
+typedef struct {
+    unsigned char* ptr;
+    size_t capacity;
+    int in_use;
+} jpeg_pool_buffer_t;
+
+struct jpeg_decoder {
+    tjhandle handle;
+
+    // reused between images
+    unsigned char* file_buf;
+    size_t file_capacity;
+    unsigned char* chroma_buf;
+    size_t chroma_capacity;
+
+    pthread_mutex_t lock;
+    jpeg_pool_buffer_t pool[JPEG_POOL_MAX];
+    int pool_size;
+    int pool_count;
+
+    jpeg_decoder_stats_t stats;
+};
+
+static int grow_buffer(unsigned char** buf, size_t* capacity, size_t size)
+{
+    if (*capacity >= size) {
+        return 0;
+    }
+    unsigned char* p = (unsigned char*)realloc(*buf, size);
+    if (p == NULL) {
+        printf("jpeg decoder: alloc %zu bytes fail\n", size);
+        return -1;
+    }
+    *buf = p;
+    *capacity = size;
+    return 0;
+}
+
+/*-------------------------------------------
+                  Buffer pool
+-------------------------------------------*/
+static unsigned char* pool_get(jpeg_decoder_t* decoder, size_t size)
+{
+    unsigned char* ptr = NULL;
+    pthread_mutex_lock(&decoder->lock);
+    // smallest free buffer that fits, else grow a free one, else add a new one
+    jpeg_pool_buffer_t* best = NULL;
+    jpeg_pool_buffer_t* any_free = NULL;
+    for (int i = 0; i < decoder->pool_count; i++) {
+        jpeg_pool_buffer_t* b = &decoder->pool[i];
+        if (b->in_use) {
+            continue;
+        }
+        any_free = b;
+        if (b->capacity >= size && (best == NULL || b->capacity < best->capacity)) {
+            best = b;
+        }
+    }
+    if (best != NULL) {
+        decoder->stats.pool_hits++;
+    } else {
+        decoder->stats.pool_misses++;
+        if (any_free != NULL) {
+            best = any_free;
+        } else if (decoder->pool_count < decoder->pool_size) {
+            best = &decoder->pool[decoder->pool_count++];
+            best->ptr = NULL;
+            best->capacity = 0;
+        }
+        if (best != NULL && grow_buffer(&best->ptr, &best->capacity, size) != 0) {
+            best = NULL;
+        }
+    }
+    if (best != NULL) {
+        best->in_use = 1;
+        ptr = best->ptr;
+    }
+    pthread_mutex_unlock(&decoder->lock);
+
+    if (ptr == NULL) {
+        // pool full, the buffer is freed on release
+        ptr = (unsigned char*)malloc(size);
+    }
+    return ptr;
+}
+
+void jpeg_decoder_release(jpeg_decoder_t* decoder, image_buffer_t* image)
+{
+    if (decoder == NULL || image == NULL || image->virt_addr == NULL) {
+        return;
+    }
+    int found = 0;
+    pthread_mutex_lock(&decoder->lock);
+    for (int i = 0; i < decoder->pool_count; i++) {
+        if (decoder->pool[i].ptr == image->virt_addr) {
+            decoder->pool[i].in_use = 0;
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&decoder->lock);
+    if (!found) {
+        free(image->virt_addr);
+    }
+    image->virt_addr = NULL;
+}
+
+/*-------------------------------------------
+                  Decoder
+-------------------------------------------*/
+jpeg_decoder_t* jpeg_decoder_create(int pool_size)
+{
+    jpeg_decoder_t* decoder = (jpeg_decoder_t*)calloc(1, sizeof(jpeg_decoder_t));
+    if (decoder == NULL) {
+        return NULL;
+    }
+    decoder->handle = tjInitDecompress();
+    if (decoder->handle == NULL) {
+        printf("tjInitDecompress fail: %s\n", tjGetErrorStr());
+        free(decoder);
+        return NULL;
+    }
+    decoder->pool_size = pool_size > JPEG_POOL_MAX ? JPEG_POOL_MAX : pool_size;
+    pthread_mutex_init(&decoder->lock, NULL);
+    return decoder;
+}
+
+void jpeg_decoder_destroy(jpeg_decoder_t* decoder)
+{
+    if (decoder == NULL) {
+        return;
+    }
+    for (int i = 0; i < decoder->pool_count; i++) {
+        free(decoder->pool[i].ptr);
+    }
+    free(decoder->file_buf);
+    free(decoder->chroma_buf);
+    tjDestroy(decoder->handle);
+    pthread_mutex_destroy(&decoder->lock);
+    free(decoder);
+}
+
+int jpeg_decoder_scale_denom(int width, int height, int min_width, int min_height)
+{
+    static const int denoms[] = {8, 4, 2};
+    if (min_width <= 0 && min_height <= 0) {
+        return 1;
+    }
+    for (int i = 0; i < 3; i++) {
+        tjscalingfactor sf = {1, denoms[i]};
+        if (TJSCALED(width, sf) >= min_width && TJSCALED(height, sf) >= min_height) {
+            return denoms[i];
+        }
+    }
+    return 1;
+}
+
+// 4:2:0 planes to NV12: Y is decoded in place, U/V go to a scratch buffer and are interleaved
+static int decode_nv12(jpeg_decoder_t* decoder, const unsigned char* data, unsigned long size, int width, int height,
+                       int flags, unsigned char* dst)
+{
+    int even_w = (width + 1) & ~1;
+    int even_h = (height + 1) & ~1;
+    int chroma_w = tjPlaneWidth(1, width, TJSAMP_420);
+    int chroma_h = tjPlaneHeight(1, height, TJSAMP_420);
+    if (grow_buffer(&decoder->chroma_buf, &decoder->chroma_capacity, (size_t)chroma_w * chroma_h * 2) != 0) {
+        return -1;
+    }
+
+    unsigned char* planes[3] = {dst, decoder->chroma_buf, decoder->chroma_buf + chroma_w * chroma_h};
+    int strides[3] = {even_w, chroma_w, chroma_w};
+    if (tjDecompressToYUVPlanes(decoder->handle, data, size, planes, width, strides, height, flags) < 0 &&
+        tjGetErrorCode(decoder->handle) != TJERR_WARNING) {
+        printf("decompress to yuv fail: %s\n", tjGetErrorStr2(decoder->handle));
+        return -1;
+    }
+
+    // odd sizes: repeat the last column / row so NV12 stays 2x2 aligned
+    if (even_w != width) {
+        for (int y = 0; y < height; y++) {
+            dst[y * even_w + width] = dst[y * even_w + width - 1];
+        }
+    }
+    if (even_h != height) {
+        memcpy(dst + height * even_w, dst + (height - 1) * even_w, even_w);
+    }
+
+    unsigned char* uv = dst + even_w * even_h;
+    for (int y = 0; y < chroma_h; y++) {
+        const unsigned char* u = planes[1] + y * chroma_w;
+        const unsigned char* v = planes[2] + y * chroma_w;
+        unsigned char* p = uv + y * even_w;
+        for (int x = 0; x < chroma_w; x++) {
+            p[x * 2] = u[x];
+            p[x * 2 + 1] = v[x];
+        }
+    }
+    return 0;
+}
+
+int jpeg_decoder_decode(jpeg_decoder_t* decoder, const unsigned char* data, unsigned long size,
+                        const jpeg_decode_param_t* param, image_buffer_t* image)
+{
+    int jpeg_width, jpeg_height, subsample, colorspace;
+    jpeg_decode_param_t default_param;
+
+    if (decoder == NULL || data == NULL || image == NULL) {
+        return -1;
+    }
+    if (param == NULL) {
+        memset(&default_param, 0, sizeof(default_param));
+        default_param.format = IMAGE_FORMAT_RGB888;
+        param = &default_param;
+    }
+
+    if (tjDecompressHeader3(decoder->handle, data, size, &jpeg_width, &jpeg_height, &subsample, &colorspace) < 0) {
+        printf("header file error, errorStr:%s, errorCode:%d\n", tjGetErrorStr2(decoder->handle),
+               tjGetErrorCode(decoder->handle));
+        return -1;
+    }
+
+    int min_width = param->min_width;
+    int min_height = param->min_height;
+    if (param->letterbox_fit && min_width > 0 && min_height > 0) {
+        // e.g. 1920x1080 into 640x640 only needs 640x360
+        float scale_w = (float)min_width / jpeg_width;
+        float scale_h = (float)min_height / jpeg_height;
+        float scale = scale_w < scale_h ? scale_w : scale_h;
+        min_width = (int)(jpeg_width * scale + 0.5f);
+        min_height = (int)(jpeg_height * scale + 0.5f);
+    }
+    int denom = jpeg_decoder_scale_denom(jpeg_width, jpeg_height, min_width, min_height);
+    tjscalingfactor sf = {1, denom};
+    int width = TJSCALED(jpeg_width, sf);
+    int height = TJSCALED(jpeg_height, sf);
+    int flags = param->fast_dct ? (TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) : 0;
+
+    image_buffer_t out;
+    memset(&out, 0, sizeof(image_buffer_t));
+    out.format = param->format;
+    switch (param->format) {
+    case IMAGE_FORMAT_RGB888:
+    case IMAGE_FORMAT_GRAY8:
+        out.width = width;
+        out.height = height;
+        break;
+    case IMAGE_FORMAT_YUV420SP_NV12:
+        if (subsample != TJSAMP_420) {
+            printf("jpeg decoder: NV12 output needs 4:2:0 jpeg, got subsampling %d\n", subsample);
+            return -1;
+        }
+        out.width = (width + 1) & ~1;
+        out.height = (height + 1) & ~1;
+        break;
+    default:
+        printf("jpeg decoder: no support format %d\n", param->format);
+        return -1;
+    }
+    int out_size = param->format == IMAGE_FORMAT_RGB888   ? out.width * out.height * 3
+                   : param->format == IMAGE_FORMAT_GRAY8 ? out.width * out.height
+                                                          : out.width * out.height * 3 / 2;
+
+    if (image->virt_addr != NULL && image->size >= out_size) {
+        out.virt_addr = image->virt_addr;
+        out.fd = image->fd;
+    } else {
+        out.virt_addr = pool_get(decoder, out_size);
+        if (out.virt_addr == NULL) {
+            return -1;
+        }
+    }
+    out.size = out_size;
+
+    int ret = 0;
+    if (param->format == IMAGE_FORMAT_YUV420SP_NV12) {
+        ret = decode_nv12(decoder, data, size, width, height, flags, out.virt_addr);
+    } else {
+        int pixel_format = param->format == IMAGE_FORMAT_RGB888 ? TJPF_RGB : TJPF_GRAY;
+        // error code 0 with ret < 0 is only a warning
+        if (tjDecompress2(decoder->handle, data, size, out.virt_addr, width, 0, height, pixel_format, flags) < 0 &&
+            tjGetErrorCode(decoder->handle) != TJERR_WARNING) {
+            printf("error : decompress fail, errorStr:%s, errorCode:%d\n", tjGetErrorStr2(decoder->handle),
+                   tjGetErrorCode(decoder->handle));
+            ret = -1;
+        }
+    }
+    if (ret != 0) {
+        if (out.virt_addr != image->virt_addr) {
+            jpeg_decoder_release(decoder, &out);
+        }
+        return -1;
+    }
+
+    pthread_mutex_lock(&decoder->lock);
+    decoder->stats.images++;
+    pthread_mutex_unlock(&decoder->lock);
+    *image = out;
+    return 0;
+}
+
+int jpeg_decoder_decode_file(jpeg_decoder_t* decoder, const char* path, const jpeg_decode_param_t* param,
+                             image_buffer_t* image)
+{
+    struct stat st;
+    if (decoder == NULL || path == NULL) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("open %s fail\n", path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        printf("%s contains no data\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (grow_buffer(&decoder->file_buf, &decoder->file_capacity, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, decoder->file_buf + done, size - done);
+        if (n <= 0) {
+            printf("read %s fail\n", path);
+            close(fd);
+            return -1;
+        }
+        done += n;
+    }
+    close(fd);
+    return jpeg_decoder_decode(decoder, decoder->file_buf, size, param, image);
+}
+
+void jpeg_decoder_get_stats(jpeg_decoder_t* decoder, jpeg_decoder_stats_t* stats)
+{
+    pthread_mutex_lock(&decoder->lock);
+    *stats = decoder->stats;
+    pthread_mutex_unlock(&decoder->lock);
+}
@@ -0,0 +1,115 @@
+#ifndef _RKNN_MODEL_ZOO_JPEG_DECODER_H_
+#define _RKNN_MODEL_ZOO_JPEG_DECODER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+
+/**
+ * @brief Reusable JPEG decoder
+ *
+ * Keeps one turbojpeg handle, the file read buffer and a pool of output buffers across images.
+ * A decoder must only be used by one thread at a time, jpeg_decoder_release() may be called
+ * from any thread.
+ */
+typedef struct jpeg_decoder jpeg_decoder_t;
+
+/**
+ * @brief Decode parameters
+ *
+ */
+typedef struct {
+    image_format_t format;  // IMAGE_FORMAT_RGB888, IMAGE_FORMAT_GRAY8 or IMAGE_FORMAT_YUV420SP_NV12 (4:2:0 jpeg only)
+    int min_width;          // decode with the largest DCT scaling (1/2, 1/4, 1/8) that keeps at least this size, 0: full size
+    int min_height;
+    int fast_dct;           // use the fast (less accurate) IDCT and upsampling
+    int letterbox_fit;      // min_width x min_height is a letterbox target, only the fitted size must be kept
+} jpeg_decode_param_t;
+
+/**
+ * @brief Decoder statistics
+ *
+ */
+typedef struct {
+    long images;
+    long pool_hits;         // output buffers reused from the pool
+    long pool_misses;       // output buffers newly allocated
+} jpeg_decoder_stats_t;
+
+/**
+ * @brief Create a decoder
+ *
+ * @param pool_size [in] Max number of output buffers kept for reuse, 0: no pool
+ * @return jpeg_decoder_t* Decoder, NULL on error
+ */
+jpeg_decoder_t* jpeg_decoder_create(int pool_size);
+
+/**
+ * @brief Destroy a decoder, buffers still held by images are freed too
+ *
+ * @param decoder [in] Decoder
+ */
+void jpeg_decoder_destroy(jpeg_decoder_t* decoder);
+
+/**
+ * @brief Get the DCT scaling denominator (1, 2, 4 or 8) for an image size
+ *
+ * @param width [in] JPEG width
+ * @param height [in] JPEG height
+ * @param min_width [in] Min decoded width, 0: no limit, both 0: full size
+ * @param min_height [in] Min decoded height, 0: no limit, both 0: full size
+ * @return int Denominator, the image is decoded at 1/denominator of its size
+ */
+int jpeg_decoder_scale_denom(int width, int height, int min_width, int min_height);
+
+/**
+ * @brief Decode JPEG data in memory
+ *
+ * If image->virt_addr is set and image->size is large enough the pixels are written there,
+ * otherwise the buffer comes from the pool and must be returned with jpeg_decoder_release().
+ *
+ * @param decoder [in] Decoder
+ * @param data [in] JPEG data
+ * @param size [in] JPEG data size
+ * @param param [in] Decode parameters, NULL: full size RGB888
+ * @param image [out] Decoded image
+ * @return int 0: success; -1: error
+ */
+int jpeg_decoder_decode(jpeg_decoder_t* decoder, const unsigned char* data, unsigned long size,
+                        const jpeg_decode_param_t* param, image_buffer_t* image);
+
+/**
+ * @brief Read and decode a JPEG file, see jpeg_decoder_decode()
+ *
+ * @param decoder [in] Decoder
+ * @param path [in] File path
+ * @param param [in] Decode parameters, NULL: full size RGB888
+ * @param image [out] Decoded image
+ * @return int 0: success; -1: error
+ */
+int jpeg_decoder_decode_file(jpeg_decoder_t* decoder, const char* path, const jpeg_decode_param_t* param,
+                             image_buffer_t* image);
+
+/**
+ * @brief Return the buffer of a decoded image to the pool
+ *
+ * @param decoder [in] Decoder
+ * @param image [in] Image, virt_addr is reset
+ */
+void jpeg_decoder_release(jpeg_decoder_t* decoder, image_buffer_t* image);
+
+/**
+ * @brief Get decoder statistics
+ *
+ * @param decoder [in] Decoder
+ * @param stats [out] Statistics
+ */
+void jpeg_decoder_get_stats(jpeg_decoder_t* decoder, jpeg_decoder_stats_t* stats);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_JPEG_DECODER_H_
@@ -0,0 +1,848 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jpeg_decoder.h"
+#include "v4l2_capture.h"
+
+struct capture_buffer {
+    v4l2_frame_t frame;         // first member, v4l2_frame_t* points to the capture_buffer
+    v4l2_capture_t* capture;
+    void* map;                  // replay: the MJPEG decode buffer, NULL for raw frames
+    size_t length;
+    std::atomic<int> refs;
+};
+
+struct capture_replay {
+    unsigned char* map;         // private mapping of the whole file
+    size_t size;
+    std::vector<size_t> offsets;        // frame start in the file
+    std::vector<size_t> sizes;          // encoded size of MJPEG frames
+    std::vector<int64_t> timestamps_us; // recorded, relative to the first frame
+    int64_t pass_us;            // length of one pass, the last frame lasts one frame interval
+    jpeg_decoder_t* decoder;    // NULL for raw frames
+    jpeg_decode_param_t param;
+    bool realtime;
+    int loops;
+    uint64_t next;              // next frame, counted over all passes
+    int64_t start_us;           // when frame 0 was due
+    std::condition_variable released;
+};
+
+struct v4l2_capture {
+    int fd;
+    enum v4l2_buf_type type;
+    image_buffer_t format;
+    std::vector<capture_buffer*> buffers;
+
+    std::mutex mutex;           // streaming state and statistics
+    bool streaming;
+    int held;
+    int64_t last_sequence;
+    uint64_t frames;
+    uint64_t dropped;
+    uint64_t latency_count;
+    double latency_sum_ms;
+    double latency_max_ms;
+    uint64_t hold_count;
+    double hold_sum_ms;
+
+    capture_replay* replay;     // a recording instead of a device
+    FILE* record;               // V4L2_CAPTURE_RECORD: raw frames and their timestamps
+    FILE* record_ts;
+};
+
+static int xioctl(int fd, unsigned long request, void* arg)
+{
+    int ret;
+    do {
+        ret = ioctl(fd, request, arg);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+static int64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool is_mplane(v4l2_capture_t* capture)
+{
+    return capture->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+}
+
+static int to_image_format(uint32_t pixel_format, image_format_t* format)
+{
+    switch (pixel_format) {
+    case V4L2_PIX_FMT_NV12:
+        *format = IMAGE_FORMAT_YUV420SP_NV12;
+        return 0;
+    case V4L2_PIX_FMT_NV21:
+        *format = IMAGE_FORMAT_YUV420SP_NV21;
+        return 0;
+    case V4L2_PIX_FMT_RGB24:
+        *format = IMAGE_FORMAT_RGB888;
+        return 0;
+    case V4L2_PIX_FMT_GREY:
+        *format = IMAGE_FORMAT_GRAY8;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+// Size of a frame without row or plane padding, as recordings are stored
+static size_t packed_size(int width, int height, image_format_t format)
+{
+    switch (format) {
+    case IMAGE_FORMAT_YUV420SP_NV12:
+    case IMAGE_FORMAT_YUV420SP_NV21:
+        return (size_t)width * height * 3 / 2;
+    case IMAGE_FORMAT_RGB888:
+        return (size_t)width * height * 3;
+    default:
+        return (size_t)width * height;
+    }
+}
+
+static void write_packed(FILE* fp, const image_buffer_t* image)
+{
+    int bpp = image->format == IMAGE_FORMAT_RGB888 ? 3 : 1;
+    size_t stride = (size_t)image->width_stride * bpp;
+    size_t row = (size_t)image->width * bpp;
+    for (int y = 0; y < image->height; y++) {
+        fwrite(image->virt_addr + y * stride, 1, row, fp);
+    }
+    if (image->format == IMAGE_FORMAT_YUV420SP_NV12 || image->format == IMAGE_FORMAT_YUV420SP_NV21) {
+        const unsigned char* uv = image->virt_addr + stride * image->height_stride;
+        for (int y = 0; y < image->height / 2; y++) {
+            fwrite(uv + y * stride, 1, row, fp);
+        }
+    }
+}
+
+static int queue_buffer(v4l2_capture_t* capture, int index)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type = capture->type;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (is_mplane(capture)) {
+        buf.m.planes = planes;
+        buf.length = 1;
+    }
+    if (xioctl(capture->fd, VIDIOC_QBUF, &buf) < 0) {
+        printf("VIDIOC_QBUF %d fail! %s\n", index, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int set_format(v4l2_capture_t* capture, v4l2_capture_config_t* config)
+{
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = capture->type;
+    if (is_mplane(capture)) {
+        fmt.fmt.pix_mp.width = config->width;
+        fmt.fmt.pix_mp.height = config->height;
+        fmt.fmt.pix_mp.pixelformat = config->pixel_format;
+        fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+        fmt.fmt.pix_mp.num_planes = 1;
+    } else {
+        fmt.fmt.pix.width = config->width;
+        fmt.fmt.pix.height = config->height;
+        fmt.fmt.pix.pixelformat = config->pixel_format;
+        fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    }
+    if (xioctl(capture->fd, VIDIOC_S_FMT, &fmt) < 0) {
+        printf("VIDIOC_S_FMT fail! %s\n", strerror(errno));
+        return -1;
+    }
+
+    uint32_t pixel_format, bytesperline, sizeimage;
+    int width, height;
+    if (is_mplane(capture)) {
+        if (fmt.fmt.pix_mp.num_planes != 1) {
+            printf("v4l2 capture: %d planes, only single plane formats are supported\n", fmt.fmt.pix_mp.num_planes);
+            return -1;
+        }
+        pixel_format = fmt.fmt.pix_mp.pixelformat;
+        width = fmt.fmt.pix_mp.width;
+        height = fmt.fmt.pix_mp.height;
+        bytesperline = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+        sizeimage = fmt.fmt.pix_mp.plane_fmt[0].sizeimage;
+    } else {
+        pixel_format = fmt.fmt.pix.pixelformat;
+        width = fmt.fmt.pix.width;
+        height = fmt.fmt.pix.height;
+        bytesperline = fmt.fmt.pix.bytesperline;
+        sizeimage = fmt.fmt.pix.sizeimage;
+    }
+    if (pixel_format != config->pixel_format || to_image_format(pixel_format, &capture->format.format) != 0) {
+        printf("v4l2 capture: pixel format %.4s not supported\n", (char*)&config->pixel_format);
+        return -1;
+    }
+
+    capture->format.width = width;
+    capture->format.height = height;
+    capture->format.width_stride = capture->format.format == IMAGE_FORMAT_RGB888 ? bytesperline / 3 : bytesperline;
+    capture->format.height_stride = height;
+    if (capture->format.format == IMAGE_FORMAT_YUV420SP_NV12 || capture->format.format == IMAGE_FORMAT_YUV420SP_NV21) {
+        // some drivers align the chroma plane to more lines than the image has
+        int lines = bytesperline > 0 ? sizeimage * 2 / 3 / bytesperline : 0;
+        if (lines > height) {
+            capture->format.height_stride = lines;
+        }
+    }
+    capture->format.size = sizeimage;
+    capture->format.virt_addr = NULL;
+    capture->format.fd = -1;
+
+    if (config->fps > 0) {
+        struct v4l2_streamparm parm;
+        memset(&parm, 0, sizeof(parm));
+        parm.type = capture->type;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = config->fps;
+        if (xioctl(capture->fd, VIDIOC_S_PARM, &parm) < 0) {
+            printf("VIDIOC_S_PARM %d fps fail, keep the driver frame rate: %s\n", config->fps, strerror(errno));
+        }
+    }
+    return 0;
+}
+
+static int setup_buffers(v4l2_capture_t* capture, int num_buffers)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = num_buffers;
+    req.type = capture->type;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(capture->fd, VIDIOC_REQBUFS, &req) < 0) {
+        printf("VIDIOC_REQBUFS fail! %s\n", strerror(errno));
+        return -1;
+    }
+    if (req.count < 2) {
+        printf("v4l2 capture: only %d buffers\n", req.count);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < req.count; i++) {
+        struct v4l2_buffer buf;
+        struct v4l2_plane planes[VIDEO_MAX_PLANES];
+        memset(&buf, 0, sizeof(buf));
+        memset(planes, 0, sizeof(planes));
+        buf.type = capture->type;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (is_mplane(capture)) {
+            buf.m.planes = planes;
+            buf.length = 1;
+        }
+        if (xioctl(capture->fd, VIDIOC_QUERYBUF, &buf) < 0) {
+            printf("VIDIOC_QUERYBUF %d fail! %s\n", i, strerror(errno));
+            return -1;
+        }
+        size_t length = is_mplane(capture) ? planes[0].length : buf.length;
+        off_t offset = is_mplane(capture) ? planes[0].m.mem_offset : buf.m.offset;
+
+        capture_buffer* buffer = new capture_buffer();
+        buffer->capture = capture;
+        buffer->refs = 0;
+        buffer->length = length;
+        buffer->map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, capture->fd, offset);
+        buffer->frame.image = capture->format;
+        buffer->frame.image.fd = -1;
+        buffer->frame.index = i;
+        capture->buffers.push_back(buffer);
+        if (buffer->map == MAP_FAILED) {
+            buffer->map = NULL;
+            printf("mmap buffer %d fail! %s\n", i, strerror(errno));
+            return -1;
+        }
+        buffer->frame.image.virt_addr = (unsigned char*)buffer->map;
+
+        // the DMABUF goes to RGA and the NPU without a copy
+        struct v4l2_exportbuffer expbuf;
+        memset(&expbuf, 0, sizeof(expbuf));
+        expbuf.type = capture->type;
+        expbuf.index = i;
+        expbuf.plane = 0;
+        expbuf.flags = O_RDWR | O_CLOEXEC;
+        if (xioctl(capture->fd, VIDIOC_EXPBUF, &expbuf) == 0) {
+            buffer->frame.image.fd = expbuf.fd;
+        } else if (i == 0) {
+            printf("VIDIOC_EXPBUF fail, frames only have a virtual address: %s\n", strerror(errno));
+        }
+    }
+    return 0;
+}
+
+// MJPEG: every frame runs from its SOI marker to the EOI marker. Inside the entropy coded data
+// 0xFF is always followed by 0x00 or a restart marker, so the first EOI ends the frame.
+static int index_mjpeg(capture_replay* replay)
+{
+    const unsigned char* data = replay->map;
+    size_t pos = 0;
+    while (pos + 4 <= replay->size) {
+        if (data[pos] != 0xFF || data[pos + 1] != 0xD8) {
+            printf("v4l2 replay: no JPEG image at offset %zu\n", pos);
+            return replay->offsets.empty() ? -1 : 0;
+        }
+        size_t end = pos + 2;
+        while (end + 1 < replay->size && !(data[end] == 0xFF && data[end + 1] == 0xD9)) {
+            end++;
+        }
+        if (end + 1 >= replay->size) {
+            printf("v4l2 replay: truncated JPEG image at offset %zu\n", pos);
+            break;
+        }
+        replay->offsets.push_back(pos);
+        replay->sizes.push_back(end + 2 - pos);
+        pos = end + 2;
+    }
+    return replay->offsets.empty() ? -1 : 0;
+}
+
+// <path>.ts, one timestamp in microseconds per frame, otherwise frames fps apart
+static void load_timestamps(capture_replay* replay, const char* path, int fps)
+{
+    size_t frames = replay->offsets.size();
+    std::string ts_path = std::string(path) + ".ts";
+    FILE* fp = fopen(ts_path.c_str(), "r");
+    if (fp != NULL) {
+        long long ts;
+        while (replay->timestamps_us.size() < frames && fscanf(fp, "%lld", &ts) == 1) {
+            replay->timestamps_us.push_back(ts);
+        }
+        fclose(fp);
+        if (replay->timestamps_us.size() != frames) {
+            printf("v4l2 replay: %s has %zu timestamps for %zu frames, using %d fps\n", ts_path.c_str(),
+                   replay->timestamps_us.size(), frames, fps);
+            replay->timestamps_us.clear();
+        }
+    }
+    int64_t interval_us = 1000000 / fps;
+    if (replay->timestamps_us.empty()) {
+        for (size_t i = 0; i < frames; i++) {
+            replay->timestamps_us.push_back(i * interval_us);
+        }
+    } else {
+        int64_t first = replay->timestamps_us[0];
+        for (size_t i = 0; i < frames; i++) {
+            replay->timestamps_us[i] -= first;
+        }
+        if (frames > 1) {
+            interval_us = replay->timestamps_us[frames - 1] / (int64_t)(frames - 1);
+        }
+    }
+    replay->pass_us = replay->timestamps_us[frames - 1] + interval_us;
+}
+
+static v4l2_capture_t* open_replay(const char* path, v4l2_capture_config_t* config)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("open %s fail! %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    void* map = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("mmap %s fail! %s\n", path, st.st_size > 0 ? strerror(errno) : "empty file");
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    v4l2_capture_t* capture = new v4l2_capture_t();
+    capture->fd = -1;
+    capture_replay* replay = new capture_replay();
+    capture->replay = replay;
+    replay->map = (unsigned char*)map;
+    replay->size = st.st_size;
+    replay->realtime = config->replay_realtime != 0;
+    replay->loops = config->replay_loops;
+
+    image_buffer_t* format = &capture->format;
+    if (to_image_format(config->pixel_format, &format->format) != 0) {
+        printf("v4l2 replay: pixel format %.4s not supported\n", (char*)&config->pixel_format);
+        v4l2_capture_close(capture);
+        return NULL;
+    }
+    bool mjpeg = replay->size >= 2 && replay->map[0] == 0xFF && replay->map[1] == 0xD8;
+    if (mjpeg) {
+        replay->decoder = jpeg_decoder_create(0);
+        replay->param.format = format->format;
+        replay->param.min_width = config->width;
+        replay->param.min_height = config->height;
+        image_buffer_t first;
+        memset(&first, 0, sizeof(image_buffer_t));
+        if (replay->decoder == NULL || index_mjpeg(replay) != 0 ||
+            jpeg_decoder_decode(replay->decoder, replay->map, replay->sizes[0], &replay->param, &first) != 0) {
+            printf("v4l2 replay: %s is not a MJPEG stream that decodes to %.4s\n", path, (char*)&config->pixel_format);
+            v4l2_capture_close(capture);
+            return NULL;
+        }
+        format->width = first.width;
+        format->height = first.height;
+        jpeg_decoder_release(replay->decoder, &first);
+    } else {
+        format->width = config->width;
+        format->height = config->height;
+        size_t frame_size = packed_size(config->width, config->height, format->format);
+        if (frame_size == 0 || replay->size < frame_size) {
+            printf("v4l2 replay: %s is smaller than one %dx%d frame\n", path, config->width, config->height);
+            v4l2_capture_close(capture);
+            return NULL;
+        }
+        if (replay->size % frame_size != 0) {
+            printf("v4l2 replay: %s ends with a partial frame, ignored\n", path);
+        }
+        for (size_t offset = 0; offset + frame_size <= replay->size; offset += frame_size) {
+            replay->offsets.push_back(offset);
+        }
+    }
+    format->width_stride = format->width;
+    format->height_stride = format->height;
+    format->size = packed_size(format->width, format->height, format->format);
+    format->virt_addr = NULL;
+    format->fd = -1;
+    load_timestamps(replay, path, config->fps > 0 ? config->fps : 30);
+
+    int num_buffers = config->num_buffers > 2 ? config->num_buffers : 2;
+    for (int i = 0; i < num_buffers; i++) {
+        capture_buffer* buffer = new capture_buffer();
+        buffer->capture = capture;
+        buffer->refs = 0;
+        buffer->frame.image = capture->format;
+        buffer->frame.index = i;
+        capture->buffers.push_back(buffer);
+        if (mjpeg) {
+            buffer->length = format->size;
+            buffer->map = malloc(buffer->length);
+            buffer->frame.image.virt_addr = (unsigned char*)buffer->map;
+            if (buffer->map == NULL) {
+                printf("v4l2 replay: alloc decode buffer size:%zu fail!\n", buffer->length);
+                v4l2_capture_close(capture);
+                return NULL;
+            }
+        }
+    }
+    printf("v4l2 replay %s: %dx%d %.4s%s, %zu frames, %.1f fps, %s\n", path, format->width, format->height,
+           (char*)&config->pixel_format, mjpeg ? " from MJPEG" : "", replay->offsets.size(),
+           replay->offsets.size() * 1e6 / replay->pass_us, replay->realtime ? "realtime" : "as fast as released");
+    return capture;
+}
+
+// Next free buffer and, for realtime replay, the frame due now; frames the consumer is late for
+// are skipped and show up as sequence gaps.
+static int replay_dequeue(v4l2_capture_t* capture, v4l2_frame_t** frame, int timeout_ms)
+{
+    capture_replay* replay = capture->replay;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    uint64_t count = replay->offsets.size();
+    uint64_t end = replay->loops > 0 ? count * replay->loops : UINT64_MAX;
+
+    std::unique_lock<std::mutex> lock(capture->mutex);
+    capture_buffer* buffer = NULL;
+    for (;;) {
+        if (!capture->streaming) {
+            printf("v4l2 replay: dequeue while stopped\n");
+            return -1;
+        }
+        if (replay->next >= end) {
+            return -3;
+        }
+        for (size_t i = 0; i < capture->buffers.size() && buffer == NULL; i++) {
+            if (capture->buffers[i]->refs == 0) {
+                buffer = capture->buffers[i];
+            }
+        }
+        if (buffer != NULL) {
+            break;
+        }
+        if (timeout_ms < 0) {
+            replay->released.wait(lock);
+        } else if (replay->released.wait_until(lock, deadline) == std::cv_status::timeout) {
+            return -2;
+        }
+    }
+
+    uint64_t n = replay->next;
+    int64_t now_us = monotonic_us();
+    if (replay->start_us == 0) {
+        replay->start_us = now_us;
+    }
+    int64_t due_us = now_us;
+    if (replay->realtime) {
+        auto due = [&](uint64_t i) {
+            return replay->start_us + (int64_t)(i / count) * replay->pass_us + replay->timestamps_us[i % count];
+        };
+        while (n + 1 < end && due(n + 1) <= now_us) {
+            n++;
+        }
+        due_us = due(n);
+        if (due_us > now_us) {
+            // only this thread takes buffers, the one found stays free
+            lock.unlock();
+            int64_t wait_us = due_us - now_us;
+            if (timeout_ms >= 0 && wait_us > (int64_t)timeout_ms * 1000) {
+                std::this_thread::sleep_until(deadline);
+                return -2;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+            lock.lock();
+        }
+    }
+    replay->next = n + 1;
+    buffer->refs = 1;
+    capture->held++;
+    lock.unlock();
+
+    size_t index = n % count;
+    image_buffer_t* image = &buffer->frame.image;
+    if (replay->decoder != NULL) {
+        image->virt_addr = (unsigned char*)buffer->map;
+        image->size = buffer->length;
+        if (jpeg_decoder_decode(replay->decoder, replay->map + replay->offsets[index], replay->sizes[index],
+                                &replay->param, image) != 0 ||
+            image->width != capture->format.width || image->height != capture->format.height) {
+            printf("v4l2 replay: decode frame %zu fail!\n", index);
+            v4l2_frame_release(&buffer->frame);
+            return -1;
+        }
+        *image = capture->format;
+        image->virt_addr = (unsigned char*)buffer->map;
+    } else {
+        image->virt_addr = replay->map + replay->offsets[index];
+    }
+    buffer->frame.sequence = (uint32_t)n;
+    buffer->frame.timestamp_us = due_us;
+    buffer->frame.dequeue_us = monotonic_us();
+
+    lock.lock();
+    capture->frames++;
+    if (capture->last_sequence >= 0 && (int64_t)n > capture->last_sequence + 1) {
+        capture->dropped += n - capture->last_sequence - 1;
+    }
+    capture->last_sequence = n;
+    double latency_ms = (buffer->frame.dequeue_us - due_us) / 1000.0;
+    capture->latency_count++;
+    capture->latency_sum_ms += latency_ms;
+    if (latency_ms > capture->latency_max_ms) {
+        capture->latency_max_ms = latency_ms;
+    }
+    *frame = &buffer->frame;
+    return 0;
+}
+
+void v4l2_capture_config_default(v4l2_capture_config_t* config)
+{
+    config->width = 1920;
+    config->height = 1080;
+    config->pixel_format = V4L2_PIX_FMT_NV12;
+    config->fps = 0;
+    config->num_buffers = 4;
+    config->replay_realtime = 1;
+    config->replay_loops = 1;
+}
+
+v4l2_capture_t* v4l2_capture_open(const char* device, v4l2_capture_config_t* config)
+{
+    struct stat st;
+    if (stat(device, &st) == 0 && S_ISREG(st.st_mode)) {
+        return open_replay(device, config);
+    }
+
+    int fd = open(device, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        printf("open %s fail! %s\n", device, strerror(errno));
+        return NULL;
+    }
+
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (xioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
+        printf("VIDIOC_QUERYCAP %s fail! %s\n", device, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_STREAMING) || !(caps & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE))) {
+        printf("%s (%s) is not a streaming capture device\n", device, cap.card);
+        close(fd);
+        return NULL;
+    }
+
+    v4l2_capture_t* capture = new v4l2_capture_t();
+    capture->fd = fd;
+    // the rkisp and rkcif video nodes are multi-planar only
+    capture->type = (caps & V4L2_CAP_VIDEO_CAPTURE) ? V4L2_BUF_TYPE_VIDEO_CAPTURE : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    capture->streaming = false;
+    capture->held = 0;
+    if (set_format(capture, config) != 0 || setup_buffers(capture, config->num_buffers) != 0) {
+        v4l2_capture_close(capture);
+        return NULL;
+    }
+    printf("v4l2 capture %s (%s): %dx%d %.4s, %d buffers, %s\n", device, cap.card, capture->format.width,
+           capture->format.height, (char*)&config->pixel_format, (int)capture->buffers.size(),
+           capture->buffers[0]->frame.image.fd >= 0 ? "dmabuf" : "mmap");
+
+    const char* record_path = getenv("V4L2_CAPTURE_RECORD");
+    if (record_path != NULL) {
+        capture->record = fopen(record_path, "wb");
+        capture->record_ts = fopen((std::string(record_path) + ".ts").c_str(), "w");
+        if (capture->record == NULL || capture->record_ts == NULL) {
+            printf("open %s fail, not recording! %s\n", record_path, strerror(errno));
+        } else {
+            printf("v4l2 capture: recording to %s\n", record_path);
+        }
+    }
+    return capture;
+}
+
+int v4l2_capture_get_format(v4l2_capture_t* capture, image_buffer_t* format)
+{
+    if (capture == NULL || format == NULL) {
+        return -1;
+    }
+    *format = capture->format;
+    return 0;
+}
+
+int v4l2_capture_start(v4l2_capture_t* capture)
+{
+    std::lock_guard<std::mutex> lock(capture->mutex);
+    if (capture->streaming) {
+        return 0;
+    }
+    if (capture->replay != NULL) {
+        // a replay starts over from its first frame
+        capture->replay->next = 0;
+        capture->replay->start_us = 0;
+    }
+    for (size_t i = 0; i < capture->buffers.size() && capture->replay == NULL; i++) {
+        if (capture->buffers[i]->refs == 0 && queue_buffer(capture, i) != 0) {
+            return -1;
+        }
+    }
+    int type = capture->type;
+    if (capture->replay == NULL && xioctl(capture->fd, VIDIOC_STREAMON, &type) < 0) {
+        printf("VIDIOC_STREAMON fail! %s\n", strerror(errno));
+        return -1;
+    }
+    capture->streaming = true;
+    capture->last_sequence = -1;
+    capture->frames = 0;
+    capture->dropped = 0;
+    capture->latency_count = 0;
+    capture->latency_sum_ms = 0;
+    capture->latency_max_ms = 0;
+    capture->hold_count = 0;
+    capture->hold_sum_ms = 0;
+    return 0;
+}
+
+int v4l2_capture_dequeue(v4l2_capture_t* capture, v4l2_frame_t** frame, int timeout_ms)
+{
+    if (capture->replay != NULL) {
+        return replay_dequeue(capture, frame, timeout_ms);
+    }
+    struct pollfd pfd;
+    pfd.fd = capture->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        printf("poll v4l2 capture fail! %s\n", strerror(errno));
+        return -1;
+    }
+    if (ret == 0) {
+        return -2;
+    }
+
+    struct v4l2_buffer buf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type = capture->type;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (is_mplane(capture)) {
+        buf.m.planes = planes;
+        buf.length = 1;
+    }
+    if (xioctl(capture->fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (errno == EAGAIN) {
+            return -2;
+        }
+        printf("VIDIOC_DQBUF fail! %s\n", strerror(errno));
+        return -1;
+    }
+    int64_t now_us = monotonic_us();
+
+    capture_buffer* buffer = capture->buffers[buf.index];
+    uint32_t bytesused = is_mplane(capture) ? planes[0].bytesused : buf.bytesused;
+    buffer->frame.image.size = bytesused > 0 ? bytesused : capture->format.size;
+    buffer->frame.sequence = buf.sequence;
+    buffer->frame.timestamp_us = (int64_t)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+    buffer->frame.dequeue_us = now_us;
+    buffer->refs = 1;
+    if (capture->record != NULL && capture->record_ts != NULL) {
+        write_packed(capture->record, &buffer->frame.image);
+        fprintf(capture->record_ts, "%lld\n", (long long)buffer->frame.timestamp_us);
+    }
+
+    std::lock_guard<std::mutex> lock(capture->mutex);
+    capture->held++;
+    capture->frames++;
+    if (capture->last_sequence >= 0 && buf.sequence > capture->last_sequence + 1) {
+        capture->dropped += buf.sequence - capture->last_sequence - 1;
+    }
+    capture->last_sequence = buf.sequence;
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        double latency_ms = (now_us - buffer->frame.timestamp_us) / 1000.0;
+        capture->latency_count++;
+        capture->latency_sum_ms += latency_ms;
+        if (latency_ms > capture->latency_max_ms) {
+            capture->latency_max_ms = latency_ms;
+        }
+    }
+    *frame = &buffer->frame;
+    return 0;
+}
+
+void v4l2_frame_ref(v4l2_frame_t* frame)
+{
+    ((capture_buffer*)frame)->refs.fetch_add(1);
+}
+
+void v4l2_frame_release(v4l2_frame_t* frame)
+{
+    if (frame == NULL) {
+        return;
+    }
+    capture_buffer* buffer = (capture_buffer*)frame;
+    if (buffer->refs.fetch_sub(1) != 1) {
+        return;
+    }
+    v4l2_capture_t* capture = buffer->capture;
+    std::lock_guard<std::mutex> lock(capture->mutex);
+    capture->held--;
+    capture->hold_count++;
+    capture->hold_sum_ms += (monotonic_us() - frame->dequeue_us) / 1000.0;
+    // back to the driver, after a stop v4l2_capture_start() queues it
+    if (capture->replay != NULL) {
+        capture->replay->released.notify_one();
+    } else if (capture->streaming) {
+        queue_buffer(capture, frame->index);
+    }
+}
+
+int v4l2_capture_stop(v4l2_capture_t* capture)
+{
+    std::lock_guard<std::mutex> lock(capture->mutex);
+    if (!capture->streaming) {
+        return 0;
+    }
+    capture->streaming = false;
+    if (capture->replay != NULL) {
+        capture->replay->released.notify_all();
+        return 0;
+    }
+    int type = capture->type;
+    if (xioctl(capture->fd, VIDIOC_STREAMOFF, &type) < 0) {
+        printf("VIDIOC_STREAMOFF fail! %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void v4l2_capture_get_stats(v4l2_capture_t* capture, v4l2_capture_stats_t* stats)
+{
+    std::lock_guard<std::mutex> lock(capture->mutex);
+    stats->frames = capture->frames;
+    stats->dropped = capture->dropped;
+    stats->latency_avg_ms = capture->latency_count > 0 ? capture->latency_sum_ms / capture->latency_count : 0;
+    stats->latency_max_ms = capture->latency_max_ms;
+    stats->hold_avg_ms = capture->hold_count > 0 ? capture->hold_sum_ms / capture->hold_count : 0;
+    stats->held = capture->held;
+}
+
+void v4l2_capture_close(v4l2_capture_t* capture)
+{
+    if (capture == NULL) {
+        return;
+    }
+    v4l2_capture_stop(capture);
+    if (capture->held > 0) {
+        printf("v4l2 capture closed with %d frames still held\n", capture->held);
+    }
+    for (size_t i = 0; i < capture->buffers.size(); i++) {
+        capture_buffer* buffer = capture->buffers[i];
+        if (capture->replay != NULL) {
+            free(buffer->map);
+        } else {
+            if (buffer->frame.image.fd >= 0) {
+                close(buffer->frame.image.fd);
+            }
+            if (buffer->map != NULL) {
+                munmap(buffer->map, buffer->length);
+            }
+        }
+        delete buffer;
+    }
+    if (capture->record != NULL) {
+        fclose(capture->record);
+    }
+    if (capture->record_ts != NULL) {
+        fclose(capture->record_ts);
+    }
+    if (capture->replay != NULL) {
+        capture_replay* replay = capture->replay;
+        if (replay->decoder != NULL) {
+            jpeg_decoder_destroy(replay->decoder);
+        }
+        munmap(replay->map, replay->size);
+        delete replay;
+        delete capture;
+        return;
+    }
+    if (!capture->buffers.empty()) {
+        struct v4l2_requestbuffers req;
+        memset(&req, 0, sizeof(req));
+        req.count = 0;
+        req.type = capture->type;
+        req.memory = V4L2_MEMORY_MMAP;
+        xioctl(capture->fd, VIDIOC_REQBUFS, &req);
+    }
+    close(capture->fd);
+    delete capture;
+}
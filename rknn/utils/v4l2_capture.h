@@ -0,0 +1,130 @@
+#ifndef _RKNN_MODEL_ZOO_V4L2_CAPTURE_H_
+#define _RKNN_MODEL_ZOO_V4L2_CAPTURE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * @brief V4L2 capture device streaming into driver buffers exported as DMABUF
+ *
+ * The same capture can replay a recording instead, for benchmarks that must not depend on a
+ * camera: v4l2_capture_open() on a regular file maps it and hands out its frames like a device
+ * would. Two kinds of files are read:
+ *  - raw frames of config->width x config->height in config->pixel_format, back to back, as
+ *    written with V4L2_CAPTURE_RECORD=<file> (see v4l2_capture_open())
+ *  - MJPEG, JPEG images back to back (e.g. ffmpeg -i clip.mp4 -c:v mjpeg -f mjpeg clip.mjpeg),
+ *    decoded to config->pixel_format (NV12, RGB24 or GREY) at the smallest DCT scale that keeps
+ *    config->width x config->height
+ * Frame timestamps come from <file>.ts, one CLOCK_MONOTONIC microsecond timestamp per line, and
+ * without it from config->fps (30 if 0).
+ */
+typedef struct v4l2_capture v4l2_capture_t;
+
+/**
+ * @brief Capture configuration
+ *
+ */
+typedef struct {
+    int width;                  // requested size, the driver may adjust it
+    int height;
+    uint32_t pixel_format;      // V4L2 fourcc: NV12, NV21, RGB24 or GREY (single plane)
+    int fps;                    // 0 keeps the driver default
+    int num_buffers;            // buffers the driver fills, frames held by consumers count against it
+    int replay_realtime;        // replay: 1 delivers frames at their recorded timestamps, frames the consumer
+                                // is late for are dropped like a camera does; 0 delivers every frame as soon
+                                // as a buffer is free, for deterministic runs
+    int replay_loops;           // replay: passes over the recording, 0 loops forever
+} v4l2_capture_config_t;
+
+/**
+ * @brief Captured frame
+ *
+ * image.fd is the DMABUF exported with VIDIOC_EXPBUF (-1 if the driver can not export),
+ * image.virt_addr the mmap of the same buffer. Replayed raw frames point into the private
+ * mapping of the file (fd -1, writes stay in memory), MJPEG frames into a decode buffer.
+ * Both belong to the capture: pass the frame on with v4l2_frame_ref() and give it back with
+ * v4l2_frame_release(), the buffer is queued to the driver again when the last reference is
+ * released.
+ */
+typedef struct {
+    image_buffer_t image;
+    int index;                  // driver buffer index
+    uint32_t sequence;          // driver frame counter, gaps are frames the driver dropped (replay: frame number
+                                // counted over all passes)
+    int64_t timestamp_us;       // driver timestamp, CLOCK_MONOTONIC (replay: when the frame was due)
+    int64_t dequeue_us;         // CLOCK_MONOTONIC when the frame was dequeued
+} v4l2_frame_t;
+
+/**
+ * @brief Capture statistics since v4l2_capture_start()
+ *
+ */
+typedef struct {
+    uint64_t frames;            // frames dequeued
+    uint64_t dropped;           // sequence gaps
+    double latency_avg_ms;      // driver timestamp to dequeue
+    double latency_max_ms;
+    double hold_avg_ms;         // dequeue to the last v4l2_frame_release()
+    int held;                   // frames currently held by consumers
+} v4l2_capture_stats_t;
+
+void v4l2_capture_config_default(v4l2_capture_config_t* config);
+
+/**
+ * @brief Open a capture device, set the format and allocate and export its buffers
+ *
+ * A regular file is opened as a replay (see v4l2_capture_t). With V4L2_CAPTURE_RECORD=<file> in
+ * the environment, the frames of a device are also written to <file> as packed raw frames and
+ * their timestamps to <file>.ts, ready to be replayed.
+ *
+ * @param device [in] Device path, e.g. /dev/video0, or the file to replay
+ * @param config [in] Configuration, the negotiated size is in v4l2_capture_get_format()
+ * @return v4l2_capture_t* NULL: error
+ */
+v4l2_capture_t* v4l2_capture_open(const char* device, v4l2_capture_config_t* config);
+
+/**
+ * @brief Negotiated format of the frames, virt_addr NULL and fd -1
+ *
+ */
+int v4l2_capture_get_format(v4l2_capture_t* capture, image_buffer_t* format);
+
+int v4l2_capture_start(v4l2_capture_t* capture);
+
+/**
+ * @brief Wait for the next frame
+ *
+ * One thread dequeues, any thread may release.
+ *
+ * @param capture [in] Capture
+ * @param frame [out] Frame holding one reference
+ * @param timeout_ms [in] Timeout in milliseconds, -1 waits forever
+ * @return int 0: success; -1: error; -2: timeout (also while every buffer is held by consumers);
+ *             -3: end of a replay
+ */
+int v4l2_capture_dequeue(v4l2_capture_t* capture, v4l2_frame_t** frame, int timeout_ms);
+
+void v4l2_frame_ref(v4l2_frame_t* frame);
+
+void v4l2_frame_release(v4l2_frame_t* frame);
+
+int v4l2_capture_stop(v4l2_capture_t* capture);
+
+void v4l2_capture_get_stats(v4l2_capture_t* capture, v4l2_capture_stats_t* stats);
+
+/**
+ * @brief Stop streaming and free the buffers, every frame must have been released
+ *
+ */
+void v4l2_capture_close(v4l2_capture_t* capture);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_V4L2_CAPTURE_H_
@@ -0,0 +1,468 @@
+// CPU reference backend, see get_cpu_backend_ops() in infer_backend.h.
+// Results only depend on the input (or the recording), so it can stand in for the NPU when
+// pre/post processing or scheduling is tested or profiled on a dev machine.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "infer_backend.h"
+#include "file_utils.h"
+
+#define CPU_INPUT_SIZE 640
+#define CPU_NUM_CLASS 80
+#define CPU_DFL_LEN 16
+#define CPU_NUM_BRANCH 3
+#define CPU_BOX_CH (4 * CPU_DFL_LEN)
+#define CPU_OUT_CH (CPU_BOX_CH + CPU_NUM_CLASS)
+
+static const int kStrides[CPU_NUM_BRANCH] = {8, 16, 32};
+
+typedef struct {
+    bool replay;
+    rknn_input_output_num io_num;
+    std::vector<rknn_tensor_attr> input_attrs;
+    std::vector<rknn_tensor_attr> output_attrs;
+    std::vector<uint8_t> input;
+    uint8_t* input_data;                         // the input tensor: input, or the buffer selected with select_input
+    std::vector<uint8_t*> bound;                 // buffers bound with bind_input
+    std::vector<std::vector<uint8_t> > owned;    // the bound ones the backend allocated, one per bind_input
+    std::vector<std::vector<int8_t> > outputs;
+    std::vector<std::vector<float> > outputs_float;
+    std::vector<float> pooled[CPU_NUM_BRANCH];   // per branch: grid x grid x 3, mean of the cell in [0, 1]
+    float weights[CPU_OUT_CH][3];
+    float bias[CPU_OUT_CH];
+    int64_t run_us;                              // of the last run, for RKNN_QUERY_PERF_RUN
+} cpu_backend_t;
+
+static cpu_backend_t* get_priv(infer_backend_t* backend)
+{
+    return (cpu_backend_t*)backend->priv;
+}
+
+static void set_attr(rknn_tensor_attr* attr, int index, const char* name, int c, int h, int w,
+                     rknn_tensor_format fmt, rknn_tensor_type type, int32_t zp, float scale)
+{
+    memset(attr, 0, sizeof(rknn_tensor_attr));
+    attr->index = index;
+    attr->n_dims = 4;
+    attr->dims[0] = 1;
+    if (fmt == RKNN_TENSOR_NHWC) {
+        attr->dims[1] = h;
+        attr->dims[2] = w;
+        attr->dims[3] = c;
+    } else {
+        attr->dims[1] = c;
+        attr->dims[2] = h;
+        attr->dims[3] = w;
+    }
+    snprintf(attr->name, RKNN_MAX_NAME_LEN, "%s", name);
+    attr->n_elems = c * h * w;
+    attr->size = attr->n_elems;
+    attr->size_with_stride = attr->size;
+    attr->w_stride = w;
+    attr->fmt = fmt;
+    attr->type = type;
+    attr->qnt_type = RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC;
+    attr->zp = zp;
+    attr->scale = scale;
+}
+
+/*-------------------------------------------
+          Tiny conv model
+-------------------------------------------*/
+static float lcg_uniform(unsigned int* state, float lo, float hi)
+{
+    *state = *state * 1103515245u + 12345u;
+    return lo + (hi - lo) * ((*state >> 8) & 0xffff) / 65535.0f;
+}
+
+static void build_conv_model(cpu_backend_t* b)
+{
+    b->io_num.n_input = 1;
+    b->io_num.n_output = CPU_NUM_BRANCH * 3;
+    b->input_attrs.resize(1);
+    set_attr(&b->input_attrs[0], 0, "images", 3, CPU_INPUT_SIZE, CPU_INPUT_SIZE, RKNN_TENSOR_NHWC,
+             RKNN_TENSOR_UINT8, 0, 1.0f / 255);
+
+    b->output_attrs.resize(b->io_num.n_output);
+    for (int i = 0; i < CPU_NUM_BRANCH; i++) {
+        int grid = CPU_INPUT_SIZE / kStrides[i];
+        char name[32];
+        snprintf(name, sizeof(name), "box%d", i);
+        set_attr(&b->output_attrs[i * 3], i * 3, name, CPU_BOX_CH, grid, grid, RKNN_TENSOR_NCHW, RKNN_TENSOR_INT8,
+                 -128, 0.1f);
+        snprintf(name, sizeof(name), "score%d", i);
+        set_attr(&b->output_attrs[i * 3 + 1], i * 3 + 1, name, CPU_NUM_CLASS, grid, grid, RKNN_TENSOR_NCHW,
+                 RKNN_TENSOR_INT8, -128, 1.0f / 255);
+        snprintf(name, sizeof(name), "score_sum%d", i);
+        set_attr(&b->output_attrs[i * 3 + 2], i * 3 + 2, name, 1, grid, grid, RKNN_TENSOR_NCHW, RKNN_TENSOR_INT8,
+                 -128, 1.0f / 255);
+        b->pooled[i].resize(grid * grid * 3);
+    }
+
+    // fixed weights: DFL logits around 8, class 0 fires on bright cells, the other classes stay low
+    unsigned int state = 20240101u;
+    for (int c = 0; c < CPU_OUT_CH; c++) {
+        for (int k = 0; k < 3; k++) {
+            b->weights[c][k] = c < CPU_BOX_CH ? lcg_uniform(&state, -2.0f, 2.0f) : lcg_uniform(&state, -1.0f, 1.0f);
+        }
+        b->bias[c] = c < CPU_BOX_CH ? 8.0f : -8.0f;
+    }
+    b->weights[CPU_BOX_CH][0] = 6.0f;
+    b->weights[CPU_BOX_CH][1] = 6.0f;
+    b->weights[CPU_BOX_CH][2] = 6.0f;
+    b->bias[CPU_BOX_CH] = -14.0f;
+}
+
+static int8_t quantize(float v, rknn_tensor_attr* attr)
+{
+    float q = roundf(v / attr->scale) + attr->zp;
+    return (int8_t)(q < -128 ? -128 : (q > 127 ? 127 : q));
+}
+
+// stride 8 average pool of the input, the coarser branches pool the finer one
+static void pool_input(cpu_backend_t* b)
+{
+    int grid = CPU_INPUT_SIZE / kStrides[0];
+    int stride = kStrides[0];
+    const uint8_t* in = b->input_data;
+    float* out = &b->pooled[0][0];
+    for (int gy = 0; gy < grid; gy++) {
+        for (int gx = 0; gx < grid; gx++) {
+            int sum[3] = {0, 0, 0};
+            for (int y = 0; y < stride; y++) {
+                const uint8_t* row = in + ((gy * stride + y) * CPU_INPUT_SIZE + gx * stride) * 3;
+                for (int x = 0; x < stride * 3; x += 3) {
+                    sum[0] += row[x];
+                    sum[1] += row[x + 1];
+                    sum[2] += row[x + 2];
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                out[(gy * grid + gx) * 3 + k] = sum[k] / (255.0f * stride * stride);
+            }
+        }
+    }
+    for (int i = 1; i < CPU_NUM_BRANCH; i++) {
+        int fine = grid;
+        grid /= 2;
+        const float* src = &b->pooled[i - 1][0];
+        float* dst = &b->pooled[i][0];
+        for (int gy = 0; gy < grid; gy++) {
+            for (int gx = 0; gx < grid; gx++) {
+                for (int k = 0; k < 3; k++) {
+                    dst[(gy * grid + gx) * 3 + k] =
+                        (src[((2 * gy) * fine + 2 * gx) * 3 + k] + src[((2 * gy) * fine + 2 * gx + 1) * 3 + k] +
+                         src[((2 * gy + 1) * fine + 2 * gx) * 3 + k] +
+                         src[((2 * gy + 1) * fine + 2 * gx + 1) * 3 + k]) / 4;
+                }
+            }
+        }
+    }
+}
+
+static void run_conv_model(cpu_backend_t* b)
+{
+    pool_input(b);
+    for (int i = 0; i < CPU_NUM_BRANCH; i++) {
+        rknn_tensor_attr* box_attr = &b->output_attrs[i * 3];
+        rknn_tensor_attr* score_attr = &b->output_attrs[i * 3 + 1];
+        rknn_tensor_attr* sum_attr = &b->output_attrs[i * 3 + 2];
+        int8_t* box = &b->outputs[i * 3][0];
+        int8_t* score = &b->outputs[i * 3 + 1][0];
+        int8_t* score_sum = &b->outputs[i * 3 + 2][0];
+        int grid_len = box_attr->dims[2] * box_attr->dims[3];
+        const float* f = &b->pooled[i][0];
+
+        for (int cell = 0; cell < grid_len; cell++, f += 3) {
+            float sum = 0;
+            for (int c = 0; c < CPU_OUT_CH; c++) {
+                float v = b->weights[c][0] * f[0] + b->weights[c][1] * f[1] + b->weights[c][2] * f[2] + b->bias[c];
+                if (c < CPU_BOX_CH) {
+                    box[c * grid_len + cell] = quantize(v, box_attr);
+                } else {
+                    float s = 1.0f / (1.0f + expf(-v));
+                    sum += s;
+                    score[(c - CPU_BOX_CH) * grid_len + cell] = quantize(s, score_attr);
+                }
+            }
+            score_sum[cell] = quantize(sum > 1.0f ? 1.0f : sum, sum_attr);
+        }
+    }
+}
+
+/*-------------------------------------------
+          Replay
+-------------------------------------------*/
+static int load_recording(cpu_backend_t* b, const char* dir)
+{
+    char path[512];
+    char* header = NULL;
+    snprintf(path, sizeof(path), "%s/attrs.bin", dir);
+    int len = read_data_from_file(path, &header);
+    if (len < (int)sizeof(rknn_input_output_num) || header == NULL) {
+        printf("no recording in %s\n", dir);
+        free(header);
+        return -1;
+    }
+    memcpy(&b->io_num, header, sizeof(rknn_input_output_num));
+    int n = b->io_num.n_input + b->io_num.n_output;
+    if (b->io_num.n_input != 1 || len != (int)(sizeof(rknn_input_output_num) + n * sizeof(rknn_tensor_attr))) {
+        printf("%s does not match this build\n", path);
+        free(header);
+        return -1;
+    }
+    const rknn_tensor_attr* attrs = (const rknn_tensor_attr*)(header + sizeof(rknn_input_output_num));
+    b->input_attrs.assign(attrs, attrs + b->io_num.n_input);
+    b->output_attrs.assign(attrs + b->io_num.n_input, attrs + n);
+    free(header);
+
+    b->outputs.resize(b->io_num.n_output);
+    for (uint32_t i = 0; i < b->io_num.n_output; i++) {
+        char* data = NULL;
+        snprintf(path, sizeof(path), "%s/output%d.bin", dir, i);
+        len = read_data_from_file(path, &data);
+        if (len != (int)b->output_attrs[i].size || data == NULL) {
+            printf("%s: %d bytes, expect %d\n", path, len, b->output_attrs[i].size);
+            free(data);
+            return -1;
+        }
+        b->outputs[i].assign(data, data + len);
+        free(data);
+    }
+    b->replay = true;
+    return 0;
+}
+
+/*-------------------------------------------
+          Backend
+-------------------------------------------*/
+static int cpu_backend_load(infer_backend_t* backend, const char* model_path)
+{
+    cpu_backend_t* b = new cpu_backend_t();
+    backend->priv = b;
+
+    struct stat st;
+    if (model_path != NULL && stat(model_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        if (load_recording(b, model_path) != 0) {
+            return -1;
+        }
+        printf("cpu backend: replay %s\n", model_path);
+    } else {
+        // the model file can not be run on the CPU, it is only a stand-in
+        build_conv_model(b);
+        b->outputs.resize(b->io_num.n_output);
+        for (uint32_t i = 0; i < b->io_num.n_output; i++) {
+            b->outputs[i].resize(b->output_attrs[i].size);
+        }
+        printf("cpu backend: reference conv model\n");
+    }
+    b->input.resize(b->input_attrs[0].size);
+    b->input_data = &b->input[0];
+    b->outputs_float.resize(b->io_num.n_output);
+    return 0;
+}
+
+static void cpu_backend_release(infer_backend_t* backend)
+{
+    delete get_priv(backend);
+    backend->priv = NULL;
+}
+
+static int cpu_backend_query_io_num(infer_backend_t* backend, rknn_input_output_num* io_num)
+{
+    *io_num = get_priv(backend)->io_num;
+    return 0;
+}
+
+static int cpu_backend_query_input_attr(infer_backend_t* backend, rknn_tensor_attr* attr)
+{
+    cpu_backend_t* b = get_priv(backend);
+    if (attr->index >= b->io_num.n_input) {
+        return -1;
+    }
+    *attr = b->input_attrs[attr->index];
+    return 0;
+}
+
+static int cpu_backend_query_output_attr(infer_backend_t* backend, rknn_tensor_attr* attr)
+{
+    cpu_backend_t* b = get_priv(backend);
+    if (attr->index >= b->io_num.n_output) {
+        return -1;
+    }
+    *attr = b->output_attrs[attr->index];
+    return 0;
+}
+
+static int cpu_backend_inputs_set(infer_backend_t* backend, uint32_t n_inputs, rknn_input inputs[])
+{
+    cpu_backend_t* b = get_priv(backend);
+    for (uint32_t i = 0; i < n_inputs; i++) {
+        if (inputs[i].index != 0 || inputs[i].buf == NULL || inputs[i].size != b->input.size() ||
+            (!inputs[i].pass_through && (inputs[i].type != RKNN_TENSOR_UINT8 || inputs[i].fmt != RKNN_TENSOR_NHWC))) {
+            printf("cpu backend: only a %d byte uint8 NHWC input is supported\n", (int)b->input.size());
+            return -1;
+        }
+        if (inputs[i].buf != b->input_data) {
+            memcpy(b->input_data, inputs[i].buf, inputs[i].size);
+        }
+    }
+    return 0;
+}
+
+static int cpu_backend_run(infer_backend_t* backend)
+{
+    cpu_backend_t* b = get_priv(backend);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!b->replay) {
+        run_conv_model(b);
+    }
+    b->run_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return 0;
+}
+
+static int cpu_backend_outputs_get(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[])
+{
+    cpu_backend_t* b = get_priv(backend);
+    for (uint32_t i = 0; i < n_outputs; i++) {
+        uint32_t index = outputs[i].index;
+        if (index >= b->io_num.n_output) {
+            return -1;
+        }
+        rknn_tensor_attr* attr = &b->output_attrs[index];
+        const std::vector<int8_t>& q = b->outputs[index];
+        void* data = (void*)&q[0];
+        uint32_t size = q.size();
+        if (outputs[i].want_float) {
+            std::vector<float>& f = b->outputs_float[index];
+            f.resize(q.size());
+            for (size_t k = 0; k < q.size(); k++) {
+                f[k] = (q[k] - attr->zp) * attr->scale;
+            }
+            data = &f[0];
+            size = f.size() * sizeof(float);
+        }
+        if (outputs[i].is_prealloc) {
+            if (outputs[i].buf == NULL || outputs[i].size < size) {
+                return -1;
+            }
+            memcpy(outputs[i].buf, data, size);
+        } else {
+            outputs[i].buf = data;
+        }
+        outputs[i].size = size;
+    }
+    return 0;
+}
+
+static int cpu_backend_outputs_release(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[])
+{
+    // the buffers belong to the backend
+    (void)backend;
+    (void)n_outputs;
+    (void)outputs;
+    return 0;
+}
+
+static void* cpu_backend_bind_input(infer_backend_t* backend, int fd, void* virt_addr, uint32_t size)
+{
+    cpu_backend_t* b = get_priv(backend);
+    (void)fd;
+    if (size < b->input.size()) {
+        return NULL;
+    }
+    uint8_t* addr = (uint8_t*)virt_addr;
+    if (addr == NULL) {
+        b->owned.push_back(std::vector<uint8_t>(size));
+        addr = &b->owned.back()[0];
+    }
+    b->bound.push_back(addr);
+    return addr;
+}
+
+static int cpu_backend_select_input(infer_backend_t* backend, void* virt_addr)
+{
+    cpu_backend_t* b = get_priv(backend);
+    if (std::find(b->bound.begin(), b->bound.end(), (uint8_t*)virt_addr) == b->bound.end()) {
+        return -1;
+    }
+    b->input_data = (uint8_t*)virt_addr;
+    return 0;
+}
+
+static void cpu_backend_unbind_input(infer_backend_t* backend, void* virt_addr)
+{
+    cpu_backend_t* b = get_priv(backend);
+    std::vector<uint8_t*>::iterator it = std::find(b->bound.begin(), b->bound.end(), (uint8_t*)virt_addr);
+    if (it != b->bound.end()) {
+        b->bound.erase(it);
+    }
+    for (size_t i = 0; i < b->owned.size(); i++) {
+        if (&b->owned[i][0] == virt_addr) {
+            b->owned.erase(b->owned.begin() + i);
+            break;
+        }
+    }
+    if (b->input_data == virt_addr) {
+        b->input_data = &b->input[0];
+    }
+}
+
+// run time and memory, there are no per-layer timings
+static int cpu_backend_query(infer_backend_t* backend, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    cpu_backend_t* b = get_priv(backend);
+    if (cmd == RKNN_QUERY_PERF_RUN && size >= sizeof(rknn_perf_run)) {
+        ((rknn_perf_run*)info)->run_duration = b->run_us;
+        return 0;
+    }
+    if (cmd == RKNN_QUERY_MEM_SIZE && size >= sizeof(rknn_mem_size)) {
+        rknn_mem_size* mem = (rknn_mem_size*)info;
+        memset(mem, 0, sizeof(rknn_mem_size));
+        mem->total_weight_size = sizeof(b->weights) + sizeof(b->bias);
+        size_t internal = 0;
+        for (int i = 0; i < CPU_NUM_BRANCH; i++) {
+            internal += b->pooled[i].size() * sizeof(float);
+        }
+        for (size_t i = 0; i < b->outputs.size(); i++) {
+            internal += b->outputs[i].size();
+        }
+        mem->total_internal_size = internal;
+        return 0;
+    }
+    return -1;
+}
+
+static const infer_backend_ops_t cpu_backend_ops = {
+    "cpu",
+    cpu_backend_load,
+    cpu_backend_release,
+    cpu_backend_query_io_num,
+    cpu_backend_query_input_attr,
+    cpu_backend_query_output_attr,
+    cpu_backend_inputs_set,
+    cpu_backend_run,
+    cpu_backend_outputs_get,
+    cpu_backend_outputs_release,
+    cpu_backend_bind_input,
+    cpu_backend_select_input,
+    cpu_backend_unbind_input,
+    NULL,    // runs are synchronous
+    NULL,
+    NULL,    // static input shape
+    NULL,
+    cpu_backend_query,
+};
+
+const infer_backend_ops_t* get_cpu_backend_ops()
+{
+    return &cpu_backend_ops;
+}
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "infer_backend.h"
+#include "model_loader.h"
+
+typedef struct {
+    rknn_context ctx;
+    rknn_tensor_mem* model_mem;
+    rknn_tensor_attr input_attr;   // native input 0 as uint8 NHWC, for rknn_set_io_mem
+    rknn_tensor_mem** input_mems;  // one per buffer bound with bind_input
+    int num_input_mems;
+    rknn_tensor_mem* input_mem;    // the one set with rknn_set_io_mem
+    bool dynamic;                  // an input shape was set, the attributes are the current ones
+} rknn_backend_t;
+
+static rknn_backend_t* get_priv(infer_backend_t* backend)
+{
+    if (backend->priv == NULL) {
+        backend->priv = calloc(1, sizeof(rknn_backend_t));
+    }
+    return (rknn_backend_t*)backend->priv;
+}
+
+static int rknn_backend_load(infer_backend_t* backend, const char* model_path)
+{
+    rknn_backend_t* b = get_priv(backend);
+    model_load_info_t load_info;
+    if (b == NULL) {
+        return -1;
+    }
+
+    // without a heap copy of the file
+    uint32_t flag = (backend->flags & INFER_BACKEND_FLAG_COLLECT_PERF) ? RKNN_FLAG_COLLECT_PERF_MASK : 0;
+    int ret = load_rknn_model(model_path, MODEL_LOAD_ZERO_COPY, flag, &b->ctx, &load_info);
+    if (ret < 0) {
+        printf("load_rknn_model fail! ret=%d\n", ret);
+        return -1;
+    }
+    b->model_mem = load_info.model_mem;
+    printf("model load: %s, read %.2fms, init %.2fms\n", get_model_load_mode_string(load_info.mode),
+           load_info.read_ms, load_info.init_ms);
+    return 0;
+}
+
+static void rknn_backend_release(infer_backend_t* backend)
+{
+    rknn_backend_t* b = (rknn_backend_t*)backend->priv;
+    if (b == NULL) {
+        return;
+    }
+    for (int i = 0; i < b->num_input_mems; i++) {
+        rknn_destroy_mem(b->ctx, b->input_mems[i]);
+    }
+    free(b->input_mems);
+    release_rknn_model(b->ctx, b->model_mem);
+    free(b);
+    backend->priv = NULL;
+}
+
+static int rknn_backend_query_io_num(infer_backend_t* backend, rknn_input_output_num* io_num)
+{
+    return rknn_query(get_priv(backend)->ctx, RKNN_QUERY_IN_OUT_NUM, io_num, sizeof(rknn_input_output_num));
+}
+
+static int rknn_backend_query_input_attr(infer_backend_t* backend, rknn_tensor_attr* attr)
+{
+    rknn_backend_t* b = get_priv(backend);
+    return rknn_query(b->ctx, b->dynamic ? RKNN_QUERY_CURRENT_INPUT_ATTR : RKNN_QUERY_INPUT_ATTR, attr,
+                      sizeof(rknn_tensor_attr));
+}
+
+static int rknn_backend_query_output_attr(infer_backend_t* backend, rknn_tensor_attr* attr)
+{
+    rknn_backend_t* b = get_priv(backend);
+    return rknn_query(b->ctx, b->dynamic ? RKNN_QUERY_CURRENT_OUTPUT_ATTR : RKNN_QUERY_OUTPUT_ATTR, attr,
+                      sizeof(rknn_tensor_attr));
+}
+
+static int rknn_backend_inputs_set(infer_backend_t* backend, uint32_t n_inputs, rknn_input inputs[])
+{
+    return rknn_inputs_set(get_priv(backend)->ctx, n_inputs, inputs);
+}
+
+static int rknn_backend_run(infer_backend_t* backend)
+{
+    return rknn_run(get_priv(backend)->ctx, NULL);
+}
+
+static int rknn_backend_outputs_get(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[])
+{
+    return rknn_outputs_get(get_priv(backend)->ctx, n_outputs, outputs, NULL);
+}
+
+static int rknn_backend_outputs_release(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[])
+{
+    return rknn_outputs_release(get_priv(backend)->ctx, n_outputs, outputs);
+}
+
+static int find_input_mem(rknn_backend_t* b, void* virt_addr)
+{
+    for (int i = 0; i < b->num_input_mems; i++) {
+        if (b->input_mems[i]->virt_addr == virt_addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void* rknn_backend_bind_input(infer_backend_t* backend, int fd, void* virt_addr, uint32_t size)
+{
+    rknn_backend_t* b = get_priv(backend);
+    // the runtime only takes dma_bufs and its own memory
+    if (fd < 0 && virt_addr != NULL) {
+        return NULL;
+    }
+    if (b->num_input_mems == 0) {
+        rknn_tensor_attr* attr = &b->input_attr;
+        memset(attr, 0, sizeof(rknn_tensor_attr));
+        attr->index = 0;
+        if (rknn_query(b->ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, attr, sizeof(rknn_tensor_attr)) != RKNN_SUCC) {
+            return NULL;
+        }
+        // the letterbox writes packed uint8 NHWC rows, a padded row stride needs the inputs_set conversion
+        attr->type = RKNN_TENSOR_UINT8;
+        attr->fmt = RKNN_TENSOR_NHWC;
+        if (attr->n_dims != 4 || (attr->w_stride != 0 && attr->w_stride != attr->dims[2])) {
+            return NULL;
+        }
+    }
+    if (size < b->input_attr.size_with_stride) {
+        return NULL;
+    }
+    rknn_tensor_mem** mems =
+        (rknn_tensor_mem**)realloc(b->input_mems, (b->num_input_mems + 1) * sizeof(rknn_tensor_mem*));
+    if (mems == NULL) {
+        return NULL;
+    }
+    b->input_mems = mems;
+
+    rknn_tensor_mem* mem =
+        fd >= 0 ? rknn_create_mem_from_fd(b->ctx, fd, virt_addr, size, 0) : rknn_create_mem(b->ctx, size);
+    if (mem == NULL) {
+        return NULL;
+    }
+    b->input_mems[b->num_input_mems++] = mem;
+    return mem->virt_addr;
+}
+
+static int rknn_backend_select_input(infer_backend_t* backend, void* virt_addr)
+{
+    rknn_backend_t* b = get_priv(backend);
+    int i = find_input_mem(b, virt_addr);
+    if (i < 0) {
+        return -1;
+    }
+    if (b->input_mems[i] == b->input_mem) {
+        return 0;
+    }
+    int ret = rknn_set_io_mem(b->ctx, b->input_mems[i], &b->input_attr);
+    if (ret != RKNN_SUCC) {
+        printf("rknn_set_io_mem input fail! ret=%d\n", ret);
+        return -1;
+    }
+    b->input_mem = b->input_mems[i];
+    return 0;
+}
+
+static void rknn_backend_unbind_input(infer_backend_t* backend, void* virt_addr)
+{
+    rknn_backend_t* b = get_priv(backend);
+    int i = find_input_mem(b, virt_addr);
+    if (i < 0) {
+        return;
+    }
+    if (b->input_mems[i] == b->input_mem) {
+        b->input_mem = NULL;
+    }
+    rknn_destroy_mem(b->ctx, b->input_mems[i]);
+    b->input_mems[i] = b->input_mems[--b->num_input_mems];
+}
+
+static int rknn_backend_run_async(infer_backend_t* backend, uint64_t* frame_id)
+{
+    rknn_run_extend extend;
+    memset(&extend, 0, sizeof(rknn_run_extend));
+    extend.non_block = 1;
+    int ret = rknn_run(get_priv(backend)->ctx, &extend);
+    *frame_id = extend.frame_id;
+    return ret;
+}
+
+static int rknn_backend_wait(infer_backend_t* backend, uint64_t frame_id, int timeout_ms)
+{
+    rknn_run_extend extend;
+    memset(&extend, 0, sizeof(rknn_run_extend));
+    extend.frame_id = frame_id;
+    extend.timeout_ms = timeout_ms;
+    return rknn_wait(get_priv(backend)->ctx, &extend);
+}
+
+static int rknn_backend_query_input_range(infer_backend_t* backend, rknn_input_range* range)
+{
+    return rknn_query(get_priv(backend)->ctx, RKNN_QUERY_INPUT_DYNAMIC_RANGE, range, sizeof(rknn_input_range));
+}
+
+static int rknn_backend_set_input_shapes(infer_backend_t* backend, uint32_t n_inputs, rknn_tensor_attr attrs[])
+{
+    rknn_backend_t* b = get_priv(backend);
+    int ret = rknn_set_input_shapes(b->ctx, n_inputs, attrs);
+    if (ret == RKNN_SUCC) {
+        b->dynamic = true;
+    }
+    return ret;
+}
+
+static int rknn_backend_query(infer_backend_t* backend, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    return rknn_query(get_priv(backend)->ctx, cmd, info, size);
+}
+
+static const infer_backend_ops_t rknn_backend_ops = {
+    "rknn",
+    rknn_backend_load,
+    rknn_backend_release,
+    rknn_backend_query_io_num,
+    rknn_backend_query_input_attr,
+    rknn_backend_query_output_attr,
+    rknn_backend_inputs_set,
+    rknn_backend_run,
+    rknn_backend_outputs_get,
+    rknn_backend_outputs_release,
+    rknn_backend_bind_input,
+    rknn_backend_select_input,
+    rknn_backend_unbind_input,
+    rknn_backend_run_async,
+    rknn_backend_wait,
+    rknn_backend_query_input_range,
+    rknn_backend_set_input_shapes,
+    rknn_backend_query,
+};
+
+const infer_backend_ops_t* get_rknn_backend_ops()
+{
+    return &rknn_backend_ops;
+}
+
+infer_backend_t* infer_backend_wrap_rknn(rknn_context ctx, rknn_tensor_mem* model_mem)
+{
+    infer_backend_t* backend = infer_backend_create("rknn");
+    if (backend == NULL) {
+        return NULL;
+    }
+    rknn_backend_t* b = get_priv(backend);
+    if (b == NULL) {
+        free(backend);
+        return NULL;
+    }
+    b->ctx = ctx;
+    b->model_mem = model_mem;
+    return backend;
+}
+
+rknn_context infer_backend_get_rknn_context(infer_backend_t* backend)
+{
+    if (backend == NULL || backend->ops != &rknn_backend_ops || backend->priv == NULL) {
+        return 0;
+    }
+    return ((rknn_backend_t*)backend->priv)->ctx;
+}
@@ -0,0 +1,216 @@
+// Asynchronous inference: throughput of yolov8_async with 1 to 3 frames in flight against the blocking
+// inference_yolov8_model(), and a check of the submit / poll / wait state machine (frame ids, results
+// equal to the blocking path, timeouts, the eventfd, error cases). Exits with 1 if a check fails.
+// Runs on the mock runtime (-DRKNN_MOCK=ON) or the cpu backend (INFER_BACKEND=cpu) on a host.
+//
+// Usage: bench_async <model_path> [image_path] [frames]
+// Without image_path a synthetic 1920x1080 frame is used.
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easy_timer.h"
+#include "image_utils.h"
+#include "yolov8.h"
+#include "yolov8_async.h"
+
+#define NUM_IMAGES 2
+
+static int g_checks = 0;
+static int g_failed = 0;
+
+static void check(bool ok, const char* what)
+{
+    g_checks++;
+    if (!ok) {
+        g_failed++;
+        printf("check fail: %s\n", what);
+    }
+}
+
+static bool same_results(object_detect_result_list* a, object_detect_result_list* b)
+{
+    if (a->count != b->count) {
+        return false;
+    }
+    for (int i = 0; i < a->count; i++) {
+        object_detect_result* x = &a->results[i];
+        object_detect_result* y = &b->results[i];
+        if (x->cls_id != y->cls_id || x->prop != y->prop || memcmp(&x->box, &y->box, sizeof(image_rect_t)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// collect one frame and compare it with the blocking result of the same image
+static void collect(yolov8_async_t* async, int64_t frame_id, object_detect_result_list* expected)
+{
+    object_detect_result_list results;
+    int64_t id = frame_id;
+    int ret = yolov8_async_wait(async, &id, &results, -1);
+    check(ret == 0, "wait returns the frame");
+    check(id == frame_id, "frames finish in submission order");
+    check(same_results(&results, &expected[id % NUM_IMAGES]), "results equal to inference_yolov8_model");
+}
+
+static void run_async(rknn_app_context_t* app_ctx, image_buffer_t* images, object_detect_result_list* expected,
+                      int frames, int depth)
+{
+    yolov8_async_config_t config;
+    yolov8_async_config_default(&config);
+    config.max_in_flight = depth;
+    yolov8_async_t* async = yolov8_async_create(app_ctx, &config);
+    if (async == NULL) {
+        check(false, "create");
+        return;
+    }
+
+    // the next frame goes in before the oldest one is collected
+    TIMER timer;
+    timer.tik();
+    int64_t next_collect = 0;
+    for (int i = 0; i < frames; i++) {
+        if (yolov8_async_in_flight(async) == depth) {
+            collect(async, next_collect++, expected);
+        }
+        int64_t id = yolov8_async_submit(async, &images[i % NUM_IMAGES]);
+        check(id == i, "frame ids count up from 0");
+    }
+    while (next_collect < frames) {
+        collect(async, next_collect++, expected);
+    }
+    timer.tok();
+    printf("%-12s in flight=%d fps=%7.1f\n", "async", depth, frames * 1000.0f / timer.get_time());
+    yolov8_async_destroy(async);
+}
+
+static void check_state_machine(rknn_app_context_t* app_ctx, image_buffer_t* images,
+                                object_detect_result_list* expected)
+{
+    yolov8_async_config_t config;
+    yolov8_async_config_default(&config);
+    config.max_in_flight = 2;
+    yolov8_async_t* async = yolov8_async_create(app_ctx, &config);
+    if (async == NULL) {
+        check(false, "create");
+        return;
+    }
+    object_detect_result_list results;
+    int64_t id = YOLOV8_ASYNC_ANY;
+    check(yolov8_async_poll(async, &id, &results) == -1, "nothing in flight");
+    id = 7;
+    check(yolov8_async_wait(async, &id, &results, 10) == -1, "unknown frame id");
+
+    int64_t first = yolov8_async_submit(async, &images[0]);
+    int64_t second = yolov8_async_submit(async, &images[1]);
+    check(yolov8_async_in_flight(async) == 2, "two frames in flight");
+    id = second;
+    int ret = yolov8_async_poll(async, &id, &results);
+    check(ret == YOLOV8_ASYNC_PENDING || ret == 0, "poll of a running frame");
+    if (ret == 0) {
+        // a backend without asynchronous runs (cpu) may be that fast
+        check(same_results(&results, &expected[1]), "second frame result");
+        second = -1;
+    }
+
+    // the eventfd wakes a poll(2) loop once a frame is done
+    struct pollfd pfd;
+    pfd.fd = yolov8_async_get_fd(async);
+    pfd.events = POLLIN;
+    check(poll(&pfd, 1, 5000) == 1 && (pfd.revents & POLLIN), "eventfd readable when a frame is done");
+    id = YOLOV8_ASYNC_ANY;
+    check(yolov8_async_poll(async, &id, &results) == 0 && id == first, "poll collects the first frame");
+    check(same_results(&results, &expected[0]), "first frame result");
+    if (second >= 0) {
+        id = second;
+        check(yolov8_async_wait(async, &id, &results, -1) == 0, "wait for the second frame");
+        check(same_results(&results, &expected[1]), "second frame result");
+    }
+    check(yolov8_async_in_flight(async) == 0, "nothing in flight after collecting");
+    check(poll(&pfd, 1, 0) == 0, "eventfd not readable after collecting");
+    id = first;
+    check(yolov8_async_poll(async, &id, &results) == -1, "a frame is collected once");
+
+    // full of uncollected results: submit returns -1 once both are done instead of blocking forever
+    yolov8_async_submit(async, &images[0]);
+    yolov8_async_submit(async, &images[0]);
+    check(yolov8_async_submit(async, &images[0]) == -1, "submit with every frame done and uncollected");
+    for (int i = 0; i < 2; i++) {
+        id = YOLOV8_ASYNC_ANY;
+        check(yolov8_async_wait(async, &id, &results, 0) == 0, "done frames are collected without waiting");
+    }
+    check(yolov8_async_submit(async, &images[0]) >= 0, "submit after collecting");
+    yolov8_async_destroy(async);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [image_path] [frames]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* image_path = argc > 2 ? argv[2] : NULL;
+    int frames = argc > 3 ? atoi(argv[3]) : 100;
+
+    // two different images, so results that go to the wrong frame id show up
+    image_buffer_t images[NUM_IMAGES];
+    memset(images, 0, sizeof(images));
+    if (image_path != NULL) {
+        if (read_image(image_path, &images[0]) != 0) {
+            printf("read image %s fail!\n", image_path);
+            return -1;
+        }
+    } else {
+        images[0].width = 1920;
+        images[0].height = 1080;
+        images[0].format = IMAGE_FORMAT_RGB888;
+        images[0].size = get_image_size(&images[0]);
+        images[0].virt_addr = (unsigned char*)malloc(images[0].size);
+        for (int i = 0; i < images[0].size; i++) {
+            images[0].virt_addr[i] = (unsigned char)(i * 7);
+        }
+    }
+    images[1] = images[0];
+    images[1].virt_addr = (unsigned char*)malloc(images[0].size);
+    for (int i = 0; i < images[0].size; i++) {
+        images[1].virt_addr[i] = 255 - images[0].virt_addr[i];
+    }
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        printf("init_yolov8_model fail! model_path=%s\n", model_path);
+        return -1;
+    }
+
+    object_detect_result_list expected[NUM_IMAGES];
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        inference_yolov8_model(&app_ctx, &images[i], &expected[i]);
+    }
+    object_detect_result_list results;
+    TIMER timer;
+    timer.tik();
+    for (int i = 0; i < frames; i++) {
+        inference_yolov8_model(&app_ctx, &images[i % NUM_IMAGES], &results);
+    }
+    timer.tok();
+    printf("\n%-12s in flight=1 fps=%7.1f\n", "blocking", frames * 1000.0f / timer.get_time());
+
+    for (int depth = 1; depth <= 3; depth++) {
+        run_async(&app_ctx, images, expected, frames, depth);
+    }
+    check_state_machine(&app_ctx, images, expected);
+    printf("checks: %d, failed: %d\n", g_checks, g_failed);
+
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        free(images[i].virt_addr);
+    }
+    return g_failed > 0 ? 1 : 0;
+}
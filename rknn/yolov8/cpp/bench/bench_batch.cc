@@ -0,0 +1,69 @@
+// Directory batch inference: images/sec and per-stage utilization for several decode thread and
+// inference context counts. Built against the mock runtime (-DRKNN_MOCK=ON, RKNN_MOCK_RUN_US sets
+// the simulated NPU time) it measures the host side of the pipeline on x86.
+//
+// Usage: bench_batch <model_path> <image_dir | @file_list> [min_images] [queue_depth]
+// The file list is repeated until it holds at least min_images entries (default 200).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yolov8.h"
+#include "yolov8_batch.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("%s <model_path> <image_dir | @file_list> [min_images] [queue_depth]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* input_path = argv[2];
+    int min_images = argc > 3 ? atoi(argv[3]) : 200;
+    int queue_depth = argc > 4 ? atoi(argv[4]) : 8;
+
+    bool is_list = input_path[0] == '@';
+    std::vector<std::string> dir_files;
+    if (yolov8_batch_list_files(is_list ? input_path + 1 : input_path, is_list, &dir_files) != 0 ||
+        dir_files.empty()) {
+        printf("no image found in %s\n", input_path);
+        return -1;
+    }
+    std::vector<std::string> files;
+    while ((int)files.size() < min_images) {
+        files.insert(files.end(), dir_files.begin(), dir_files.end());
+    }
+
+    int cpus = (int)std::thread::hardware_concurrency();
+    int decode_counts[] = {1, cpus > 2 ? cpus / 2 : 2};
+    int context_counts[] = {1, 2, 3};
+
+    init_post_process();
+    printf("images=%d queue_depth=%d cpus=%d\n", (int)files.size(), queue_depth, cpus);
+    for (size_t d = 0; d < sizeof(decode_counts) / sizeof(decode_counts[0]); d++) {
+        for (size_t c = 0; c < sizeof(context_counts) / sizeof(context_counts[0]); c++) {
+            yolov8_batch_config_t config;
+            yolov8_batch_config_default(&config);
+            config.decode_threads = decode_counts[d];
+            config.num_contexts = context_counts[c];
+            config.queue_depth = queue_depth;
+            config.report_every = 0;
+
+            yolov8_batch_stats_t stats;
+            if (run_yolov8_batch(model_path, files, &config, &stats) != 0) {
+                printf("run_yolov8_batch fail!\n");
+                deinit_post_process();
+                return -1;
+            }
+            printf("\n--- decode_threads=%d contexts=%d\n", config.decode_threads, config.num_contexts);
+            yolov8_batch_print_stats(&stats);
+        }
+    }
+    deinit_post_process();
+    return 0;
+}
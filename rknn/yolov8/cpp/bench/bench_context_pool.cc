@@ -0,0 +1,150 @@
+// Shared-weight context pool: frames/sec of several submitting streams for one context versus one
+// context per NPU core, round robin versus least loaded dispatch. Every stream runs a preallocated
+// model input, so only the NPU and post process are measured.
+// With the mock runtime (-DRKNN_MOCK=ON) RKNN_MOCK_RUN_JITTER_US makes the run time uneven, which
+// is where least loaded dispatch pulls ahead of round robin; the runs per simulated core show the pinning.
+//
+// Usage: bench_context_pool <model_path> [frames] [streams]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "easy_timer.h"
+#include "yolov8_pool.h"
+#ifdef RKNN_MOCK
+#include "rknn_mock.h"
+#endif
+
+typedef struct {
+    const char* name;
+    int num_contexts;
+    yolov8_pool_schedule_t schedule;
+    int pin_cores;
+} pool_case_t;
+
+static void stream_worker(yolov8_context_pool_t* pool, image_buffer_t* input, std::atomic<int>* remaining,
+                          std::atomic<int>* failed)
+{
+    letterbox_t letter_box;
+    memset(&letter_box, 0, sizeof(letterbox_t));
+    letter_box.scale = 1.0f;
+    object_detect_result_list results;
+    while ((*remaining)-- > 0) {
+        if (yolov8_pool_inference_with_input(pool, input, &letter_box, &results) != 0) {
+            (*failed)++;
+        }
+    }
+}
+
+static int run_case(const char* model_path, pool_case_t* c, int frames, int streams)
+{
+    yolov8_pool_config_t config;
+    yolov8_pool_config_default(&config);
+    config.num_contexts = c->num_contexts;
+    config.schedule = c->schedule;
+    config.pin_cores = c->pin_cores;
+
+    // keep the model info dump of every context out of the table
+    fflush(stdout);
+    int saved_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    yolov8_context_pool_t* pool = yolov8_pool_create(model_path, &config);
+    fflush(stdout);
+    dup2(saved_fd, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_fd);
+    if (pool == NULL) {
+        printf("yolov8_pool_create fail!\n");
+        return -1;
+    }
+
+    rknn_app_context_t* app_ctx = yolov8_pool_get_context(pool, 0);
+    image_buffer_t input;
+    memset(&input, 0, sizeof(image_buffer_t));
+    input.width = app_ctx->model_width;
+    input.height = app_ctx->model_height;
+    input.format = IMAGE_FORMAT_RGB888;
+    input.size = input.width * input.height * 3;
+    input.virt_addr = (unsigned char*)malloc(input.size);
+    memset(input.virt_addr, 114, input.size);
+
+    // warm up every context once
+    std::atomic<int> remaining(yolov8_pool_size(pool));
+    std::atomic<int> failed(0);
+    stream_worker(pool, &input, &remaining, &failed);
+    yolov8_pool_reset_stats(pool);
+#ifdef RKNN_MOCK
+    rknn_mock_reset_core_runs();
+#endif
+
+    TIMER timer;
+    remaining = frames;
+    timer.tik();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < streams; i++) {
+        threads.push_back(std::thread(stream_worker, pool, &input, &remaining, &failed));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    timer.tok();
+    float ms = timer.get_time();
+
+    int n = yolov8_pool_size(pool);
+    std::vector<yolov8_pool_context_stats_t> stats(n);
+    yolov8_pool_get_stats(pool, &stats[0]);
+    printf("%-22s contexts=%d fps=%7.1f failed=%d\n", c->name, n, frames * 1000.0f / ms, (int)failed);
+    for (int i = 0; i < n; i++) {
+        printf("  ctx%d core_mask=%-2d shared=%-16s runs=%-5ld utilization=%5.1f%%\n", i, stats[i].core_mask,
+               get_model_share_mode_string(stats[i].shared), stats[i].runs, stats[i].busy_ms * 100 / ms);
+    }
+#ifdef RKNN_MOCK
+    long core_runs[8];
+    int cores = rknn_mock_get_core_runs(core_runs, 8);
+    printf("  npu core runs:");
+    for (int i = 0; i < cores; i++) {
+        printf(" %ld", core_runs[i]);
+    }
+    printf("\n");
+#endif
+
+    free(input.virt_addr);
+    yolov8_pool_destroy(pool);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [frames] [streams]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    int frames = argc > 2 ? atoi(argv[2]) : 300;
+    int streams = argc > 3 ? atoi(argv[3]) : 4;
+
+    pool_case_t cases[] = {
+        {"single context", 1, POOL_SCHEDULE_ROUND_ROBIN, 0},
+        {"3 auto, round robin", 3, POOL_SCHEDULE_ROUND_ROBIN, 0},
+        {"3 pinned, round robin", 3, POOL_SCHEDULE_ROUND_ROBIN, 1},
+        {"3 pinned, least loaded", 3, POOL_SCHEDULE_LEAST_LOADED, 1},
+    };
+
+    init_post_process();
+    printf("frames=%d streams=%d\n", frames, streams);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (run_case(model_path, &cases[i], frames, streams) != 0) {
+            break;
+        }
+    }
+    deinit_post_process();
+    return 0;
+}
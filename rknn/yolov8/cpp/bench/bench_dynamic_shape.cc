@@ -0,0 +1,114 @@
+// Dynamic input shapes: a non square frame letterboxed into the largest (square) input shape against the
+// registered shape that fits it, e.g. 1920x1080 into 640x640 vs 640x384. Reports throughput, latency, the
+// padded share of the input and the detections of both, which must map to the same boxes.
+// On the mock runtime the shapes come from RKNN_MOCK_SHAPES (set to 640x640,640x384,384x640 unless given).
+//
+// Usage: bench_dynamic_shape <model_path> [image_path] [frames]
+// Without image_path a synthetic 1920x1080 frame is used.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easy_timer.h"
+#include "image_utils.h"
+#include "yolov8.h"
+
+#define BG_COLOR 114
+
+// inference_yolov8_model() with the shape fixed by the caller
+static int inference_letterboxed(rknn_app_context_t* app_ctx, image_buffer_t* img, object_detect_result_list* results)
+{
+    letterbox_t letter_box;
+    memset(&letter_box, 0, sizeof(letterbox_t));
+    int ret = convert_image_with_letterbox(img, &app_ctx->input_img, &letter_box, BG_COLOR);
+    if (ret < 0) {
+        return ret;
+    }
+    return inference_yolov8_model_with_input(app_ctx, &app_ctx->input_img, &letter_box, results);
+}
+
+static void run(const char* name, rknn_app_context_t* app_ctx, image_buffer_t* src, int frames, bool fixed)
+{
+    object_detect_result_list results;
+    if (fixed) {
+        inference_letterboxed(app_ctx, src, &results);
+    } else {
+        inference_yolov8_model(app_ctx, src, &results);
+    }
+    TIMER timer;
+    timer.tik();
+    for (int i = 0; i < frames; i++) {
+        if (fixed) {
+            inference_letterboxed(app_ctx, src, &results);
+        } else {
+            inference_yolov8_model(app_ctx, src, &results);
+        }
+    }
+    timer.tok();
+
+    float scale = fminf((float)app_ctx->model_width / src->width, (float)app_ctx->model_height / src->height);
+    float content = scale * src->width * scale * src->height;
+    float padding = 100.0f * (1.0f - content / (app_ctx->model_width * app_ctx->model_height));
+    printf("%-11s input=%dx%d padding=%4.1f%% fps=%7.1f latency=%6.2fms\n", name, app_ctx->model_width,
+           app_ctx->model_height, padding, frames * 1000.0f / timer.get_time(), timer.get_time() / frames);
+    for (int i = 0; i < results.count; i++) {
+        object_detect_result* det = &results.results[i];
+        printf("  %s @ (%d %d %d %d) %.3f\n", coco_cls_to_name(det->cls_id), det->box.left, det->box.top,
+               det->box.right, det->box.bottom, det->prop);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [image_path] [frames]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* image_path = argc > 2 ? argv[2] : NULL;
+    int frames = argc > 3 ? atoi(argv[3]) : 100;
+    setenv("RKNN_MOCK_SHAPES", "640x640,640x384,384x640", 0);
+
+    image_buffer_t src;
+    memset(&src, 0, sizeof(image_buffer_t));
+    if (image_path != NULL) {
+        if (read_image(image_path, &src) != 0) {
+            printf("read image %s fail!\n", image_path);
+            return -1;
+        }
+    } else {
+        src.width = 1920;
+        src.height = 1080;
+        src.format = IMAGE_FORMAT_RGB888;
+        src.size = get_image_size(&src);
+        src.virt_addr = (unsigned char*)malloc(src.size);
+        for (int i = 0; i < src.size; i++) {
+            src.virt_addr[i] = (unsigned char)(i * 7);
+        }
+    }
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        printf("init_yolov8_model fail! model_path=%s\n", model_path);
+        return -1;
+    }
+    if (app_ctx.num_shapes == 0) {
+        printf("%s has static input shapes\n", model_path);
+        release_yolov8_model(&app_ctx);
+        return -1;
+    }
+
+    // init leaves the largest shape set
+    printf("\n");
+    run("letterbox", &app_ctx, &src, frames, true);
+    run("dynamic", &app_ctx, &src, frames, false);
+
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+    free(src.virt_addr);
+    return 0;
+}
@@ -0,0 +1,283 @@
+// Frame buffers of a whole frame path under load: capture, letterbox, NPU and encode either allocate their
+// buffers per frame with malloc and free them when done, or take them from frame pools (utils/frame_pool.h)
+// that are allocated once and pass the frames on by reference.
+//   capture  a synthetic width x height RGB source copied into a frame buffer, as a capture copy does
+//   pipeline letterbox, NPU and post process (yolov8_pipeline.h, its model inputs come from a frame pool)
+//   encode   the frame copied into an encoder input buffer in the result callback
+// Each mode runs in a fresh child process so its peak RSS (VmHWM) is its own. Allocations are the
+// malloc, calloc and realloc calls of the whole process while frames flow, counted by wrappers around the
+// glibc allocator; page faults are the minor faults of the same window.
+// Runs on the mock runtime (-DRKNN_MOCK=ON) or the cpu backend (INFER_BACKEND=cpu) on a host.
+//
+// Usage: bench_frame_pool <model_path> [width] [height] [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "frame_pool.h"
+#include "yolov8.h"
+#include "yolov8_pipeline.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<uint64_t> g_allocations(0);
+
+extern "C" void* malloc(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+typedef struct {
+    int ok;
+    long frames;
+    double seconds;
+    uint64_t allocations;
+    long minor_faults;
+    long base_kb;
+    long peak_kb;
+    int pool_buffers;
+    uint64_t pool_waited;
+} run_result_t;
+
+typedef struct {
+    bool pooled;
+    frame_pool_t* encode_pool;
+    long objects;
+} run_state_t;
+
+static double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long read_status_kb(const char* key)
+{
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    char line[256];
+    long kb = 0;
+    size_t len = strlen(key);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, key, len) == 0) {
+            kb = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+static long minor_faults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+// encode stage: the frame goes into an encoder input buffer, then every buffer of the frame is given back
+static void on_result(void* user_data, int64_t frame_id, image_buffer_t* img, object_detect_result_list* od_results,
+                      int ret)
+{
+    run_state_t* state = (run_state_t*)user_data;
+    if (ret == 0) {
+        state->objects += od_results->count;
+    }
+    if (state->pooled) {
+        frame_t* encode = frame_pool_acquire(state->encode_pool, -1);
+        memcpy(encode->image.virt_addr, img->virt_addr, img->size);
+        encode->frame_id = frame_id;
+        frame_release(encode);
+        frame_release(frame_from_image(img));
+    } else {
+        unsigned char* encode = (unsigned char*)malloc(img->size);
+        memcpy(encode, img->virt_addr, img->size);
+        free(encode);
+        free(img->virt_addr);
+        free(img);
+    }
+}
+
+static void child_run(const char* model_path, bool pooled, int width, int height, int frames, int out_fd)
+{
+    run_result_t r;
+    memset(&r, 0, sizeof(r));
+
+    image_buffer_t src;
+    memset(&src, 0, sizeof(image_buffer_t));
+    src.width = width;
+    src.height = height;
+    src.width_stride = width;
+    src.height_stride = height;
+    src.format = IMAGE_FORMAT_RGB888;
+    src.size = width * height * 3;
+    src.fd = -1;
+    src.virt_addr = (unsigned char*)malloc(src.size);
+    for (int i = 0; i < src.size; i++) {
+        src.virt_addr[i] = (unsigned char)(i * 7);
+    }
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        _exit(1);
+    }
+    yolov8_pipeline_config_t config;
+    yolov8_pipeline_config_default(&config);
+    run_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.pooled = pooled;
+
+    // frames queued and in the stages, plus the one being captured
+    frame_pool_t* capture_pool = NULL;
+    if (pooled) {
+        frame_pool_config_t pool_config;
+        frame_pool_config_default(&pool_config);
+        pool_config.width = width;
+        pool_config.height = height;
+        pool_config.format = IMAGE_FORMAT_RGB888;
+        pool_config.count = config.queue_depth + config.num_buffers + 2;
+        capture_pool = frame_pool_create(&pool_config);
+        pool_config.count = 2;
+        state.encode_pool = frame_pool_create(&pool_config);
+        if (capture_pool == NULL || state.encode_pool == NULL) {
+            _exit(1);
+        }
+    }
+    yolov8_pipeline_t* pipeline = yolov8_pipeline_create(&app_ctx, &config, on_result, &state);
+    if (pipeline == NULL) {
+        _exit(1);
+    }
+
+    r.base_kb = read_status_kb("VmRSS");
+    uint64_t allocations = g_allocations.load();
+    long faults = minor_faults();
+    double start = now_s();
+    for (int i = 0; i < frames; i++) {
+        image_buffer_t* img;
+        if (pooled) {
+            frame_t* frame = frame_pool_acquire(capture_pool, -1);
+            frame->frame_id = i;
+            img = &frame->image;
+        } else {
+            img = (image_buffer_t*)malloc(sizeof(image_buffer_t));
+            *img = src;
+            img->virt_addr = (unsigned char*)malloc(src.size);
+        }
+        memcpy(img->virt_addr, src.virt_addr, src.size);
+        yolov8_pipeline_submit(pipeline, img, i);
+    }
+    yolov8_pipeline_flush(pipeline);
+    r.seconds = now_s() - start;
+    r.allocations = g_allocations.load() - allocations;
+    r.minor_faults = minor_faults() - faults;
+    r.peak_kb = read_status_kb("VmHWM");
+    r.frames = frames;
+
+    yolov8_pipeline_destroy(pipeline);
+    if (pooled) {
+        frame_pool_stats_t stats;
+        frame_pool_get_stats(capture_pool, &stats);
+        r.pool_buffers = stats.buffers;
+        r.pool_waited = stats.waited;
+        frame_pool_destroy(capture_pool);
+        frame_pool_destroy(state.encode_pool);
+    }
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+    free(src.virt_addr);
+    r.ok = 1;
+    if (write(out_fd, &r, sizeof(r)) != sizeof(r)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+static int run_child(const char* model_path, bool pooled, int width, int height, int frames, run_result_t* r)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        // keep the runtime logs of the child out of the table
+        if (freopen("/dev/null", "w", stdout) == NULL) {
+            _exit(1);
+        }
+        child_run(model_path, pooled, width, height, frames, fds[1]);
+    }
+    close(fds[1]);
+    int n = read(fds[0], r, sizeof(run_result_t));
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    return n == sizeof(run_result_t) && r->ok ? 0 : -1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [width] [height] [frames]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    int width = argc > 2 ? atoi(argv[2]) : 1920;
+    int height = argc > 3 ? atoi(argv[3]) : 1080;
+    int frames = argc > 4 ? atoi(argv[4]) : 200;
+
+    printf("%dx%d RGB, %d frames\n", width, height, frames);
+    printf("%-7s %8s %12s %12s %14s %12s %10s\n", "buffers", "fps", "allocs/sec", "allocs/frame", "faults/frame",
+           "peak RSS MB", "pool wait");
+    const char* names[2] = {"malloc", "pool"};
+    for (int pooled = 0; pooled < 2; pooled++) {
+        run_result_t r;
+        if (run_child(model_path, pooled != 0, width, height, frames, &r) != 0) {
+            printf("%-7s run fail\n", names[pooled]);
+            continue;
+        }
+        char waited[32] = "-";
+        if (pooled) {
+            snprintf(waited, sizeof(waited), "%llu/%d", (unsigned long long)r.pool_waited, r.pool_buffers);
+        }
+        printf("%-7s %8.1f %12.0f %12.2f %14.1f %12.1f %10s\n", names[pooled], r.frames / r.seconds,
+               r.allocations / r.seconds, (double)r.allocations / r.frames, (double)r.minor_faults / r.frames,
+               r.peak_kb / 1024.0, waited);
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+// Letterbox destination per frame vs per context: latency, syscalls and page faults per frame of
+// inference_yolov8_model(). "per frame" is what it used to do: dma_buf_alloc, letterbox, an
+// inputs_set copy and dma_buf_free for every frame. "persistent" uses the buffer allocated by
+// init_yolov8_model() that is also bound as the model input (rknn_create_mem_from_fd + rknn_set_io_mem).
+//
+// "input" times only what differs between the two: getting the letterbox destination and handing
+// it to the model (alloc/free, set input), without the letterbox itself, which is the same work
+// for both and is reported next to it; "frame" is the whole inference, where the NPU run and the post process
+// are the same for both and dominate (20 ms of simulated NPU per run on the mock, see
+// RKNN_MOCK_RUN_US), so a whole frame difference is within the run to run noise there. Medians
+// of frames timed one by one, the two modes alternating in rounds of 10 frames.
+//
+// Syscalls are counted by wrapping the libc entry points the dma allocator and the runtime use
+// (open, close, ioctl, mmap, munmap); calls glibc makes internally (e.g. malloc's mmap) are not
+// seen, the page faults show those.
+//
+// Usage: bench_input_buffer <model_path> [image_path] [frames]
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "image_utils.h"
+#include "yolov8.h"
+#include "dma_alloc.hpp"
+
+enum { SYS_OPEN = 0, SYS_CLOSE, SYS_IOCTL, SYS_MMAP, SYS_MUNMAP, SYS_NUM };
+static const char* kSysNames[SYS_NUM] = {"open", "close", "ioctl", "mmap", "munmap"};
+static std::atomic<long> g_sys_count[SYS_NUM];
+
+static void* next_symbol(const char* name)
+{
+    return dlsym(RTLD_NEXT, name);
+}
+
+extern "C" {
+
+int open(const char* path, int flags, ...)
+{
+    static int (*real_open)(const char*, int, ...) = (int (*)(const char*, int, ...))next_symbol("open");
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+    g_sys_count[SYS_OPEN]++;
+    return real_open(path, flags, mode);
+}
+
+int close(int fd)
+{
+    static int (*real_close)(int) = (int (*)(int))next_symbol("close");
+    g_sys_count[SYS_CLOSE]++;
+    return real_close(fd);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+    static int (*real_ioctl)(int, unsigned long, ...) = (int (*)(int, unsigned long, ...))next_symbol("ioctl");
+    va_list ap;
+    va_start(ap, request);
+    void* arg = va_arg(ap, void*);
+    va_end(ap);
+    g_sys_count[SYS_IOCTL]++;
+    return real_ioctl(fd, request, arg);
+}
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+    static void* (*real_mmap)(void*, size_t, int, int, int, off_t) =
+        (void* (*)(void*, size_t, int, int, int, off_t))next_symbol("mmap");
+    g_sys_count[SYS_MMAP]++;
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void* addr, size_t length)
+{
+    static int (*real_munmap)(void*, size_t) = (int (*)(void*, size_t))next_symbol("munmap");
+    g_sys_count[SYS_MUNMAP]++;
+    return real_munmap(addr, length);
+}
+
+}  // extern "C"
+
+// The letterbox destination of the pre-persistent inference_yolov8_model(): allocated per frame
+static bool alloc_frame_buffer(rknn_app_context_t* app_ctx, image_buffer_t* dst_img)
+{
+    memset(dst_img, 0, sizeof(image_buffer_t));
+    dst_img->width = app_ctx->model_width;
+    dst_img->height = app_ctx->model_height;
+    dst_img->format = IMAGE_FORMAT_RGB888;
+    dst_img->size = get_image_size(dst_img);
+    bool is_dma = dma_buf_alloc(DMA_HEAP_DMA32_UNCACHE_PATCH, dst_img->size, &dst_img->fd,
+                                (void**)&dst_img->virt_addr) == 0;
+    if (!is_dma) {
+        dst_img->fd = 0;
+        dst_img->virt_addr = (unsigned char*)malloc(dst_img->size);
+    }
+    return is_dma;
+}
+
+static void free_frame_buffer(image_buffer_t* dst_img, bool is_dma)
+{
+    if (is_dma) {
+        dma_buf_free(dst_img->size, &dst_img->fd, dst_img->virt_addr);
+    } else {
+        free(dst_img->virt_addr);
+    }
+}
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// One frame; input_only stops once the model has its input (buffer, letterbox, set input), the part
+// that differs between the two paths, otherwise the whole inference
+static int run_frame(rknn_app_context_t* app_ctx, image_buffer_t* img, bool persistent, bool input_only,
+                     object_detect_result_list* od_results, double* letterbox_ms)
+{
+    letterbox_t letter_box;
+    memset(&letter_box, 0, sizeof(letterbox_t));
+    if (persistent) {
+        if (!input_only) {
+            return inference_yolov8_model(app_ctx, img, od_results);
+        }
+        double start = now_ms();
+        int ret = convert_image_with_letterbox(img, &app_ctx->input_img, &letter_box, 114);
+        *letterbox_ms = now_ms() - start;
+        return ret == 0 ? yolov8_set_input(app_ctx, &app_ctx->input_img) : ret;
+    }
+    image_buffer_t dst_img;
+    bool is_dma = alloc_frame_buffer(app_ctx, &dst_img);
+    double start = now_ms();
+    int ret = convert_image_with_letterbox(img, &dst_img, &letter_box, 114);
+    *letterbox_ms = now_ms() - start;
+    if (ret == 0) {
+        if (input_only) {
+            ret = yolov8_set_input(app_ctx, &dst_img);
+        } else {
+            ret = inference_yolov8_model_with_input(app_ctx, &dst_img, &letter_box, od_results);
+        }
+    }
+    free_frame_buffer(&dst_img, is_dma);
+    return ret;
+}
+
+static long minor_faults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+typedef struct {
+    const char* name;
+    bool persistent;
+    std::vector<double> input_ms;
+    std::vector<double> letterbox_ms;
+    std::vector<double> frame_ms;
+    long sys[SYS_NUM];
+    long faults;
+    long frames;
+} mode_stats_t;
+
+static void measure(rknn_app_context_t* app_ctx, image_buffer_t* src, mode_stats_t* mode, bool input_only,
+                    int frames)
+{
+    object_detect_result_list results;
+    for (int i = 0; i < frames; i++) {
+        long sys_before[SYS_NUM];
+        for (int k = 0; k < SYS_NUM; k++) {
+            sys_before[k] = g_sys_count[k];
+        }
+        long faults = minor_faults();
+        double letterbox_ms = 0;
+        double start = now_ms();
+        run_frame(app_ctx, src, mode->persistent, input_only, &results, &letterbox_ms);
+        double ms = now_ms() - start;
+        if (input_only) {
+            mode->input_ms.push_back(ms - letterbox_ms);
+            mode->letterbox_ms.push_back(letterbox_ms);
+        } else {
+            mode->frame_ms.push_back(ms);
+        }
+        if (!input_only) {
+            for (int k = 0; k < SYS_NUM; k++) {
+                mode->sys[k] += g_sys_count[k] - sys_before[k];
+            }
+            mode->faults += minor_faults() - faults;
+            mode->frames++;
+        }
+    }
+}
+
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) {
+        return 0;
+    }
+    size_t k = (size_t)(p / 100 * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static void report(const mode_stats_t* mode)
+{
+    long total = 0;
+    char detail[256];
+    int len = 0;
+    for (int i = 0; i < SYS_NUM; i++) {
+        total += mode->sys[i];
+        len += snprintf(detail + len, sizeof(detail) - len, " %s=%.1f", kSysNames[i],
+                        (float)mode->sys[i] / mode->frames);
+    }
+    printf("%-11s input p50=%6.3fms p90=%6.3fms (+ letterbox %6.3fms)  frame p50=%7.2fms  "
+           "syscalls/frame=%5.1f (%s ) page faults/frame=%7.1f\n",
+           mode->name, percentile(mode->input_ms, 50), percentile(mode->input_ms, 90),
+           percentile(mode->letterbox_ms, 50), percentile(mode->frame_ms, 50), (float)total / mode->frames, detail + 1,
+           (float)mode->faults / mode->frames);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [image_path] [frames]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* image_path = argc > 2 ? argv[2] : NULL;
+    int frames = argc > 3 ? atoi(argv[3]) : 100;
+
+    image_buffer_t src;
+    memset(&src, 0, sizeof(image_buffer_t));
+    if (image_path != NULL) {
+        if (read_image(image_path, &src) != 0) {
+            printf("read image %s fail!\n", image_path);
+            return -1;
+        }
+    } else {
+        src.width = 1920;
+        src.height = 1080;
+        src.format = IMAGE_FORMAT_RGB888;
+        src.size = get_image_size(&src);
+        src.virt_addr = (unsigned char*)calloc(1, src.size);
+    }
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        printf("init_yolov8_model fail! model_path=%s\n", model_path);
+        return -1;
+    }
+
+    mode_stats_t modes[2];
+    const char* names[2] = {"per frame", "persistent"};
+    for (int m = 0; m < 2; m++) {
+        modes[m].name = names[m];
+        modes[m].persistent = m == 1;
+        memset(modes[m].sys, 0, sizeof(modes[m].sys));
+        modes[m].faults = 0;
+        modes[m].frames = 0;
+        measure(&app_ctx, &src, &modes[m], false, 1);  // warm up
+        modes[m].frame_ms.clear();
+        memset(modes[m].sys, 0, sizeof(modes[m].sys));
+        modes[m].faults = 0;
+        modes[m].frames = 0;
+    }
+    // The modes take turns in short rounds, so a drift of the host (or of the simulated NPU) hits both
+    const int round = 10;
+    for (int done = 0; done < frames; done += round) {
+        int n = frames - done < round ? frames - done : round;
+        for (int m = 0; m < 2; m++) {
+            measure(&app_ctx, &src, &modes[m], true, n);
+            measure(&app_ctx, &src, &modes[m], false, n);
+        }
+    }
+    printf("\n");
+    for (int m = 0; m < 2; m++) {
+        report(&modes[m]);
+    }
+
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+    free(src.virt_addr);
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Model loading on its own: startup time and peak RSS of rknn_init for each load mode.
+// Every measurement runs in a fresh child process so the peak RSS (VmHWM) belongs to that load only.
+// Peak RSS counts mapped page cache too, the sampled peak of RssAnon shows the private copies alone.
+// "cold" drops the model file from the page cache first.
+//
+// Usage: bench_model_load <model_path> [runs]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "easy_timer.h"
+#include "model_loader.h"
+
+typedef struct {
+    int ok;
+    int mode;
+    float total_ms;
+    float read_ms;
+    float init_ms;
+    long base_kb;
+    long peak_kb;
+    long base_anon_kb;
+    long peak_anon_kb;
+} load_result_t;
+
+static long read_status_kb(const char* key)
+{
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    char line[256];
+    long kb = 0;
+    size_t len = strlen(key);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, key, len) == 0) {
+            kb = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+static void drop_page_cache(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static void child_load(const char* model_path, model_load_mode_t mode, int out_fd)
+{
+    load_result_t r;
+    memset(&r, 0, sizeof(r));
+    r.base_kb = read_status_kb("VmRSS");
+    r.base_anon_kb = read_status_kb("RssAnon");
+
+    // there is no high water mark for anonymous memory, sample it
+    std::atomic<bool> loading(true);
+    std::atomic<long> peak_anon(r.base_anon_kb);
+    std::thread sampler([&] {
+        while (loading) {
+            long kb = read_status_kb("RssAnon");
+            if (kb > peak_anon) {
+                peak_anon = kb;
+            }
+            usleep(500);
+        }
+    });
+
+    TIMER timer;
+    rknn_context ctx = 0;
+    model_load_info_t info;
+    timer.tik();
+    int ret = load_rknn_model(model_path, mode, 0, &ctx, &info);
+    timer.tok();
+    loading = false;
+    sampler.join();
+    r.peak_anon_kb = peak_anon;
+    if (ret == 0) {
+        r.ok = 1;
+        r.mode = info.mode;
+        r.total_ms = timer.get_time();
+        r.read_ms = info.read_ms;
+        r.init_ms = info.init_ms;
+        r.peak_kb = read_status_kb("VmHWM");
+        release_rknn_model(ctx, info.model_mem);
+    }
+    if (write(out_fd, &r, sizeof(r)) != sizeof(r)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+static int run_child(const char* model_path, model_load_mode_t mode, load_result_t* r)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        // keep the runtime logs of the child out of the table
+        if (freopen("/dev/null", "w", stdout) == NULL) {
+            _exit(1);
+        }
+        child_load(model_path, mode, fds[1]);
+    }
+    close(fds[1]);
+    int n = read(fds[0], r, sizeof(load_result_t));
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    return n == sizeof(load_result_t) && r->ok ? 0 : -1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [runs]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    model_load_mode_t modes[] = {MODEL_LOAD_HEAP, MODEL_LOAD_MMAP, MODEL_LOAD_ZERO_COPY};
+
+    printf("%-10s %-5s %-10s %10s %10s %10s %14s %14s\n", "mode", "cache", "used", "total ms", "read ms", "init ms",
+           "peak RSS +MB", "peak anon +MB");
+    for (int cold = 1; cold >= 0; cold--) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            load_result_t sum;
+            memset(&sum, 0, sizeof(sum));
+            int done = 0;
+            for (int i = 0; i < runs; i++) {
+                if (cold) {
+                    drop_page_cache(model_path);
+                }
+                load_result_t r;
+                if (run_child(model_path, modes[m], &r) != 0) {
+                    continue;
+                }
+                sum.mode = r.mode;
+                sum.total_ms += r.total_ms;
+                sum.read_ms += r.read_ms;
+                sum.init_ms += r.init_ms;
+                sum.peak_kb += r.peak_kb - r.base_kb;
+                sum.peak_anon_kb += r.peak_anon_kb - r.base_anon_kb;
+                done++;
+            }
+            if (done == 0) {
+                printf("%-10s %-5s load fail\n", get_model_load_mode_string(modes[m]), cold ? "cold" : "warm");
+                continue;
+            }
+            printf("%-10s %-5s %-10s %10.2f %10.2f %10.2f %14.1f %14.1f\n", get_model_load_mode_string(modes[m]),
+                   cold ? "cold" : "warm", get_model_load_mode_string((model_load_mode_t)sum.mode),
+                   sum.total_ms / done, sum.read_ms / done, sum.init_ms / done, sum.peak_kb / 1024.0 / done,
+                   sum.peak_anon_kb / 1024.0 / done);
+        }
+    }
+    return 0;
+}
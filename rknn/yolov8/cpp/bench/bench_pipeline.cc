@@ -0,0 +1,119 @@
+// Pipelined inference: throughput and per-stage latency of the three stage pipeline for one to three
+// buffer sets, against inference_yolov8_model() running letterbox, NPU and post process back to back.
+// Runs on the mock runtime (-DRKNN_MOCK=ON) or the cpu backend (INFER_BACKEND=cpu) on a host.
+//
+// Usage: bench_pipeline <model_path> [image_path] [frames]
+// Without image_path a synthetic 1920x1080 frame is used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "easy_timer.h"
+#include "image_utils.h"
+#include "yolov8.h"
+#include "yolov8_pipeline.h"
+
+static void on_result(void* user_data, int64_t frame_id, image_buffer_t* img, object_detect_result_list* od_results,
+                      int ret)
+{
+    long* objects = (long*)user_data;
+    (void)frame_id;
+    (void)img;  // the same source frame is submitted every time, nothing to release
+    if (ret == 0) {
+        *objects += od_results->count;
+    }
+}
+
+static void print_stats(const char* name, yolov8_pipeline_stats_t* stats)
+{
+    static const char* stage_names[PIPELINE_STAGE_NUM] = {"preprocess", "npu", "postprocess"};
+    printf("%-12s frames=%-4ld fps=%7.1f latency avg=%7.2fms max=%7.2fms\n", name, stats->frames, stats->fps,
+           stats->avg_latency_ms, stats->max_latency_ms);
+    for (int i = 0; i < PIPELINE_STAGE_NUM; i++) {
+        yolov8_pipeline_stage_stats_t* s = &stats->stages[i];
+        printf("  %-12s avg=%7.2fms max=%7.2fms\n", stage_names[i], s->avg_ms, s->max_ms);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [image_path] [frames]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* image_path = argc > 2 ? argv[2] : NULL;
+    int frames = argc > 3 ? atoi(argv[3]) : 100;
+
+    image_buffer_t src;
+    memset(&src, 0, sizeof(image_buffer_t));
+    if (image_path != NULL) {
+        if (read_image(image_path, &src) != 0) {
+            printf("read image %s fail!\n", image_path);
+            return -1;
+        }
+    } else {
+        src.width = 1920;
+        src.height = 1080;
+        src.format = IMAGE_FORMAT_RGB888;
+        src.size = get_image_size(&src);
+        src.virt_addr = (unsigned char*)malloc(src.size);
+        for (int i = 0; i < src.size; i++) {
+            src.virt_addr[i] = (unsigned char)(i * 7);
+        }
+    }
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        printf("init_yolov8_model fail! model_path=%s\n", model_path);
+        return -1;
+    }
+
+    // sequential reference, the stages of a frame run back to back
+    TIMER timer;
+    object_detect_result_list results;
+    inference_yolov8_model(&app_ctx, &src, &results);
+    timer.tik();
+    for (int i = 0; i < frames; i++) {
+        inference_yolov8_model(&app_ctx, &src, &results);
+    }
+    timer.tok();
+    printf("\n%-12s frames=%-4d fps=%7.1f latency avg=%7.2fms\n", "sequential", frames,
+           frames * 1000.0f / timer.get_time(), timer.get_time() / frames);
+
+    for (int buffers = 1; buffers <= 3; buffers++) {
+        yolov8_pipeline_config_t config;
+        yolov8_pipeline_config_default(&config);
+        config.num_buffers = buffers;
+        long objects = 0;
+        yolov8_pipeline_t* pipeline = yolov8_pipeline_create(&app_ctx, &config, on_result, &objects);
+        if (pipeline == NULL) {
+            break;
+        }
+        // warm up, then measure the steady state
+        for (int i = 0; i < buffers; i++) {
+            yolov8_pipeline_submit(pipeline, &src, i);
+        }
+        yolov8_pipeline_flush(pipeline);
+        yolov8_pipeline_reset_stats(pipeline);
+        for (int i = 0; i < frames; i++) {
+            yolov8_pipeline_submit(pipeline, &src, i);
+        }
+        yolov8_pipeline_flush(pipeline);
+
+        yolov8_pipeline_stats_t stats;
+        yolov8_pipeline_get_stats(pipeline, &stats);
+        char name[32];
+        snprintf(name, sizeof(name), "pipeline x%d", buffers);
+        print_stats(name, &stats);
+        yolov8_pipeline_destroy(pipeline);
+    }
+
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+    free(src.virt_addr);
+    return 0;
+}
@@ -0,0 +1,156 @@
+// End to end frame rate from a recording instead of a camera: frames replayed through the V4L2 capture
+// API (utils/v4l2_capture.h, raw frames recorded with V4L2_CAPTURE_RECORD or a MJPEG clip) go into the
+// three stage pipeline without a copy and are released in its result callback.
+//   fast      every frame as soon as the pipeline takes it: the same frames in the same order on every
+//             run, so fps can be compared between builds and the detection checksum must not change
+//   realtime  frames at their recorded timestamps, frames the pipeline is too slow for are dropped as
+//             a camera would
+// Runs on the mock runtime (-DRKNN_MOCK=ON) or the cpu backend (INFER_BACKEND=cpu) on a host; there the
+// letterbox has no RGA for NV12, replay RGB3 recordings.
+//
+// Usage: bench_replay <model_path> <recording> [width] [height] [NV12|RGB3|GREY] [frames] [realtime|fast]
+// frames defaults to one pass over the recording.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/videodev2.h>
+
+#include "v4l2_capture.h"
+#include "yolov8.h"
+#include "yolov8_pipeline.h"
+
+struct Result {
+    long objects;
+    uint64_t checksum;          // order independent, frames may complete in any order
+    double e2e_sum_ms;          // frame due to result
+    double e2e_max_ms;
+};
+
+static int64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void on_result(void* user_data, int64_t frame_id, image_buffer_t* img, object_detect_result_list* od_results,
+                      int ret)
+{
+    Result* result = (Result*)user_data;
+    (void)frame_id;  // the capture sequence identifies the frame across runs
+    v4l2_frame_t* frame = (v4l2_frame_t*)img;  // image is the first member
+    double e2e_ms = (monotonic_us() - frame->timestamp_us) / 1000.0;
+    result->e2e_sum_ms += e2e_ms;
+    if (e2e_ms > result->e2e_max_ms) {
+        result->e2e_max_ms = e2e_ms;
+    }
+    if (ret == 0) {
+        result->objects += od_results->count;
+        uint64_t hash = frame->sequence;
+        for (int i = 0; i < od_results->count; i++) {
+            object_detect_result* det = &od_results->results[i];
+            hash = hash * 31 + det->cls_id;
+            hash = hash * 31 + (uint32_t)(det->box.left + det->box.top * 4099 + det->box.right * 8191 +
+                                          det->box.bottom * 16381);
+        }
+        result->checksum += hash;
+    }
+    v4l2_frame_release(frame);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("%s <model_path> <recording> [width] [height] [NV12|RGB3|GREY] [frames] [realtime|fast]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* recording = argv[2];
+
+    yolov8_pipeline_config_t pipeline_config;
+    yolov8_pipeline_config_default(&pipeline_config);
+
+    v4l2_capture_config_t config;
+    v4l2_capture_config_default(&config);
+    config.width = argc > 3 ? atoi(argv[3]) : 1920;
+    config.height = argc > 4 ? atoi(argv[4]) : 1080;
+    if (argc > 5 && strlen(argv[5]) == 4) {
+        config.pixel_format = v4l2_fourcc(argv[5][0], argv[5][1], argv[5][2], argv[5][3]);
+    }
+    int frames = argc > 6 ? atoi(argv[6]) : 0;
+    config.replay_realtime = argc > 7 && strcmp(argv[7], "fast") == 0 ? 0 : 1;
+    config.replay_loops = frames > 0 ? 0 : 1;
+    // frames queued and in the stages, plus the one being dequeued
+    config.num_buffers = pipeline_config.queue_depth + pipeline_config.num_buffers + 2;
+
+    v4l2_capture_t* capture = v4l2_capture_open(recording, &config);
+    if (capture == NULL) {
+        return -1;
+    }
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        printf("init_yolov8_model fail! model_path=%s\n", model_path);
+        v4l2_capture_close(capture);
+        return -1;
+    }
+
+    Result result;
+    memset(&result, 0, sizeof(Result));
+    yolov8_pipeline_t* pipeline = yolov8_pipeline_create(&app_ctx, &pipeline_config, on_result, &result);
+    if (pipeline == NULL) {
+        release_yolov8_model(&app_ctx);
+        v4l2_capture_close(capture);
+        return -1;
+    }
+
+    v4l2_capture_start(capture);
+    long submitted = 0;
+    int64_t start_us = monotonic_us();
+    while (frames <= 0 || submitted < frames) {
+        v4l2_frame_t* frame;
+        int ret = v4l2_capture_dequeue(capture, &frame, 3000);
+        if (ret == -2) {
+            printf("no frame for 3s\n");
+            break;
+        }
+        if (ret != 0) {
+            break;  // -3: end of the recording
+        }
+        // blocks while the pipeline is full, which is what paces a fast replay
+        if (yolov8_pipeline_submit(pipeline, &frame->image, submitted) != 0) {
+            v4l2_frame_release(frame);
+            break;
+        }
+        submitted++;
+    }
+    yolov8_pipeline_flush(pipeline);
+    double elapsed_s = (monotonic_us() - start_us) / 1e6;
+
+    v4l2_capture_stats_t capture_stats;
+    v4l2_capture_get_stats(capture, &capture_stats);
+    yolov8_pipeline_stats_t stats;
+    yolov8_pipeline_get_stats(pipeline, &stats);
+    yolov8_pipeline_destroy(pipeline);
+    v4l2_capture_stop(capture);
+    v4l2_capture_close(capture);
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+
+    printf("%-8s frames=%-5ld fps=%7.1f end to end avg=%7.2fms max=%7.2fms dropped=%llu failed=%ld\n",
+           config.replay_realtime ? "realtime" : "fast", stats.frames, elapsed_s > 0 ? stats.frames / elapsed_s : 0.0,
+           stats.frames > 0 ? result.e2e_sum_ms / stats.frames : 0.0, result.e2e_max_ms,
+           (unsigned long long)capture_stats.dropped, stats.failed);
+    printf("objects=%ld checksum=%016llx\n", result.objects, (unsigned long long)result.checksum);
+    // the checksum only covers the frames that ran, it is no reference with failed ones
+    if (stats.failed > 0) {
+        printf("%ld of %ld frames failed%s\n", stats.failed, stats.frames,
+               config.pixel_format != V4L2_PIX_FMT_RGB24 ? ", replay an RGB3 recording where there is no RGA" : "");
+        return -1;
+    }
+    return stats.frames > 0 ? 0 : -1;
+}
@@ -0,0 +1,118 @@
+// Tiled inference on 4K frames: tiles/sec and end-to-end latency, against whole-frame letterbox inference.
+//
+// Usage: bench_tiled <model_path> [image_path] [iterations]
+// Without image_path a synthetic 3840x2160 frame is used, smaller images are scaled up to 4K.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "easy_timer.h"
+#include "image_utils.h"
+#include "yolov8.h"
+#include "yolov8_tiled.h"
+
+#define FRAME_WIDTH 3840
+#define FRAME_HEIGHT 2160
+
+static void print_latency(const char* name, std::vector<float>& ms, int tiles_per_frame)
+{
+    std::sort(ms.begin(), ms.end());
+    float sum = 0;
+    for (size_t i = 0; i < ms.size(); i++) {
+        sum += ms[i];
+    }
+    float avg = sum / ms.size();
+    printf("%-12s frames=%-4d avg=%8.2f ms p50=%8.2f ms p99=%8.2f ms max=%8.2f ms tiles/sec=%8.1f\n", name,
+           (int)ms.size(), avg, ms[ms.size() / 2], ms[(ms.size() * 99) / 100], ms.back(),
+           tiles_per_frame * 1000.0f / avg);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("%s <model_path> [image_path] [iterations]\n", argv[0]);
+        return -1;
+    }
+    const char* model_path = argv[1];
+    const char* image_path = argc > 2 ? argv[2] : NULL;
+    int iterations = argc > 3 ? atoi(argv[3]) : 20;
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(rknn_app_context_t));
+    init_post_process();
+    if (init_yolov8_model(model_path, &app_ctx) != 0) {
+        printf("init_yolov8_model fail! model_path=%s\n", model_path);
+        return -1;
+    }
+
+    image_buffer_t frame;
+    memset(&frame, 0, sizeof(image_buffer_t));
+    frame.width = FRAME_WIDTH;
+    frame.height = FRAME_HEIGHT;
+    frame.format = IMAGE_FORMAT_RGB888;
+    frame.size = get_image_size(&frame);
+    frame.virt_addr = (unsigned char*)malloc(frame.size);
+    if (image_path != NULL) {
+        image_buffer_t src;
+        memset(&src, 0, sizeof(image_buffer_t));
+        if (read_image(image_path, &src) != 0) {
+            printf("read image fail! image_path=%s\n", image_path);
+            return -1;
+        }
+        convert_image(&src, &frame, NULL, NULL, 0);
+        free(src.virt_addr);
+    } else {
+        for (int y = 0; y < FRAME_HEIGHT; y++) {
+            for (int x = 0; x < FRAME_WIDTH; x++) {
+                unsigned char* p = frame.virt_addr + (y * FRAME_WIDTH + x) * 3;
+                p[0] = (unsigned char)x;
+                p[1] = (unsigned char)y;
+                p[2] = (unsigned char)(x ^ y);
+            }
+        }
+    }
+
+    object_detect_result_list results;
+    TIMER timer;
+
+    std::vector<float> whole_ms;
+    for (int i = 0; i < iterations; i++) {
+        timer.tik();
+        inference_yolov8_model(&app_ctx, &frame, &results);
+        timer.tok();
+        whole_ms.push_back(timer.get_time());
+    }
+    int whole_count = results.count;
+
+    yolov8_tile_config_t config;
+    yolov8_tile_config_default(&config);
+    yolov8_tile_stats_t stats;
+    std::vector<float> tiled_ms;
+    float pre = 0, infer = 0, merge = 0;
+    for (int i = 0; i < iterations; i++) {
+        timer.tik();
+        inference_yolov8_model_tiled(&app_ctx, &frame, &config, &results, &stats);
+        timer.tok();
+        tiled_ms.push_back(timer.get_time());
+        pre += stats.preprocess_ms;
+        infer += stats.inference_ms;
+        merge += stats.merge_ms;
+    }
+
+    printf("\n4K frame %dx%d, model %dx%d, %d tiles (%d row gathered), overlap %.2f\n", FRAME_WIDTH, FRAME_HEIGHT,
+           app_ctx.model_width, app_ctx.model_height, stats.num_tiles, stats.num_views, config.overlap);
+    print_latency("whole frame", whole_ms, 1);
+    print_latency("tiled", tiled_ms, stats.num_tiles + (config.full_frame ? 1 : 0));
+    printf("tiled stages: preprocess=%.3f ms inference=%.3f ms merge=%.3f ms\n", pre / iterations,
+           infer / iterations, merge / iterations);
+    printf("detections: whole frame=%d tiled=%d\n", whole_count, results.count);
+
+    free(frame.virt_addr);
+    release_yolov8_model(&app_ctx);
+    deinit_post_process();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#ifndef _RKNN_DEMO_BOUNDED_QUEUE_H_
+#define _RKNN_DEMO_BOUNDED_QUEUE_H_
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Blocking FIFO with a fixed capacity, push waits while full and pop waits while empty.
+// After close() pushes fail and pops drain the remaining items, then fail. The items live in a
+// ring allocated once, T must be default constructible and copyable.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : items_(capacity > 0 ? capacity : 1), head_(0), count_(0), closed_(false) {}
+
+    bool push(const T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return closed_ || count_ < items_.size(); });
+        if (closed_) {
+            return false;
+        }
+        items_[(head_ + count_) % items_.size()] = item;
+        count_++;
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T* item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || count_ > 0; });
+        if (count_ == 0) {
+            return false;
+        }
+        take(item);
+        not_full_.notify_one();
+        return true;
+    }
+
+    // pop without waiting, false when empty
+    bool try_pop(T* item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == 0) {
+            return false;
+        }
+        take(item);
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+private:
+    void take(T* item)
+    {
+        *item = items_[head_];
+        head_ = (head_ + 1) % items_.size();
+        count_--;
+    }
+
+    std::vector<T> items_;
+    size_t head_;
+    size_t count_;
+    bool closed_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+#endif //_RKNN_DEMO_BOUNDED_QUEUE_H_
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "infer_backend.h"
+#include "file_utils.h"
+
+infer_backend_t* infer_backend_create(const char* name)
+{
+    if (name == NULL) {
+        name = getenv("INFER_BACKEND");
+    }
+    if (name == NULL || name[0] == '\0') {
+        name = "rknn";
+    }
+
+    const infer_backend_ops_t* ops = NULL;
+    if (strcmp(name, "rknn") == 0) {
+        ops = get_rknn_backend_ops();
+    } else if (strcmp(name, "cpu") == 0) {
+        ops = get_cpu_backend_ops();
+    } else {
+        printf("unknown inference backend %s\n", name);
+        return NULL;
+    }
+    infer_backend_t* backend = (infer_backend_t*)calloc(1, sizeof(infer_backend_t));
+    if (backend == NULL) {
+        return NULL;
+    }
+    backend->ops = ops;
+    return backend;
+}
+
+void infer_backend_destroy(infer_backend_t* backend)
+{
+    if (backend == NULL) {
+        return;
+    }
+    backend->ops->release(backend);
+    free(backend);
+}
+
+const char* infer_backend_name(infer_backend_t* backend)
+{
+    return backend->ops->name;
+}
+
+int infer_backend_load(infer_backend_t* backend, const char* model_path)
+{
+    return backend->ops->load(backend, model_path);
+}
+
+int infer_backend_query_io_num(infer_backend_t* backend, rknn_input_output_num* io_num)
+{
+    return backend->ops->query_io_num(backend, io_num);
+}
+
+int infer_backend_query_input_attr(infer_backend_t* backend, rknn_tensor_attr* attr)
+{
+    return backend->ops->query_input_attr(backend, attr);
+}
+
+int infer_backend_query_output_attr(infer_backend_t* backend, rknn_tensor_attr* attr)
+{
+    return backend->ops->query_output_attr(backend, attr);
+}
+
+int infer_backend_inputs_set(infer_backend_t* backend, uint32_t n_inputs, rknn_input inputs[])
+{
+    if (backend->input_mode == INFER_INPUT_MODE_BOUND) {
+        printf("%s backend: inputs_set on an input bound with bind_input\n", backend->ops->name);
+        return -1;
+    }
+    backend->input_mode = INFER_INPUT_MODE_COPY;
+    return backend->ops->inputs_set(backend, n_inputs, inputs);
+}
+
+int infer_backend_run(infer_backend_t* backend)
+{
+    return backend->ops->run(backend);
+}
+
+int infer_backend_outputs_get(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[])
+{
+    return backend->ops->outputs_get(backend, n_outputs, outputs);
+}
+
+int infer_backend_outputs_release(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[])
+{
+    return backend->ops->outputs_release(backend, n_outputs, outputs);
+}
+
+void* infer_backend_bind_input(infer_backend_t* backend, int fd, void* virt_addr, uint32_t size)
+{
+    if (backend->ops->bind_input == NULL) {
+        return NULL;
+    }
+    if (backend->input_mode == INFER_INPUT_MODE_COPY) {
+        printf("%s backend: bind_input on an input given with inputs_set\n", backend->ops->name);
+        return NULL;
+    }
+    void* addr = backend->ops->bind_input(backend, fd, virt_addr, size);
+    if (addr != NULL) {
+        backend->input_mode = INFER_INPUT_MODE_BOUND;
+    }
+    return addr;
+}
+
+int infer_backend_select_input(infer_backend_t* backend, void* virt_addr)
+{
+    if (backend->input_mode != INFER_INPUT_MODE_BOUND || backend->ops->select_input == NULL) {
+        return -1;
+    }
+    return backend->ops->select_input(backend, virt_addr);
+}
+
+void infer_backend_unbind_input(infer_backend_t* backend, void* virt_addr)
+{
+    if (backend->input_mode != INFER_INPUT_MODE_BOUND || backend->ops->unbind_input == NULL) {
+        return;
+    }
+    backend->ops->unbind_input(backend, virt_addr);
+}
+
+int infer_backend_run_async(infer_backend_t* backend, uint64_t* frame_id)
+{
+    if (backend->ops->run_async == NULL) {
+        *frame_id = 0;
+        return backend->ops->run(backend);
+    }
+    return backend->ops->run_async(backend, frame_id);
+}
+
+int infer_backend_wait(infer_backend_t* backend, uint64_t frame_id, int timeout_ms)
+{
+    if (backend->ops->wait == NULL) {
+        return 0;
+    }
+    return backend->ops->wait(backend, frame_id, timeout_ms);
+}
+
+int infer_backend_query_input_range(infer_backend_t* backend, rknn_input_range* range)
+{
+    if (backend->ops->query_input_range == NULL) {
+        return -1;
+    }
+    return backend->ops->query_input_range(backend, range);
+}
+
+int infer_backend_set_input_shapes(infer_backend_t* backend, uint32_t n_inputs, rknn_tensor_attr attrs[])
+{
+    if (backend->ops->set_input_shapes == NULL) {
+        return -1;
+    }
+    return backend->ops->set_input_shapes(backend, n_inputs, attrs);
+}
+
+int infer_backend_query(infer_backend_t* backend, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    if (backend->ops->query == NULL) {
+        return -1;
+    }
+    return backend->ops->query(backend, cmd, info, size);
+}
+
+int infer_backend_record(infer_backend_t* backend, const char* dir)
+{
+    rknn_input_output_num io_num;
+    int ret = infer_backend_query_io_num(backend, &io_num);
+    if (ret < 0) {
+        return -1;
+    }
+    std::vector<rknn_tensor_attr> attrs(io_num.n_input + io_num.n_output);
+    for (uint32_t i = 0; i < attrs.size(); i++) {
+        memset(&attrs[i], 0, sizeof(rknn_tensor_attr));
+        if (i < io_num.n_input) {
+            attrs[i].index = i;
+            ret = infer_backend_query_input_attr(backend, &attrs[i]);
+        } else {
+            attrs[i].index = i - io_num.n_input;
+            ret = infer_backend_query_output_attr(backend, &attrs[i]);
+        }
+        if (ret < 0) {
+            printf("query tensor %d fail! ret=%d\n", i, ret);
+            return -1;
+        }
+    }
+
+    // attrs.bin: rknn_input_output_num followed by the input and output attributes
+    char path[512];
+    snprintf(path, sizeof(path), "%s/attrs.bin", dir);
+    std::vector<char> header(sizeof(io_num) + attrs.size() * sizeof(rknn_tensor_attr));
+    memcpy(&header[0], &io_num, sizeof(io_num));
+    memcpy(&header[sizeof(io_num)], &attrs[0], attrs.size() * sizeof(rknn_tensor_attr));
+    if (write_data_to_file(path, &header[0], header.size()) < 0) {
+        return -1;
+    }
+
+    std::vector<rknn_output> outputs(io_num.n_output);
+    memset(&outputs[0], 0, outputs.size() * sizeof(rknn_output));
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+        outputs[i].index = i;
+        outputs[i].want_float = 0;
+    }
+    ret = infer_backend_outputs_get(backend, io_num.n_output, &outputs[0]);
+    if (ret < 0) {
+        printf("outputs_get fail! ret=%d\n", ret);
+        return -1;
+    }
+    for (uint32_t i = 0; i < io_num.n_output && ret >= 0; i++) {
+        snprintf(path, sizeof(path), "%s/output%d.bin", dir, i);
+        ret = write_data_to_file(path, (const char*)outputs[i].buf, outputs[i].size);
+    }
+    infer_backend_outputs_release(backend, io_num.n_output, &outputs[0]);
+    return ret < 0 ? -1 : 0;
+}
@@ -0,0 +1,144 @@
+#ifndef _RKNN_DEMO_INFER_BACKEND_H_
+#define _RKNN_DEMO_INFER_BACKEND_H_
+
+#include "rknn_api.h"
+
+// Tensors are described with the rknn_api.h types (rknn_tensor_attr, rknn_input, rknn_output) whatever
+// the backend, so pre and post processing do not change. Only the header is needed for that, a backend
+// other than "rknn" does not call into librknnrt.
+
+typedef struct infer_backend_t infer_backend_t;
+
+typedef struct {
+    const char* name;
+    int (*load)(infer_backend_t* backend, const char* model_path);
+    void (*release)(infer_backend_t* backend);
+    int (*query_io_num)(infer_backend_t* backend, rknn_input_output_num* io_num);
+    int (*query_input_attr)(infer_backend_t* backend, rknn_tensor_attr* attr);    // attr->index selects the tensor
+    int (*query_output_attr)(infer_backend_t* backend, rknn_tensor_attr* attr);
+    int (*inputs_set)(infer_backend_t* backend, uint32_t n_inputs, rknn_input inputs[]);
+    int (*run)(infer_backend_t* backend);
+    // same contract as rknn_outputs_get: buf is owned by the backend until outputs_release unless is_prealloc
+    int (*outputs_get)(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[]);
+    int (*outputs_release)(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[]);
+    // optional, NULL: not supported, see infer_backend_bind_input()
+    void* (*bind_input)(infer_backend_t* backend, int fd, void* virt_addr, uint32_t size);
+    int (*select_input)(infer_backend_t* backend, void* virt_addr);
+    void (*unbind_input)(infer_backend_t* backend, void* virt_addr);
+    // optional, NULL: run blocks, see infer_backend_run_async()
+    int (*run_async)(infer_backend_t* backend, uint64_t* frame_id);
+    int (*wait)(infer_backend_t* backend, uint64_t frame_id, int timeout_ms);
+    // optional, NULL: static input shapes. The attribute queries report the shape set last.
+    int (*query_input_range)(infer_backend_t* backend, rknn_input_range* range);   // range->index selects the input
+    int (*set_input_shapes)(infer_backend_t* backend, uint32_t n_inputs, rknn_tensor_attr attrs[]);
+    // optional, NULL: nothing to report. rknn_query() commands, e.g. RKNN_QUERY_PERF_RUN
+    int (*query)(infer_backend_t* backend, rknn_query_cmd cmd, void* info, uint32_t size);
+} infer_backend_ops_t;
+
+// per-layer timings for RKNN_QUERY_PERF_DETAIL (RKNN_FLAG_COLLECT_PERF_MASK), slows runs down
+#define INFER_BACKEND_FLAG_COLLECT_PERF 0x1
+
+// How input 0 reaches the backend, fixed by the first inputs_set or bind_input
+typedef enum {
+    INFER_INPUT_MODE_NONE = 0,
+    INFER_INPUT_MODE_COPY,      // infer_backend_inputs_set() per frame
+    INFER_INPUT_MODE_BOUND,     // buffers bound with infer_backend_bind_input(), one selected per frame
+} infer_input_mode_t;
+
+struct infer_backend_t {
+    const infer_backend_ops_t* ops;
+    void* priv;
+    uint32_t flags;       // INFER_BACKEND_FLAG_*, set before load
+    infer_input_mode_t input_mode;
+};
+
+const infer_backend_ops_t* get_rknn_backend_ops();
+
+/**
+ * Deterministic CPU reference: replays tensors recorded with infer_backend_record() when the model
+ * path is such a directory, otherwise runs a tiny fixed-weight conv model (stride 8/16/32 average pool +
+ * 1x1 conv) with the yolov8 output layout of the model zoo. Bright areas score as class 0.
+ */
+const infer_backend_ops_t* get_cpu_backend_ops();
+
+/**
+ * Create a backend by name: "rknn" or "cpu". NULL takes the INFER_BACKEND environment variable,
+ * "rknn" if it is not set. Returns NULL for an unknown name.
+ */
+infer_backend_t* infer_backend_create(const char* name);
+
+// Wrap an existing rknn context (e.g. from rknn_dup_context), the backend owns ctx and model_mem afterwards
+infer_backend_t* infer_backend_wrap_rknn(rknn_context ctx, rknn_tensor_mem* model_mem);
+
+// rknn context of an "rknn" backend, 0 for the others
+rknn_context infer_backend_get_rknn_context(infer_backend_t* backend);
+
+// Release the model and free the backend
+void infer_backend_destroy(infer_backend_t* backend);
+
+const char* infer_backend_name(infer_backend_t* backend);
+
+int infer_backend_load(infer_backend_t* backend, const char* model_path);
+
+int infer_backend_query_io_num(infer_backend_t* backend, rknn_input_output_num* io_num);
+
+int infer_backend_query_input_attr(infer_backend_t* backend, rknn_tensor_attr* attr);
+
+int infer_backend_query_output_attr(infer_backend_t* backend, rknn_tensor_attr* attr);
+
+int infer_backend_inputs_set(infer_backend_t* backend, uint32_t n_inputs, rknn_input inputs[]);
+
+int infer_backend_run(infer_backend_t* backend);
+
+int infer_backend_outputs_get(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[]);
+
+int infer_backend_outputs_release(infer_backend_t* backend, uint32_t n_outputs, rknn_output outputs[]);
+
+/**
+ * Bind a buffer the caller writes as memory input 0 can be read from, so no inputs_set copy is
+ * needed per frame: the dma_buf fd / virt_addr, the caller's virt_addr when fd < 0 (only backends
+ * that read any memory, e.g. cpu) or memory of the backend when virt_addr is NULL too. Bind every
+ * buffer once (e.g. each one of a frame pool) and pick the one of a run with infer_backend_select_input().
+ * Returns the address to write the uint8 NHWC input to, NULL when the backend can not bind it.
+ * A backend with bound buffers only reads those: inputs_set fails afterwards, and binding fails
+ * once inputs_set was used. A binding lasts until unbind or destroy, a dma_buf must outlive it.
+ */
+void* infer_backend_bind_input(infer_backend_t* backend, int fd, void* virt_addr, uint32_t size);
+
+// Make the following runs read the bound buffer at virt_addr (rknn_set_io_mem), -1 if it is not bound
+int infer_backend_select_input(infer_backend_t* backend, void* virt_addr);
+
+// Drop the binding of the buffer at virt_addr, before it is freed
+void infer_backend_unbind_input(infer_backend_t* backend, void* virt_addr);
+
+/**
+ * Start a run without waiting for it, frame_id identifies it for infer_backend_wait(). Inputs must
+ * not change and outputs not be read before the wait returned. Backends without asynchronous runs
+ * run to completion here (frame_id 0).
+ */
+int infer_backend_run_async(infer_backend_t* backend, uint64_t* frame_id);
+
+// Wait for a run started with infer_backend_run_async(), timeout_ms <= 0 waits forever.
+// RKNN_ERR_TIMEOUT when it did not finish in time.
+int infer_backend_wait(infer_backend_t* backend, uint64_t frame_id, int timeout_ms);
+
+/**
+ * Input shapes a dynamic shape model was exported with (RKNN_QUERY_INPUT_DYNAMIC_RANGE), -1 when
+ * the backend or the model has static shapes.
+ */
+int infer_backend_query_input_range(infer_backend_t* backend, rknn_input_range* range);
+
+// Run the following frames with these input shapes (one of the ranges), the input and output
+// attributes change with them. -1 for static shapes.
+int infer_backend_set_input_shapes(infer_backend_t* backend, uint32_t n_inputs, rknn_tensor_attr attrs[]);
+
+// rknn_query() on the model, for the performance and memory reports. -1 when the backend has none.
+int infer_backend_query(infer_backend_t* backend, rknn_query_cmd cmd, void* info, uint32_t size);
+
+/**
+ * Write the attributes and the raw outputs of the last run to dir (attrs.bin, output<i>.bin), for
+ * the cpu backend to replay. E.g. record on the board, replay on a dev machine.
+ */
+int infer_backend_record(infer_backend_t* backend, const char* dir);
+
+#endif //_RKNN_DEMO_INFER_BACKEND_H_
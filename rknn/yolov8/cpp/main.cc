@@ -19,8 +19,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "yolov8.h"
+#include "yolov8_tiled.h"
+#include "yolov8_batch.h"
+#include "yolov8_profile.h"
 #include "image_utils.h"
 #include "file_utils.h"
 #include "image_drawing.h"
@@ -29,24 +33,76 @@
     #include "dma_alloc.hpp"
 #endif
 
+/*-------------------------------------------
+                  Batch Mode
+-------------------------------------------*/
+static int run_batch(const char *model_path, const char *input_path, const char *output_path)
+{
+    bool is_list = input_path[0] == '@';
+    std::vector<std::string> files;
+    if (yolov8_batch_list_files(is_list ? input_path + 1 : input_path, is_list, &files) != 0 || files.empty())
+    {
+        printf("no image found in %s\n", input_path);
+        return -1;
+    }
+    printf("batch: %d images\n", (int)files.size());
+
+    yolov8_batch_config_t config;
+    yolov8_batch_config_default(&config);
+    config.output_path = output_path;
+
+    init_post_process();
+    yolov8_batch_stats_t stats;
+    int ret = run_yolov8_batch(model_path, files, &config, &stats);
+    deinit_post_process();
+    if (ret != 0)
+    {
+        printf("run_yolov8_batch fail! ret=%d\n", ret);
+        return -1;
+    }
+    yolov8_batch_print_stats(&stats);
+    return 0;
+}
+
+static bool is_directory(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    if (argc != 3 && argc != 4)
     {
-        printf("%s <model_path> <image_path>\n", argv[0]);
+        printf("%s <model_path> <image_path> [tiled]\n", argv[0]);
+        printf("%s <model_path> <image_dir | @file_list> [result.jsonl]\n", argv[0]);
         return -1;
     }
 
     const char *model_path = argv[1];
     const char *image_path = argv[2];
+    if (image_path[0] == '@' || is_directory(image_path))
+    {
+        return run_batch(model_path, image_path, argc == 4 ? argv[3] : NULL);
+    }
+    bool tiled = argc == 4 && strcmp(argv[3], "tiled") == 0;
 
     int ret;
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
 
+#if !defined(ZERO_COPY) && !defined(RV1106_1103) && !defined(RKNPU1)
+    // stage, NPU and per-layer timings, written as JSON, CSV or Chrome trace depending on the file name
+    const char *profile_path = getenv("YOLOV8_PROFILE");
+    if (profile_path != NULL)
+    {
+        rknn_app_ctx.profile = yolov8_profile_create(NULL);
+    }
+#endif
+
     init_post_process();
 
     ret = init_yolov8_model(model_path, &rknn_app_ctx);
@@ -80,13 +136,39 @@ int main(int argc, char **argv)
 
     object_detect_result_list od_results;
 
-    ret = inference_yolov8_model(&rknn_app_ctx, &src_image, &od_results);
+    if (tiled)
+    {
+        yolov8_tile_stats_t tile_stats;
+        ret = inference_yolov8_model_tiled(&rknn_app_ctx, &src_image, NULL, &od_results, &tile_stats);
+        printf("tiles=%d (row gathered %d) preprocess=%.3fms inference=%.2fms merge=%.3fms\n", tile_stats.num_tiles,
+               tile_stats.num_views, tile_stats.preprocess_ms, tile_stats.inference_ms, tile_stats.merge_ms);
+    }
+    else
+    {
+        ret = inference_yolov8_model(&rknn_app_ctx, &src_image, &od_results);
+#if !defined(ZERO_COPY) && !defined(RV1106_1103) && !defined(RKNPU1)
+        // dump the raw outputs for the cpu backend to replay on a host
+        const char *record_dir = getenv("INFER_BACKEND_RECORD");
+        if (ret == 0 && record_dir != NULL && infer_backend_record(rknn_app_ctx.backend, record_dir) == 0)
+        {
+            printf("outputs recorded to %s\n", record_dir);
+        }
+#endif
+    }
     if (ret != 0)
     {
         printf("init_yolov8_model fail! ret=%d\n", ret);
         goto out;
     }
 
+#if !defined(ZERO_COPY) && !defined(RV1106_1103) && !defined(RKNPU1)
+    if (rknn_app_ctx.profile != NULL &&
+        yolov8_profile_export(rknn_app_ctx.profile, profile_path, yolov8_profile_format_from_path(profile_path)) == 0)
+    {
+        printf("profile written to %s\n", profile_path);
+    }
+#endif
+
     // 画框和概率
     char text[256];
     for (int i = 0; i < od_results.count; i++)
@@ -117,6 +199,9 @@ out:
     {
         printf("release_yolov8_model fail! ret=%d\n", ret);
     }
+#if !defined(ZERO_COPY) && !defined(RV1106_1103) && !defined(RKNPU1)
+    yolov8_profile_destroy(rknn_app_ctx.profile);
+#endif
 
     if (src_image.virt_addr != NULL)
     {
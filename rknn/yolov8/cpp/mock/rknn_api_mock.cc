@@ -0,0 +1,770 @@
+// Mock of the rknn runtime (librknnrt) for host builds.
+//
+// Exposes a yolov8 model as exported by the model zoo: one 640x640x3 uint8 NHWC input and 9 int8
+// outputs (box / score / score_sum for strides 8, 16 and 32). rknn_run sleeps for the configured NPU
+// time on one of the simulated cores and writes one synthetic detection, so preprocessing,
+// postprocessing and scheduling can be run and benchmarked without a board. The model file is not
+// parsed, rknn_init copies it like the runtime does (or keeps the caller's buffer with
+// RKNN_FLAG_MODEL_BUFFER_ZERO_COPY).
+//
+// Environment:
+//   RKNN_MOCK_RUN_US     NPU time of one rknn_run in microseconds (default 20000)
+//   RKNN_MOCK_RUN_JITTER_US  random extra NPU time per run, 0 to this value (default 0)
+//   RKNN_MOCK_CORES      number of simulated NPU cores (default 3), runs beyond that wait for a core
+//                        that rknn_set_core_mask allows
+//   RKNN_MOCK_INPUT      model input width and height (default 640)
+//   RKNN_MOCK_SHAPES     dynamic input shapes, e.g. "640x640,640x384" (WxH, the first is set at init),
+//                        for rknn_set_input_shapes; the NPU time scales with the input area
+//
+// RKNN_QUERY_PERF_DETAIL (with RKNN_FLAG_COLLECT_PERF_MASK) returns a synthetic per-layer table in the
+// format of the runtime: the simulated NPU time of the last run split over yolov8 like layers.
+//
+// rknn_run with extend->non_block queues the run on a thread of the context and returns its frame
+// id, rknn_wait / rknn_outputs_get wait for it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rknn_api.h"
+#include "rknn_mock.h"
+
+#define MOCK_NUM_CLASS 80
+#define MOCK_DFL_LEN 16
+#define MOCK_MAX_CORES 8
+
+static const int kStrides[3] = {8, 16, 32};
+
+typedef struct {
+    rknn_tensor_attr attr;
+    std::vector<int8_t> data;        // used when no memory is bound with rknn_set_io_mem
+    std::vector<float> data_float;   // for want_float outputs
+    rknn_tensor_mem* io_mem;
+} mock_tensor_t;
+
+typedef struct {
+    mock_tensor_t input;
+    mock_tensor_t outputs[9];
+    uint32_t flag;
+    int core_mask;                   // RKNN_NPU_CORE_AUTO: any core
+    unsigned int seed;
+    std::vector<int> shapes;         // dynamic input shapes: height, width pairs, empty for a static model
+    std::vector<char> weights;       // the runtime's copy of the model
+    uint32_t model_size;
+    int64_t last_run_us;             // simulated NPU time of the last run
+    std::string perf_detail;         // returned by RKNN_QUERY_PERF_DETAIL
+    const void* model_buffer;        // zero copy model buffer or the weights of a shared context
+    bool inputs_set_used;            // the input is given with rknn_inputs_set, not rknn_set_io_mem
+
+    // runs in submission order, non blocking ones on run_thread
+    std::mutex run_lock;
+    std::condition_variable run_cond;
+    std::thread run_thread;
+    std::deque<uint64_t> queued;
+    uint64_t last_frame_id;          // of the last rknn_run
+    uint64_t done_frame_id;          // of the last finished run
+    bool stop;
+} mock_context_t;
+
+/*-------------------------------------------
+                Simulated NPU
+-------------------------------------------*/
+static struct {
+    std::mutex lock;
+    std::condition_variable cond;
+    bool inited;
+    int run_us;
+    int jitter_us;
+    int num_cores;
+    int input_size;
+    bool busy[MOCK_MAX_CORES];
+    long runs[MOCK_MAX_CORES];
+} g_npu;
+
+static int env_int(const char* name, int def)
+{
+    const char* v = getenv(name);
+    return v != NULL && atoi(v) > 0 ? atoi(v) : def;
+}
+
+static void npu_init()
+{
+    std::lock_guard<std::mutex> lock(g_npu.lock);
+    if (g_npu.inited) {
+        return;
+    }
+    g_npu.run_us = env_int("RKNN_MOCK_RUN_US", 20000);
+    g_npu.jitter_us = env_int("RKNN_MOCK_RUN_JITTER_US", 0);
+    g_npu.num_cores = env_int("RKNN_MOCK_CORES", 3);
+    g_npu.input_size = env_int("RKNN_MOCK_INPUT", 640);
+    if (g_npu.num_cores > MOCK_MAX_CORES) {
+        g_npu.num_cores = MOCK_MAX_CORES;
+    }
+    g_npu.inited = true;
+}
+
+static int npu_acquire_core(int core_mask)
+{
+    std::unique_lock<std::mutex> lock(g_npu.lock);
+    int allowed = core_mask == RKNN_NPU_CORE_AUTO || core_mask == RKNN_NPU_CORE_ALL ? -1 : core_mask;
+    for (;;) {
+        for (int i = 0; i < g_npu.num_cores; i++) {
+            if (!g_npu.busy[i] && (allowed & (1 << i))) {
+                g_npu.busy[i] = true;
+                g_npu.runs[i]++;
+                return i;
+            }
+        }
+        g_npu.cond.wait(lock);
+    }
+}
+
+static void npu_release_core(int core)
+{
+    std::lock_guard<std::mutex> lock(g_npu.lock);
+    g_npu.busy[core] = false;
+    g_npu.cond.notify_all();
+}
+
+/*-------------------------------------------
+                Model
+-------------------------------------------*/
+static void set_attr(rknn_tensor_attr* attr, int index, const char* name, int c, int h, int w,
+                     rknn_tensor_format fmt, rknn_tensor_type type, int32_t zp, float scale)
+{
+    memset(attr, 0, sizeof(rknn_tensor_attr));
+    attr->index = index;
+    attr->n_dims = 4;
+    attr->dims[0] = 1;
+    if (fmt == RKNN_TENSOR_NHWC) {
+        attr->dims[1] = h;
+        attr->dims[2] = w;
+        attr->dims[3] = c;
+    } else {
+        attr->dims[1] = c;
+        attr->dims[2] = h;
+        attr->dims[3] = w;
+    }
+    snprintf(attr->name, RKNN_MAX_NAME_LEN, "%s", name);
+    attr->n_elems = c * h * w;
+    attr->size = attr->n_elems;
+    attr->size_with_stride = attr->size;
+    attr->w_stride = w;
+    attr->fmt = fmt;
+    attr->type = type;
+    attr->qnt_type = RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC;
+    attr->zp = zp;
+    attr->scale = scale;
+}
+
+static void parse_shapes(mock_context_t* ctx)
+{
+    const char* v = getenv("RKNN_MOCK_SHAPES");
+    while (v != NULL && *v != '\0') {
+        int w = 0;
+        int h = 0;
+        if (sscanf(v, "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+            ctx->shapes.push_back(h);
+            ctx->shapes.push_back(w);
+        }
+        v = strchr(v, ',');
+        v = v != NULL ? v + 1 : NULL;
+    }
+}
+
+static void build_model(mock_context_t* ctx, int height, int width)
+{
+    set_attr(&ctx->input.attr, 0, "images", 3, height, width, RKNN_TENSOR_NHWC, RKNN_TENSOR_UINT8, 0, 1.0f / 255);
+    ctx->input.data.resize(ctx->input.attr.size);
+
+    for (int b = 0; b < 3; b++) {
+        int grid_h = height / kStrides[b];
+        int grid_w = width / kStrides[b];
+        char name[32];
+        snprintf(name, sizeof(name), "box%d", b);
+        set_attr(&ctx->outputs[b * 3].attr, b * 3, name, 4 * MOCK_DFL_LEN, grid_h, grid_w, RKNN_TENSOR_NCHW,
+                 RKNN_TENSOR_INT8, -128, 0.1f);
+        snprintf(name, sizeof(name), "score%d", b);
+        set_attr(&ctx->outputs[b * 3 + 1].attr, b * 3 + 1, name, MOCK_NUM_CLASS, grid_h, grid_w, RKNN_TENSOR_NCHW,
+                 RKNN_TENSOR_INT8, -128, 1.0f / 255);
+        snprintf(name, sizeof(name), "score_sum%d", b);
+        set_attr(&ctx->outputs[b * 3 + 2].attr, b * 3 + 2, name, 1, grid_h, grid_w, RKNN_TENSOR_NCHW,
+                 RKNN_TENSOR_INT8, -128, 1.0f / 255);
+    }
+    for (int i = 0; i < 9; i++) {
+        ctx->outputs[i].data.resize(ctx->outputs[i].attr.size);
+    }
+    // memory bound for a smaller shape no longer fits
+    mock_tensor_t* tensors[10] = {&ctx->input};
+    for (int i = 0; i < 9; i++) {
+        tensors[i + 1] = &ctx->outputs[i];
+    }
+    for (int i = 0; i < 10; i++) {
+        if (tensors[i]->io_mem != NULL && tensors[i]->io_mem->size < tensors[i]->attr.size) {
+            tensors[i]->io_mem = NULL;
+        }
+    }
+}
+
+static void build_model(mock_context_t* ctx)
+{
+    parse_shapes(ctx);
+    if (!ctx->shapes.empty()) {
+        build_model(ctx, ctx->shapes[0], ctx->shapes[1]);
+    } else {
+        build_model(ctx, g_npu.input_size, g_npu.input_size);
+    }
+}
+
+static int8_t* tensor_data(mock_tensor_t* t)
+{
+    return t->io_mem != NULL ? (int8_t*)t->io_mem->virt_addr : &t->data[0];
+}
+
+// One object on the stride 32 branch, its class and size follow the input pixels so results
+// differ between images while staying reproducible.
+static void compute_outputs(mock_context_t* ctx)
+{
+    const uint8_t* in = (const uint8_t*)tensor_data(&ctx->input);
+    int in_h = ctx->input.attr.dims[1];
+    int in_w = ctx->input.attr.dims[2];
+    const uint8_t* center = in + ((in_h / 2) * in_w + in_w / 2) * 3;
+    int cls = (center[0] + center[1] + center[2]) % MOCK_NUM_CLASS;
+    int extent = 2 + center[1] % 6;
+
+    for (int i = 0; i < 9; i++) {
+        memset(tensor_data(&ctx->outputs[i]), -128, ctx->outputs[i].attr.size);
+    }
+    mock_tensor_t* box = &ctx->outputs[6];
+    mock_tensor_t* score = &ctx->outputs[7];
+    mock_tensor_t* score_sum = &ctx->outputs[8];
+    int grid_h = box->attr.dims[2];
+    int grid_w = box->attr.dims[3];
+    int grid_len = grid_h * grid_w;
+    int cell = (grid_h / 2) * grid_w + grid_w / 2;
+
+    // 0.9 with zp -128 and scale 1/255
+    tensor_data(score)[cls * grid_len + cell] = 101;
+    tensor_data(score_sum)[cell] = 101;
+    // peaked DFL distribution: left, top, right, bottom distances of extent cells
+    for (int side = 0; side < 4; side++) {
+        tensor_data(box)[(side * MOCK_DFL_LEN + extent) * grid_len + cell] = 127;
+    }
+}
+
+static void run_on_npu(mock_context_t* ctx)
+{
+    int core = npu_acquire_core(ctx->core_mask);
+    int jitter = g_npu.jitter_us > 0 ? rand_r(&ctx->seed) % (g_npu.jitter_us + 1) : 0;
+    // relative to the RKNN_MOCK_INPUT square
+    long run_us = (long)g_npu.run_us * ctx->input.attr.dims[1] * ctx->input.attr.dims[2] /
+                  (g_npu.input_size * g_npu.input_size);
+    usleep(run_us + jitter);
+    ctx->last_run_us = run_us + jitter;
+    compute_outputs(ctx);
+    npu_release_core(core);
+}
+
+static void run_thread(mock_context_t* ctx)
+{
+    std::unique_lock<std::mutex> lock(ctx->run_lock);
+    for (;;) {
+        ctx->run_cond.wait(lock, [ctx] { return ctx->stop || !ctx->queued.empty(); });
+        if (ctx->queued.empty()) {
+            break;
+        }
+        uint64_t frame_id = ctx->queued.front();
+        lock.unlock();
+        run_on_npu(ctx);
+        lock.lock();
+        ctx->queued.pop_front();
+        ctx->done_frame_id = frame_id;
+        ctx->run_cond.notify_all();
+    }
+}
+
+// wait until the runs up to frame_id are done, timeout_ms <= 0 waits forever
+static bool wait_frame(mock_context_t* ctx, std::unique_lock<std::mutex>& lock, uint64_t frame_id, int timeout_ms)
+{
+    auto done = [ctx, frame_id] { return ctx->done_frame_id >= frame_id; };
+    if (timeout_ms <= 0) {
+        ctx->run_cond.wait(lock, done);
+        return true;
+    }
+    return ctx->run_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), done);
+}
+
+static void build_perf_detail(mock_context_t* ctx)
+{
+    // share of the NPU time per layer, roughly the profile of a yolov8n
+    static const struct {
+        const char* op_type;
+        const char* target;
+        const char* name;
+        int weight;
+    } kLayers[] = {
+        {"InputOperator", "CPU", "InputOperator:images", 1},
+        {"ConvExSwish", "NPU", "Conv:/model.0/conv/Conv", 9},
+        {"ConvExSwish", "NPU", "Conv:/model.1/conv/Conv", 8},
+        {"ConvExSwish", "NPU", "Conv:/model.2/cv1/conv/Conv", 6},
+        {"Split", "NPU", "Split:/model.2/Split", 1},
+        {"ConvExSwish", "NPU", "Conv:/model.2/m.0/cv1/conv/Conv", 5},
+        {"ConvExSwish", "NPU", "Conv:/model.3/conv/Conv", 6},
+        {"ConvExSwish", "NPU", "Conv:/model.4/cv1/conv/Conv", 5},
+        {"ConvExSwish", "NPU", "Conv:/model.5/conv/Conv", 5},
+        {"ConvExSwish", "NPU", "Conv:/model.6/cv1/conv/Conv", 4},
+        {"ConvExSwish", "NPU", "Conv:/model.7/conv/Conv", 4},
+        {"MaxPool", "NPU", "MaxPool:/model.9/m/MaxPool", 2},
+        {"Resize", "NPU", "Resize:/model.10/Resize", 2},
+        {"Concat", "NPU", "Concat:/model.11/Concat", 2},
+        {"ConvExSwish", "NPU", "Conv:/model.15/cv2/conv/Conv", 8},
+        {"ConvExSwish", "NPU", "Conv:/model.22/cv2.0/cv2.0.2/Conv", 12},
+        {"ConvSigmoid", "NPU", "Conv:/model.22/cv3.0/cv3.0.2/Conv", 14},
+        {"ReduceSum", "NPU", "ReduceSum:/model.22/ReduceSum", 3},
+        {"OutputOperator", "CPU", "OutputOperator:box0", 3},
+    };
+    int num_layers = sizeof(kLayers) / sizeof(kLayers[0]);
+    int total_weight = 0;
+    for (int i = 0; i < num_layers; i++) {
+        total_weight += kLayers[i].weight;
+    }
+    char line[512];
+    ctx->perf_detail = "-------------------------------------------------------------------------------\n"
+                       "                 Operator Time Consuming Ranking Table (mock)\n"
+                       "-------------------------------------------------------------------------------\n";
+    snprintf(line, sizeof(line), "%-5s%-17s%-9s%-7s%-15s%-15s%-11s%-13s%s\n", "ID", "OpType", "DataType", "Target",
+             "InputShape", "OutputShape", "Time(us)", "MacUsage(%)", "FullName");
+    ctx->perf_detail += line;
+    int64_t total = 0;
+    for (int i = 0; i < num_layers; i++) {
+        int64_t us = ctx->last_run_us * kLayers[i].weight / total_weight;
+        total += us;
+        snprintf(line, sizeof(line), "%-5d%-17s%-9s%-7s%-15s%-15s%-11lld%-13s%s\n", i + 1, kLayers[i].op_type, "INT8",
+                 kLayers[i].target, "\\", "\\", (long long)us, "\\", kLayers[i].name);
+        ctx->perf_detail += line;
+    }
+    snprintf(line, sizeof(line), "Total Operator Elapsed Per Frame Time(us): %lld\n", (long long)total);
+    ctx->perf_detail += line;
+}
+
+static void destroy_ctx(mock_context_t* ctx)
+{
+    if (ctx->run_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(ctx->run_lock);
+            ctx->stop = true;
+        }
+        ctx->run_cond.notify_all();
+        ctx->run_thread.join();
+    }
+    delete ctx;
+}
+
+/*-------------------------------------------
+                API
+-------------------------------------------*/
+static mock_context_t* get_ctx(rknn_context context)
+{
+    return (mock_context_t*)(uintptr_t)context;
+}
+
+int rknn_init(rknn_context* context, void* model, uint32_t size, uint32_t flag, rknn_init_extend* extend)
+{
+    if (context == NULL || model == NULL || size == 0) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    npu_init();
+    mock_context_t* ctx = new mock_context_t();
+    ctx->flag = flag;
+    ctx->model_size = size;
+    ctx->seed = (unsigned int)(uintptr_t)ctx;
+    if ((flag & RKNN_FLAG_SHARE_WEIGHT_MEM) && extend != NULL && extend->ctx != 0) {
+        mock_context_t* src = get_ctx(extend->ctx);
+        ctx->model_buffer = src->model_buffer != NULL ? src->model_buffer : &src->weights[0];
+    } else if (flag & RKNN_FLAG_MODEL_BUFFER_ZERO_COPY) {
+        if (extend == NULL) {
+            delete ctx;
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        ctx->model_buffer = model;
+    } else {
+        ctx->weights.assign((const char*)model, (const char*)model + size);
+    }
+    build_model(ctx);
+    *context = (rknn_context)(uintptr_t)ctx;
+    return RKNN_SUCC;
+}
+
+int rknn_dup_context(rknn_context* context_in, rknn_context* context_out)
+{
+    if (context_in == NULL || context_out == NULL || *context_in == 0) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    mock_context_t* src = get_ctx(*context_in);
+    mock_context_t* ctx = new mock_context_t();
+    ctx->flag = src->flag;
+    ctx->model_size = src->model_size;
+    ctx->seed = (unsigned int)(uintptr_t)ctx;
+    ctx->model_buffer = src->model_buffer != NULL ? src->model_buffer : &src->weights[0];
+    build_model(ctx);
+    *context_out = (rknn_context)(uintptr_t)ctx;
+    return RKNN_SUCC;
+}
+
+int rknn_set_core_mask(rknn_context context, rknn_core_mask core_mask)
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL) {
+        return RKNN_ERR_CTX_INVALID;
+    }
+    if (core_mask != RKNN_NPU_CORE_AUTO && core_mask != RKNN_NPU_CORE_ALL &&
+        (core_mask & ((1 << g_npu.num_cores) - 1)) == 0) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    ctx->core_mask = core_mask;
+    return RKNN_SUCC;
+}
+
+int rknn_destroy(rknn_context context)
+{
+    destroy_ctx(get_ctx(context));
+    return RKNN_SUCC;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    (void)size;  // callers pass the struct of the command
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL || info == NULL) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    switch (cmd) {
+    case RKNN_QUERY_IN_OUT_NUM: {
+        rknn_input_output_num* io_num = (rknn_input_output_num*)info;
+        io_num->n_input = 1;
+        io_num->n_output = 9;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_INPUT_ATTR:
+    case RKNN_QUERY_CURRENT_INPUT_ATTR:
+    case RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR:
+    case RKNN_QUERY_NATIVE_INPUT_ATTR:
+    case RKNN_QUERY_NATIVE_NHWC_INPUT_ATTR: {
+        rknn_tensor_attr* attr = (rknn_tensor_attr*)info;
+        if (attr->index != 0) {
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        *attr = ctx->input.attr;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_OUTPUT_ATTR:
+    case RKNN_QUERY_CURRENT_OUTPUT_ATTR:
+    case RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR:
+    case RKNN_QUERY_NATIVE_OUTPUT_ATTR:
+    case RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR: {
+        rknn_tensor_attr* attr = (rknn_tensor_attr*)info;
+        if (attr->index >= 9) {
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        *attr = ctx->outputs[attr->index].attr;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_INPUT_DYNAMIC_RANGE: {
+        rknn_input_range* range = (rknn_input_range*)info;
+        if (range->index != 0 || ctx->shapes.empty()) {
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        range->shape_number = ctx->shapes.size() / 2;
+        range->fmt = RKNN_TENSOR_NHWC;
+        range->n_dims = 4;
+        snprintf(range->name, RKNN_MAX_NAME_LEN, "%s", ctx->input.attr.name);
+        for (uint32_t i = 0; i < range->shape_number; i++) {
+            range->dyn_range[i][0] = 1;
+            range->dyn_range[i][1] = ctx->shapes[i * 2];
+            range->dyn_range[i][2] = ctx->shapes[i * 2 + 1];
+            range->dyn_range[i][3] = 3;
+        }
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_PERF_RUN: {
+        ((rknn_perf_run*)info)->run_duration = ctx->last_run_us;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_PERF_DETAIL: {
+        if (!(ctx->flag & RKNN_FLAG_COLLECT_PERF_MASK)) {
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        build_perf_detail(ctx);
+        rknn_perf_detail* detail = (rknn_perf_detail*)info;
+        detail->perf_data = (char*)ctx->perf_detail.c_str();
+        detail->data_len = ctx->perf_detail.size();
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_MEM_SIZE: {
+        rknn_mem_size* mem = (rknn_mem_size*)info;
+        memset(mem, 0, sizeof(rknn_mem_size));
+        mem->total_weight_size = ctx->model_size;
+        mem->total_internal_size = ctx->input.attr.size;
+        for (int i = 0; i < 9; i++) {
+            mem->total_internal_size += ctx->outputs[i].attr.size;
+        }
+        mem->total_dma_allocated_size = (uint64_t)mem->total_weight_size + mem->total_internal_size;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_SDK_VERSION: {
+        rknn_sdk_version* version = (rknn_sdk_version*)info;
+        snprintf(version->api_version, sizeof(version->api_version), "mock");
+        snprintf(version->drv_version, sizeof(version->drv_version), "mock");
+        return RKNN_SUCC;
+    }
+    default:
+        return RKNN_ERR_PARAM_INVALID;
+    }
+}
+
+int rknn_inputs_set(rknn_context context, uint32_t n_inputs, rknn_input inputs[])
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL || n_inputs != 1 || inputs[0].buf == NULL || inputs[0].size < ctx->input.attr.size) {
+        return RKNN_ERR_INPUT_INVALID;
+    }
+    // one way of giving the input per context, the runtime does not define mixing them
+    if (ctx->input.io_mem != NULL) {
+        printf("mock: rknn_inputs_set on an input bound with rknn_set_io_mem\n");
+        return RKNN_ERR_INPUT_INVALID;
+    }
+    ctx->inputs_set_used = true;
+    if (inputs[0].buf != tensor_data(&ctx->input)) {
+        memcpy(tensor_data(&ctx->input), inputs[0].buf, ctx->input.attr.size);
+    }
+    return RKNN_SUCC;
+}
+
+int rknn_run(rknn_context context, rknn_run_extend* extend)
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL) {
+        return RKNN_ERR_CTX_INVALID;
+    }
+    std::unique_lock<std::mutex> lock(ctx->run_lock);
+    uint64_t frame_id = ++ctx->last_frame_id;
+    if (extend != NULL) {
+        extend->frame_id = frame_id;
+    }
+    if (extend != NULL && extend->non_block) {
+        if (!ctx->run_thread.joinable()) {
+            ctx->run_thread = std::thread(run_thread, ctx);
+        }
+        ctx->queued.push_back(frame_id);
+        ctx->run_cond.notify_all();
+        return RKNN_SUCC;
+    }
+    // blocking: after the runs queued before it
+    wait_frame(ctx, lock, frame_id - 1, 0);
+    lock.unlock();
+    run_on_npu(ctx);
+    lock.lock();
+    ctx->done_frame_id = frame_id;
+    ctx->run_cond.notify_all();
+    return RKNN_SUCC;
+}
+
+int rknn_wait(rknn_context context, rknn_run_extend* extend)
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL || extend == NULL) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    std::unique_lock<std::mutex> lock(ctx->run_lock);
+    if (extend->frame_id > ctx->last_frame_id) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    return wait_frame(ctx, lock, extend->frame_id, extend->timeout_ms) ? RKNN_SUCC : RKNN_ERR_TIMEOUT;
+}
+
+int rknn_set_input_shapes(rknn_context context, uint32_t n_inputs, rknn_tensor_attr attr[])
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL || n_inputs != 1 || attr == NULL || attr[0].fmt != RKNN_TENSOR_NHWC) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    for (size_t i = 0; i < ctx->shapes.size(); i += 2) {
+        if (attr[0].dims[1] == (uint32_t)ctx->shapes[i] && attr[0].dims[2] == (uint32_t)ctx->shapes[i + 1]) {
+            // after the runs in flight
+            std::unique_lock<std::mutex> lock(ctx->run_lock);
+            wait_frame(ctx, lock, ctx->last_frame_id, 0);
+            build_model(ctx, ctx->shapes[i], ctx->shapes[i + 1]);
+            return RKNN_SUCC;
+        }
+    }
+    return RKNN_ERR_PARAM_INVALID;
+}
+
+int rknn_outputs_get(rknn_context context, uint32_t n_outputs, rknn_output outputs[], rknn_output_extend* extend)
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL || n_outputs > 9) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    {
+        // blocks until the last run finished
+        std::unique_lock<std::mutex> lock(ctx->run_lock);
+        wait_frame(ctx, lock, ctx->last_frame_id, 0);
+        if (extend != NULL) {
+            extend->frame_id = ctx->done_frame_id;
+        }
+    }
+    for (uint32_t i = 0; i < n_outputs; i++) {
+        if (outputs[i].index >= 9) {
+            return RKNN_ERR_OUTPUT_INVALID;
+        }
+        mock_tensor_t* t = &ctx->outputs[outputs[i].index];
+        const int8_t* src = tensor_data(t);
+        uint32_t n = t->attr.n_elems;
+        if (outputs[i].want_float) {
+            t->data_float.resize(n);
+            for (uint32_t k = 0; k < n; k++) {
+                t->data_float[k] = ((float)src[k] - t->attr.zp) * t->attr.scale;
+            }
+        }
+        const void* data = outputs[i].want_float ? (const void*)&t->data_float[0] : (const void*)src;
+        uint32_t bytes = outputs[i].want_float ? n * sizeof(float) : n;
+        if (outputs[i].is_prealloc) {
+            if (outputs[i].buf == NULL || outputs[i].size < bytes) {
+                return RKNN_ERR_OUTPUT_INVALID;
+            }
+            memcpy(outputs[i].buf, data, bytes);
+        } else {
+            outputs[i].buf = (void*)data;
+            outputs[i].size = bytes;
+        }
+    }
+    return RKNN_SUCC;
+}
+
+int rknn_outputs_release(rknn_context context, uint32_t n_ouputs, rknn_output outputs[])
+{
+    // outputs point into the context's tensors
+    (void)context;
+    (void)n_ouputs;
+    (void)outputs;
+    return RKNN_SUCC;
+}
+
+rknn_tensor_mem* rknn_create_mem(rknn_context ctx, uint32_t size)
+{
+    (void)ctx;
+    rknn_tensor_mem* mem = (rknn_tensor_mem*)calloc(1, sizeof(rknn_tensor_mem));
+    mem->virt_addr = malloc(size);
+    mem->size = size;
+    mem->fd = -1;
+    mem->priv_data = mem->virt_addr;   // owned by the runtime
+    return mem;
+}
+
+rknn_tensor_mem* rknn_create_mem2(rknn_context ctx, uint64_t size, uint64_t alloc_flags)
+{
+    if (ctx == 0 && !(alloc_flags & RKNN_MEM_FLAG_ALLOC_NO_CONTEXT)) {
+        return NULL;
+    }
+    return rknn_create_mem(ctx, (uint32_t)size);
+}
+
+rknn_tensor_mem* rknn_create_mem_from_fd(rknn_context ctx, int32_t fd, void* virt_addr, uint32_t size, int32_t offset)
+{
+    (void)ctx;
+    if (virt_addr == NULL) {
+        return NULL;
+    }
+    rknn_tensor_mem* mem = (rknn_tensor_mem*)calloc(1, sizeof(rknn_tensor_mem));
+    mem->virt_addr = (char*)virt_addr + offset;
+    mem->fd = fd;
+    mem->offset = offset;
+    mem->size = size;
+    return mem;
+}
+
+int rknn_destroy_mem(rknn_context context, rknn_tensor_mem* mem)
+{
+    if (mem == NULL) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx != NULL) {
+        if (ctx->input.io_mem == mem) {
+            ctx->input.io_mem = NULL;
+        }
+        for (int i = 0; i < 9; i++) {
+            if (ctx->outputs[i].io_mem == mem) {
+                ctx->outputs[i].io_mem = NULL;
+            }
+        }
+    }
+    free(mem->priv_data);
+    free(mem);
+    return RKNN_SUCC;
+}
+
+int rknn_set_io_mem(rknn_context context, rknn_tensor_mem* mem, rknn_tensor_attr* attr)
+{
+    mock_context_t* ctx = get_ctx(context);
+    if (ctx == NULL || mem == NULL || attr == NULL) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    // tensors are told apart by name like the real runtime
+    mock_tensor_t* t = NULL;
+    if (strcmp(attr->name, ctx->input.attr.name) == 0) {
+        t = &ctx->input;
+    }
+    for (int i = 0; i < 9 && t == NULL; i++) {
+        if (strcmp(attr->name, ctx->outputs[i].attr.name) == 0) {
+            t = &ctx->outputs[i];
+        }
+    }
+    if (t == NULL || mem->size < t->attr.size) {
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    if (t == &ctx->input && ctx->inputs_set_used) {
+        printf("mock: rknn_set_io_mem on an input given with rknn_inputs_set\n");
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    t->io_mem = mem;
+    return RKNN_SUCC;
+}
+
+int rknn_mem_sync(rknn_context context, rknn_tensor_mem* mem, rknn_mem_sync_mode mode)
+{
+    // host memory is coherent
+    (void)context;
+    (void)mem;
+    (void)mode;
+    return RKNN_SUCC;
+}
+
+/*-------------------------------------------
+                Mock only
+-------------------------------------------*/
+int rknn_mock_get_core_runs(long* runs, int max_cores)
+{
+    std::lock_guard<std::mutex> lock(g_npu.lock);
+    int n = g_npu.num_cores < max_cores ? g_npu.num_cores : max_cores;
+    for (int i = 0; i < n; i++) {
+        runs[i] = g_npu.runs[i];
+    }
+    return n;
+}
+
+void rknn_mock_reset_core_runs()
+{
+    std::lock_guard<std::mutex> lock(g_npu.lock);
+    memset(g_npu.runs, 0, sizeof(g_npu.runs));
+}
@@ -0,0 +1,17 @@
+#ifndef _RKNN_DEMO_RKNN_MOCK_H_
+#define _RKNN_DEMO_RKNN_MOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of rknn_run calls per simulated NPU core since start or the last reset, returns the number of cores
+int rknn_mock_get_core_runs(long* runs, int max_cores);
+
+void rknn_mock_reset_core_runs();
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif //_RKNN_DEMO_RKNN_MOCK_H_
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "model_loader.h"
+#include "file_utils.h"
+#include "easy_timer.h"
+
+const char* get_model_load_mode_string(model_load_mode_t mode)
+{
+    switch (mode) {
+    case MODEL_LOAD_HEAP:
+        return "heap";
+    case MODEL_LOAD_MMAP:
+        return "mmap";
+    case MODEL_LOAD_ZERO_COPY:
+        return "zero_copy";
+    default:
+        return "unknown";
+    }
+}
+
+static int init_from_buffer(void* model, int model_size, uint32_t flag, rknn_init_extend* extend, rknn_context* ctx,
+                            model_load_info_t* info)
+{
+    TIMER timer;
+    timer.tik();
+    int ret = rknn_init(ctx, model, model_size, flag, extend);
+    timer.tok();
+    info->init_ms = timer.get_time();
+    return ret;
+}
+
+static int load_heap(const char* model_path, uint32_t flag, rknn_context* ctx, model_load_info_t* info)
+{
+    TIMER timer;
+    char* model = NULL;
+    timer.tik();
+    int model_len = read_data_from_file(model_path, &model);
+    timer.tok();
+    if (model_len <= 0 || model == NULL) {
+        printf("load_model fail!\n");
+        return -1;
+    }
+    info->read_ms = timer.get_time();
+    info->model_size = model_len;
+    int ret = init_from_buffer(model, model_len, flag, NULL, ctx, info);
+    free(model);
+    return ret;
+}
+
+static int load_mmap(const char* model_path, uint32_t flag, rknn_init_extend* extend, rknn_context* ctx,
+                     model_load_info_t* info)
+{
+    int model_len = 0;
+    void* model = map_file(model_path, &model_len);
+    if (model == NULL) {
+        return -1;
+    }
+    info->model_size = model_len;
+    // the runtime keeps its own copy, the mapping is only needed during init
+    int ret = init_from_buffer(model, model_len, flag, extend, ctx, info);
+    unmap_file(model, model_len);
+    return ret;
+}
+
+static int load_zero_copy(const char* model_path, uint32_t flag, rknn_context* ctx, model_load_info_t* info)
+{
+    TIMER timer;
+    int model_len = get_file_size(model_path);
+    if (model_len <= 0) {
+        return -1;
+    }
+    rknn_tensor_mem* mem = rknn_create_mem2(0, model_len, RKNN_MEM_FLAG_ALLOC_NO_CONTEXT);
+    if (mem == NULL || mem->virt_addr == NULL) {
+        printf("alloc model buffer in NPU memory fail\n");
+        return -1;
+    }
+    timer.tik();
+    int read_len = read_file_to_buffer(model_path, mem->virt_addr, model_len);
+    timer.tok();
+    if (read_len != model_len) {
+        rknn_destroy_mem(0, mem);
+        return -1;
+    }
+    info->read_ms = timer.get_time();
+    info->model_size = model_len;
+
+    rknn_init_extend extend;
+    memset(&extend, 0, sizeof(rknn_init_extend));
+    extend.model_buffer_fd = mem->fd;
+    extend.model_buffer_flags = mem->flags;
+    int ret = init_from_buffer(mem->virt_addr, model_len, flag | RKNN_FLAG_MODEL_BUFFER_ZERO_COPY, &extend, ctx, info);
+    if (ret < 0) {
+        rknn_destroy_mem(0, mem);
+        return ret;
+    }
+    info->model_mem = mem;
+    return ret;
+}
+
+int load_rknn_model(const char* model_path, model_load_mode_t mode, uint32_t flag, rknn_context* ctx,
+                    model_load_info_t* info)
+{
+    model_load_info_t local_info;
+    if (model_path == NULL || ctx == NULL) {
+        return -1;
+    }
+    if (info == NULL) {
+        info = &local_info;
+    }
+    memset(info, 0, sizeof(model_load_info_t));
+    info->mode = mode;
+
+    int ret;
+    switch (mode) {
+    case MODEL_LOAD_HEAP:
+        ret = load_heap(model_path, flag, ctx, info);
+        break;
+    case MODEL_LOAD_ZERO_COPY:
+        ret = load_zero_copy(model_path, flag, ctx, info);
+        if (ret == 0) {
+            break;
+        }
+        // older runtimes (or rknn_init refusing the buffer): fall back to mmap
+        printf("zero copy model load fail, ret=%d, use mmap\n", ret);
+        memset(info, 0, sizeof(model_load_info_t));
+        info->mode = MODEL_LOAD_MMAP;
+        ret = load_mmap(model_path, flag, NULL, ctx, info);
+        break;
+    case MODEL_LOAD_MMAP:
+    default:
+        info->mode = MODEL_LOAD_MMAP;
+        ret = load_mmap(model_path, flag, NULL, ctx, info);
+        break;
+    }
+    if (ret < 0) {
+        printf("rknn_init fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+int dup_rknn_model(rknn_context src, const char* model_path, rknn_context* ctx, model_share_mode_t* shared)
+{
+    model_share_mode_t local_shared;
+    if (shared == NULL) {
+        shared = &local_shared;
+    }
+    *ctx = 0;
+    int ret = rknn_dup_context(&src, ctx);
+    if (ret == RKNN_SUCC) {
+        *shared = MODEL_SHARE_DUP;
+        return 0;
+    }
+
+    model_load_info_t info;
+    memset(&info, 0, sizeof(model_load_info_t));
+    rknn_init_extend extend;
+    memset(&extend, 0, sizeof(rknn_init_extend));
+    extend.ctx = src;
+    ret = load_mmap(model_path, RKNN_FLAG_SHARE_WEIGHT_MEM, &extend, ctx, &info);
+    if (ret == RKNN_SUCC) {
+        *shared = MODEL_SHARE_WEIGHT_MEM;
+        return 0;
+    }
+
+    printf("weights can not be shared, ret=%d, load the model again\n", ret);
+    *shared = MODEL_SHARE_NONE;
+    return load_rknn_model(model_path, MODEL_LOAD_MMAP, 0, ctx, NULL);
+}
+
+const char* get_model_share_mode_string(model_share_mode_t mode)
+{
+    switch (mode) {
+    case MODEL_SHARE_DUP:
+        return "dup_context";
+    case MODEL_SHARE_WEIGHT_MEM:
+        return "share_weight_mem";
+    case MODEL_SHARE_NONE:
+        return "none";
+    default:
+        return "unknown";
+    }
+}
+
+void release_rknn_model(rknn_context ctx, rknn_tensor_mem* model_mem)
+{
+    if (ctx != 0) {
+        rknn_destroy(ctx);
+    }
+    if (model_mem != NULL) {
+        rknn_destroy_mem(0, model_mem);
+    }
+}
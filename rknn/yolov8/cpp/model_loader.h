@@ -0,0 +1,47 @@
+#ifndef _RKNN_DEMO_MODEL_LOADER_H_
+#define _RKNN_DEMO_MODEL_LOADER_H_
+
+#include "rknn_api.h"
+
+typedef enum {
+    MODEL_LOAD_HEAP = 0,      // read into a malloc buffer, the runtime copies it (peak: 2x model size)
+    MODEL_LOAD_MMAP,          // map the file, the runtime copies straight from the page cache
+    MODEL_LOAD_ZERO_COPY,     // read into NPU memory the runtime uses in place (RKNN_FLAG_MODEL_BUFFER_ZERO_COPY)
+} model_load_mode_t;
+
+typedef enum {
+    MODEL_SHARE_DUP = 0,      // rknn_dup_context
+    MODEL_SHARE_WEIGHT_MEM,   // rknn_init with RKNN_FLAG_SHARE_WEIGHT_MEM
+    MODEL_SHARE_NONE,         // separate load, the weights are duplicated
+} model_share_mode_t;
+
+typedef struct {
+    model_load_mode_t mode;     // mode actually used, zero copy falls back to mmap when the runtime refuses it
+    rknn_tensor_mem* model_mem; // zero copy model buffer, must live as long as the context
+    int model_size;
+    float read_ms;              // file to memory, 0 for mmap (pages are read during rknn_init)
+    float init_ms;              // rknn_init
+} model_load_info_t;
+
+/**
+ * Create a context from a model file.
+ * flag is passed on to rknn_init (RKNN_FLAG_MODEL_BUFFER_ZERO_COPY is added for zero copy).
+ * The context must be released with release_rknn_model(), which also frees the zero copy buffer.
+ */
+int load_rknn_model(const char* model_path, model_load_mode_t mode, uint32_t flag, rknn_context* ctx,
+                    model_load_info_t* info);
+
+/**
+ * Create another context of the model that shares the weights of src: rknn_dup_context, else
+ * rknn_init with RKNN_FLAG_SHARE_WEIGHT_MEM, else a separate load. shared (can be NULL) tells which one.
+ * src must outlive the new context.
+ */
+int dup_rknn_model(rknn_context src, const char* model_path, rknn_context* ctx, model_share_mode_t* shared);
+
+void release_rknn_model(rknn_context ctx, rknn_tensor_mem* model_mem);
+
+const char* get_model_load_mode_string(model_load_mode_t mode);
+
+const char* get_model_share_mode_string(model_share_mode_t mode);
+
+#endif //_RKNN_DEMO_MODEL_LOADER_H_
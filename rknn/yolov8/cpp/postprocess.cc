@@ -21,7 +21,6 @@
 #include <string.h>
 #include <sys/time.h>
 
-#include <set>
 #include <vector>
 #define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
 
@@ -106,7 +105,7 @@ static float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0
     return u <= 0.f ? 0.f : (i / u);
 }
 
-static int nms(int validCount, std::vector<float> &outputLocations, std::vector<int> classIds, std::vector<int> &order,
+static int nms(int validCount, std::vector<float> &outputLocations, const std::vector<int> &classIds, std::vector<int> &order,
                int filterId, float threshold)
 {
     for (int i = 0; i < validCount; ++i)
@@ -510,9 +509,15 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
 #else
     rknn_output *_outputs = (rknn_output *)outputs;
 #endif
-    std::vector<float> filterBoxes;
-    std::vector<float> objProbs;
-    std::vector<int> classId;
+    // kept per thread, so a frame reuses the capacity of the previous ones instead of allocating
+    static thread_local std::vector<float> filterBoxes;
+    static thread_local std::vector<float> objProbs;
+    static thread_local std::vector<int> classId;
+    static thread_local std::vector<int> indexArray;
+    filterBoxes.clear();
+    objProbs.clear();
+    classId.clear();
+    indexArray.clear();
     int validCount = 0;
     int stride = 0;
     int grid_h = 0;
@@ -610,18 +615,23 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
     {
         return 0;
     }
-    std::vector<int> indexArray;
     for (int i = 0; i < validCount; ++i)
     {
         indexArray.push_back(i);
     }
     quick_sort_indice_inverse(objProbs, 0, validCount - 1, indexArray);
 
-    std::set<int> class_set(std::begin(classId), std::end(classId));
-
-    for (auto c : class_set)
+    bool class_found[OBJ_CLASS_NUM] = {false};
+    for (int i = 0; i < validCount; ++i)
+    {
+        class_found[classId[i]] = true;
+    }
+    for (int c = 0; c < OBJ_CLASS_NUM; ++c)
     {
-        nms(validCount, filterBoxes, classId, indexArray, c, nms_threshold);
+        if (class_found[c])
+        {
+            nms(validCount, filterBoxes, classId, indexArray, c, nms_threshold);
+        }
     }
 
     int last_count = 0;
@@ -18,6 +18,8 @@
 #include <math.h>
 
 #include "yolov8.h"
+#include "infer_backend.h"
+#include "yolov8_profile.h"
 #include "common.h"
 #include "file_utils.h"
 #include "image_utils.h"
@@ -32,35 +34,217 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
            get_qnt_type_string(attr->qnt_type), attr->zp, attr->scale);
 }
 
+// The letterbox destination lives as long as the context: one dma_buf (or NPU memory of the backend)
+// that is also bound as the model input, instead of an alloc, an inputs_set copy and a free per frame.
+static int alloc_input_buffer(rknn_app_context_t *app_ctx)
+{
+    image_buffer_t *img = &app_ctx->input_img;
+    memset(img, 0, sizeof(image_buffer_t));
+    img->width = app_ctx->model_width;
+    img->height = app_ctx->model_height;
+    img->format = IMAGE_FORMAT_RGB888;
+    img->size = get_image_size(img);
+    app_ctx->input_buf_size = img->size;
+    for (int i = 0; i < app_ctx->num_shapes; i++)
+    {
+        image_buffer_t shape_img = *img;
+        shape_img.width = app_ctx->shapes[i].width;
+        shape_img.height = app_ctx->shapes[i].height;
+        if (get_image_size(&shape_img) > app_ctx->input_buf_size)
+        {
+            app_ctx->input_buf_size = get_image_size(&shape_img);
+        }
+    }
+    // the input memory of a dynamic shape model would have to be bound again for every shape
+    bool bind = app_ctx->num_shapes == 0;
+
+    void *virt_addr = NULL;
+    int fd = -1;
+    if (dma_buf_alloc(DMA_HEAP_DMA32_UNCACHE_PATCH, app_ctx->input_buf_size, &fd, &virt_addr) == 0)
+    {
+        app_ctx->input_is_dma = true;
+        img->fd = fd;
+        img->virt_addr = (unsigned char *)virt_addr;
+        app_ctx->input_is_bound = bind && infer_backend_bind_input(app_ctx->backend, fd, virt_addr, img->size) != NULL;
+    }
+    else
+    {
+        // no dma heap (e.g. host build with the mock runtime): memory of the backend, else malloc
+        img->fd = 0;
+        img->virt_addr = bind ? (unsigned char *)infer_backend_bind_input(app_ctx->backend, -1, NULL, img->size) : NULL;
+        app_ctx->input_is_bound = img->virt_addr != NULL;
+        if (img->virt_addr == NULL)
+        {
+            img->virt_addr = (unsigned char *)malloc(app_ctx->input_buf_size);
+        }
+    }
+    if (img->virt_addr == NULL)
+    {
+        printf("alloc input buffer size:%d fail!\n", img->size);
+        return -1;
+    }
+    printf("input buffer: %s%s\n", app_ctx->input_is_dma ? "dma_buf" : (app_ctx->input_is_bound ? "npu" : "malloc"),
+           app_ctx->input_is_bound ? ", bound as model input" : "");
+    return 0;
+}
+
+static void free_input_buffer(rknn_app_context_t *app_ctx)
+{
+    image_buffer_t *img = &app_ctx->input_img;
+    if (img->virt_addr != NULL)
+    {
+        if (app_ctx->input_is_dma)
+        {
+            dma_buf_free(app_ctx->input_buf_size, &img->fd, img->virt_addr);
+        }
+        else if (!app_ctx->input_is_bound)
+        {
+            free(img->virt_addr);
+        }
+    }
+    memset(img, 0, sizeof(image_buffer_t));
+    app_ctx->input_is_dma = false;
+    app_ctx->input_is_bound = false;
+    app_ctx->input_buf_size = 0;
+}
+
+static void free_input_shapes(rknn_app_context_t *app_ctx)
+{
+    for (int i = 0; i < app_ctx->num_shapes; i++)
+    {
+        free(app_ctx->shapes[i].output_attrs);
+    }
+    free(app_ctx->shapes);
+    app_ctx->shapes = NULL;
+    app_ctx->num_shapes = 0;
+}
+
+// Dynamic shape models: set every registered input shape once to cache the output attributes it
+// produces, then run with the largest one. Static models keep num_shapes 0.
+static int init_input_shapes(rknn_app_context_t *app_ctx)
+{
+    rknn_input_range *range = (rknn_input_range *)calloc(1, sizeof(rknn_input_range));
+    if (range == NULL)
+    {
+        return -1;
+    }
+    range->index = 0;
+    int ret = infer_backend_query_input_range(app_ctx->backend, range);
+    if (ret < 0 || range->shape_number < 2 || range->n_dims != 4)
+    {
+        free(range);
+        return 0;
+    }
+
+    int num_shapes = range->shape_number;
+    app_ctx->shapes = (yolov8_input_shape_t *)calloc(num_shapes, sizeof(yolov8_input_shape_t));
+    if (app_ctx->shapes == NULL)
+    {
+        free(range);
+        return -1;
+    }
+    int largest = 0;
+    printf("dynamic input shapes:");
+    for (int i = 0; i < num_shapes; i++)
+    {
+        yolov8_input_shape_t *shape = &app_ctx->shapes[i];
+        rknn_tensor_attr *attr = &shape->input_attr;
+        *attr = app_ctx->input_attrs[0];
+        attr->fmt = range->fmt;
+        for (int d = 0; d < 4; d++)
+        {
+            attr->dims[d] = range->dyn_range[i][d];
+        }
+        bool nchw = range->fmt == RKNN_TENSOR_NCHW;
+        shape->height = nchw ? attr->dims[2] : attr->dims[1];
+        shape->width = nchw ? attr->dims[3] : attr->dims[2];
+        attr->n_elems = attr->dims[0] * attr->dims[1] * attr->dims[2] * attr->dims[3];
+        attr->size = attr->n_elems;
+        attr->size_with_stride = attr->size;
+        attr->w_stride = shape->width;
+
+        ret = infer_backend_set_input_shapes(app_ctx->backend, 1, attr);
+        if (ret < 0)
+        {
+            printf("\nset input shape %dx%d fail! ret=%d\n", shape->width, shape->height, ret);
+            break;
+        }
+        shape->output_attrs = (rknn_tensor_attr *)calloc(app_ctx->io_num.n_output, sizeof(rknn_tensor_attr));
+        for (uint32_t j = 0; j < app_ctx->io_num.n_output && ret >= 0; j++)
+        {
+            shape->output_attrs[j].index = j;
+            ret = infer_backend_query_output_attr(app_ctx->backend, &shape->output_attrs[j]);
+        }
+        if (ret < 0)
+        {
+            free(shape->output_attrs);
+            printf("\nquery output attr of shape %dx%d fail! ret=%d\n", shape->width, shape->height, ret);
+            break;
+        }
+        app_ctx->num_shapes++;
+        printf(" %dx%d", shape->width, shape->height);
+        if (shape->width * shape->height > app_ctx->shapes[largest].width * app_ctx->shapes[largest].height)
+        {
+            largest = i;
+        }
+    }
+    printf("\n");
+    free(range);
+    if (ret < 0)
+    {
+        free_input_shapes(app_ctx);
+        return -1;
+    }
+    return yolov8_set_input_shape(app_ctx, largest);
+}
+
 int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
-    rknn_context ctx = 0;
 
-    // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL)
+    // rknn unless INFER_BACKEND selects another one
+    infer_backend_t *backend = infer_backend_create(NULL);
+    if (backend == NULL)
     {
-        printf("load_model fail!\n");
         return -1;
     }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    yolov8_profile_prepare_backend(app_ctx->profile, backend);
+    ret = infer_backend_load(backend, model_path);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("load model on %s backend fail! ret=%d\n", infer_backend_name(backend), ret);
+        infer_backend_destroy(backend);
         return -1;
     }
 
+    return init_yolov8_model_with_backend(backend, app_ctx);
+}
+
+int init_yolov8_model_with_context(rknn_context ctx, rknn_app_context_t *app_ctx)
+{
+    infer_backend_t *backend = infer_backend_wrap_rknn(ctx, NULL);
+    if (backend == NULL)
+    {
+        rknn_destroy(ctx);
+        return -1;
+    }
+    return init_yolov8_model_with_backend(backend, app_ctx);
+}
+
+int init_yolov8_model_with_backend(infer_backend_t *backend, rknn_app_context_t *app_ctx)
+{
+    int ret;
+
+    // owned from here on, release_yolov8_model() destroys it even if the setup below fails
+    app_ctx->backend = backend;
+    app_ctx->rknn_ctx = infer_backend_get_rknn_context(backend);
+
     // Get Model Input Output Number
     rknn_input_output_num io_num;
-    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+    ret = infer_backend_query_io_num(backend, &io_num);
     if (ret != RKNN_SUCC)
     {
-        printf("rknn_query fail! ret=%d\n", ret);
+        printf("query io num fail! ret=%d\n", ret);
         return -1;
     }
     printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
@@ -72,10 +256,10 @@ int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx)
     for (int i = 0; i < io_num.n_input; i++)
     {
         input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
+        ret = infer_backend_query_input_attr(backend, &(input_attrs[i]));
         if (ret != RKNN_SUCC)
         {
-            printf("rknn_query fail! ret=%d\n", ret);
+            printf("query input attr fail! ret=%d\n", ret);
             return -1;
         }
         dump_tensor_attr(&(input_attrs[i]));
@@ -88,18 +272,15 @@ int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx)
     for (int i = 0; i < io_num.n_output; i++)
     {
         output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
+        ret = infer_backend_query_output_attr(backend, &(output_attrs[i]));
         if (ret != RKNN_SUCC)
         {
-            printf("rknn_query fail! ret=%d\n", ret);
+            printf("query output attr fail! ret=%d\n", ret);
             return -1;
         }
         dump_tensor_attr(&(output_attrs[i]));
     }
 
-    // Set to context
-    app_ctx->rknn_ctx = ctx;
-
     // TODO
     if (output_attrs[0].qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && output_attrs[0].type == RKNN_TENSOR_INT8)
     {
@@ -133,7 +314,12 @@ int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx)
     printf("model input height=%d, width=%d, channel=%d\n",
            app_ctx->model_height, app_ctx->model_width, app_ctx->model_channel);
 
-    return 0;
+    if (init_input_shapes(app_ctx) < 0)
+    {
+        return -1;
+    }
+    yolov8_profile_query_mem_size(app_ctx->profile, backend);
+    return alloc_input_buffer(app_ctx);
 }
 
 int release_yolov8_model(rknn_app_context_t *app_ctx)
@@ -148,88 +334,183 @@ int release_yolov8_model(rknn_app_context_t *app_ctx)
         free(app_ctx->output_attrs);
         app_ctx->output_attrs = NULL;
     }
-    if (app_ctx->rknn_ctx != 0)
+    // the backend unbinds the input before its dma_buf goes away
+    if (app_ctx->backend != NULL)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        infer_backend_destroy(app_ctx->backend);
+        app_ctx->backend = NULL;
         app_ctx->rknn_ctx = 0;
     }
+    free_input_buffer(app_ctx);
+    free_input_shapes(app_ctx);
     return 0;
 }
 
-int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results)
+int yolov8_select_input_shape(rknn_app_context_t *app_ctx, int width, int height)
 {
-    int ret;
-    image_buffer_t dst_img;
-    letterbox_t letter_box;
-    rknn_input inputs[app_ctx->io_num.n_input];
-    rknn_output outputs[app_ctx->io_num.n_output];
-    const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
-    const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
-    int bg_color = 114;
-
-    if ((!app_ctx) || !(img) || (!od_results))
+    if (app_ctx->num_shapes == 0 || width <= 0 || height <= 0)
     {
         return -1;
     }
+    // the scale a letterbox into the largest shape gives is the reference, the smallest shape that keeps it wins
+    float ref_scale = 0;
+    for (int i = 0; i < app_ctx->num_shapes; i++)
+    {
+        yolov8_input_shape_t *shape = &app_ctx->shapes[i];
+        float scale = fminf((float)shape->width / width, (float)shape->height / height);
+        ref_scale = fmaxf(ref_scale, scale);
+    }
+    int best = -1;
+    for (int i = 0; i < app_ctx->num_shapes; i++)
+    {
+        yolov8_input_shape_t *shape = &app_ctx->shapes[i];
+        float scale = fminf((float)shape->width / width, (float)shape->height / height);
+        if (scale < ref_scale * 0.999f)
+        {
+            continue;
+        }
+        if (best < 0 || shape->width * shape->height < app_ctx->shapes[best].width * app_ctx->shapes[best].height)
+        {
+            best = i;
+        }
+    }
+    return best;
+}
 
-    memset(od_results, 0x00, sizeof(*od_results));
-    memset(&letter_box, 0, sizeof(letterbox_t));
-    memset(&dst_img, 0, sizeof(image_buffer_t));
-    memset(inputs, 0, sizeof(inputs));
-    memset(outputs, 0, sizeof(outputs));
-
-    // Pre Process
-    dst_img.width = app_ctx->model_width;
-    dst_img.height = app_ctx->model_height;
-    dst_img.format = IMAGE_FORMAT_RGB888;
-    dst_img.size = get_image_size(&dst_img);
-    // dst_img.virt_addr = (unsigned char *)malloc(dst_img.size);
-    /*
-    * Allocate dma_buf within 4G from dma32_heap,
-    * return dma_fd and virtual address.
-    */
-    ret = dma_buf_alloc(DMA_HEAP_DMA32_UNCACHE_PATCH, dst_img.size, &dst_img.fd, (void **)&dst_img.virt_addr);
-    if (ret < 0) {
-        printf("alloc dma32_heap buffer failed!\n");
+int yolov8_set_input_shape(rknn_app_context_t *app_ctx, int index)
+{
+    if (index < 0 || index >= app_ctx->num_shapes)
+    {
         return -1;
     }
-    
-    if (dst_img.virt_addr == NULL)
+    yolov8_input_shape_t *shape = &app_ctx->shapes[index];
+    int ret = infer_backend_set_input_shapes(app_ctx->backend, 1, &shape->input_attr);
+    if (ret < 0)
     {
-        printf("malloc buffer size:%d fail!\n", dst_img.size);
+        printf("set input shape %dx%d fail! ret=%d\n", shape->width, shape->height, ret);
         return -1;
     }
+    app_ctx->input_attrs[0] = shape->input_attr;
+    memcpy(app_ctx->output_attrs, shape->output_attrs, app_ctx->io_num.n_output * sizeof(rknn_tensor_attr));
+    app_ctx->model_width = shape->width;
+    app_ctx->model_height = shape->height;
+    app_ctx->shape_index = index;
+    // input_img keeps its memory, sized for the largest shape
+    app_ctx->input_img.width = shape->width;
+    app_ctx->input_img.height = shape->height;
+    app_ctx->input_img.size = get_image_size(&app_ctx->input_img);
+    return 0;
+}
 
-    // letterbox
-    ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
-    if (ret < 0)
+// Rows of a model input that may be a view into a larger image (width_stride > model_width)
+static void copy_input_rows(rknn_app_context_t *app_ctx, const image_buffer_t *src, unsigned char *dst)
+{
+    int row = app_ctx->model_width * app_ctx->model_channel;
+    int stride = (src->width_stride > app_ctx->model_width ? src->width_stride : app_ctx->model_width) *
+                 app_ctx->model_channel;
+    if (stride == row)
     {
-        printf("convert_image_with_letterbox fail! ret=%d\n", ret);
-        return -1;
+        memcpy(dst, src->virt_addr, row * app_ctx->model_height);
+        return;
     }
+    for (int y = 0; y < app_ctx->model_height; y++)
+    {
+        memcpy(dst + y * row, src->virt_addr + y * stride, row);
+    }
+}
 
-    // Set Input Data
+int yolov8_set_input(rknn_app_context_t *app_ctx, image_buffer_t *input_img)
+{
+    bool packed = input_img->width_stride <= app_ctx->model_width;
+    int ret;
+
+    // a bound context never takes inputs_set: a bound buffer is selected as it is, anything else is
+    // copied into input_img first
+    if (app_ctx->input_is_bound)
+    {
+        if (packed && infer_backend_select_input(app_ctx->backend, input_img->virt_addr) == 0)
+        {
+            return 0;
+        }
+        copy_input_rows(app_ctx, input_img, app_ctx->input_img.virt_addr);
+        ret = infer_backend_select_input(app_ctx->backend, app_ctx->input_img.virt_addr);
+        if (ret < 0)
+        {
+            printf("select input fail! ret=%d\n", ret);
+        }
+        return ret;
+    }
+
+    rknn_input inputs[app_ctx->io_num.n_input];
+    memset(inputs, 0, sizeof(inputs));
     inputs[0].index = 0;
     inputs[0].type = RKNN_TENSOR_UINT8;
     inputs[0].fmt = RKNN_TENSOR_NHWC;
     inputs[0].size = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
-    inputs[0].buf = dst_img.virt_addr;
-
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    inputs[0].buf = input_img->virt_addr;
+    if (!packed)
+    {
+        copy_input_rows(app_ctx, input_img, app_ctx->input_img.virt_addr);
+        inputs[0].buf = app_ctx->input_img.virt_addr;
+    }
+    ret = infer_backend_inputs_set(app_ctx->backend, app_ctx->io_num.n_input, inputs);
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
+    }
+    return ret;
+}
+
+int yolov8_bind_input(rknn_app_context_t *app_ctx, image_buffer_t *img)
+{
+    if (!app_ctx->input_is_bound || img->width_stride > app_ctx->model_width || img->virt_addr == NULL)
+    {
+        return -1;
+    }
+    return infer_backend_bind_input(app_ctx->backend, img->fd, img->virt_addr, img->size) != NULL ? 0 : -1;
+}
+
+void yolov8_unbind_input(rknn_app_context_t *app_ctx, image_buffer_t *img)
+{
+    if (app_ctx->input_is_bound)
+    {
+        infer_backend_unbind_input(app_ctx->backend, img->virt_addr);
+    }
+}
+
+static int run_model(rknn_app_context_t *app_ctx, image_buffer_t *input_img, letterbox_t *letter_box,
+                     object_detect_result_list *od_results)
+{
+    int ret;
+    rknn_output outputs[app_ctx->io_num.n_output];
+    const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
+    const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
+    yolov8_profile_t *profile = app_ctx->profile;
+    double t;
+
+    memset(od_results, 0x00, sizeof(*od_results));
+    memset(outputs, 0, sizeof(outputs));
+
+    // Set Input Data
+    t = yolov8_profile_stage_begin(profile);
+    ret = yolov8_set_input(app_ctx, input_img);
+    yolov8_profile_stage_end(profile, PROFILE_STAGE_INPUTS_SET, t);
+    if (ret < 0)
+    {
         return -1;
     }
 
     // Run
     // printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    t = yolov8_profile_stage_begin(profile);
+    ret = infer_backend_run(app_ctx->backend);
+    yolov8_profile_stage_end(profile, PROFILE_STAGE_RUN, t);
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
         return -1;
     }
+    yolov8_profile_query_run(profile, app_ctx->backend);
 
     // Get Output
     memset(outputs, 0, sizeof(outputs));
@@ -238,26 +519,89 @@ int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
         outputs[i].index = i;
         outputs[i].want_float = (!app_ctx->is_quant);
     }
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    t = yolov8_profile_stage_begin(profile);
+    ret = infer_backend_outputs_get(app_ctx->backend, app_ctx->io_num.n_output, outputs);
+    yolov8_profile_stage_end(profile, PROFILE_STAGE_OUTPUTS_GET, t);
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Post Process
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    t = yolov8_profile_stage_begin(profile);
+    post_process(app_ctx, outputs, letter_box, box_conf_threshold, nms_threshold, od_results);
+    yolov8_profile_stage_end(profile, PROFILE_STAGE_POSTPROCESS, t);
 
     // Remeber to release rknn output
-    rknn_outputs_release(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs);
+    infer_backend_outputs_release(app_ctx->backend, app_ctx->io_num.n_output, outputs);
+
+    return ret;
+}
 
-out:
-    if (dst_img.virt_addr != NULL)
+int inference_yolov8_model_with_input(rknn_app_context_t *app_ctx, image_buffer_t *input_img, letterbox_t *letter_box,
+                                      object_detect_result_list *od_results)
+{
+    if ((!app_ctx) || !(input_img) || (!letter_box) || (!od_results))
     {
-        // free(dst_img.virt_addr);
-        dma_buf_free(dst_img.size, &dst_img.fd, dst_img.virt_addr);
-        dst_img.virt_addr = NULL;
+        return -1;
     }
 
+    // a record per frame, inference_yolov8_model() may have opened it already
+    bool opened = yolov8_profile_begin_frame(app_ctx->profile);
+    int ret = run_model(app_ctx, input_img, letter_box, od_results);
+    if (opened)
+    {
+        yolov8_profile_end_frame(app_ctx->profile);
+    }
     return ret;
-}
\ No newline at end of file
+}
+
+int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results)
+{
+    int ret;
+    letterbox_t letter_box;
+    int bg_color = 114;
+
+    if ((!app_ctx) || !(img) || (!od_results))
+    {
+        return -1;
+    }
+
+    memset(od_results, 0x00, sizeof(*od_results));
+    memset(&letter_box, 0, sizeof(letterbox_t));
+
+    bool opened = yolov8_profile_begin_frame(app_ctx->profile);
+    double t = yolov8_profile_stage_begin(app_ctx->profile);
+    ret = 0;
+    if (app_ctx->num_shapes > 0)
+    {
+        int shape = yolov8_select_input_shape(app_ctx, img->width, img->height);
+        if (shape != app_ctx->shape_index && yolov8_set_input_shape(app_ctx, shape) < 0)
+        {
+            ret = -1;
+        }
+    }
+
+    // Pre Process, into the input buffer allocated at init
+    if (ret == 0)
+    {
+        ret = convert_image_with_letterbox(img, &app_ctx->input_img, &letter_box, bg_color);
+        if (ret < 0)
+        {
+            printf("convert_image_with_letterbox fail! ret=%d\n", ret);
+            ret = -1;
+        }
+    }
+    yolov8_profile_stage_end(app_ctx->profile, PROFILE_STAGE_PREPROCESS, t);
+
+    if (ret == 0)
+    {
+        ret = inference_yolov8_model_with_input(app_ctx, &app_ctx->input_img, &letter_box, od_results);
+    }
+    if (opened)
+    {
+        yolov8_profile_end_frame(app_ctx->profile);
+    }
+    return ret;
+}
@@ -18,6 +18,7 @@
 #include <math.h>
 
 #include "yolov8.h"
+#include "model_loader.h"
 #include "common.h"
 #include "file_utils.h"
 #include "image_utils.h"
@@ -38,23 +39,27 @@ static void dump_tensor_attr(rknn_tensor_attr *attr) {
 
 int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx) {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
+    model_load_info_t load_info;
 
-    // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    // Load RKNN Model, without a heap copy of the file
+    ret = load_rknn_model(model_path, MODEL_LOAD_ZERO_COPY, 0, &ctx, &load_info);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("load_rknn_model fail! ret=%d\n", ret);
         return -1;
     }
+    app_ctx->model_mem = load_info.model_mem;
+    printf("model load: %s, read %.2fms, init %.2fms\n", get_model_load_mode_string(load_info.mode),
+           load_info.read_ms, load_info.init_ms);
+
+    return init_yolov8_model_with_context(ctx, app_ctx);
+}
+
+int init_yolov8_model_with_context(rknn_context ctx, rknn_app_context_t *app_ctx) {
+    int ret;
+
+    // owned from here on, release_yolov8_model() destroys it even if the setup below fails
+    app_ctx->rknn_ctx = ctx;
 
     // Get Model Input Output Number
     rknn_input_output_num io_num;
@@ -115,8 +120,6 @@ int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx) {
         }
     }
 
-    // Set to context
-    app_ctx->rknn_ctx = ctx;
 
     // TODO
     if (output_native_attrs[0].qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && output_native_attrs[0].type == RKNN_TENSOR_INT8) {
@@ -238,55 +241,41 @@ int release_yolov8_model(rknn_app_context_t *app_ctx) {
         }
     }
     if (app_ctx->rknn_ctx != 0) {
-        ret = rknn_destroy(app_ctx->rknn_ctx);
-        if (ret != RKNN_SUCC) {
-            printf("rknn_destroy fail! ret=%d\n", ret);
-            return -1;
-        }
+        release_rknn_model(app_ctx->rknn_ctx, app_ctx->model_mem);
         app_ctx->rknn_ctx = 0;
-
+        app_ctx->model_mem = NULL;
     }
     return 0;
 }
 
-int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results) {
+int inference_yolov8_model_with_input(rknn_app_context_t *app_ctx, image_buffer_t *input_img, letterbox_t *letter_box,
+                                      object_detect_result_list *od_results) {
     int ret;
-    image_buffer_t dst_img;
-    letterbox_t letter_box;
     const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
     const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
-    int bg_color = 114;
 
-    if ((!app_ctx) || !(img) || (!od_results)) {
+    if ((!app_ctx) || !(input_img) || (!letter_box) || (!od_results)) {
         return -1;
     }
 
     memset(od_results, 0x00, sizeof(*od_results));
-    memset(&letter_box, 0, sizeof(letterbox_t));
-    memset(&dst_img, 0, sizeof(image_buffer_t));
 
-    // Pre Process
-    dst_img.width = app_ctx->model_width;
-    dst_img.height = app_ctx->model_height;
-    dst_img.format = IMAGE_FORMAT_RGB888;
-    dst_img.size = get_image_size(&dst_img);
-    dst_img.fd = app_ctx->input_mems[0]->fd;
-    dst_img.virt_addr = (unsigned char*)app_ctx->input_mems[0]->virt_addr;
-
-    if (dst_img.virt_addr == NULL && dst_img.fd == 0) {
-        printf("malloc buffer size:%d fail!\n", dst_img.size);
-        return -1;
-    }
-
-    // letterbox
-    ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
-    if (ret < 0) {
-        printf("convert_image_with_letterbox fail! ret=%d\n", ret);
-        return -1;
+    // the input must live in the input tensor memory bound to the context
+    if (input_img->virt_addr != app_ctx->input_mems[0]->virt_addr) {
+        if (input_img->virt_addr == NULL) {
+            printf("input image has no virtual address\n");
+            return -1;
+        }
+        int row = app_ctx->model_width * app_ctx->model_channel;
+        int stride = input_img->width_stride > app_ctx->model_width
+                         ? input_img->width_stride * app_ctx->model_channel : row;
+        for (int y = 0; y < app_ctx->model_height; y++) {
+            memcpy((unsigned char *)app_ctx->input_mems[0]->virt_addr + y * row, input_img->virt_addr + y * stride, row);
+        }
     }
 
     // Run
-    printf("rknn_run\n");
+    // printf("rknn_run\n");
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0) {
         printf("rknn_run fail! ret=%d\n", ret);
@@ -319,7 +308,7 @@ int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // Post Process
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    post_process(app_ctx, outputs, letter_box, box_conf_threshold, nms_threshold, od_results);
 
     for (int i = 0; i < app_ctx->io_num.n_output; i++) {
         free(outputs[i].buf);
@@ -327,4 +316,53 @@ int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
 
 out:
     return ret;
-}
\ No newline at end of file
+}
+
+// the input tensor memory is created at init, other buffers are copied into it
+int yolov8_bind_input(rknn_app_context_t *app_ctx, image_buffer_t *img) {
+    (void)app_ctx;
+    (void)img;
+    return -1;
+}
+
+void yolov8_unbind_input(rknn_app_context_t *app_ctx, image_buffer_t *img) {
+    (void)app_ctx;
+    (void)img;
+}
+
+int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results) {
+    int ret;
+    image_buffer_t dst_img;
+    letterbox_t letter_box;
+    int bg_color = 114;
+
+    if ((!app_ctx) || !(img) || (!od_results)) {
+        return -1;
+    }
+
+    memset(od_results, 0x00, sizeof(*od_results));
+    memset(&letter_box, 0, sizeof(letterbox_t));
+    memset(&dst_img, 0, sizeof(image_buffer_t));
+
+    // Pre Process
+    dst_img.width = app_ctx->model_width;
+    dst_img.height = app_ctx->model_height;
+    dst_img.format = IMAGE_FORMAT_RGB888;
+    dst_img.size = get_image_size(&dst_img);
+    dst_img.fd = app_ctx->input_mems[0]->fd;
+    dst_img.virt_addr = (unsigned char*)app_ctx->input_mems[0]->virt_addr;
+
+    if (dst_img.virt_addr == NULL && dst_img.fd == 0) {
+        printf("malloc buffer size:%d fail!\n", dst_img.size);
+        return -1;
+    }
+
+    // letterbox
+    ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
+    if (ret < 0) {
+        printf("convert_image_with_letterbox fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    return inference_yolov8_model_with_input(app_ctx, &dst_img, &letter_box, od_results);
+}
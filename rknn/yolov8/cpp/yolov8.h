@@ -18,6 +18,7 @@
 
 #include "rknn_api.h"
 #include "common.h"
+#include "infer_backend.h"
 
 #if defined(RV1106_1103) 
     typedef struct {
@@ -27,8 +28,28 @@
     }rknn_dma_buf;
 #endif
 
+typedef struct yolov8_profile_t yolov8_profile_t;
+
+// One input shape of a dynamic shape model with the output attributes it produces
+typedef struct {
+    int width;
+    int height;
+    rknn_tensor_attr input_attr;
+    rknn_tensor_attr* output_attrs;
+} yolov8_input_shape_t;
+
 typedef struct {
-    rknn_context rknn_ctx;
+    rknn_context rknn_ctx;         // 0 when a backend other than rknn runs the model
+    rknn_tensor_mem* model_mem;    // model buffer of a zero copy load, NULL otherwise
+    infer_backend_t* backend;      // rknpu2/yolov8.cc runs the model through it, owns rknn_ctx
+    image_buffer_t input_img;      // letterbox destination of inference_yolov8_model, allocated once
+    bool input_is_dma;
+    bool input_is_bound;           // input 0 is read from bound buffers (input_img, yolov8_bind_input), never inputs_set
+    int input_buf_size;            // allocated size of input_img, fits the largest input shape
+    int num_shapes;                // input shapes of a dynamic shape model, 0 for a static model
+    yolov8_input_shape_t* shapes;
+    int shape_index;               // shape the model runs with, its attrs are in input_attrs / output_attrs
+    yolov8_profile_t* profile;     // set before init to record every inference (yolov8_profile.h), not owned
     rknn_input_output_num io_num;
     rknn_tensor_attr* input_attrs;
     rknn_tensor_attr* output_attrs;
@@ -54,8 +75,38 @@ typedef struct {
 
 int init_yolov8_model(const char* model_path, rknn_app_context_t* app_ctx);
 
+// Set up an app context around an already created rknn context (e.g. from rknn_dup_context), owns ctx afterwards
+int init_yolov8_model_with_context(rknn_context ctx, rknn_app_context_t* app_ctx);
+
+// Set up an app context around a loaded backend (rknpu2/yolov8.cc only), owns backend afterwards
+int init_yolov8_model_with_backend(infer_backend_t* backend, rknn_app_context_t* app_ctx);
+
 int release_yolov8_model(rknn_app_context_t* app_ctx);
 
+// A dynamic shape model is switched to the input shape that fits img first (yolov8_select_input_shape)
 int inference_yolov8_model(rknn_app_context_t* app_ctx, image_buffer_t* img, object_detect_result_list* od_results);
 
+// Run on an already preprocessed model input (model_width x model_height RGB888), letter_box maps the boxes back.
+// input_img may be a view into a larger image: rows width_stride pixels apart
+int inference_yolov8_model_with_input(rknn_app_context_t* app_ctx, image_buffer_t* input_img, letterbox_t* letter_box,
+                                      object_detect_result_list* od_results);
+
+// Give input_img to the model for the next run without running it, e.g. before infer_backend_run_async().
+// Selects it when it is bound, copies it otherwise (rknpu2/yolov8.cc only)
+int yolov8_set_input(rknn_app_context_t* app_ctx, image_buffer_t* input_img);
+
+// Bind a buffer that will be passed as model input (e.g. each one of a frame pool) once, so runs read it in
+// place instead of a copy per frame. -1: the context or the buffer can not be bound, it keeps being copied
+int yolov8_bind_input(rknn_app_context_t* app_ctx, image_buffer_t* img);
+
+// Before the buffer is freed
+void yolov8_unbind_input(rknn_app_context_t* app_ctx, image_buffer_t* img);
+
+// Dynamic shape models: the registered shape for a width x height source with the least padding and no
+// less resolution than the largest shape gives (e.g. 640x384 for 1920x1080), -1 for static models
+int yolov8_select_input_shape(rknn_app_context_t* app_ctx, int width, int height);
+
+// Run the following frames with registered shape index: model_width / height, the attrs and input_img follow
+int yolov8_set_input_shape(rknn_app_context_t* app_ctx, int index);
+
 #endif //_RKNN_DEMO_YOLOV8_H_
\ No newline at end of file
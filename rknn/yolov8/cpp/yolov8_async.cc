@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "yolov8_async.h"
+#include "frame_pool.h"
+#include "image_utils.h"
+
+#define ASYNC_BG_COLOR 114
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_PREPROCESS,           // reserved by submit, letterbox in progress
+    SLOT_QUEUED,
+    SLOT_RUNNING,
+    SLOT_DONE,
+} async_slot_state_t;
+
+typedef struct {
+    async_slot_state_t state;
+    int64_t frame_id;
+    uint64_t npu_frame_id;     // from infer_backend_run_async
+    frame_t* input;            // letterboxed model input, held by the slot
+    letterbox_t letter_box;
+    std::vector<rknn_output> outputs;
+    object_detect_result_list results;
+    int ret;
+} async_slot_t;
+
+struct yolov8_async_t {
+    rknn_app_context_t* app_ctx;
+    std::vector<async_slot_t> slots;
+    frame_pool_t* inputs;
+    int event_fd;
+    std::thread npu_thread;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    int64_t next_frame_id;
+    bool stop;
+};
+
+static int find_slot(yolov8_async_t* a, int64_t frame_id)
+{
+    for (size_t i = 0; i < a->slots.size(); i++) {
+        if (a->slots[i].state != SLOT_FREE && a->slots[i].frame_id == frame_id) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// lowest frame id in the given state, -1 if none
+static int oldest_slot(yolov8_async_t* a, async_slot_state_t state)
+{
+    int found = -1;
+    for (size_t i = 0; i < a->slots.size(); i++) {
+        if (a->slots[i].state == state && (found < 0 || a->slots[i].frame_id < a->slots[found].frame_id)) {
+            found = (int)i;
+        }
+    }
+    return found;
+}
+
+static int count_in_flight(yolov8_async_t* a)
+{
+    int n = 0;
+    for (size_t i = 0; i < a->slots.size(); i++) {
+        n += a->slots[i].state != SLOT_FREE;
+    }
+    return n;
+}
+
+static bool has_slot(yolov8_async_t* a, async_slot_state_t state)
+{
+    return oldest_slot(a, state) >= 0;
+}
+
+/*-------------------------------------------
+                  NPU thread
+-------------------------------------------*/
+static void finish_slot(yolov8_async_t* a, async_slot_t* slot, int ret)
+{
+    {
+        std::lock_guard<std::mutex> lock(a->lock);
+        slot->ret = ret;
+        slot->state = SLOT_DONE;
+    }
+    uint64_t one = 1;
+    if (write(a->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        printf("async: eventfd write fail!\n");
+    }
+    a->cond.notify_all();
+}
+
+// the context holds one frame: set its input and start it
+static int start_slot(yolov8_async_t* a, async_slot_t* slot)
+{
+    rknn_app_context_t* app_ctx = a->app_ctx;
+    int ret = yolov8_set_input(app_ctx, &slot->input->image);
+    if (ret < 0) {
+        printf("async: set input of frame %lld fail! ret=%d\n", (long long)slot->frame_id, ret);
+        return ret;
+    }
+    ret = infer_backend_run_async(app_ctx->backend, &slot->npu_frame_id);
+    if (ret < 0) {
+        printf("async: run of frame %lld fail! ret=%d\n", (long long)slot->frame_id, ret);
+    }
+    return ret;
+}
+
+// next queued frame, started; -1 if there is none (wait for one when block)
+static int start_next(yolov8_async_t* a, bool block)
+{
+    for (;;) {
+        int next;
+        {
+            std::unique_lock<std::mutex> lock(a->lock);
+            if (block) {
+                a->cond.wait(lock, [a] { return a->stop || has_slot(a, SLOT_QUEUED); });
+            }
+            next = oldest_slot(a, SLOT_QUEUED);
+            if (next < 0) {
+                return -1;
+            }
+            a->slots[next].state = SLOT_RUNNING;
+        }
+        int ret = start_slot(a, &a->slots[next]);
+        if (ret == 0) {
+            return next;
+        }
+        finish_slot(a, &a->slots[next], -1);
+    }
+}
+
+static int collect_outputs(yolov8_async_t* a, async_slot_t* slot)
+{
+    rknn_app_context_t* app_ctx = a->app_ctx;
+    int ret = infer_backend_wait(app_ctx->backend, slot->npu_frame_id, 0);
+    if (ret < 0) {
+        printf("async: wait for frame %lld fail! ret=%d\n", (long long)slot->frame_id, ret);
+        return ret;
+    }
+    ret = infer_backend_outputs_get(app_ctx->backend, app_ctx->io_num.n_output, &slot->outputs[0]);
+    if (ret < 0) {
+        printf("async: outputs_get of frame %lld fail! ret=%d\n", (long long)slot->frame_id, ret);
+        return ret;
+    }
+    infer_backend_outputs_release(app_ctx->backend, app_ctx->io_num.n_output, &slot->outputs[0]);
+    return 0;
+}
+
+static void npu_thread(yolov8_async_t* a)
+{
+    int running = -1;
+    for (;;) {
+        if (running < 0) {
+            running = start_next(a, true);
+            if (running < 0) {
+                break;
+            }
+        }
+        async_slot_t* slot = &a->slots[running];
+        int ret = collect_outputs(a, slot);
+        // the outputs are copied out: the NPU runs the next frame while this one is post processed
+        running = start_next(a, false);
+        if (ret == 0) {
+            memset(&slot->results, 0, sizeof(slot->results));
+            ret = post_process(a->app_ctx, &slot->outputs[0], &slot->letter_box, BOX_THRESH, NMS_THRESH,
+                               &slot->results);
+        }
+        finish_slot(a, slot, ret < 0 ? -1 : 0);
+    }
+}
+
+/*-------------------------------------------
+                  Public API
+-------------------------------------------*/
+void yolov8_async_config_default(yolov8_async_config_t* config)
+{
+    memset(config, 0, sizeof(yolov8_async_config_t));
+    config->max_in_flight = 3;
+}
+
+static void free_slots(yolov8_async_t* a)
+{
+    for (size_t i = 0; i < a->slots.size(); i++) {
+        async_slot_t* slot = &a->slots[i];
+        if (slot->input != NULL) {
+            yolov8_unbind_input(a->app_ctx, &slot->input->image);
+        }
+        frame_release(slot->input);
+        for (size_t j = 0; j < slot->outputs.size(); j++) {
+            free(slot->outputs[j].buf);
+        }
+    }
+    frame_pool_destroy(a->inputs);
+    if (a->event_fd >= 0) {
+        close(a->event_fd);
+    }
+}
+
+yolov8_async_t* yolov8_async_create(rknn_app_context_t* app_ctx, yolov8_async_config_t* config)
+{
+    yolov8_async_config_t default_config;
+    if (app_ctx == NULL || app_ctx->backend == NULL) {
+        printf("async inference needs a model initialized with an inference backend\n");
+        return NULL;
+    }
+    if (config == NULL) {
+        yolov8_async_config_default(&default_config);
+        config = &default_config;
+    }
+    int num_slots = config->max_in_flight > 0 ? config->max_in_flight : 1;
+
+    yolov8_async_t* a = new yolov8_async_t();
+    a->app_ctx = app_ctx;
+    a->event_fd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+    a->next_frame_id = 0;
+    a->stop = false;
+    a->slots.resize(num_slots);
+    frame_pool_config_t pool_config;
+    frame_pool_config_default(&pool_config);
+    pool_config.width = app_ctx->model_width;
+    pool_config.height = app_ctx->model_height;
+    pool_config.format = IMAGE_FORMAT_RGB888;
+    pool_config.count = num_slots;
+    a->inputs = frame_pool_create(&pool_config);
+    bool ok = a->event_fd >= 0 && a->inputs != NULL;
+    for (int i = 0; i < num_slots && ok; i++) {
+        async_slot_t* slot = &a->slots[i];
+        slot->state = SLOT_FREE;
+        slot->input = frame_pool_acquire(a->inputs, 0);
+        ok = slot->input != NULL;
+        // the slot keeps its input buffer, bound once it is run in place
+        if (ok) {
+            yolov8_bind_input(app_ctx, &slot->input->image);
+        }
+
+        // per frame in flight, the NPU thread copies the outputs here before starting the next frame
+        slot->outputs.resize(app_ctx->io_num.n_output);
+        for (uint32_t j = 0; j < app_ctx->io_num.n_output; j++) {
+            rknn_output* out = &slot->outputs[j];
+            rknn_tensor_attr* attr = &app_ctx->output_attrs[j];
+            memset(out, 0, sizeof(rknn_output));
+            out->index = j;
+            out->want_float = !app_ctx->is_quant;
+            out->is_prealloc = 1;
+            out->size = out->want_float ? attr->n_elems * sizeof(float) : attr->size;
+            out->buf = malloc(out->size);
+            ok = ok && out->buf != NULL;
+        }
+    }
+    if (!ok) {
+        printf("async: alloc buffers fail!\n");
+        free_slots(a);
+        delete a;
+        return NULL;
+    }
+    a->npu_thread = std::thread(npu_thread, a);
+    return a;
+}
+
+int64_t yolov8_async_submit(yolov8_async_t* async, image_buffer_t* img)
+{
+    if (img == NULL) {
+        return -1;
+    }
+    int index;
+    int64_t frame_id;
+    {
+        std::unique_lock<std::mutex> lock(async->lock);
+        for (;;) {
+            index = oldest_slot(async, SLOT_FREE);
+            if (index >= 0) {
+                break;
+            }
+            // nothing will free a slot unless a frame is still being worked on
+            if (!has_slot(async, SLOT_PREPROCESS) && !has_slot(async, SLOT_QUEUED) &&
+                !has_slot(async, SLOT_RUNNING)) {
+                printf("async: %d frames done and not collected, wait for them first\n", (int)async->slots.size());
+                return -1;
+            }
+            async->cond.wait(lock);
+        }
+        frame_id = async->next_frame_id++;
+        async->slots[index].state = SLOT_PREPROCESS;
+        async->slots[index].frame_id = frame_id;
+    }
+
+    async_slot_t* slot = &async->slots[index];
+    memset(&slot->letter_box, 0, sizeof(letterbox_t));
+    int ret = convert_image_with_letterbox(img, &slot->input->image, &slot->letter_box, ASYNC_BG_COLOR);
+    {
+        std::lock_guard<std::mutex> lock(async->lock);
+        if (ret < 0) {
+            printf("async: letterbox of frame %lld fail! ret=%d\n", (long long)frame_id, ret);
+            slot->state = SLOT_FREE;
+        } else {
+            slot->state = SLOT_QUEUED;
+        }
+    }
+    async->cond.notify_all();
+    return ret < 0 ? -1 : frame_id;
+}
+
+int yolov8_async_wait(yolov8_async_t* async, int64_t* frame_id, object_detect_result_list* od_results,
+                      int timeout_ms)
+{
+    if (frame_id == NULL || od_results == NULL) {
+        return -1;
+    }
+    std::unique_lock<std::mutex> lock(async->lock);
+    bool any = *frame_id == YOLOV8_ASYNC_ANY;
+    int index = -1;
+    // also true when there is nothing to wait for (any: nothing in flight, else an unknown frame id)
+    auto ready = [async, any, frame_id, &index] {
+        if (any) {
+            index = oldest_slot(async, SLOT_DONE);
+            return index >= 0 || count_in_flight(async) == 0;
+        }
+        index = find_slot(async, *frame_id);
+        return index < 0 || async->slots[index].state == SLOT_DONE;
+    };
+    if (timeout_ms < 0) {
+        async->cond.wait(lock, ready);
+    } else if (!async->cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+        return YOLOV8_ASYNC_PENDING;
+    }
+    if (index < 0) {
+        return -1;
+    }
+
+    async_slot_t* slot = &async->slots[index];
+    *frame_id = slot->frame_id;
+    int ret = slot->ret;
+    if (ret == 0) {
+        *od_results = slot->results;
+    } else {
+        memset(od_results, 0, sizeof(object_detect_result_list));
+    }
+    slot->state = SLOT_FREE;
+    uint64_t value;
+    if (read(async->event_fd, &value, sizeof(value)) != sizeof(value)) {
+        printf("async: eventfd read fail!\n");
+    }
+    lock.unlock();
+    async->cond.notify_all();
+    return ret;
+}
+
+int yolov8_async_poll(yolov8_async_t* async, int64_t* frame_id, object_detect_result_list* od_results)
+{
+    return yolov8_async_wait(async, frame_id, od_results, 0);
+}
+
+int yolov8_async_get_fd(yolov8_async_t* async)
+{
+    return async->event_fd;
+}
+
+int yolov8_async_in_flight(yolov8_async_t* async)
+{
+    std::lock_guard<std::mutex> lock(async->lock);
+    return count_in_flight(async);
+}
+
+void yolov8_async_destroy(yolov8_async_t* async)
+{
+    if (async == NULL) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(async->lock);
+        async->stop = true;
+    }
+    async->cond.notify_all();
+    // the NPU thread finishes the queued frames before it sees stop
+    async->npu_thread.join();
+    free_slots(async);
+    delete async;
+}
@@ -0,0 +1,61 @@
+#ifndef _RKNN_DEMO_YOLOV8_ASYNC_H_
+#define _RKNN_DEMO_YOLOV8_ASYNC_H_
+
+#include <stdint.h>
+
+#include "yolov8.h"
+
+#define YOLOV8_ASYNC_ANY -1       // frame id for yolov8_async_wait(): the next finished frame
+#define YOLOV8_ASYNC_PENDING 1    // yolov8_async_wait() / poll(): not finished yet
+
+typedef struct {
+    int max_in_flight;        // frames submitted and not collected yet, submit blocks beyond that
+} yolov8_async_config_t;
+
+typedef struct yolov8_async_t yolov8_async_t;
+
+void yolov8_async_config_default(yolov8_async_config_t* config);
+
+/**
+ * Asynchronous inference on one context: submit() letterboxes the frame on the calling thread and
+ * queues it, an NPU thread starts it with a non blocking rknn_run and collects it with rknn_wait,
+ * starting the next queued frame before post processing the finished one. So frame N+1 can be
+ * submitted (and run) before the results of frame N are collected.
+ * A frame goes submitted -> queued -> running -> done -> collected by poll() or wait().
+ * app_ctx must come from init_yolov8_model() (rknpu2/yolov8.cc, any backend) and is used by it
+ * only until yolov8_async_destroy().
+ */
+yolov8_async_t* yolov8_async_create(rknn_app_context_t* app_ctx, yolov8_async_config_t* config);
+
+/**
+ * Queue a frame, returns its frame id (increasing from 0) or -1. img is not used after the call.
+ * Blocks while max_in_flight frames are in flight, fails when all of them are done and wait for
+ * collection.
+ */
+int64_t yolov8_async_submit(yolov8_async_t* async, image_buffer_t* img);
+
+/**
+ * Collect a finished frame: *frame_id selects it, YOLOV8_ASYNC_ANY the oldest finished one, and
+ * is set to the collected frame. timeout_ms < 0 waits forever, 0 does not wait.
+ * Returns 0 with od_results filled, YOLOV8_ASYNC_PENDING on timeout, -1 for an unknown frame id,
+ * nothing in flight or a failed frame (collected as well).
+ */
+int yolov8_async_wait(yolov8_async_t* async, int64_t* frame_id, object_detect_result_list* od_results,
+                      int timeout_ms);
+
+// yolov8_async_wait() with a timeout of 0
+int yolov8_async_poll(yolov8_async_t* async, int64_t* frame_id, object_detect_result_list* od_results);
+
+/**
+ * eventfd (EFD_SEMAPHORE) that is readable while finished frames wait for collection, for
+ * poll/epoll loops. Collecting a frame reads it once; do not read it yourself.
+ */
+int yolov8_async_get_fd(yolov8_async_t* async);
+
+// Frames submitted and not collected yet
+int yolov8_async_in_flight(yolov8_async_t* async);
+
+// Finish the frames in flight, drop their results, stop the NPU thread and free the buffers
+void yolov8_async_destroy(yolov8_async_t* async);
+
+#endif //_RKNN_DEMO_YOLOV8_ASYNC_H_
@@ -0,0 +1,461 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "yolov8_batch.h"
+#include "yolov8_pool.h"
+#include "bounded_queue.h"
+#include "image_utils.h"
+#include "jpeg_decoder.h"
+#include "frame_pool.h"
+
+#define BATCH_BG_COLOR 114
+#define BATCH_WRITE_BUFFER (1 << 20)
+
+typedef struct {
+    int index;
+    image_buffer_t image;
+    jpeg_decoder_t* decoder;   // owner of image.virt_addr, NULL: malloc
+} decoded_item_t;
+
+typedef struct {
+    int index;
+    frame_t* input;            // model input buffer holding the letterboxed image
+    int width;
+    int height;
+    letterbox_t letter_box;
+} input_item_t;
+
+typedef struct {
+    int index;
+    int width;
+    int height;
+    object_detect_result_list results;
+} result_item_t;
+
+struct batch_state_t {
+    const std::vector<std::string>* files;
+    yolov8_batch_config_t* config;
+    std::vector<jpeg_decoder_t*> decoders;
+    frame_pool_t* slots;
+    yolov8_context_pool_t* pool;
+
+    BoundedQueue<decoded_item_t> decoded;
+    BoundedQueue<input_item_t> inputs;
+    BoundedQueue<result_item_t> results;
+
+    std::atomic<int> next_file;
+    std::atomic<long> failed;
+    std::atomic<long> written;
+    std::atomic<int> running[BATCH_STAGE_NUM];   // the last thread of a stage closes its output queue
+
+    std::mutex stats_lock;
+    double busy_ms[BATCH_STAGE_NUM];
+    double start_ms;
+
+    batch_state_t(int depth)
+        : slots(NULL), pool(NULL), decoded(depth), inputs(depth), results(depth), next_file(0), failed(0),
+          written(0)
+    {
+        memset(busy_ms, 0, sizeof(busy_ms));
+    }
+};
+
+// every slot is bound on every context once, inference reads it in place whichever context runs it
+static void bind_slots(batch_state_t* s, bool bind)
+{
+    image_buffer_t image;
+    for (int i = 0; frame_pool_get_image(s->slots, i, &image) == 0; i++) {
+        for (int c = 0; c < yolov8_pool_size(s->pool); c++) {
+            rknn_app_context_t* app_ctx = yolov8_pool_get_context(s->pool, c);
+            if (bind) {
+                yolov8_bind_input(app_ctx, &image);
+            } else {
+                yolov8_unbind_input(app_ctx, &image);
+            }
+        }
+    }
+}
+
+static double now_ms()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void add_busy(batch_state_t* s, int stage, double ms)
+{
+    std::lock_guard<std::mutex> lock(s->stats_lock);
+    s->busy_ms[stage] += ms;
+}
+
+static bool is_jpeg(const std::string& path)
+{
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    return ext == "jpg" || ext == "jpeg" || ext == "JPG" || ext == "JPEG";
+}
+
+static void release_decoded(decoded_item_t* item)
+{
+    if (item->decoder != NULL) {
+        jpeg_decoder_release(item->decoder, &item->image);
+    } else if (item->image.virt_addr != NULL) {
+        free(item->image.virt_addr);
+        item->image.virt_addr = NULL;
+    }
+}
+
+/*-------------------------------------------
+                  Stages
+-------------------------------------------*/
+static void decode_worker(batch_state_t* s, jpeg_decoder_t* decoder)
+{
+    jpeg_decode_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.format = IMAGE_FORMAT_RGB888;
+    // no need to decode more pixels than the letterbox keeps
+    rknn_app_context_t* app_ctx = yolov8_pool_get_context(s->pool, 0);
+    param.min_width = app_ctx->model_width;
+    param.min_height = app_ctx->model_height;
+    param.letterbox_fit = 1;
+
+    double busy = 0;
+    int num_files = (int)s->files->size();
+    for (;;) {
+        int index = s->next_file++;
+        if (index >= num_files) {
+            break;
+        }
+        const std::string& path = (*s->files)[index];
+        double t0 = now_ms();
+        decoded_item_t item;
+        memset(&item, 0, sizeof(decoded_item_t));
+        item.index = index;
+        int ret;
+        if (is_jpeg(path)) {
+            item.decoder = decoder;
+            ret = jpeg_decoder_decode_file(decoder, path.c_str(), &param, &item.image);
+        } else {
+            ret = read_image(path.c_str(), &item.image);
+        }
+        busy += now_ms() - t0;
+        if (ret != 0 || item.image.width <= 0) {
+            printf("decode %s fail!\n", path.c_str());
+            release_decoded(&item);
+            s->failed++;
+            continue;
+        }
+        if (!s->decoded.push(item)) {
+            release_decoded(&item);
+            break;
+        }
+    }
+    add_busy(s, BATCH_STAGE_DECODE, busy);
+    if (--s->running[BATCH_STAGE_DECODE] == 0) {
+        s->decoded.close();
+    }
+}
+
+static void preprocess_worker(batch_state_t* s)
+{
+    double busy = 0;
+    decoded_item_t item;
+    while (s->decoded.pop(&item)) {
+        frame_t* slot = frame_pool_acquire(s->slots, -1);
+        double t0 = now_ms();
+        input_item_t input;
+        memset(&input, 0, sizeof(input_item_t));
+        input.index = item.index;
+        input.input = slot;
+        input.width = item.image.width;
+        input.height = item.image.height;
+        int ret = convert_image_with_letterbox(&item.image, &slot->image, &input.letter_box, BATCH_BG_COLOR);
+        release_decoded(&item);
+        busy += now_ms() - t0;
+        if (ret < 0) {
+            printf("letterbox %s fail! ret=%d\n", (*s->files)[item.index].c_str(), ret);
+            s->failed++;
+            frame_release(slot);
+            continue;
+        }
+        s->inputs.push(input);
+    }
+    add_busy(s, BATCH_STAGE_PREPROCESS, busy);
+    if (--s->running[BATCH_STAGE_PREPROCESS] == 0) {
+        s->inputs.close();
+    }
+}
+
+static void inference_worker(batch_state_t* s)
+{
+    double busy = 0;
+    input_item_t input;
+    result_item_t* result = (result_item_t*)malloc(sizeof(result_item_t));
+    while (s->inputs.pop(&input)) {
+        double t0 = now_ms();
+        int ret = yolov8_pool_inference_with_input(s->pool, &input.input->image, &input.letter_box,
+                                                   &result->results);
+        frame_release(input.input);
+        busy += now_ms() - t0;
+        if (ret < 0) {
+            printf("inference %s fail! ret=%d\n", (*s->files)[input.index].c_str(), ret);
+            s->failed++;
+            continue;
+        }
+        result->index = input.index;
+        result->width = input.width;
+        result->height = input.height;
+        s->results.push(*result);
+    }
+    free(result);
+    add_busy(s, BATCH_STAGE_INFERENCE, busy);
+    if (--s->running[BATCH_STAGE_INFERENCE] == 0) {
+        s->results.close();
+    }
+}
+
+static void write_json_string(FILE* fp, const char* str)
+{
+    fputc('"', fp);
+    for (const char* p = str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', fp);
+        }
+        fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+static void write_result(FILE* fp, const std::string& path, result_item_t* r)
+{
+    fputs("{\"image\":", fp);
+    write_json_string(fp, path.c_str());
+    fprintf(fp, ",\"width\":%d,\"height\":%d,\"objects\":[", r->width, r->height);
+    for (int i = 0; i < r->results.count; i++) {
+        object_detect_result* det = &r->results.results[i];
+        fprintf(fp, "%s{\"class\":", i > 0 ? "," : "");
+        write_json_string(fp, coco_cls_to_name(det->cls_id));
+        fprintf(fp, ",\"score\":%.3f,\"box\":[%d,%d,%d,%d]}", det->prop, det->box.left, det->box.top,
+                det->box.right, det->box.bottom);
+    }
+    fputs("]}\n", fp);
+}
+
+static void writer_worker(batch_state_t* s)
+{
+    FILE* fp = NULL;
+    std::vector<char> file_buffer;
+    if (s->config->output_path != NULL) {
+        fp = fopen(s->config->output_path, "w");
+        if (fp == NULL) {
+            printf("open %s fail, results are not written\n", s->config->output_path);
+        } else {
+            file_buffer.resize(BATCH_WRITE_BUFFER);
+            setvbuf(fp, &file_buffer[0], _IOFBF, file_buffer.size());
+        }
+    }
+
+    double busy = 0;
+    result_item_t* result = (result_item_t*)malloc(sizeof(result_item_t));
+    while (s->results.pop(result)) {
+        double t0 = now_ms();
+        if (fp != NULL) {
+            write_result(fp, (*s->files)[result->index], result);
+        }
+        long written = ++s->written;
+        busy += now_ms() - t0;
+        if (s->config->report_every > 0 && written % s->config->report_every == 0) {
+            printf("batch: %ld/%d images, %.1f images/sec\n", written, (int)s->files->size(),
+                   written * 1000.0 / (now_ms() - s->start_ms));
+        }
+    }
+    free(result);
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    add_busy(s, BATCH_STAGE_WRITE, busy);
+}
+
+/*-------------------------------------------
+                  Public API
+-------------------------------------------*/
+void yolov8_batch_config_default(yolov8_batch_config_t* config)
+{
+    int cpus = (int)std::thread::hardware_concurrency();
+    memset(config, 0, sizeof(yolov8_batch_config_t));
+    // leave cores for letterbox, post process and the writer
+    config->decode_threads = cpus > 4 ? cpus / 2 : 1;
+    config->preprocess_threads = 1;
+    config->num_contexts = 3;
+    config->queue_depth = 8;
+    config->output_path = NULL;
+    config->report_every = 1000;
+}
+
+int yolov8_batch_list_files(const char* path, bool is_list, std::vector<std::string>* files)
+{
+    files->clear();
+    if (!is_list) {
+        char** list = NULL;
+        int count = list_image_files(path, &list);
+        if (count < 0) {
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            files->push_back(list[i]);
+        }
+        free_image_file_list(list, count);
+        return 0;
+    }
+
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len > 0 && line[0] != '#') {
+            files->push_back(line);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+int run_yolov8_batch(const char* model_path, const std::vector<std::string>& files, yolov8_batch_config_t* config,
+                     yolov8_batch_stats_t* stats)
+{
+    static const char* stage_names[BATCH_STAGE_NUM] = {"decode", "preprocess", "inference", "write"};
+    yolov8_batch_config_t default_config;
+    int ret = 0;
+
+    if (model_path == NULL || stats == NULL || files.empty()) {
+        return -1;
+    }
+    if (config == NULL) {
+        yolov8_batch_config_default(&default_config);
+        config = &default_config;
+    }
+    int depth = config->queue_depth > 0 ? config->queue_depth : 1;
+    int num_contexts = config->num_contexts > 0 ? config->num_contexts : 1;
+    int decode_threads = config->decode_threads > 0 ? config->decode_threads : 1;
+    int preprocess_threads = config->preprocess_threads > 0 ? config->preprocess_threads : 1;
+    // every context holds one input while the next ones wait letterboxed in the queue
+    int num_slots = depth + num_contexts;
+
+    batch_state_t* s = new batch_state_t(depth);
+    s->files = &files;
+    s->config = config;
+
+    // the contexts share one copy of the weights and are spread over the NPU cores
+    yolov8_pool_config_t pool_config;
+    yolov8_pool_config_default(&pool_config);
+    pool_config.num_contexts = num_contexts;
+    s->pool = yolov8_pool_create(model_path, &pool_config);
+    if (s->pool == NULL) {
+        printf("yolov8_pool_create fail! model_path=%s\n", model_path);
+        ret = -1;
+        goto out;
+    }
+
+    // model inputs are allocated once and cycle between preprocess and inference
+    {
+        frame_pool_config_t slot_config;
+        frame_pool_config_default(&slot_config);
+        slot_config.width = yolov8_pool_get_context(s->pool, 0)->model_width;
+        slot_config.height = yolov8_pool_get_context(s->pool, 0)->model_height;
+        slot_config.format = IMAGE_FORMAT_RGB888;
+        slot_config.count = num_slots;
+        s->slots = frame_pool_create(&slot_config);
+        if (s->slots == NULL) {
+            ret = -1;
+            goto out;
+        }
+        bind_slots(s, true);
+    }
+
+    // one decoder per worker, its pool covers the images queued or in preprocessing
+    for (int i = 0; i < decode_threads; i++) {
+        jpeg_decoder_t* decoder = jpeg_decoder_create(depth + preprocess_threads + 1);
+        if (decoder == NULL) {
+            ret = -1;
+            goto out;
+        }
+        s->decoders.push_back(decoder);
+    }
+
+    {
+        s->running[BATCH_STAGE_DECODE] = decode_threads;
+        s->running[BATCH_STAGE_PREPROCESS] = preprocess_threads;
+        s->running[BATCH_STAGE_INFERENCE] = num_contexts;
+        s->running[BATCH_STAGE_WRITE] = 1;
+        s->start_ms = now_ms();
+
+        std::vector<std::thread> threads;
+        threads.push_back(std::thread(writer_worker, s));
+        for (int i = 0; i < num_contexts; i++) {
+            threads.push_back(std::thread(inference_worker, s));
+        }
+        for (int i = 0; i < preprocess_threads; i++) {
+            threads.push_back(std::thread(preprocess_worker, s));
+        }
+        for (int i = 0; i < decode_threads; i++) {
+            threads.push_back(std::thread(decode_worker, s, s->decoders[i]));
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+
+    memset(stats, 0, sizeof(yolov8_batch_stats_t));
+    stats->total_ms = (float)(now_ms() - s->start_ms);
+    stats->images = s->written;
+    stats->failed = s->failed;
+    stats->images_per_sec = stats->total_ms > 0 ? stats->images * 1000.0f / stats->total_ms : 0;
+    {
+        int stage_threads[BATCH_STAGE_NUM] = {decode_threads, preprocess_threads, num_contexts, 1};
+        for (int i = 0; i < BATCH_STAGE_NUM; i++) {
+            yolov8_batch_stage_stats_t* stage = &stats->stages[i];
+            stage->name = stage_names[i];
+            stage->threads = stage_threads[i];
+            stage->busy_ms = s->busy_ms[i];
+            stage->utilization = stats->total_ms > 0 ? (float)(s->busy_ms[i] / (stage_threads[i] * stats->total_ms)) : 0;
+        }
+    }
+
+out:
+    for (size_t i = 0; i < s->decoders.size(); i++) {
+        jpeg_decoder_destroy(s->decoders[i]);
+    }
+    if (s->slots != NULL) {
+        bind_slots(s, false);
+    }
+    frame_pool_destroy(s->slots);
+    yolov8_pool_destroy(s->pool);
+    delete s;
+    return ret;
+}
+
+void yolov8_batch_print_stats(yolov8_batch_stats_t* stats)
+{
+    printf("images=%ld failed=%ld time=%.1fms %.1f images/sec\n", stats->images, stats->failed, stats->total_ms,
+           stats->images_per_sec);
+    for (int i = 0; i < BATCH_STAGE_NUM; i++) {
+        yolov8_batch_stage_stats_t* stage = &stats->stages[i];
+        printf("  %-10s threads=%-2d busy=%10.1fms utilization=%5.1f%%\n", stage->name, stage->threads,
+               stage->busy_ms, stage->utilization * 100);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef _RKNN_DEMO_YOLOV8_BATCH_H_
+#define _RKNN_DEMO_YOLOV8_BATCH_H_
+
+#include <string>
+#include <vector>
+
+#include "yolov8.h"
+
+typedef struct {
+    int decode_threads;       // parallel JPEG decode workers
+    int preprocess_threads;   // letterbox workers
+    int num_contexts;         // inference contexts, one thread each
+    int queue_depth;          // capacity of every queue between two stages
+    const char* output_path;  // JSON lines result file, NULL: results are dropped
+    int report_every;         // print progress every n images, 0: off
+} yolov8_batch_config_t;
+
+enum {
+    BATCH_STAGE_DECODE = 0,
+    BATCH_STAGE_PREPROCESS,
+    BATCH_STAGE_INFERENCE,
+    BATCH_STAGE_WRITE,
+    BATCH_STAGE_NUM
+};
+
+typedef struct {
+    const char* name;
+    int threads;
+    double busy_ms;           // time spent working, summed over the threads of the stage
+    float utilization;        // busy_ms / (threads * total_ms)
+} yolov8_batch_stage_stats_t;
+
+typedef struct {
+    long images;
+    long failed;
+    float total_ms;
+    float images_per_sec;
+    yolov8_batch_stage_stats_t stages[BATCH_STAGE_NUM];
+} yolov8_batch_stats_t;
+
+void yolov8_batch_config_default(yolov8_batch_config_t* config);
+
+// Collect the input files: every image of a directory, or one path per line of a list file
+int yolov8_batch_list_files(const char* path, bool is_list, std::vector<std::string>* files);
+
+/**
+ * Offline inference over a set of image files as a four stage pipeline:
+ * decode workers -> preprocess (letterbox into preallocated model inputs) -> one thread per
+ * inference context -> result writer. Stages are connected by bounded queues, so the decoders
+ * run ahead of the NPU by at most queue_depth images and memory stays flat for any number of files.
+ * Images that fail to decode or infer are counted in stats->failed and skipped.
+ */
+int run_yolov8_batch(const char* model_path, const std::vector<std::string>& files, yolov8_batch_config_t* config,
+                     yolov8_batch_stats_t* stats);
+
+void yolov8_batch_print_stats(yolov8_batch_stats_t* stats);
+
+#endif //_RKNN_DEMO_YOLOV8_BATCH_H_
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "yolov8_pipeline.h"
+#include "bounded_queue.h"
+#include "frame_pool.h"
+#include "image_utils.h"
+
+#define PIPELINE_BG_COLOR 114
+
+typedef struct {
+    int64_t frame_id;
+    image_buffer_t* img;
+    double submit_ms;
+} pipeline_frame_t;
+
+typedef struct {
+    pipeline_frame_t frame;
+    frame_t* input;            // NULL once the input went back to the pool
+    int out_slot;
+    letterbox_t letter_box;
+    uint64_t run_id;           // of infer_backend_run_async()
+    double npu_start_ms;
+    int ret;
+} pipeline_item_t;
+
+struct yolov8_pipeline_t {
+    rknn_app_context_t* app_ctx;
+    yolov8_pipeline_callback callback;
+    void* user_data;
+
+    frame_pool_t* inputs;                              // letterboxed model inputs
+    std::vector<std::vector<rknn_output> > outputs;   // per slot one preallocated rknn_output per model output
+
+    BoundedQueue<pipeline_frame_t> submitted;
+    BoundedQueue<int> free_outputs;
+    BoundedQueue<pipeline_item_t> preprocessed;
+    BoundedQueue<pipeline_item_t> inferred;
+    std::thread threads[PIPELINE_STAGE_NUM];
+
+    std::mutex lock;
+    std::condition_variable done_cond;
+    long pending;              // submitted, callback not called yet
+    yolov8_pipeline_stats_t stats;
+    double latency_ms;
+    double first_done_ms;
+    double last_done_ms;
+
+    yolov8_pipeline_t(int queue_depth, int num_buffers)
+        : inputs(NULL), submitted(queue_depth), free_outputs(num_buffers), preprocessed(num_buffers),
+          inferred(num_buffers), pending(0), latency_ms(0), first_done_ms(0), last_done_ms(0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+};
+
+static double now_ms()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void add_stage_time(yolov8_pipeline_t* p, int stage, double ms)
+{
+    std::lock_guard<std::mutex> lock(p->lock);
+    yolov8_pipeline_stage_stats_t* s = &p->stats.stages[stage];
+    s->frames++;
+    s->busy_ms += ms;
+    if (ms > s->max_ms) {
+        s->max_ms = (float)ms;
+    }
+}
+
+/*-------------------------------------------
+                  Stages
+-------------------------------------------*/
+static void preprocess_thread(yolov8_pipeline_t* p)
+{
+    pipeline_frame_t frame;
+    while (p->submitted.pop(&frame)) {
+        pipeline_item_t item;
+        memset(&item, 0, sizeof(pipeline_item_t));
+        item.frame = frame;
+        item.out_slot = -1;
+        // waits while every input is in flight, the NPU stage releases them
+        item.input = frame_pool_acquire(p->inputs, -1);
+        item.input->frame_id = frame.frame_id;
+        double t0 = now_ms();
+        item.ret = convert_image_with_letterbox(frame.img, &item.input->image, &item.letter_box, PIPELINE_BG_COLOR);
+        add_stage_time(p, PIPELINE_STAGE_PREPROCESS, now_ms() - t0);
+        if (item.ret < 0) {
+            printf("pipeline: letterbox of frame %lld fail! ret=%d\n", (long long)frame.frame_id, item.ret);
+            frame_release(item.input);
+            item.input = NULL;
+        }
+        p->preprocessed.push(item);
+    }
+    p->preprocessed.close();
+}
+
+static void start_npu(yolov8_pipeline_t* p, pipeline_item_t* item)
+{
+    rknn_app_context_t* app_ctx = p->app_ctx;
+    item->npu_start_ms = now_ms();
+    item->ret = yolov8_set_input(app_ctx, &item->input->image);
+    if (item->ret < 0) {
+        printf("pipeline: set input fail! ret=%d\n", item->ret);
+        return;
+    }
+    item->ret = infer_backend_run_async(app_ctx->backend, &item->run_id);
+    if (item->ret < 0) {
+        printf("pipeline: run fail! ret=%d\n", item->ret);
+    }
+}
+
+static int finish_npu(yolov8_pipeline_t* p, pipeline_item_t* item)
+{
+    rknn_app_context_t* app_ctx = p->app_ctx;
+    int ret = infer_backend_wait(app_ctx->backend, item->run_id, 0);
+    if (ret < 0) {
+        printf("pipeline: wait fail! ret=%d\n", ret);
+        return ret;
+    }
+    rknn_output* outputs = &p->outputs[item->out_slot][0];
+    ret = infer_backend_outputs_get(app_ctx->backend, app_ctx->io_num.n_output, outputs);
+    if (ret < 0) {
+        printf("pipeline: outputs_get fail! ret=%d\n", ret);
+        return ret;
+    }
+    infer_backend_outputs_release(app_ctx->backend, app_ctx->io_num.n_output, outputs);
+    return 0;
+}
+
+static void npu_thread(yolov8_pipeline_t* p)
+{
+    pipeline_item_t item;
+    pipeline_item_t next;
+    bool have_next = false;    // popped while item ran, its run started when it has an output slot
+    while (have_next || p->preprocessed.pop(&item)) {
+        if (have_next) {
+            item = next;
+            have_next = false;
+        }
+        if (item.ret == 0 && item.out_slot < 0) {
+            if (!p->free_outputs.pop(&item.out_slot)) {
+                break;
+            }
+            start_npu(p, &item);
+        }
+        if (item.ret == 0) {
+            item.ret = finish_npu(p, &item);
+            add_stage_time(p, PIPELINE_STAGE_NPU, now_ms() - item.npu_start_ms);
+            // the next frame runs before this one is handed on, so the preprocess woken by the
+            // release below can not keep the NPU waiting when they share a core
+            have_next = p->preprocessed.try_pop(&next);
+            if (have_next && next.ret == 0 && p->free_outputs.try_pop(&next.out_slot)) {
+                start_npu(p, &next);
+            }
+        }
+        // the input is consumed, preprocess can fill it with the next frame
+        frame_release(item.input);
+        item.input = NULL;
+        if (item.ret < 0 && item.out_slot >= 0) {
+            p->free_outputs.push(item.out_slot);
+            item.out_slot = -1;
+        }
+        p->inferred.push(item);
+    }
+    p->inferred.close();
+}
+
+static void postprocess_thread(yolov8_pipeline_t* p)
+{
+    pipeline_item_t item;
+    object_detect_result_list results;
+    while (p->inferred.pop(&item)) {
+        memset(&results, 0, sizeof(results));
+        if (item.ret == 0) {
+            double t0 = now_ms();
+            item.ret = post_process(p->app_ctx, &p->outputs[item.out_slot][0], &item.letter_box, BOX_THRESH,
+                                    NMS_THRESH, &results);
+            add_stage_time(p, PIPELINE_STAGE_POSTPROCESS, now_ms() - t0);
+            p->free_outputs.push(item.out_slot);
+        }
+        p->callback(p->user_data, item.frame.frame_id, item.frame.img, &results, item.ret);
+
+        double done = now_ms();
+        {
+            std::lock_guard<std::mutex> lock(p->lock);
+            double latency = done - item.frame.submit_ms;
+            p->stats.frames++;
+            if (item.ret < 0) {
+                p->stats.failed++;
+            }
+            p->latency_ms += latency;
+            if (latency > p->stats.max_latency_ms) {
+                p->stats.max_latency_ms = (float)latency;
+            }
+            if (p->first_done_ms == 0) {
+                p->first_done_ms = done;
+            }
+            p->last_done_ms = done;
+            p->pending--;
+        }
+        p->done_cond.notify_all();
+    }
+}
+
+/*-------------------------------------------
+                  Public API
+-------------------------------------------*/
+void yolov8_pipeline_config_default(yolov8_pipeline_config_t* config)
+{
+    memset(config, 0, sizeof(yolov8_pipeline_config_t));
+    config->num_buffers = 3;
+    config->queue_depth = 4;
+}
+
+// without a DMA heap the input buffers are memory of the backend, bound as they are allocated
+static void* alloc_bound_input(void* user_data, size_t size)
+{
+    rknn_app_context_t* app_ctx = (rknn_app_context_t*)user_data;
+    return infer_backend_bind_input(app_ctx->backend, -1, NULL, (uint32_t)size);
+}
+
+static void free_bound_input(void* user_data, void* addr)
+{
+    infer_backend_unbind_input(((rknn_app_context_t*)user_data)->backend, addr);
+}
+
+// every input buffer is bound once, the NPU reads the letterbox output in place (a dma_buf on the board).
+// -1 when one of them can not be bound
+static int bind_inputs(yolov8_pipeline_t* p, bool bind)
+{
+    image_buffer_t image;
+    int i = 0;
+    if (p->inputs == NULL || !p->app_ctx->input_is_bound) {
+        return 0;
+    }
+    for (; frame_pool_get_image(p->inputs, i, &image) == 0; i++) {
+        // the backend memory ones are bound by the pool
+        if (image.fd < 0) {
+            continue;
+        }
+        if (!bind) {
+            yolov8_unbind_input(p->app_ctx, &image);
+        } else if (yolov8_bind_input(p->app_ctx, &image) != 0) {
+            printf("pipeline: bind input buffer %d fail!\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void free_buffers(yolov8_pipeline_t* p)
+{
+    bind_inputs(p, false);
+    frame_pool_destroy(p->inputs);
+    for (size_t i = 0; i < p->outputs.size(); i++) {
+        for (size_t j = 0; j < p->outputs[i].size(); j++) {
+            free(p->outputs[i][j].buf);
+        }
+    }
+}
+
+yolov8_pipeline_t* yolov8_pipeline_create(rknn_app_context_t* app_ctx, yolov8_pipeline_config_t* config,
+                                          yolov8_pipeline_callback callback, void* user_data)
+{
+    yolov8_pipeline_config_t default_config;
+    if (app_ctx == NULL || app_ctx->backend == NULL || callback == NULL) {
+        printf("pipeline needs a model initialized with an inference backend\n");
+        return NULL;
+    }
+    if (config == NULL) {
+        yolov8_pipeline_config_default(&default_config);
+        config = &default_config;
+    }
+    int num_buffers = config->num_buffers > 0 ? config->num_buffers : 1;
+    int queue_depth = config->queue_depth > 0 ? config->queue_depth : 1;
+
+    yolov8_pipeline_t* p = new yolov8_pipeline_t(queue_depth, num_buffers);
+    p->app_ctx = app_ctx;
+    p->callback = callback;
+    p->user_data = user_data;
+
+    frame_pool_config_t pool_config;
+    frame_pool_config_default(&pool_config);
+    pool_config.width = app_ctx->model_width;
+    pool_config.height = app_ctx->model_height;
+    pool_config.format = IMAGE_FORMAT_RGB888;
+    pool_config.count = num_buffers;
+    // a context that copies its input (e.g. a model with padded rows) copies these as well
+    if (app_ctx->input_is_bound) {
+        pool_config.heap_alloc = alloc_bound_input;
+        pool_config.heap_free = free_bound_input;
+        pool_config.heap_user_data = app_ctx;
+    }
+    p->inputs = frame_pool_create(&pool_config);
+    p->outputs.resize(num_buffers);
+    for (int i = 0; i < num_buffers; i++) {
+
+        // outputs are copied straight into these, post process reads them while the NPU runs the next frame
+        p->outputs[i].resize(app_ctx->io_num.n_output);
+        for (uint32_t j = 0; j < app_ctx->io_num.n_output; j++) {
+            rknn_output* out = &p->outputs[i][j];
+            rknn_tensor_attr* attr = &app_ctx->output_attrs[j];
+            memset(out, 0, sizeof(rknn_output));
+            out->index = j;
+            out->want_float = !app_ctx->is_quant;
+            out->is_prealloc = 1;
+            out->size = out->want_float ? attr->n_elems * sizeof(float) : attr->size;
+            out->buf = malloc(out->size);
+        }
+        bool ok = p->inputs != NULL;
+        for (uint32_t j = 0; j < app_ctx->io_num.n_output; j++) {
+            ok = ok && p->outputs[i][j].buf != NULL;
+        }
+        if (!ok) {
+            printf("pipeline: alloc buffers fail!\n");
+            free_buffers(p);
+            delete p;
+            return NULL;
+        }
+        p->free_outputs.push(i);
+    }
+    if (bind_inputs(p, true) != 0) {
+        free_buffers(p);
+        delete p;
+        return NULL;
+    }
+    frame_pool_stats_t pool_stats;
+    frame_pool_get_stats(p->inputs, &pool_stats);
+    printf("pipeline: %d input buffers, %d dma_buf, %s\n", pool_stats.buffers, pool_stats.dma_buffers,
+           app_ctx->input_is_bound ? "bound as model input" : "copied to the model input");
+
+    p->threads[PIPELINE_STAGE_PREPROCESS] = std::thread(preprocess_thread, p);
+    p->threads[PIPELINE_STAGE_NPU] = std::thread(npu_thread, p);
+    p->threads[PIPELINE_STAGE_POSTPROCESS] = std::thread(postprocess_thread, p);
+    return p;
+}
+
+int yolov8_pipeline_submit(yolov8_pipeline_t* pipeline, image_buffer_t* img, int64_t frame_id)
+{
+    if (img == NULL) {
+        return -1;
+    }
+    pipeline_frame_t frame;
+    frame.frame_id = frame_id;
+    frame.img = img;
+    frame.submit_ms = now_ms();
+    {
+        std::lock_guard<std::mutex> lock(pipeline->lock);
+        pipeline->pending++;
+    }
+    if (!pipeline->submitted.push(frame)) {
+        std::lock_guard<std::mutex> lock(pipeline->lock);
+        pipeline->pending--;
+        return -1;
+    }
+    return 0;
+}
+
+void yolov8_pipeline_flush(yolov8_pipeline_t* pipeline)
+{
+    std::unique_lock<std::mutex> lock(pipeline->lock);
+    pipeline->done_cond.wait(lock, [pipeline] { return pipeline->pending == 0; });
+}
+
+void yolov8_pipeline_get_stats(yolov8_pipeline_t* pipeline, yolov8_pipeline_stats_t* stats)
+{
+    std::lock_guard<std::mutex> lock(pipeline->lock);
+    *stats = pipeline->stats;
+    if (stats->frames > 0) {
+        stats->avg_latency_ms = (float)(pipeline->latency_ms / stats->frames);
+    }
+    if (stats->frames > 1 && pipeline->last_done_ms > pipeline->first_done_ms) {
+        stats->fps = (float)((stats->frames - 1) * 1000.0 / (pipeline->last_done_ms - pipeline->first_done_ms));
+    }
+    for (int i = 0; i < PIPELINE_STAGE_NUM; i++) {
+        yolov8_pipeline_stage_stats_t* s = &stats->stages[i];
+        s->avg_ms = s->frames > 0 ? (float)(s->busy_ms / s->frames) : 0;
+    }
+}
+
+void yolov8_pipeline_reset_stats(yolov8_pipeline_t* pipeline)
+{
+    std::lock_guard<std::mutex> lock(pipeline->lock);
+    memset(&pipeline->stats, 0, sizeof(yolov8_pipeline_stats_t));
+    pipeline->latency_ms = 0;
+    pipeline->first_done_ms = 0;
+    pipeline->last_done_ms = 0;
+}
+
+void yolov8_pipeline_destroy(yolov8_pipeline_t* pipeline)
+{
+    if (pipeline == NULL) {
+        return;
+    }
+    yolov8_pipeline_flush(pipeline);
+    // closing the input ends the stages one after the other
+    pipeline->submitted.close();
+    for (int i = 0; i < PIPELINE_STAGE_NUM; i++) {
+        pipeline->threads[i].join();
+    }
+    free_buffers(pipeline);
+    delete pipeline;
+}
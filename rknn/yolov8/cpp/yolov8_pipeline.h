@@ -0,0 +1,69 @@
+#ifndef _RKNN_DEMO_YOLOV8_PIPELINE_H_
+#define _RKNN_DEMO_YOLOV8_PIPELINE_H_
+
+#include <stdint.h>
+
+#include "yolov8.h"
+
+enum {
+    PIPELINE_STAGE_PREPROCESS = 0,
+    PIPELINE_STAGE_NPU,
+    PIPELINE_STAGE_POSTPROCESS,
+    PIPELINE_STAGE_NUM
+};
+
+typedef struct {
+    int num_buffers;          // input and output tensor sets, frames in flight between the stages (3: triple buffering)
+    int queue_depth;          // submitted frames waiting for preprocess, submit blocks beyond that
+} yolov8_pipeline_config_t;
+
+typedef struct {
+    long frames;
+    double busy_ms;           // summed over the frames
+    float avg_ms;
+    float max_ms;
+} yolov8_pipeline_stage_stats_t;
+
+typedef struct {
+    long frames;
+    long failed;
+    float avg_latency_ms;     // submit to result callback
+    float max_latency_ms;
+    float fps;                // steady state: between the first and the last result
+    yolov8_pipeline_stage_stats_t stages[PIPELINE_STAGE_NUM];
+} yolov8_pipeline_stats_t;
+
+// Called on the postprocess thread, ret < 0 when the frame failed. img is the submitted image, free to reuse now.
+typedef void (*yolov8_pipeline_callback)(void* user_data, int64_t frame_id, image_buffer_t* img,
+                                         object_detect_result_list* od_results, int ret);
+
+typedef struct yolov8_pipeline_t yolov8_pipeline_t;
+
+void yolov8_pipeline_config_default(yolov8_pipeline_config_t* config);
+
+/**
+ * Run letterbox, the NPU and post process of consecutive frames on their own threads, so up to
+ * three frames are worked on at once. The stages hand over preallocated input and output tensor
+ * buffers (num_buffers of each) through bounded queues; nothing is allocated per frame. The input
+ * buffers are bound as model input (dma_bufs, or backend memory without a DMA heap), NULL when one
+ * can not be.
+ * app_ctx must come from init_yolov8_model() (rknpu2/yolov8.cc, any backend) and is used by the
+ * pipeline only until yolov8_pipeline_destroy().
+ */
+yolov8_pipeline_t* yolov8_pipeline_create(rknn_app_context_t* app_ctx, yolov8_pipeline_config_t* config,
+                                          yolov8_pipeline_callback callback, void* user_data);
+
+// Queue a frame, blocks while the pipeline is full. img must stay valid until its callback.
+int yolov8_pipeline_submit(yolov8_pipeline_t* pipeline, image_buffer_t* img, int64_t frame_id);
+
+// Wait until every submitted frame went through its callback
+void yolov8_pipeline_flush(yolov8_pipeline_t* pipeline);
+
+void yolov8_pipeline_get_stats(yolov8_pipeline_t* pipeline, yolov8_pipeline_stats_t* stats);
+
+void yolov8_pipeline_reset_stats(yolov8_pipeline_t* pipeline);
+
+// Flush, stop the threads and free the buffers
+void yolov8_pipeline_destroy(yolov8_pipeline_t* pipeline);
+
+#endif //_RKNN_DEMO_YOLOV8_PIPELINE_H_
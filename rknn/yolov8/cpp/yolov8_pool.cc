@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "yolov8_pool.h"
+
+#define POOL_DEFAULT_NPU_CORES 3
+
+typedef struct {
+    rknn_app_context_t app_ctx;
+    bool busy;
+    int waiting;               // frames scheduled on this context that wait for it
+    yolov8_pool_context_stats_t stats;
+} pool_context_t;
+
+struct yolov8_context_pool_t {
+    yolov8_pool_config_t config;
+    std::vector<pool_context_t> contexts;
+    std::mutex lock;
+    std::condition_variable cond;
+    unsigned int next;         // round robin position
+};
+
+static double now_ms()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int pick_context(yolov8_context_pool_t* pool)
+{
+    int n = (int)pool->contexts.size();
+    if (pool->config.schedule == POOL_SCHEDULE_ROUND_ROBIN) {
+        return (int)(pool->next++ % n);
+    }
+    int best = 0;
+    int best_load = 0;
+    for (int i = 0; i < n; i++) {
+        pool_context_t* c = &pool->contexts[i];
+        int load = (c->busy ? 1 : 0) + c->waiting;
+        if (i == 0 || load < best_load ||
+            (load == best_load && c->stats.busy_ms < pool->contexts[best].stats.busy_ms)) {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+void yolov8_pool_config_default(yolov8_pool_config_t* config)
+{
+    memset(config, 0, sizeof(yolov8_pool_config_t));
+    config->num_contexts = 0;
+    config->npu_cores = POOL_DEFAULT_NPU_CORES;
+    config->schedule = POOL_SCHEDULE_LEAST_LOADED;
+    config->pin_cores = 1;
+}
+
+yolov8_context_pool_t* yolov8_pool_create(const char* model_path, yolov8_pool_config_t* config)
+{
+    yolov8_pool_config_t default_config;
+    if (model_path == NULL) {
+        return NULL;
+    }
+    if (config == NULL) {
+        yolov8_pool_config_default(&default_config);
+        config = &default_config;
+    }
+
+    yolov8_context_pool_t* pool = new yolov8_context_pool_t();
+    pool->config = *config;
+    pool->next = 0;
+    if (pool->config.npu_cores <= 0) {
+        pool->config.npu_cores = POOL_DEFAULT_NPU_CORES;
+    }
+    if (pool->config.num_contexts <= 0) {
+        pool->config.num_contexts = pool->config.npu_cores;
+    }
+    int num_contexts = pool->config.num_contexts;
+
+    pool->contexts.resize(num_contexts);
+    for (int i = 0; i < num_contexts; i++) {
+        memset(&pool->contexts[i], 0, sizeof(pool_context_t));
+    }
+
+    for (int i = 0; i < num_contexts; i++) {
+        pool_context_t* c = &pool->contexts[i];
+        int ret;
+        rknn_context ctx0 = pool->contexts[0].app_ctx.rknn_ctx;
+        if (i == 0 || ctx0 == 0) {
+            // context 0, or a backend other than rknn: nothing to share
+            ret = init_yolov8_model(model_path, &c->app_ctx);
+            c->stats.shared = MODEL_SHARE_NONE;
+        } else {
+            rknn_context ctx = 0;
+            ret = dup_rknn_model(ctx0, model_path, &ctx, &c->stats.shared);
+            if (ret == 0) {
+                ret = init_yolov8_model_with_context(ctx, &c->app_ctx);
+            }
+        }
+        if (ret != 0) {
+            printf("create context %d of %s fail! ret=%d\n", i, model_path, ret);
+            yolov8_pool_destroy(pool);
+            return NULL;
+        }
+
+        c->stats.core_mask = RKNN_NPU_CORE_AUTO;
+        if (pool->config.pin_cores && c->app_ctx.rknn_ctx != 0) {
+            rknn_core_mask mask = (rknn_core_mask)(RKNN_NPU_CORE_0 << (i % pool->config.npu_cores));
+            ret = rknn_set_core_mask(c->app_ctx.rknn_ctx, mask);
+            if (ret == RKNN_SUCC) {
+                c->stats.core_mask = mask;
+            } else {
+                // single core SoCs refuse any mask, the context still works
+                printf("rknn_set_core_mask(%d) for context %d fail! ret=%d\n", mask, i, ret);
+            }
+        }
+        if (i > 0) {
+            printf("context %d: weights shared by %s\n", i, get_model_share_mode_string(c->stats.shared));
+        }
+    }
+    return pool;
+}
+
+void yolov8_pool_destroy(yolov8_context_pool_t* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    // context 0 owns the weights (and the zero copy model buffer), release it last
+    for (int i = (int)pool->contexts.size() - 1; i >= 0; i--) {
+        release_yolov8_model(&pool->contexts[i].app_ctx);
+    }
+    delete pool;
+}
+
+int yolov8_pool_size(yolov8_context_pool_t* pool)
+{
+    return (int)pool->contexts.size();
+}
+
+rknn_app_context_t* yolov8_pool_get_context(yolov8_context_pool_t* pool, int index)
+{
+    if (index < 0 || index >= (int)pool->contexts.size()) {
+        return NULL;
+    }
+    return &pool->contexts[index].app_ctx;
+}
+
+int yolov8_pool_acquire(yolov8_context_pool_t* pool)
+{
+    std::unique_lock<std::mutex> lock(pool->lock);
+    int index = pick_context(pool);
+    pool_context_t* c = &pool->contexts[index];
+    c->waiting++;
+    pool->cond.wait(lock, [c] { return !c->busy; });
+    c->waiting--;
+    c->busy = true;
+    return index;
+}
+
+void yolov8_pool_release(yolov8_context_pool_t* pool, int index, double busy_ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+        pool_context_t* c = &pool->contexts[index];
+        c->busy = false;
+        c->stats.runs++;
+        c->stats.busy_ms += busy_ms;
+    }
+    pool->cond.notify_all();
+}
+
+int yolov8_pool_inference(yolov8_context_pool_t* pool, image_buffer_t* img, object_detect_result_list* od_results)
+{
+    int index = yolov8_pool_acquire(pool);
+    double t0 = now_ms();
+    int ret = inference_yolov8_model(&pool->contexts[index].app_ctx, img, od_results);
+    yolov8_pool_release(pool, index, now_ms() - t0);
+    return ret;
+}
+
+int yolov8_pool_inference_with_input(yolov8_context_pool_t* pool, image_buffer_t* input_img, letterbox_t* letter_box,
+                                     object_detect_result_list* od_results)
+{
+    int index = yolov8_pool_acquire(pool);
+    double t0 = now_ms();
+    int ret = inference_yolov8_model_with_input(&pool->contexts[index].app_ctx, input_img, letter_box, od_results);
+    yolov8_pool_release(pool, index, now_ms() - t0);
+    return ret;
+}
+
+void yolov8_pool_get_stats(yolov8_context_pool_t* pool, yolov8_pool_context_stats_t* stats)
+{
+    std::lock_guard<std::mutex> lock(pool->lock);
+    for (size_t i = 0; i < pool->contexts.size(); i++) {
+        stats[i] = pool->contexts[i].stats;
+    }
+}
+
+void yolov8_pool_reset_stats(yolov8_context_pool_t* pool)
+{
+    std::lock_guard<std::mutex> lock(pool->lock);
+    for (size_t i = 0; i < pool->contexts.size(); i++) {
+        pool->contexts[i].stats.runs = 0;
+        pool->contexts[i].stats.busy_ms = 0;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef _RKNN_DEMO_YOLOV8_POOL_H_
+#define _RKNN_DEMO_YOLOV8_POOL_H_
+
+#include "yolov8.h"
+#include "model_loader.h"
+
+typedef enum {
+    POOL_SCHEDULE_ROUND_ROBIN = 0,   // contexts in turn, a frame waits for its context even if another one is idle
+    POOL_SCHEDULE_LEAST_LOADED,      // context with the fewest running + waiting frames, ties go to the least busy one
+} yolov8_pool_schedule_t;
+
+typedef struct {
+    int num_contexts;                 // 0: one per NPU core
+    int npu_cores;                    // 3 on rk3588, 2 on rk3576
+    yolov8_pool_schedule_t schedule;
+    int pin_cores;                    // context i runs on core i % npu_cores, 0: RKNN_NPU_CORE_AUTO
+} yolov8_pool_config_t;
+
+typedef struct {
+    rknn_core_mask core_mask;
+    model_share_mode_t shared;        // how the weights are shared with context 0
+    long runs;
+    double busy_ms;                   // time the context was held, inference and post process
+} yolov8_pool_context_stats_t;
+
+typedef struct yolov8_context_pool_t yolov8_context_pool_t;
+
+void yolov8_pool_config_default(yolov8_pool_config_t* config);
+
+/**
+ * Create num_contexts contexts of one model. Context 0 loads the model, the others share its
+ * weights (rknn_dup_context or RKNN_FLAG_SHARE_WEIGHT_MEM, see dup_rknn_model()), so the memory
+ * of a pool is about one model plus the per context buffers. Returns NULL on failure.
+ */
+yolov8_context_pool_t* yolov8_pool_create(const char* model_path, yolov8_pool_config_t* config);
+
+void yolov8_pool_destroy(yolov8_context_pool_t* pool);
+
+int yolov8_pool_size(yolov8_context_pool_t* pool);
+
+// Context i, e.g. for the model input size. Use acquire / release to run it from several threads.
+rknn_app_context_t* yolov8_pool_get_context(yolov8_context_pool_t* pool, int index);
+
+// Pick a context by the schedule and wait until it is free, returns its index. Thread safe.
+int yolov8_pool_acquire(yolov8_context_pool_t* pool);
+
+// Hand a context back, busy_ms is added to its stats
+void yolov8_pool_release(yolov8_context_pool_t* pool, int index, double busy_ms);
+
+// inference_yolov8_model() / inference_yolov8_model_with_input() on the next context of the schedule
+int yolov8_pool_inference(yolov8_context_pool_t* pool, image_buffer_t* img, object_detect_result_list* od_results);
+
+int yolov8_pool_inference_with_input(yolov8_context_pool_t* pool, image_buffer_t* input_img, letterbox_t* letter_box,
+                                     object_detect_result_list* od_results);
+
+// stats must hold yolov8_pool_size() entries
+void yolov8_pool_get_stats(yolov8_context_pool_t* pool, yolov8_pool_context_stats_t* stats);
+
+void yolov8_pool_reset_stats(yolov8_context_pool_t* pool);
+
+#endif //_RKNN_DEMO_YOLOV8_POOL_H_
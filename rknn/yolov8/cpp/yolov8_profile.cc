@@ -0,0 +1,405 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "yolov8_profile.h"
+
+static const char* kStageNames[PROFILE_STAGE_NUM] = {"preprocess", "inputs_set", "run", "outputs_get", "postprocess"};
+
+typedef struct {
+    yolov8_profile_record_t record;
+    std::vector<yolov8_layer_profile_t> layers;
+} profile_entry_t;
+
+struct yolov8_profile_t {
+    yolov8_profile_config_t config;
+    std::chrono::steady_clock::time_point start;
+    std::deque<profile_entry_t> entries;
+    profile_entry_t current;
+    bool open;
+    int64_t next_frame_id;
+    bool has_mem_size;
+    rknn_mem_size mem_size;
+};
+
+static double elapsed_ms(yolov8_profile_t* p)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p->start).count();
+}
+
+/*-------------------------------------------
+          RKNN_QUERY_PERF_DETAIL table
+-------------------------------------------*/
+static std::vector<std::string> split_words(const char* line, const char* end)
+{
+    std::vector<std::string> words;
+    const char* p = line;
+    while (p < end) {
+        while (p < end && isspace((unsigned char)*p)) {
+            p++;
+        }
+        const char* word = p;
+        while (p < end && !isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (p > word) {
+            words.push_back(std::string(word, p - word));
+        }
+    }
+    return words;
+}
+
+static int find_word(const std::vector<std::string>& words, const char* name)
+{
+    for (size_t i = 0; i < words.size(); i++) {
+        if (words[i] == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// The runtime prints a table: a header line "ID OpType DataType Target InputShape ... Time(us) ... FullName"
+// and a row per layer. Columns up to Time(us) hold no spaces, the full name is the last column.
+static void parse_perf_detail(const char* text, size_t len, std::vector<yolov8_layer_profile_t>* layers)
+{
+    int col_op = -1;
+    int col_target = -1;
+    int col_time = -1;
+    const char* end = text + len;
+    const char* line = text;
+    while (line < end) {
+        const char* eol = (const char*)memchr(line, '\n', end - line);
+        if (eol == NULL) {
+            eol = end;
+        }
+        std::vector<std::string> words = split_words(line, eol);
+        line = eol + 1;
+        if (words.empty()) {
+            continue;
+        }
+        if (col_time < 0) {
+            if (find_word(words, "Time(us)") >= 0 && find_word(words, "OpType") >= 0) {
+                col_op = find_word(words, "OpType");
+                col_target = find_word(words, "Target");
+                col_time = find_word(words, "Time(us)");
+            }
+            continue;
+        }
+        if (!isdigit((unsigned char)words[0][0]) || (int)words.size() <= col_time) {
+            continue;
+        }
+        yolov8_layer_profile_t layer;
+        memset(&layer, 0, sizeof(layer));
+        snprintf(layer.name, sizeof(layer.name), "%s", words.back().c_str());
+        snprintf(layer.op_type, sizeof(layer.op_type), "%s", words[col_op].c_str());
+        if (col_target >= 0) {
+            snprintf(layer.target, sizeof(layer.target), "%s", words[col_target].c_str());
+        }
+        layer.time_us = atoll(words[col_time].c_str());
+        layers->push_back(layer);
+    }
+}
+
+/*-------------------------------------------
+                  Recording
+-------------------------------------------*/
+void yolov8_profile_config_default(yolov8_profile_config_t* config)
+{
+    memset(config, 0, sizeof(yolov8_profile_config_t));
+    config->max_records = 10000;
+    config->layers = true;
+}
+
+yolov8_profile_t* yolov8_profile_create(yolov8_profile_config_t* config)
+{
+    yolov8_profile_t* p = new yolov8_profile_t();
+    if (config != NULL) {
+        p->config = *config;
+    } else {
+        yolov8_profile_config_default(&p->config);
+    }
+    if (p->config.max_records <= 0) {
+        p->config.max_records = 1;
+    }
+    p->start = std::chrono::steady_clock::now();
+    return p;
+}
+
+void yolov8_profile_destroy(yolov8_profile_t* profile)
+{
+    delete profile;
+}
+
+void yolov8_profile_prepare_backend(yolov8_profile_t* profile, infer_backend_t* backend)
+{
+    if (profile != NULL && profile->config.layers) {
+        backend->flags |= INFER_BACKEND_FLAG_COLLECT_PERF;
+    }
+}
+
+void yolov8_profile_query_mem_size(yolov8_profile_t* profile, infer_backend_t* backend)
+{
+    if (profile == NULL) {
+        return;
+    }
+    memset(&profile->mem_size, 0, sizeof(rknn_mem_size));
+    profile->has_mem_size =
+        infer_backend_query(backend, RKNN_QUERY_MEM_SIZE, &profile->mem_size, sizeof(rknn_mem_size)) == RKNN_SUCC;
+}
+
+bool yolov8_profile_begin_frame(yolov8_profile_t* profile)
+{
+    if (profile == NULL || profile->open) {
+        return false;
+    }
+    profile->open = true;
+    profile->current.layers.clear();
+    memset(&profile->current.record, 0, sizeof(yolov8_profile_record_t));
+    profile->current.record.frame_id = profile->next_frame_id++;
+    profile->current.record.npu_run_us = -1;
+    return true;
+}
+
+double yolov8_profile_stage_begin(yolov8_profile_t* profile)
+{
+    return profile != NULL ? elapsed_ms(profile) : 0;
+}
+
+void yolov8_profile_stage_end(yolov8_profile_t* profile, int stage, double start_ms)
+{
+    if (profile == NULL || !profile->open) {
+        return;
+    }
+    profile->current.record.stage_start_ms[stage] = start_ms;
+    profile->current.record.stage_ms[stage] = elapsed_ms(profile) - start_ms;
+}
+
+void yolov8_profile_query_run(yolov8_profile_t* profile, infer_backend_t* backend)
+{
+    if (profile == NULL || !profile->open) {
+        return;
+    }
+    rknn_perf_run perf_run;
+    if (infer_backend_query(backend, RKNN_QUERY_PERF_RUN, &perf_run, sizeof(rknn_perf_run)) == RKNN_SUCC) {
+        profile->current.record.npu_run_us = perf_run.run_duration;
+    }
+    if (!profile->config.layers) {
+        return;
+    }
+    rknn_perf_detail perf_detail;
+    memset(&perf_detail, 0, sizeof(rknn_perf_detail));
+    if (infer_backend_query(backend, RKNN_QUERY_PERF_DETAIL, &perf_detail, sizeof(rknn_perf_detail)) == RKNN_SUCC &&
+        perf_detail.perf_data != NULL) {
+        size_t len = perf_detail.data_len > 0 ? perf_detail.data_len : strlen(perf_detail.perf_data);
+        parse_perf_detail(perf_detail.perf_data, len, &profile->current.layers);
+    }
+}
+
+void yolov8_profile_end_frame(yolov8_profile_t* profile)
+{
+    if (profile == NULL || !profile->open) {
+        return;
+    }
+    profile->open = false;
+    if ((int)profile->entries.size() >= profile->config.max_records) {
+        profile->entries.pop_front();
+    }
+    profile->entries.push_back(profile->current);
+    profile_entry_t* entry = &profile->entries.back();
+    entry->record.num_layers = entry->layers.size();
+    entry->record.layers = entry->layers.empty() ? NULL : &entry->layers[0];
+}
+
+int yolov8_profile_num_records(yolov8_profile_t* profile)
+{
+    return profile->entries.size();
+}
+
+const yolov8_profile_record_t* yolov8_profile_get_record(yolov8_profile_t* profile, int index)
+{
+    if (index < 0 || index >= (int)profile->entries.size()) {
+        return NULL;
+    }
+    return &profile->entries[index].record;
+}
+
+bool yolov8_profile_get_mem_size(yolov8_profile_t* profile, rknn_mem_size* mem_size)
+{
+    if (profile->has_mem_size) {
+        *mem_size = profile->mem_size;
+    }
+    return profile->has_mem_size;
+}
+
+void yolov8_profile_clear(yolov8_profile_t* profile)
+{
+    profile->entries.clear();
+}
+
+/*-------------------------------------------
+                  Export
+-------------------------------------------*/
+// layer names come from the model, keep JSON and CSV valid whatever they contain
+static void write_string(FILE* fp, const char* s, bool csv)
+{
+    fputc('"', fp);
+    for (; *s != '\0'; s++) {
+        if (*s == '"') {
+            fputs(csv ? "\"\"" : "\\\"", fp);
+        } else if (*s == '\\' && !csv) {
+            fputs("\\\\", fp);
+        } else if ((unsigned char)*s >= 0x20) {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void export_json(yolov8_profile_t* p, FILE* fp)
+{
+    fprintf(fp, "{\n");
+    if (p->has_mem_size) {
+        rknn_mem_size* m = &p->mem_size;
+        fprintf(fp,
+                "  \"mem_size\": {\"total_weight_size\": %u, \"total_internal_size\": %u, "
+                "\"total_dma_allocated_size\": %llu, \"total_sram_size\": %u, \"free_sram_size\": %u},\n",
+                m->total_weight_size, m->total_internal_size, (unsigned long long)m->total_dma_allocated_size,
+                m->total_sram_size, m->free_sram_size);
+    }
+    fprintf(fp, "  \"records\": [");
+    for (size_t i = 0; i < p->entries.size(); i++) {
+        const yolov8_profile_record_t* r = &p->entries[i].record;
+        fprintf(fp, "%s\n    {\"frame_id\": %lld, \"npu_run_us\": %lld, \"stages\": {", i > 0 ? "," : "",
+                (long long)r->frame_id, (long long)r->npu_run_us);
+        for (int s = 0; s < PROFILE_STAGE_NUM; s++) {
+            fprintf(fp, "%s\"%s\": {\"start_ms\": %.3f, \"ms\": %.3f}", s > 0 ? ", " : "", kStageNames[s],
+                    r->stage_start_ms[s], r->stage_ms[s]);
+        }
+        fprintf(fp, "}, \"layers\": [");
+        for (int l = 0; l < r->num_layers; l++) {
+            const yolov8_layer_profile_t* layer = &r->layers[l];
+            fprintf(fp, "%s\n      {\"name\": ", l > 0 ? "," : "");
+            write_string(fp, layer->name, false);
+            fprintf(fp, ", \"op_type\": ");
+            write_string(fp, layer->op_type, false);
+            fprintf(fp, ", \"target\": ");
+            write_string(fp, layer->target, false);
+            fprintf(fp, ", \"time_us\": %lld}", (long long)layer->time_us);
+        }
+        fprintf(fp, "%s]}", r->num_layers > 0 ? "\n    " : "");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+static void export_csv(yolov8_profile_t* p, FILE* fp)
+{
+    fprintf(fp, "frame_id,type,name,op_type,target,start_ms,duration_ms\n");
+    for (size_t i = 0; i < p->entries.size(); i++) {
+        const yolov8_profile_record_t* r = &p->entries[i].record;
+        long long id = (long long)r->frame_id;
+        for (int s = 0; s < PROFILE_STAGE_NUM; s++) {
+            fprintf(fp, "%lld,stage,%s,,,%.3f,%.3f\n", id, kStageNames[s], r->stage_start_ms[s], r->stage_ms[s]);
+        }
+        double run_start = r->stage_start_ms[PROFILE_STAGE_RUN];
+        if (r->npu_run_us >= 0) {
+            fprintf(fp, "%lld,npu,run,,NPU,%.3f,%.3f\n", id, run_start, r->npu_run_us / 1000.0);
+        }
+        // layers run one after the other from the start of the run
+        double start = run_start;
+        for (int l = 0; l < r->num_layers; l++) {
+            const yolov8_layer_profile_t* layer = &r->layers[l];
+            fprintf(fp, "%lld,layer,", id);
+            write_string(fp, layer->name, true);
+            fprintf(fp, ",%s,%s,%.3f,%.3f\n", layer->op_type, layer->target, start, layer->time_us / 1000.0);
+            start += layer->time_us / 1000.0;
+        }
+    }
+    if (p->has_mem_size) {
+        fprintf(fp, "-1,mem,total_weight_size,,,0,%u\n", p->mem_size.total_weight_size);
+        fprintf(fp, "-1,mem,total_internal_size,,,0,%u\n", p->mem_size.total_internal_size);
+        fprintf(fp, "-1,mem,total_dma_allocated_size,,,0,%llu\n",
+                (unsigned long long)p->mem_size.total_dma_allocated_size);
+    }
+}
+
+static void trace_event(FILE* fp, bool* first, const char* name, const char* cat, int tid, double start_ms, double ms,
+                        long long frame_id)
+{
+    fprintf(fp, "%s\n  {\"name\": ", *first ? "" : ",");
+    write_string(fp, name, false);
+    fprintf(fp, ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.1f, \"dur\": %.1f, "
+                "\"args\": {\"frame_id\": %lld}}",
+            cat, tid, start_ms * 1000, ms * 1000, frame_id);
+    *first = false;
+}
+
+static void export_chrome_trace(yolov8_profile_t* p, FILE* fp)
+{
+    // thread 1: host stages, 2: NPU run, 3: NPU layers
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    fprintf(fp, "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"host\"}},");
+    fprintf(fp, "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"npu\"}},");
+    fprintf(fp, "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 3, \"args\": {\"name\": \"npu layers\"}}");
+    bool first = false;
+    for (size_t i = 0; i < p->entries.size(); i++) {
+        const yolov8_profile_record_t* r = &p->entries[i].record;
+        long long id = (long long)r->frame_id;
+        for (int s = 0; s < PROFILE_STAGE_NUM; s++) {
+            if (r->stage_ms[s] > 0) {
+                trace_event(fp, &first, kStageNames[s], "stage", 1, r->stage_start_ms[s], r->stage_ms[s], id);
+            }
+        }
+        double start = r->stage_start_ms[PROFILE_STAGE_RUN];
+        if (r->npu_run_us >= 0) {
+            trace_event(fp, &first, "npu run", "npu", 2, start, r->npu_run_us / 1000.0, id);
+        }
+        for (int l = 0; l < r->num_layers; l++) {
+            const yolov8_layer_profile_t* layer = &r->layers[l];
+            trace_event(fp, &first, layer->name, layer->op_type, 3, start, layer->time_us / 1000.0, id);
+            start += layer->time_us / 1000.0;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+}
+
+yolov8_profile_format_t yolov8_profile_format_from_path(const char* path)
+{
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".csv") == 0) {
+        return PROFILE_FORMAT_CSV;
+    }
+    if ((len >= 6 && strcmp(path + len - 6, ".trace") == 0) || (len >= 11 && strcmp(path + len - 11, ".trace.json") == 0)) {
+        return PROFILE_FORMAT_CHROME_TRACE;
+    }
+    return PROFILE_FORMAT_JSON;
+}
+
+int yolov8_profile_export(yolov8_profile_t* profile, const char* path, yolov8_profile_format_t format)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    switch (format) {
+    case PROFILE_FORMAT_CSV:
+        export_csv(profile, fp);
+        break;
+    case PROFILE_FORMAT_CHROME_TRACE:
+        export_chrome_trace(profile, fp);
+        break;
+    default:
+        export_json(profile, fp);
+        break;
+    }
+    int ret = ferror(fp) ? -1 : 0;
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,93 @@
+#ifndef _RKNN_DEMO_YOLOV8_PROFILE_H_
+#define _RKNN_DEMO_YOLOV8_PROFILE_H_
+
+#include <stdint.h>
+
+#include "rknn_api.h"
+#include "infer_backend.h"
+
+enum {
+    PROFILE_STAGE_PREPROCESS = 0,
+    PROFILE_STAGE_INPUTS_SET,
+    PROFILE_STAGE_RUN,
+    PROFILE_STAGE_OUTPUTS_GET,
+    PROFILE_STAGE_POSTPROCESS,
+    PROFILE_STAGE_NUM
+};
+
+typedef enum {
+    PROFILE_FORMAT_JSON = 0,
+    PROFILE_FORMAT_CSV,            // one row per stage, NPU run and layer: frame_id,type,name,op_type,target,start_ms,duration_ms
+    PROFILE_FORMAT_CHROME_TRACE,   // chrome://tracing or ui.perfetto.dev
+} yolov8_profile_format_t;
+
+typedef struct {
+    char name[64];
+    char op_type[32];
+    char target[8];                // CPU / NPU
+    int64_t time_us;
+} yolov8_layer_profile_t;
+
+typedef struct {
+    int64_t frame_id;
+    double stage_start_ms[PROFILE_STAGE_NUM];   // host clock, ms since the profile was created
+    double stage_ms[PROFILE_STAGE_NUM];         // 0 for stages the frame did not go through
+    int64_t npu_run_us;                         // RKNN_QUERY_PERF_RUN, -1 if the backend does not report it
+    int num_layers;                             // RKNN_QUERY_PERF_DETAIL, 0 without RKNN_FLAG_COLLECT_PERF_MASK
+    yolov8_layer_profile_t* layers;
+} yolov8_profile_record_t;
+
+typedef struct {
+    int max_records;               // the oldest records are dropped beyond that
+    bool layers;                   // per-layer timings: init with RKNN_FLAG_COLLECT_PERF_MASK, slows the NPU down
+} yolov8_profile_config_t;
+
+typedef struct yolov8_profile_t yolov8_profile_t;
+
+void yolov8_profile_config_default(yolov8_profile_config_t* config);
+
+/**
+ * Profiling of the yolov8 wrapper: set rknn_app_context_t.profile before init_yolov8_model() and every
+ * inference adds a record with the host stage timings, the NPU run time and the per-layer breakdown;
+ * init adds the memory usage (RKNN_QUERY_MEM_SIZE). One context at a time, not thread safe.
+ */
+yolov8_profile_t* yolov8_profile_create(yolov8_profile_config_t* config);
+
+void yolov8_profile_destroy(yolov8_profile_t* profile);
+
+// Export format from the file name: .csv, .trace.json or .trace (Chrome trace), otherwise JSON
+yolov8_profile_format_t yolov8_profile_format_from_path(const char* path);
+
+int yolov8_profile_export(yolov8_profile_t* profile, const char* path, yolov8_profile_format_t format);
+
+int yolov8_profile_num_records(yolov8_profile_t* profile);
+
+const yolov8_profile_record_t* yolov8_profile_get_record(yolov8_profile_t* profile, int index);
+
+// RKNN_QUERY_MEM_SIZE at init, false if the backend does not report it
+bool yolov8_profile_get_mem_size(yolov8_profile_t* profile, rknn_mem_size* mem_size);
+
+void yolov8_profile_clear(yolov8_profile_t* profile);
+
+/*-------------------------------------------
+   Used by rknpu2/yolov8.cc, all accept NULL
+-------------------------------------------*/
+// Set the backend flags the profile needs before the model is loaded
+void yolov8_profile_prepare_backend(yolov8_profile_t* profile, infer_backend_t* backend);
+
+void yolov8_profile_query_mem_size(yolov8_profile_t* profile, infer_backend_t* backend);
+
+// Start a record unless one is open, true if this call opened it (and has to end it)
+bool yolov8_profile_begin_frame(yolov8_profile_t* profile);
+
+// Returns the start time to pass to yolov8_profile_stage_end()
+double yolov8_profile_stage_begin(yolov8_profile_t* profile);
+
+void yolov8_profile_stage_end(yolov8_profile_t* profile, int stage, double start_ms);
+
+// NPU run time and layers of the last run
+void yolov8_profile_query_run(yolov8_profile_t* profile, infer_backend_t* backend);
+
+void yolov8_profile_end_frame(yolov8_profile_t* profile);
+
+#endif //_RKNN_DEMO_YOLOV8_PROFILE_H_
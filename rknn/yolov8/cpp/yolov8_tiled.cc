@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "yolov8_tiled.h"
+#include "image_utils.h"
+#include "easy_timer.h"
+#include "dma_alloc.hpp"
+
+// a box is considered a border cut of another one when this much of it lies inside the other
+#define TILE_CONTAIN_THRESH 0.8f
+
+void yolov8_tile_config_default(yolov8_tile_config_t* config)
+{
+    config->tile_width = 0;
+    config->overlap = 0.2f;
+    config->full_frame = true;
+    config->nms_threshold = NMS_THRESH;
+}
+
+static void tile_starts(int length, int tile, float overlap, std::vector<int>* starts)
+{
+    starts->clear();
+    if (length <= tile) {
+        starts->push_back(0);
+        return;
+    }
+    int stride = (int)(tile * (1.0f - overlap));
+    if (stride < 1) {
+        stride = 1;
+    }
+    int n = (length - tile + stride - 1) / stride + 1;
+    // spread the tiles evenly so the last one ends on the image border
+    for (int i = 0; i < n; i++) {
+        starts->push_back((int)((long)i * (length - tile) / (n - 1)));
+    }
+}
+
+int yolov8_generate_tiles(int img_width, int img_height, int tile_width, int tile_height, float overlap,
+                          std::vector<image_rect_t>* tiles)
+{
+    if (tile_width <= 0 || tile_height <= 0 || img_width < tile_width || img_height < tile_height) {
+        return -1;
+    }
+    std::vector<int> xs;
+    std::vector<int> ys;
+    tile_starts(img_width, tile_width, overlap, &xs);
+    tile_starts(img_height, tile_height, overlap, &ys);
+
+    tiles->clear();
+    for (size_t j = 0; j < ys.size(); j++) {
+        for (size_t i = 0; i < xs.size(); i++) {
+            image_rect_t tile;
+            tile.left = xs[i];
+            tile.top = ys[j];
+            tile.right = xs[i] + tile_width - 1;
+            tile.bottom = ys[j] + tile_height - 1;
+            tiles->push_back(tile);
+        }
+    }
+    return 0;
+}
+
+static float box_area(const image_rect_t& b)
+{
+    return (float)(b.right - b.left + 1) * (b.bottom - b.top + 1);
+}
+
+static float box_intersection(const image_rect_t& a, const image_rect_t& b)
+{
+    float w = (float)(std::min(a.right, b.right) - std::max(a.left, b.left) + 1);
+    float h = (float)(std::min(a.bottom, b.bottom) - std::max(a.top, b.top) + 1);
+    return w <= 0 || h <= 0 ? 0.f : w * h;
+}
+
+static bool cmp_prop(const object_detect_result& a, const object_detect_result& b)
+{
+    return a.prop > b.prop;
+}
+
+void yolov8_merge_tile_results(std::vector<object_detect_result>& boxes, float nms_threshold,
+                               object_detect_result_list* od_results)
+{
+    std::sort(boxes.begin(), boxes.end(), cmp_prop);
+    std::vector<bool> removed(boxes.size(), false);
+
+    memset(od_results, 0, sizeof(object_detect_result_list));
+    for (size_t i = 0; i < boxes.size() && od_results->count < OBJ_NUMB_MAX_SIZE; i++) {
+        if (removed[i]) {
+            continue;
+        }
+        od_results->results[od_results->count++] = boxes[i];
+        float area_i = box_area(boxes[i].box);
+        for (size_t j = i + 1; j < boxes.size(); j++) {
+            if (removed[j] || boxes[j].cls_id != boxes[i].cls_id) {
+                continue;
+            }
+            float inter = box_intersection(boxes[i].box, boxes[j].box);
+            if (inter <= 0) {
+                continue;
+            }
+            float area_j = box_area(boxes[j].box);
+            float iou = inter / (area_i + area_j - inter);
+            float contain = inter / std::min(area_i, area_j);
+            if (iou > nms_threshold || contain > TILE_CONTAIN_THRESH) {
+                removed[j] = true;
+            }
+        }
+    }
+}
+
+// model input memory of the context, a tile gathered there is run without another copy
+static image_buffer_t model_input_image(rknn_app_context_t* app_ctx)
+{
+#if defined(ZERO_COPY)
+    image_buffer_t input;
+    memset(&input, 0, sizeof(image_buffer_t));
+    input.width = app_ctx->model_width;
+    input.height = app_ctx->model_height;
+    input.format = IMAGE_FORMAT_RGB888;
+    input.size = get_image_size(&input);
+    input.fd = app_ctx->input_mems[0]->fd;
+    input.virt_addr = (unsigned char*)app_ctx->input_mems[0]->virt_addr;
+    return input;
+#else
+    return app_ctx->input_img;
+#endif
+}
+
+// copy the rows of an unscaled tile out of the source image, the model reads packed rows
+static void gather_tile_rows(image_buffer_t* img, int src_stride, const image_rect_t& tile, image_buffer_t* dst)
+{
+    int row = dst->width * 3;
+    const unsigned char* src = img->virt_addr + ((size_t)tile.top * src_stride + tile.left) * 3;
+    for (int y = 0; y < dst->height; y++) {
+        memcpy(dst->virt_addr + (size_t)y * row, src + (size_t)y * src_stride * 3, row);
+    }
+}
+
+static void append_results(object_detect_result_list* results, int offset_x, int offset_y,
+                           std::vector<object_detect_result>* boxes)
+{
+    for (int i = 0; i < results->count; i++) {
+        object_detect_result r = results->results[i];
+        r.box.left += offset_x;
+        r.box.right += offset_x;
+        r.box.top += offset_y;
+        r.box.bottom += offset_y;
+        boxes->push_back(r);
+    }
+}
+
+int inference_yolov8_model_tiled(rknn_app_context_t* app_ctx, image_buffer_t* img, yolov8_tile_config_t* config,
+                                 object_detect_result_list* od_results, yolov8_tile_stats_t* stats)
+{
+    int ret = 0;
+    yolov8_tile_config_t default_config;
+    yolov8_tile_stats_t local_stats;
+    TIMER timer;
+
+    if ((!app_ctx) || !(img) || (!od_results)) {
+        return -1;
+    }
+    if (config == NULL) {
+        yolov8_tile_config_default(&default_config);
+        config = &default_config;
+    }
+    if (stats == NULL) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(yolov8_tile_stats_t));
+
+    int model_w = app_ctx->model_width;
+    int model_h = app_ctx->model_height;
+    int tile_w = config->tile_width > 0 ? config->tile_width : model_w;
+    int tile_h = tile_w * model_h / model_w;
+
+    std::vector<image_rect_t> tiles;
+    if (yolov8_generate_tiles(img->width, img->height, tile_w, tile_h, config->overlap, &tiles) != 0) {
+        printf("image %dx%d is smaller than one tile, run whole frame\n", img->width, img->height);
+        return inference_yolov8_model(app_ctx, img, od_results);
+    }
+    stats->num_tiles = (int)tiles.size();
+
+    // unscaled tiles skip the resize: their rows are gathered from the source image (its row stride, offset by
+    // the tile origin) straight into the model input memory, one tile at a time
+    int model_size = model_w * model_h * 3;
+    int src_stride = img->width_stride > img->width ? img->width_stride : img->width;
+    bool can_gather = tile_w == model_w && img->format == IMAGE_FORMAT_RGB888 && img->virt_addr != NULL;
+    image_buffer_t model_input = model_input_image(app_ctx);
+    std::vector<image_rect_t> batch_rois;
+    std::vector<int> batch_index(tiles.size(), -1);
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (!can_gather) {
+            batch_index[i] = (int)batch_rois.size();
+            batch_rois.push_back(tiles[i]);
+        }
+    }
+    stats->num_views = (int)(tiles.size() - batch_rois.size());
+
+    // Pre Process: all scaled tiles in one batch
+    timer.tik();
+    image_buffer_t batch;
+    memset(&batch, 0, sizeof(image_buffer_t));
+    bool batch_dma = false;
+    if (!batch_rois.empty()) {
+        batch.width = model_w;
+        batch.height = model_h * (int)batch_rois.size();
+        batch.format = IMAGE_FORMAT_RGB888;
+        batch.size = get_image_size(&batch);
+        if (dma_buf_alloc(DMA_HEAP_DMA32_UNCACHE_PATCH, batch.size, &batch.fd, (void**)&batch.virt_addr) == 0) {
+            batch_dma = true;
+        } else {
+            batch.fd = 0;
+            batch.virt_addr = (unsigned char*)malloc(batch.size);
+            if (batch.virt_addr == NULL) {
+                printf("malloc buffer size:%d fail!\n", batch.size);
+                return -1;
+            }
+        }
+        ret = convert_image_rois(img, &batch_rois[0], (int)batch_rois.size(), &batch);
+        if (ret < 0) {
+            printf("convert_image_rois fail! ret=%d\n", ret);
+            goto out;
+        }
+    }
+    timer.tok();
+    stats->preprocess_ms = timer.get_time();
+
+    {
+        std::vector<object_detect_result> boxes;
+        object_detect_result_list tile_results;
+
+        // Inference per tile, the row gather of an unscaled tile counts as preprocess
+        letterbox_t letter_box;
+        memset(&letter_box, 0, sizeof(letterbox_t));
+        letter_box.scale = (float)model_w / tile_w;
+        for (size_t i = 0; i < tiles.size(); i++) {
+            image_buffer_t input;
+            if (batch_index[i] < 0) {
+                input = model_input;
+                timer.tik();
+                gather_tile_rows(img, src_stride, tiles[i], &input);
+                timer.tok();
+                stats->preprocess_ms += timer.get_time();
+            } else {
+                memset(&input, 0, sizeof(image_buffer_t));
+                input.width = model_w;
+                input.height = model_h;
+                input.format = IMAGE_FORMAT_RGB888;
+                input.size = model_size;
+                input.virt_addr = batch.virt_addr + (size_t)batch_index[i] * model_size;
+            }
+            timer.tik();
+            ret = inference_yolov8_model_with_input(app_ctx, &input, &letter_box, &tile_results);
+            timer.tok();
+            stats->inference_ms += timer.get_time();
+            if (ret < 0) {
+                printf("tile %d inference fail! ret=%d\n", (int)i, ret);
+                goto out;
+            }
+            append_results(&tile_results, tiles[i].left, tiles[i].top, &boxes);
+        }
+        if (config->full_frame) {
+            letterbox_t frame_box;
+            memset(&frame_box, 0, sizeof(letterbox_t));
+            timer.tik();
+            ret = convert_image_with_letterbox(img, &model_input, &frame_box, 114);
+            timer.tok();
+            stats->preprocess_ms += timer.get_time();
+            if (ret < 0) {
+                printf("convert_image_with_letterbox fail! ret=%d\n", ret);
+                goto out;
+            }
+            timer.tik();
+            ret = inference_yolov8_model_with_input(app_ctx, &model_input, &frame_box, &tile_results);
+            timer.tok();
+            stats->inference_ms += timer.get_time();
+            if (ret < 0) {
+                printf("full frame inference fail! ret=%d\n", ret);
+                goto out;
+            }
+            append_results(&tile_results, 0, 0, &boxes);
+        }
+
+        // Merge
+        timer.tik();
+        yolov8_merge_tile_results(boxes, config->nms_threshold, od_results);
+        timer.tok();
+        stats->merge_ms = timer.get_time();
+    }
+
+out:
+    if (batch.virt_addr != NULL) {
+        if (batch_dma) {
+            dma_buf_free(batch.size, &batch.fd, batch.virt_addr);
+        } else {
+            free(batch.virt_addr);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,43 @@
+#ifndef _RKNN_DEMO_YOLOV8_TILED_H_
+#define _RKNN_DEMO_YOLOV8_TILED_H_
+
+#include <vector>
+
+#include "yolov8.h"
+
+typedef struct {
+    int tile_width;        // tile width on the source image, 0: model width (no scaling)
+    float overlap;         // overlap between neighbour tiles, fraction of the tile size
+    bool full_frame;       // also run the letterboxed whole frame, catches objects larger than a tile
+    float nms_threshold;   // IoU threshold of the cross-tile merge
+} yolov8_tile_config_t;
+
+typedef struct {
+    int num_tiles;
+    int num_views;         // unscaled tiles gathered from the rows of the source image, without a resize
+    float preprocess_ms;   // batch resize of the scaled tiles, row gathers, letterbox of the full frame
+    float inference_ms;    // rknn run + per tile post process (decode and NMS inside the tile)
+    float merge_ms;        // NMS across the tiles
+} yolov8_tile_stats_t;
+
+void yolov8_tile_config_default(yolov8_tile_config_t* config);
+
+// Split the image in overlapping tiles, tile height follows the model aspect ratio
+int yolov8_generate_tiles(int img_width, int img_height, int tile_width, int tile_height, float overlap,
+                          std::vector<image_rect_t>* tiles);
+
+// Class-wise NMS over boxes of all tiles, also drops boxes cut at a tile border that lie inside a bigger one
+void yolov8_merge_tile_results(std::vector<object_detect_result>& boxes, float nms_threshold,
+                               object_detect_result_list* od_results);
+
+/**
+ * Tiled inference for frames much larger than the model input.
+ * Tiles as wide as the model input are row copies of the source image (RGB888) into the model input memory,
+ * scaled tiles are preprocessed in one batch (convert_image_rois). Each tile runs through the model and
+ * the boxes are mapped back to the source image and merged. stats can be NULL.
+ * Falls back to inference_yolov8_model() when the image is smaller than one tile.
+ */
+int inference_yolov8_model_tiled(rknn_app_context_t* app_ctx, image_buffer_t* img, yolov8_tile_config_t* config,
+                                 object_detect_result_list* od_results, yolov8_tile_stats_t* stats);
+
+#endif //_RKNN_DEMO_YOLOV8_TILED_H_
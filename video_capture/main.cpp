@@ -3,11 +3,28 @@
 #include <string>
 #include <chrono>
 #include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <climits>
 
-// Build GStreamer pipeline string for V4L2 device
+#include <sys/stat.h>
+
+#include "latency_stats.h"
+#include "preview_sink.h"
+
+// Build GStreamer pipeline string for V4L2 device, or for a video file played at its own
+// frame rate so runs without a camera are reproducible
 std::string buildGstreamerPipeline(const std::string& device, int width, int height, int fps) {
-    std::string pipeline = "v4l2src device=" + device + " min-buffers=2 io-mode=mmap ! ";
-    pipeline += "video/x-raw, width=(int)" + std::to_string(width) + ", height=(int)" + std::to_string(height) + ", framerate=(fraction)" + std::to_string(fps) + "/1 ! ";
+    struct stat st;
+    std::string pipeline;
+    if (stat(device.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        pipeline = "filesrc location=\"" + device + "\" ! decodebin ! videoconvert ! videoscale ! "
+                   "videorate ! identity sync=true ! ";
+    } else {
+        pipeline = "v4l2src device=" + device + " min-buffers=2 io-mode=mmap ! ";
+    }
+    pipeline += "video/x-raw, width=(int)" + std::to_string(width) + ", height=(int)" +
+                std::to_string(height) + ", framerate=(fraction)" + std::to_string(fps) + "/1 ! ";
     pipeline += "videoconvert ! video/x-raw, format=(string)BGR ! appsink";
     return pipeline;
 }
@@ -19,7 +36,8 @@ int main(int argc, char** argv) {
 
     // Check command line arguments
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <v4l2_device> [width] [height] [fps]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <v4l2_device|video_file> [width] [height] [fps]"
+                  << std::endl;
         return -1;
     }
 
@@ -44,18 +62,40 @@ int main(int argc, char** argv) {
     height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
     std::cout << "Video size: " << width << "x" << height << std::endl;
 
+    // Window: PREVIEW=off|full|FPS[@SCALE], a 10 fps half size preview by default, headless
+    // without a display
+    PreviewConfig previewConfig;
+    if (!previewFromEnv(previewConfig)) {
+        std::cerr << "Unknown PREVIEW, expected off, full or FPS[@SCALE]" << std::endl;
+        return -1;
+    }
+    std::cout << "Preview: " << previewName(previewConfig) << std::endl;
+    handleStopSignals();
+
     // Create window
-    cv::namedWindow("GStreamer Video", cv::WINDOW_NORMAL);
-    cv::resizeWindow("GStreamer Video", width, height);
+    if (previewConfig.mode == PREVIEW_FULL) {
+        cv::namedWindow("GStreamer Video", cv::WINDOW_NORMAL);
+        cv::resizeWindow("GStreamer Video", width, height);
+    }
+    BgrPreview preview("GStreamer Video", previewConfig, width, height);
 
     cv::Mat frame;
-    auto prevTime = std::chrono::high_resolution_clock::now();
-    int frameCount = 0;
+    auto prevTime = std::chrono::steady_clock::now();
+
+    // Delay from the buffer PTS to the window, dumped as JSON every second when
+    // LATENCY_STATS=<file> is set. cv::VideoCapture does not expose the pipeline clock, so the
+    // PTS is put on steady_clock with the smallest arrival - PTS offset seen. That is not a
+    // latency: the fastest frame counts as 0, and the figures are the jitter over it (queuing
+    // and display delay that varies), not the time since the sensor. camera_gstreamer measures
+    // the real capture latency.
+    LatencyStats latency("jitter over min");
+    const char* latencyFile = getenv("LATENCY_STATS");
+    int64_t ptsOffset = LLONG_MAX;
 
     std::cout << "Start playing video..." << std::endl;
     std::cout << "Press 'q' to quit" << std::endl;
 
-    while (true) {
+    while (!stopRequested()) {
         // Read a frame
         cap >> frame;
 
@@ -65,27 +105,53 @@ int main(int argc, char** argv) {
             break;
         }
 
-        // Calculate FPS
-        frameCount++;
-        auto currTime = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(currTime - prevTime).count();
-
-        if (duration >= 1) {
-            std::cout << "\rCurrent FPS: " << frameCount / duration << "    " << std::flush;
-            frameCount = 0;
-            prevTime = currTime;
+        FrameTimestamps times;
+        times.mark(STAGE_DEQUEUE);
+        double ptsMs = cap.get(cv::CAP_PROP_POS_MSEC);
+        if (ptsMs > 0) {
+            int64_t ptsNs = (int64_t)(ptsMs * 1e6);
+            ptsOffset = std::min(ptsOffset, times.ns[STAGE_DEQUEUE] - ptsNs);
+            times.ns[STAGE_CAPTURE] = ptsNs + ptsOffset;
         }
 
-        // Show frame
-        cv::imshow("GStreamer Video", frame);
-
-        // Press 'q' to quit
-        if (cv::waitKey(1) == 'q') {
+        int key = -1;
+        if (previewConfig.mode == PREVIEW_FULL) {
+            // Show frame
+            cv::imshow("GStreamer Video", frame);
+
+            // Press 'q' to quit
+            key = cv::waitKey(1);
+            times.mark(STAGE_DISPLAY);
+        } else {
+            // Copied only when the preview is about to show a frame
+            key = preview.offer(frame);
+            times.mark(STAGE_PROCESS);
+        }
+        latency.add(times);
+        if (key == 'q') {
             break;
         }
+
+        // Calculate FPS over the real length of the window, not a truncated second
+        auto currTime = std::chrono::steady_clock::now();
+        if (currTime - prevTime >= std::chrono::seconds(1)) {
+            prevTime = currTime;
+            char fpsText[32];
+            snprintf(fpsText, sizeof(fpsText), "%.1f", latency.windowFps());
+            std::cout << "\rCurrent FPS: " << fpsText << " | " << latency.line() << "    " << std::flush;
+            if (latencyFile) {
+                latency.dumpJson(latencyFile);
+            }
+        }
+    }
+
+    if (latencyFile) {
+        latency.dumpJson(latencyFile);
     }
+    std::cout << std::endl << latency.frames() << " frames, " << latency.line() << std::endl;
 
     // Release resources
+    preview.stop();
     cap.release();
     cv::destroyAllWindows();
 
@@ -0,0 +1,103 @@
+// Capture, overlay and encode on videotestsrc, no camera or RTSP server needed:
+//   nv12      GstCapture maps the NV12 buffer for writing, overlays are drawn into it and the
+//             same buffer goes to the encoder through appsrc
+//   bgr+copy  what main.cpp did before: videoconvert to BGR, a copy into a Mat (cv::VideoCapture),
+//             overlays on the Mat, a copy into a new buffer (cv::VideoWriter), videoconvert to I420
+// Reports frames/sec and CPU time per frame including the encoder threads (until the encoder has
+// taken the last frame), CPU copies per frame and colour conversions per frame.
+//
+// Usage: bench_publish [width] [height] [frames] [encoder]
+// encoder defaults to mpph264enc when installed and x264enc otherwise; "identity" leaves encoding
+// out, to compare the paths alone
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <chrono>
+
+#include <opencv2/opencv.hpp>
+
+#include "gst_capture.h"
+#include "gst_publisher.h"
+#include "nv12_overlay.h"
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static bool run(const char* name, const std::string& source, const std::string& encoder, int width, int height,
+                bool nv12) {
+    GstCapture capture;
+    capture.setWritable(nv12);
+    // no drops: every frame of the source is encoded
+    if (!capture.open(source, width, height, 0, nv12 ? "NV12" : "BGR", 4, false)) {
+        printf("%-9s failed to open: %s\n", name, capture.description().c_str());
+        return false;
+    }
+    GstPublisher publisher;
+    if (!publisher.open(encoder, "fakesink", width, height, 30, nv12 ? "NV12" : "BGR")) {
+        printf("%-9s failed to open: %s\n", name, publisher.description().c_str());
+        return false;
+    }
+
+    cv::Mat mat;
+    uint64_t frame_bytes = 0, copied_bytes = 0;
+    int count = 0;
+    double cpu_start = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    GstFrame frame;
+    while (capture.read(frame, 5000)) {
+        size_t size = gst_buffer_get_size(frame.buffer());
+        frame_bytes += size;
+        char text[32];
+        snprintf(text, sizeof(text), "frame %d", count);
+        if (nv12) {
+            Nv12Overlay overlay(frame.writable_plane(0), frame.stride(0), frame.writable_plane(1), frame.stride(1),
+                                width, height);
+            overlay.rectangle(cv::Rect(8, 8, 240, 44), cv::Scalar(0, 0, 0), -1);
+            overlay.text(text, cv::Point(16, 40), 1.0, cv::Scalar(255, 255, 255));
+            publisher.push(frame);
+        } else {
+            // cv::Mat copy of the appsink buffer
+            cv::Mat(height, width, CV_8UC3, (void*)frame.plane(0), frame.stride(0)).copyTo(mat);
+            copied_bytes += mat.total() * mat.elemSize();
+            cv::rectangle(mat, cv::Rect(8, 8, 240, 44), cv::Scalar(0, 0, 0), -1);
+            cv::putText(mat, text, cv::Point(16, 40), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(255, 255, 255), 2);
+            publisher.pushCopy(mat.data, mat.total() * mat.elemSize());
+        }
+        frame.reset();
+        count++;
+    }
+    copied_bytes += publisher.copiedBytes() + capture.copiedFrames() * (frame_bytes / (count > 0 ? count : 1));
+    publisher.close();
+    auto end = std::chrono::steady_clock::now();
+    double cpu = cpuSeconds() - cpu_start;
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    printf("%-9s %dx%d frames=%-5d fps=%8.1f cpu/frame=%6.3fms copies/frame=%.2f conversions/frame=%d encoded=%llu\n",
+           name, width, height, count, count / seconds, count > 0 ? cpu * 1000 / count : 0.0,
+           frame_bytes > 0 ? (double)copied_bytes / frame_bytes : 0.0, nv12 ? 0 : 2,
+           (unsigned long long)publisher.frames());
+    return count > 0 && publisher.frames() == (uint64_t)count;
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? atoi(argv[1]) : 1280;
+    int height = argc > 2 ? atoi(argv[2]) : 720;
+    int frames = argc > 3 ? atoi(argv[3]) : 300;
+
+    gst_init(&argc, &argv);
+    std::string encoder = argc > 4 ? argv[4] : GstPublisher::defaultEncoder();
+    std::string source = "videotestsrc pattern=ball num-buffers=" + std::to_string(frames);
+    printf("encoder: %s\n", encoder.c_str());
+    bool ok = run("nv12", source, encoder, width, height, true);
+    ok = run("bgr+copy", source + " ! video/x-raw, format=NV12 ! videoconvert", encoder, width, height, false) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Capture decoupled from its sinks, no camera, encoder or window needed. A producer stands in
+// for a camera at a fixed frame rate; it feeds a "publish" sink that stalls like a slow RTSP
+// client (publish_ms per frame and a 500 ms stall every 100th frame) and a "display" sink taking
+// display_ms per frame.
+//   serial   capture, publish and display back to back on one thread, as main.cpp used to
+//   staged   a SinkStage per sink, each with its own queue and drop policy
+// Reports for the producer the frames it missed (a camera would overrun) and the longest time
+// it spent handing a frame over, and per sink the frames consumed and dropped and the latency.
+//
+// Usage: bench_sink_stage [fps] [publish_ms] [display_ms] [seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "frame_queue.h"
+#include "latency_histogram.h"
+#include "sink_stage.h"
+
+struct Frame {
+    uint64_t seq;
+};
+
+static void work(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static void publishWork(uint64_t seq, int publish_ms) {
+    work(seq % 100 == 99 ? 500 : publish_ms);
+}
+
+// Camera clock: frames due since start that the producer did not pick up in time are missed
+struct Camera {
+    int64_t period_ns;
+    int64_t start_ns;
+    uint64_t next;
+    uint64_t missed;
+
+    Camera(int fps) : period_ns(1000000000LL / fps), start_ns(frameQueueNowNs()), next(0), missed(0) {}
+
+    // Waits for the next frame; false once seconds are over
+    bool wait(int seconds) {
+        int64_t now = frameQueueNowNs();
+        uint64_t due = (now - start_ns) / period_ns;
+        if (due > next) {
+            missed += due - next;  // overrun: the buffers were not dequeued in time
+            next = due;
+        }
+        int64_t at = start_ns + (int64_t)next * period_ns;
+        if (at > start_ns + seconds * 1000000000LL) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(at - now));
+        next++;
+        return true;
+    }
+};
+
+static void runSerial(int fps, int publish_ms, int display_ms, int seconds) {
+    Camera camera(fps);
+    uint64_t frames = 0;
+    int64_t longest = 0;
+    LatencyHistogram latency;
+    while (camera.wait(seconds)) {
+        int64_t captured = frameQueueNowNs();
+        publishWork(frames, publish_ms);
+        work(display_ms);
+        int64_t done = frameQueueNowNs();
+        longest = std::max(longest, done - captured);
+        latency.record((done - captured) / 1000);
+        frames++;
+    }
+    printf("serial  captured %llu, missed %llu, longest hand-over %.1f ms, latency p50/p99 %.1f/%.1f ms\n",
+           (unsigned long long)frames, (unsigned long long)camera.missed, longest / 1e6, latency.percentile(50) / 1000.0,
+           latency.percentile(99) / 1000.0);
+}
+
+static void runStaged(int fps, int publish_ms, int display_ms, int seconds) {
+    BackpressureConfig config;
+    SinkStage<Frame> publish("publish", 4, config);
+    SinkStage<Frame> display("display", 1, config);
+    FramePool<Frame> pool(4 + 1 + 3, [](Frame&) {});
+    publish.start([publish_ms](const FrameRef<Frame>& frame) {
+        publishWork(frame->seq, publish_ms);
+        return true;
+    });
+    display.start([display_ms](const FrameRef<Frame>&) {
+        work(display_ms);
+        return true;
+    });
+
+    Camera camera(fps);
+    uint64_t frames = 0, pool_dropped = 0;
+    int64_t longest = 0;
+    while (camera.wait(seconds)) {
+        int64_t captured = frameQueueNowNs();
+        FrameRef<Frame> frame = pool.acquire();
+        if (frame) {
+            frame->seq = frames;
+            frame.timestamp() = captured;
+            publish.offer(frame);
+            display.offer(frame);
+        } else {
+            pool_dropped++;
+        }
+        frame.reset();
+        longest = std::max(longest, frameQueueNowNs() - captured);
+        frames++;
+    }
+    publish.stop();
+    display.stop();
+    printf("staged  captured %llu, missed %llu, longest hand-over %.3f ms, pool full %llu\n",
+           (unsigned long long)frames, (unsigned long long)camera.missed, longest / 1e6,
+           (unsigned long long)pool_dropped);
+    SinkStage<Frame>* sinks[2] = {&publish, &display};
+    for (int i = 0; i < 2; i++) {
+        LatencyHistogram latency = sinks[i]->latency();
+        printf("        %-7s consumed %llu/%llu, dropped %llu, latency p50/p99 %.1f/%.1f ms\n",
+               sinks[i]->name().c_str(), (unsigned long long)sinks[i]->consumed(),
+               (unsigned long long)sinks[i]->offered(), (unsigned long long)sinks[i]->queue().dropped(),
+               latency.percentile(50) / 1000.0, latency.percentile(99) / 1000.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    int fps = argc > 1 ? atoi(argv[1]) : 30;
+    int publish_ms = argc > 2 ? atoi(argv[2]) : 20;
+    int display_ms = argc > 3 ? atoi(argv[3]) : 10;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+
+    printf("camera %d fps, publish %d ms/frame (500 ms stall every 100th), display %d ms/frame, %d s\n", fps,
+           publish_ms, display_ms, seconds);
+    runSerial(fps, publish_ms, display_ms, seconds);
+    runStaged(fps, publish_ms, display_ms, seconds);
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include "gst_publisher.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <gst/app/gstappsrc.h>
+
+GstPublisher::GstPublisher()
+    : pipeline_(nullptr), src_(nullptr), fps_(30), frames_(0), copied_bytes_(0), first_pts_(-1) {}
+
+GstPublisher::~GstPublisher() {
+    close();
+}
+
+std::string GstPublisher::defaultEncoder() {
+    if (!gst_is_initialized()) {
+        gst_init(nullptr, nullptr);
+    }
+    GstElementFactory* factory = gst_element_factory_find("mpph264enc");
+    if (factory) {
+        gst_object_unref(factory);
+        return "mpph264enc bps=8000";
+    }
+    return "x264enc tune=zerolatency speed-preset=ultrafast bitrate=8000";
+}
+
+std::string GstPublisher::sinkFor(const std::string& location) {
+    if (location.compare(0, 7, "rtsp://") == 0) {
+        return "h264parse ! rtspclientsink location=" + location;
+    }
+    if (location == "fakesink") {
+        return "fakesink sync=false";
+    }
+    return location;
+}
+
+void GstPublisher::logBusErrors() {
+    GstBus* bus = gst_element_get_bus(pipeline_);
+    GstMessage* msg;
+    while ((msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR)) != nullptr) {
+        GError* error = nullptr;
+        gchar* debug = nullptr;
+        gst_message_parse_error(msg, &error, &debug);
+        std::cerr << "Error: " << GST_OBJECT_NAME(msg->src) << ": " << error->message << std::endl;
+        g_error_free(error);
+        g_free(debug);
+        gst_message_unref(msg);
+    }
+    gst_object_unref(bus);
+}
+
+bool GstPublisher::open(const std::string& encoder, const std::string& sink, int width, int height, int fps,
+                        const std::string& format) {
+    close();
+    if (!gst_is_initialized()) {
+        gst_init(nullptr, nullptr);
+    }
+
+    std::string caps = "video/x-raw, format=" + format + ", width=" + std::to_string(width) +
+                       ", height=" + std::to_string(height) + ", framerate=" + std::to_string(fps) + "/1";
+    // NV12 and I420 are what the encoders take; anything else is the former cv::VideoWriter path
+    std::string convert = format == "NV12" || format == "I420" ? "" : "videoconvert ! video/x-raw, format=I420 ! ";
+    // enc and out name the last element of the encoder and of the sink, for the stage probes
+    description_ = "appsrc name=src is-live=true format=time block=true caps=\"" + caps + "\" ! " + convert +
+                   encoder + (on_stage_ ? " name=enc ! " : " ! ") + sink + (on_stage_ ? " name=out" : "");
+
+    GError* error = nullptr;
+    pipeline_ = gst_parse_launch(description_.c_str(), &error);
+    if (error) {
+        std::cerr << "Error: " << error->message << std::endl;
+        g_error_free(error);
+        if (pipeline_) {
+            gst_object_unref(pipeline_);
+            pipeline_ = nullptr;
+        }
+        return false;
+    }
+    src_ = gst_bin_get_by_name(GST_BIN(pipeline_), "src");
+    fps_ = fps > 0 ? fps : 30;
+    frames_ = 0;
+    copied_bytes_ = 0;
+    first_pts_ = -1;
+    if (on_stage_) {
+        addStageProbe("enc", STAGE_ENCODED);
+        addStageProbe("out", STAGE_SENT);
+    }
+
+    if (gst_element_set_state(pipeline_, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        logBusErrors();
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Buffers leaving the encoder (its src pad) or entering the sink: its sink pad, or the first
+// request pad for sinks without one (rtspclientsink)
+void GstPublisher::addStageProbe(const char* element, Stage stage) {
+    GstElement* e = gst_bin_get_by_name(GST_BIN(pipeline_), element);
+    if (!e) {
+        return;
+    }
+    GstPad* pad = gst_element_get_static_pad(e, stage == STAGE_ENCODED ? "src" : "sink");
+    if (!pad) {
+        GstIterator* it = gst_element_iterate_sink_pads(e);
+        GValue item = G_VALUE_INIT;
+        if (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+            pad = GST_PAD(g_value_dup_object(&item));
+            g_value_unset(&item);
+        }
+        gst_iterator_free(it);
+    }
+    if (pad) {
+        // The probe gets this as user data, the pad tells which stage it is
+        g_object_set_data(G_OBJECT(pad), "publish-stage", GINT_TO_POINTER(stage + 1));
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, onBuffer, this, nullptr);
+        gst_object_unref(pad);
+    } else {
+        std::cerr << "Warning: no pad to time the " << element << " stage on" << std::endl;
+    }
+    gst_object_unref(e);
+}
+
+GstPadProbeReturn GstPublisher::onBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    GstPublisher* self = static_cast<GstPublisher*>(user_data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    int stage = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(pad), "publish-stage")) - 1;
+    // Codec headers and the like carry no PTS. first_pts_ was set before the first buffer went out.
+    if (buffer && stage >= 0 && GST_BUFFER_PTS_IS_VALID(buffer)) {
+        int64_t first = self->first_pts_ >= 0 ? self->first_pts_ : 0;
+        self->on_stage_((int64_t)GST_BUFFER_PTS(buffer) + first, (Stage)stage);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+bool GstPublisher::pushBuffer(GstBuffer* buffer, int64_t pts_ns) {
+    // Timestamps from 0: the capture PTS when there is one, the frame count otherwise
+    GstClockTime duration = GST_SECOND / fps_;
+    if (pts_ns > 0) {
+        if (first_pts_ < 0) {
+            first_pts_ = pts_ns;
+        }
+        GST_BUFFER_PTS(buffer) = pts_ns - first_pts_;
+    } else {
+        GST_BUFFER_PTS(buffer) = frames_ * duration;
+    }
+    GST_BUFFER_DURATION(buffer) = duration;
+
+    // Takes the buffer
+    if (gst_app_src_push_buffer(GST_APP_SRC(src_), buffer) != GST_FLOW_OK) {
+        logBusErrors();
+        return false;
+    }
+    frames_++;
+    return true;
+}
+
+bool GstPublisher::push(const GstFrame& frame) {
+    if (!pipeline_ || frame.empty()) {
+        return false;
+    }
+    // New metadata (the PTS) over the same memory: the pixels are shared, not copied
+    GstBuffer* buffer = gst_buffer_copy(frame.buffer());
+    return pushBuffer(buffer, (int64_t)frame.pts_ns());
+}
+
+bool GstPublisher::push(uint8_t* data, size_t size, void (*release)(void*), void* user) {
+    if (!pipeline_) {
+        if (release) {
+            release(user);
+        }
+        return false;
+    }
+    GstBuffer* buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, data, size, 0, size, user, release);
+    return pushBuffer(buffer, 0);
+}
+
+bool GstPublisher::pushCopy(const uint8_t* data, size_t size) {
+    if (!pipeline_) {
+        return false;
+    }
+    GstBuffer* buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+    gst_buffer_fill(buffer, 0, data, size);
+    copied_bytes_ += size;
+    return pushBuffer(buffer, 0);
+}
+
+void GstPublisher::close() {
+    if (pipeline_) {
+        // Let the encoder and the sink finish the stream
+        gst_app_src_end_of_stream(GST_APP_SRC(src_));
+        GstBus* bus = gst_element_get_bus(pipeline_);
+        GstMessage* msg =
+            gst_bus_timed_pop_filtered(bus, 5 * GST_SECOND, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        if (msg) {
+            gst_message_unref(msg);
+        }
+        gst_object_unref(bus);
+        gst_element_set_state(pipeline_, GST_STATE_NULL);
+        gst_object_unref(src_);
+        gst_object_unref(pipeline_);
+    }
+    pipeline_ = nullptr;
+    src_ = nullptr;
+}
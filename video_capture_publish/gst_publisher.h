@@ -0,0 +1,82 @@
+#ifndef VIDEO_CAPTURE_PUBLISH_GST_PUBLISHER_H
+#define VIDEO_CAPTURE_PUBLISH_GST_PUBLISHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <gst/gst.h>
+
+#include "gst_capture.h"
+
+// Encoder pipeline fed through appsrc, the output side of GstCapture. NV12 goes to the encoder
+// as it is: a captured frame's buffer is passed on with a new reference (no conversion, no copy),
+// and memory owned by the caller is wrapped in a GstBuffer instead of being copied.
+class GstPublisher {
+public:
+    // Points a pushed frame is reported at, see onStage()
+    enum Stage {
+        STAGE_ENCODED,  // left the encoder
+        STAGE_SENT,     // reached the sink (rtspclientsink, fakesink)
+    };
+    typedef std::function<void(int64_t pts_ns, Stage stage)> StageCallback;
+
+private:
+    GstElement* pipeline_;
+    GstElement* src_;
+    std::string description_;
+    int fps_;
+    uint64_t frames_;
+    uint64_t copied_bytes_;
+    int64_t first_pts_;
+    StageCallback on_stage_;
+
+    bool pushBuffer(GstBuffer* buffer, int64_t pts_ns);
+    void logBusErrors();
+    void addStageProbe(const char* element, Stage stage);
+    static GstPadProbeReturn onBuffer(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+public:
+    GstPublisher();
+    ~GstPublisher();
+
+    GstPublisher(const GstPublisher&) = delete;
+    GstPublisher& operator=(const GstPublisher&) = delete;
+
+    // encoder e.g. defaultEncoder(), sink e.g. sinkFor("rtsp://127.0.0.1:8554/live"). NV12 and
+    // I420 go straight to the encoder; other formats (BGR from OpenCV) get a videoconvert first.
+    bool open(const std::string& encoder, const std::string& sink, int width, int height, int fps,
+              const std::string& format = "NV12");
+
+    // Zero copy: the encoder gets the captured buffer itself, in whatever memory it lives in
+    bool push(const GstFrame& frame);
+
+    // Zero copy: size bytes at data in the default layout of the caps; release(user) runs once
+    // the encoder is done with them
+    bool push(uint8_t* data, size_t size, void (*release)(void*), void* user);
+
+    // Copies data into a new buffer, as cv::VideoWriter does
+    bool pushCopy(const uint8_t* data, size_t size);
+
+    // Ends the stream and waits up to 5 s for the sink to take the last frames
+    void close();
+
+    // Called on a streaming thread with GstFrame::pts_ns() of a pushed frame, once it leaves the
+    // encoder and once it reaches the sink; it may come before push() returned. Set before open().
+    void onStage(const StageCallback& callback) { on_stage_ = callback; }
+
+    bool isOpened() const { return pipeline_ != nullptr; }
+    const std::string& description() const { return description_; }
+    uint64_t frames() const { return frames_; }
+    uint64_t copiedBytes() const { return copied_bytes_; }
+
+    // mpph264enc when the Rockchip MPP plugin is installed, x264enc otherwise
+    static std::string defaultEncoder();
+
+    // "rtsp://..." publishes to an RTSP server, "fakesink" discards the stream for measurements,
+    // anything else is taken as a sink description
+    static std::string sinkFor(const std::string& location);
+};
+
+#endif  // VIDEO_CAPTURE_PUBLISH_GST_PUBLISHER_H
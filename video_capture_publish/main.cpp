@@ -2,7 +2,26 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <cstdio>
 #include <cstdlib>
+#include <ctime>
+
+#include "frame_queue.h"
+#include "gst_capture.h"
+#include "gst_publisher.h"
+#include "latency_stats.h"
+#include "nv12_overlay.h"
+#include "preview_sink.h"
+#include "sink_stage.h"
+
+// Frames each sink may fall behind before its policy drops some
+#define PUBLISH_QUEUE_SIZE 4
+#define DISPLAY_QUEUE_SIZE 1
 
 // Build GStreamer pipeline string for V4L2 device
 std::string buildGstreamerPipeline(const std::string& device, int width, int height, int fps) {
@@ -14,32 +33,51 @@ std::string buildGstreamerPipeline(const std::string& device, int width, int hei
 
 // Build GStreamer pipeline string for RTSP streaming
 std::string buildRtspOutputPipeline(const std::string& rtspUrl, int width, int height, int fps) {
-    std::string pipeline = "appsrc ! videoconvert ! video/x-raw, format=I420 ! mpph264enc bps=8000 ! h264parse ! rtspclientsink location=";
-    pipeline += rtspUrl;
+    std::string pipeline = "appsrc ! videoconvert ! video/x-raw, format=I420 ! " + GstPublisher::defaultEncoder() + " ! ";
+    pipeline += GstPublisher::sinkFor(rtspUrl);
     return pipeline;
 }
 
-int main(int argc, char** argv) {
-    // Set environment variables for RGA hardware acceleration
-    setenv("GST_VIDEO_CONVERT_USE_RGA", "1", 1);
-    setenv("GST_VIDEO_FLIP_USE_RGA", "1", 1);
+// On-screen text of both paths: frame rate and wall clock time
+std::string overlayText(double fps) {
+    char clock[16];
+    time_t now = time(nullptr);
+    strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&now));
+    char text[64];
+    snprintf(text, sizeof(text), "%s  %.1f fps", clock, fps);
+    return text;
+}
 
-    // Check command line arguments
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <v4l2_device> <rtsp_url> [width] [height] [fps]" << std::endl;
-        return -1;
-    }
+// Frame rate over the real length of the window, not a truncated second
+struct FpsCounter {
+    std::chrono::steady_clock::time_point start;
+    int frames;
+    double fps;
 
-    std::string device = argv[1];
-    std::string rtspUrl = argv[2];
-    int width = (argc >= 4) ? std::stoi(argv[3]) : 1280;
-    int height = (argc >= 5) ? std::stoi(argv[4]) : 720;
-    int fps = (argc >= 6) ? std::stoi(argv[5]) : 25;
+    FpsCounter() : start(std::chrono::steady_clock::now()), frames(0), fps(0) {}
 
+    bool tick() {
+        frames++;
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - start).count();
+        if (seconds < 1.0) {
+            return false;
+        }
+        fps = frames / seconds;
+        frames = 0;
+        start = now;
+        return true;
+    }
+};
+
+// Former path: BGR from cv::VideoCapture, overlays on the BGR image, cv::VideoWriter converts
+// back to I420 for the encoder. Two conversions and two copies per frame.
+int runBgr(const std::string& device, const std::string& rtspUrl, int width, int height, int fps,
+           const PreviewConfig& previewConfig) {
     // Build input and output GStreamer pipelines
     std::string inputPipeline = buildGstreamerPipeline(device, width, height, fps);
     std::string outputPipeline = buildRtspOutputPipeline(rtspUrl, width, height, fps);
-    
+
     std::cout << "Input pipeline: " << inputPipeline << std::endl;
     std::cout << "Output pipeline: " << outputPipeline << std::endl;
 
@@ -63,17 +101,19 @@ int main(int argc, char** argv) {
     }
 
     // Create window
-    cv::namedWindow("GStreamer Video", cv::WINDOW_NORMAL);
-    cv::resizeWindow("GStreamer Video", width, height);
+    if (previewConfig.mode == PREVIEW_FULL) {
+        cv::namedWindow("GStreamer Video", cv::WINDOW_NORMAL);
+        cv::resizeWindow("GStreamer Video", width, height);
+    }
+    BgrPreview preview("GStreamer Video", previewConfig, width, height);
 
     cv::Mat frame;
-    auto prevTime = std::chrono::high_resolution_clock::now();
-    int frameCount = 0;
+    FpsCounter counter;
 
     std::cout << "Start playing video and streaming to RTSP..." << std::endl;
     std::cout << "Press 'q' to quit" << std::endl;
 
-    while (true) {
+    while (!stopRequested()) {
         // Read a frame
         cap >> frame;
 
@@ -83,35 +123,328 @@ int main(int argc, char** argv) {
             break;
         }
 
+        cv::putText(frame, overlayText(counter.fps), cv::Point(16, 40), cv::FONT_HERSHEY_SIMPLEX, 1.0,
+                    cv::Scalar(255, 255, 255), 2);
+
         // Write frame to RTSP stream
         writer.write(frame);
 
         // Calculate FPS
-        frameCount++;
-        auto currTime = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(currTime - prevTime).count();
-
-        if (duration >= 1) {
-            std::cout << "\rCurrent FPS: " << frameCount / duration << "    " << std::flush;
-            frameCount = 0;
-            prevTime = currTime;
+        if (counter.tick()) {
+            std::cout << "\rCurrent FPS: " << cv::format("%.1f", counter.fps) << "    " << std::flush;
         }
 
-        // Show frame
-        cv::imshow("GStreamer Video", frame);
+        int key = -1;
+        if (previewConfig.mode == PREVIEW_FULL) {
+            // Show frame
+            cv::imshow("GStreamer Video", frame);
+            key = cv::waitKey(1);
+        } else {
+            key = preview.offer(frame);
+        }
 
         // Press 'q' to quit
-        if (cv::waitKey(1) == 'q') {
+        if (key == 'q') {
             break;
         }
     }
 
     // Release resources
+    preview.stop();
     writer.release();
     cap.release();
     cv::destroyAllWindows();
+    return 0;
+}
 
-    std::cout << std::endl << "Exited." << std::endl;
+// Slot of the frame pool shared by the sinks; it only holds a reference to the buffer
+struct PublishFrame {
+    GstFrame frame;
+    FrameTimestamps times;
+};
 
+inline void frame_pool_recycle(PublishFrame& frame) {
+    frame.frame.reset();
+    frame.times.clear();
+}
+
+// Publish path latency: capture, overlays drawn (process), encoded, handed to the sink. The two
+// last stages are reported by encoder pad probes on streaming threads, hence the lock.
+struct PublishLatency {
+    std::mutex mutex;
+    LatencyStats stats;
+    std::map<int64_t, FrameTimestamps> pending;  // by GstFrame::pts_ns(), pushed and not at the sink yet
+
+    void pushed(int64_t pts_ns, const FrameTimestamps& times) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[pts_ns] = times;
+        // Frames the encoder dropped are never reported
+        if (pending.size() > 64) {
+            pending.erase(pending.begin());
+        }
+    }
+
+    void reached(int64_t pts_ns, GstPublisher::Stage stage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pending.find(pts_ns);
+        if (it == pending.end()) {
+            return;
+        }
+        if (stage == GstPublisher::STAGE_ENCODED) {
+            // The first buffer of the frame, an encoder may split it
+            if (it->second.ns[STAGE_ENCODE] == 0) {
+                it->second.mark(STAGE_ENCODE);
+            }
+            return;
+        }
+        it->second.mark(STAGE_PUBLISH);
+        stats.add(it->second);
+        // Frames before it did not make it to the sink
+        pending.erase(pending.begin(), ++it);
+    }
+
+    std::string line(const char* dump_file) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (dump_file) {
+            stats.dumpJson(dump_file);
+        }
+        return stats.line();
+    }
+};
+
+// Capture thread: overlays, then the frame is offered to every sink. Never waits for a sink;
+// a frame no sink has room for is dropped right away and its buffer goes back to the source.
+void captureThread(GstCapture& cap, FramePool<PublishFrame>& pool, SinkStage<PublishFrame>& publish,
+                   SinkStage<PublishFrame>& display, PreviewSink<GstFrame>& preview, PreviewMode previewMode,
+                   std::atomic<bool>& running, std::atomic<double>& capture_fps, std::atomic<uint64_t>& pool_dropped) {
+    FpsCounter counter;
+    while (running) {
+        GstFrame captured;
+        if (!cap.read(captured, 1000)) {
+            if (cap.isEos()) {
+                break;
+            }
+            std::cerr << "Failed to read frame" << std::endl;
+            continue;
+        }
+        if (captured.format() != GST_VIDEO_FORMAT_NV12) {
+            std::cerr << "Error: expected NV12 frames" << std::endl;
+            break;
+        }
+        if (counter.tick()) {
+            capture_fps = counter.fps;
+        }
+
+        FrameRef<PublishFrame> frame = pool.acquire();
+        if (!frame) {
+            // Every slot is queued or in a sink
+            pool_dropped++;
+            continue;
+        }
+
+        // Overlays in NV12, on the captured buffer itself, before the sinks share it
+        Nv12Overlay overlay(captured.writable_plane(0), captured.stride(0), captured.writable_plane(1),
+                            captured.stride(1), captured.width(), captured.height());
+        overlay.rectangle(cv::Rect(8, 8, 360, 44), cv::Scalar(0, 0, 0), -1);
+        overlay.text(overlayText(counter.fps), cv::Point(16, 40), 1.0, cv::Scalar(255, 255, 255));
+        frame->frame = captured;
+        frame->times.ns[STAGE_CAPTURE] = captured.capture_ns();
+        frame->times.mark(STAGE_PROCESS);
+        frame.seq() = captured.seq();
+        frame.timestamp() = captured.capture_ns();
+        publish.offer(frame);
+        if (previewMode == PREVIEW_FULL) {
+            display.offer(frame);
+        } else if (previewMode == PREVIEW_SCALED) {
+            preview.offer(captured);
+        }
+    }
+    running = false;
+}
+
+// NV12 end to end: overlays are drawn into the captured buffer and the same buffer goes to the
+// encoder through appsrc. Only the preview window converts, to BGR for imshow.
+// Capture, encoder and window run on their own threads with a bounded queue and a drop policy
+// per sink, so neither a slow RTSP client nor a slow display holds up the camera. The full size
+// window (PREVIEW=full) is on the main thread; the scaled preview is a PreviewSink taking the
+// latest frame, and headless runs have no window at all.
+int runNv12(const std::string& device, const std::string& rtspUrl, int width, int height, int fps,
+            const BackpressureConfig& publishPolicy, const BackpressureConfig& displayPolicy,
+            const PreviewConfig& previewConfig) {
+    GstCapture cap;
+    cap.setWritable(true);
+    if (!cap.open(GstCapture::sourceFor(device, width, height, fps), width, height, fps)) {
+        std::cerr << "Failed to open video stream" << std::endl;
+        return -1;
+    }
+    std::cout << "Input pipeline: " << cap.description() << std::endl;
+
+    SinkStage<PublishFrame> publish("publish", PUBLISH_QUEUE_SIZE, publishPolicy);
+    SinkStage<PublishFrame> display("display", DISPLAY_QUEUE_SIZE, displayPolicy);
+    // Queued frames, one in each sink and one released by a drop
+    FramePool<PublishFrame> pool(PUBLISH_QUEUE_SIZE + DISPLAY_QUEUE_SIZE + 3, [](PublishFrame&) {});
+
+    // Capture to sink latency, dumped as JSON every second when LATENCY_STATS=<file> is set
+    PublishLatency latency;
+    const char* latencyFile = getenv("LATENCY_STATS");
+
+    // Opened on the first frame, which has the actual video size
+    GstPublisher publisher;
+    publisher.onStage([&](int64_t pts_ns, GstPublisher::Stage stage) { latency.reached(pts_ns, stage); });
+    publish.start([&](const FrameRef<PublishFrame>& frame) {
+        if (!publisher.isOpened()) {
+            if (!publisher.open(GstPublisher::defaultEncoder(), GstPublisher::sinkFor(rtspUrl), frame->frame.width(),
+                                frame->frame.height(), fps)) {
+                std::cerr << "Failed to open RTSP output stream" << std::endl;
+                return false;
+            }
+            std::cout << "Output pipeline: " << publisher.description() << std::endl;
+        }
+        // Zero copy into the encoder; blocks while appsrc is full, which only holds up this sink.
+        // The probes may report the frame before push() returns.
+        latency.pushed((int64_t)frame->frame.pts_ns(), frame->times);
+        if (!publisher.push(frame->frame)) {
+            std::cerr << "Failed to write frame" << std::endl;
+            return false;
+        }
+        return true;
+    });
+
+    PreviewSink<GstFrame> preview("GStreamer Video", previewConfig, [](const GstFrame& f, double scale, cv::Mat& bgr) {
+        renderNv12Preview(f.plane(0), f.stride(0), f.plane(1), f.stride(1), f.width(), f.height(), scale, bgr);
+    });
+    if (previewConfig.mode == PREVIEW_SCALED) {
+        preview.start();
+    } else if (previewConfig.mode == PREVIEW_FULL) {
+        cv::namedWindow("GStreamer Video", cv::WINDOW_NORMAL);
+    }
+
+    std::atomic<bool> running(true);
+    std::atomic<double> capture_fps(0.0);
+    std::atomic<uint64_t> pool_dropped(0);
+    std::thread capture(captureThread, std::ref(cap), std::ref(pool), std::ref(publish), std::ref(display),
+                        std::ref(preview), previewConfig.mode, std::ref(running), std::ref(capture_fps),
+                        std::ref(pool_dropped));
+
+    bool sized = false;
+    cv::Mat bgr;
+
+    std::cout << "Start playing video and streaming to RTSP..." << std::endl;
+    std::cout << "Press 'q' to quit" << std::endl;
+
+    auto show = [&](const FrameRef<PublishFrame>& frame) {
+        const GstFrame& f = frame->frame;
+        if (!sized) {
+            std::cout << "Video size: " << f.width() << "x" << f.height() << std::endl;
+            cv::resizeWindow("GStreamer Video", f.width(), f.height());
+            sized = true;
+        }
+        cv::Mat y(f.height(), f.width(), CV_8UC1, (void*)f.plane(0), f.stride(0));
+        cv::Mat uv(f.height() / 2, f.width() / 2, CV_8UC2, (void*)f.plane(1), f.stride(1));
+        cv::cvtColorTwoPlane(y, uv, bgr, cv::COLOR_YUV2BGR_NV12);
+        cv::imshow("GStreamer Video", bgr);
+        return true;
+    };
+    auto last_status = std::chrono::steady_clock::now();
+    while (running && !publish.ended() && !stopRequested()) {
+        int key = -1;
+        if (previewConfig.mode == PREVIEW_FULL) {
+            display.poll(show, 10);
+            // Called with or without a new frame to keep the window responsive
+            key = cv::waitKey(1);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            key = preview.key();
+        }
+
+        // Press 'q' to quit
+        if (key == 'q') {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_status >= std::chrono::seconds(1)) {
+            std::cout << "\rCapture: " << cv::format("%.1f", capture_fps.load()) << " fps, pool full "
+                      << pool_dropped << ", copied " << cap.copiedFrames() << " | " << publish.line();
+            if (previewConfig.mode == PREVIEW_FULL) {
+                std::cout << " | " << display.line();
+            } else if (previewConfig.mode == PREVIEW_SCALED) {
+                std::cout << " | preview " << preview.shown() << "/" << preview.offered();
+            }
+            std::cout << " | " << latency.line(latencyFile) << "    " << std::flush;
+            last_status = now;
+        }
+    }
+
+    running = false;
+    capture.join();
+    // The encoder gets the frames still queued, then the end of the stream
+    preview.stop();
+    display.stop();
+    publish.stop();
+    publisher.close();
+    cap.close();
+    cv::destroyAllWindows();
+    std::cout << std::endl
+              << "Captured " << cap.frames() << ", published " << publish.consumed() << "/" << publish.offered()
+              << ", displayed " << display.consumed() + preview.shown() << std::endl;
+    std::cout << "Publish " << latency.line(latencyFile) << std::endl;
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv) {
+    // Set environment variables for RGA hardware acceleration
+    setenv("GST_VIDEO_CONVERT_USE_RGA", "1", 1);
+    setenv("GST_VIDEO_FLIP_USE_RGA", "1", 1);
+
+    // Check command line arguments
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <v4l2_device|video_file|source> <rtsp_url|fakesink|sink> [width] [height] [fps] [nv12|bgr]"
+                     " [publish_policy] [display_policy]"
+                  << std::endl;
+        return -1;
+    }
+
+    std::string device = argv[1];
+    std::string rtspUrl = argv[2];
+    int width = (argc >= 4) ? std::stoi(argv[3]) : 1280;
+    int height = (argc >= 5) ? std::stoi(argv[4]) : 720;
+    int fps = (argc >= 6) ? std::stoi(argv[5]) : 25;
+    std::string mode = (argc >= 7) ? argv[6] : "nv12";
+
+    // Encoder: drop the oldest queued frame, the stream stays close to live. Window: show the
+    // latest frame only.
+    BackpressureConfig publishPolicy, displayPolicy;
+    std::string policies[2] = {(argc >= 8) ? argv[7] : "drop-oldest", (argc >= 9) ? argv[8] : "drop-oldest"};
+    if (!parseBackpressure(policies[0], publishPolicy) || !parseBackpressure(policies[1], displayPolicy)) {
+        std::cerr << "Unknown policy, expected drop-oldest, drop-newest, keep-every=N or latency-target=MS"
+                  << std::endl;
+        return -1;
+    }
+
+    // Window: PREVIEW=off|full|FPS[@SCALE], a 10 fps half size preview by default, headless
+    // without a display
+    PreviewConfig previewConfig;
+    if (!previewFromEnv(previewConfig)) {
+        std::cerr << "Unknown PREVIEW, expected off, full or FPS[@SCALE]" << std::endl;
+        return -1;
+    }
+    std::cout << "Preview: " << previewName(previewConfig) << std::endl;
+    // Ctrl-C ends headless runs
+    handleStopSignals();
+
+    int ret;
+    if (mode == "bgr") {
+        ret = runBgr(device, rtspUrl, width, height, fps, previewConfig);
+    } else if (mode == "nv12") {
+        ret = runNv12(device, rtspUrl, width, height, fps, publishPolicy, displayPolicy, previewConfig);
+    } else {
+        std::cerr << "Unknown mode: " << mode << std::endl;
+        return -1;
+    }
+
+    std::cout << std::endl << "Exited." << std::endl;
+
+    return ret;
+}
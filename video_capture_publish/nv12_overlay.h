@@ -0,0 +1,50 @@
+#ifndef VIDEO_CAPTURE_PUBLISH_NV12_OVERLAY_H
+#define VIDEO_CAPTURE_PUBLISH_NV12_OVERLAY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+// Draws on an NV12 image in place, without converting it: every shape goes once on the Y
+// plane at full resolution and once on the interleaved UV plane at half resolution, in the
+// color converted to BT.601 YUV.
+class Nv12Overlay {
+private:
+    cv::Mat y_;
+    cv::Mat uv_;
+
+    static cv::Rect half(const cv::Rect& r) { return cv::Rect(r.x / 2, r.y / 2, r.width / 2, r.height / 2); }
+    static int halfThickness(int thickness) { return thickness < 0 ? thickness : std::max(1, thickness / 2); }
+
+public:
+    Nv12Overlay(uint8_t* y, int y_stride, uint8_t* uv, int uv_stride, int width, int height)
+        : y_(height, width, CV_8UC1, y, y_stride), uv_(height / 2, width / 2, CV_8UC2, uv, uv_stride) {}
+
+    // BT.601 limited range, what NV12 from cameras and encoders uses
+    static void toYuv(const cv::Scalar& bgr, cv::Scalar& y, cv::Scalar& uv) {
+        double b = bgr[0], g = bgr[1], r = bgr[2];
+        y = cv::Scalar(16 + 0.257 * r + 0.504 * g + 0.098 * b);
+        uv = cv::Scalar(128 - 0.148 * r - 0.291 * g + 0.439 * b, 128 + 0.439 * r - 0.368 * g - 0.071 * b);
+    }
+
+    // thickness < 0 fills the rectangle
+    void rectangle(const cv::Rect& rect, const cv::Scalar& bgr, int thickness = 2) {
+        cv::Scalar y, uv;
+        toYuv(bgr, y, uv);
+        cv::rectangle(y_, rect, y, thickness);
+        cv::rectangle(uv_, half(rect), uv, halfThickness(thickness));
+    }
+
+    void text(const std::string& text, const cv::Point& origin, double scale, const cv::Scalar& bgr,
+              int thickness = 2) {
+        cv::Scalar y, uv;
+        toYuv(bgr, y, uv);
+        cv::putText(y_, text, origin, cv::FONT_HERSHEY_SIMPLEX, scale, y, thickness);
+        cv::putText(uv_, text, cv::Point(origin.x / 2, origin.y / 2), cv::FONT_HERSHEY_SIMPLEX, scale / 2, uv,
+                    halfThickness(thickness));
+    }
+};
+
+#endif  // VIDEO_CAPTURE_PUBLISH_NV12_OVERLAY_H
@@ -0,0 +1,149 @@
+#ifndef VIDEO_CAPTURE_PUBLISH_SINK_STAGE_H
+#define VIDEO_CAPTURE_PUBLISH_SINK_STAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "frame_queue.h"
+#include "latency_histogram.h"
+
+// One output of the capture loop (encoder, window, ...) behind a bounded FrameQueue of its own.
+// The capture loop offer()s each frame to every sink and never waits: a sink that falls behind
+// loses frames from its own queue, by its own backpressure policy, while capture and the other
+// sinks go on. The consumer runs on the stage's thread (start()) or, for outputs tied to one
+// thread such as HighGUI windows, on the caller's (poll()).
+template <typename Frame>
+class SinkStage {
+public:
+    // Called for each frame; false ends the stage, e.g. when the encoder failed
+    typedef std::function<bool(const FrameRef<Frame>&)> Consumer;
+
+    SinkStage(const std::string& name, size_t queue_size, const BackpressureConfig& config)
+        : name_(name), queue_(queue_size, config), offered_(0), consumed_(0), stopped_(false), ended_(false),
+          window_consumed_(0), window_start_ns_(frameQueueNowNs()) {}
+
+    ~SinkStage() { stop(); }
+
+    SinkStage(const SinkStage&) = delete;
+    SinkStage& operator=(const SinkStage&) = delete;
+
+    void start(Consumer consumer) {
+        thread_ = std::thread([this, consumer] {
+            while (poll(consumer, 1000)) {
+            }
+        });
+    }
+
+    // From the capture loop, never blocks. False when the policy dropped the frame.
+    bool offer(const FrameRef<Frame>& frame) {
+        if (ended_) {
+            return false;
+        }
+        offered_++;
+        return queue_.push(frame);
+    }
+
+    // Consumes at most one frame, waiting up to timeout_ms for it. False once the stage is
+    // stopped and drained, or when the consumer returned false.
+    bool poll(const Consumer& consumer, int timeout_ms) {
+        FrameRef<Frame> frame;
+        if (!queue_.pop(frame, timeout_ms)) {
+            return !stopped_ && !ended_;
+        }
+        int64_t start_ns = frameQueueNowNs();
+        bool more = consumer(frame);
+        int64_t end_ns = frameQueueNowNs();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latency_.record((end_ns - frame.timestamp()) / 1000);
+            service_.record((end_ns - start_ns) / 1000);
+        }
+        consumed_++;
+        if (!more) {
+            ended_ = true;
+        }
+        return more;
+    }
+
+    // Lets the consumer finish the queued frames, then joins the stage's thread
+    void stop() {
+        stopped_ = true;
+        queue_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    const std::string& name() const { return name_; }
+    bool ended() const { return ended_; }
+    uint64_t offered() const { return offered_; }
+    uint64_t consumed() const { return consumed_; }
+    const FrameQueue<Frame>& queue() const { return queue_; }
+
+    // Frames consumed per second since the previous call, for one status thread
+    double windowFps() {
+        int64_t now = frameQueueNowNs();
+        uint64_t consumed = consumed_;
+        double seconds = (now - window_start_ns_) / 1e9;
+        double fps = seconds > 0 ? (consumed - window_consumed_) / seconds : 0;
+        window_consumed_ = consumed;
+        window_start_ns_ = now;
+        return fps;
+    }
+
+    // Capture to consumer done, in us
+    LatencyHistogram latency() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return latency_;
+    }
+
+    // "publish 24.9 fps, dropped 3 (oldest 3), ms p50/p99: latency 33.1/51.0 service 8.0/12.5"
+    std::string line() {
+        char buf[160];
+        double fps = windowFps();
+        LatencyHistogram latency, service;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latency = latency_;
+            service = service_;
+        }
+        std::string out(buf, snprintf(buf, sizeof(buf), "%s %.1f fps, dropped %llu", name_.c_str(), fps,
+                                      (unsigned long long)queue_.dropped()));
+        std::string reasons;
+        for (int reason = 0; reason < DROP_REASON_COUNT; reason++) {
+            uint64_t n = queue_.dropped((DropReason)reason);
+            if (n > 0) {
+                snprintf(buf, sizeof(buf), "%s%s %llu", reasons.empty() ? "" : ", ", dropReasonName(reason),
+                         (unsigned long long)n);
+                reasons += buf;
+            }
+        }
+        if (!reasons.empty()) {
+            out += " (" + reasons + ")";
+        }
+        snprintf(buf, sizeof(buf), ", ms p50/p99: latency %.1f/%.1f service %.1f/%.1f", latency.percentile(50) / 1000.0,
+                 latency.percentile(99) / 1000.0, service.percentile(50) / 1000.0, service.percentile(99) / 1000.0);
+        return out + buf;
+    }
+
+private:
+    std::string name_;
+    FrameQueue<Frame> queue_;
+    std::thread thread_;
+    std::atomic<uint64_t> offered_;
+    std::atomic<uint64_t> consumed_;
+    std::atomic<bool> stopped_;
+    std::atomic<bool> ended_;
+    mutable std::mutex mutex_;
+    LatencyHistogram latency_;
+    LatencyHistogram service_;
+    uint64_t window_consumed_;
+    int64_t window_start_ns_;
+};
+
+#endif  // VIDEO_CAPTURE_PUBLISH_SINK_STAGE_H